@@ -0,0 +1,111 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "async-buffer-processor.hpp"
+
+#include <utility>
+
+namespace {
+
+osmium::memory::Buffer new_buffer()
+{
+    return osmium::memory::Buffer{async_buffer_processor_t::BUFFER_SIZE,
+                                  osmium::memory::Buffer::auto_grow::yes};
+}
+
+} // anonymous namespace
+
+async_buffer_processor_t::async_buffer_processor_t(process_func_t func)
+: m_func(std::move(func)), m_buffer(new_buffer()),
+  m_thread([this]() { run(); })
+{}
+
+async_buffer_processor_t::~async_buffer_processor_t() noexcept
+{
+    {
+        std::lock_guard<std::mutex> const lock{m_mutex};
+        m_stopped = true;
+        m_queue.clear();
+    }
+    m_queue_cond.notify_one();
+    m_thread.join();
+}
+
+void async_buffer_processor_t::check_error()
+{
+    if (m_error) {
+        std::rethrow_exception(m_error);
+    }
+}
+
+void async_buffer_processor_t::add(osmium::OSMObject const &object)
+{
+    m_buffer.add_item(object);
+    m_buffer.commit();
+
+    if (m_buffer.committed() >= BUFFER_SIZE) {
+        send_buffer();
+    }
+}
+
+void async_buffer_processor_t::send_buffer()
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_queue_full_cond.wait(
+        lock, [&] { return m_error || m_queue.size() < MAX_QUEUED_BUFFERS; });
+    check_error();
+
+    m_queue.push_back(std::exchange(m_buffer, new_buffer()));
+    m_queue_cond.notify_one();
+}
+
+void async_buffer_processor_t::sync()
+{
+    if (m_buffer.committed() > 0) {
+        send_buffer();
+    }
+
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_queue_full_cond.wait(lock, [&] { return m_queue.empty() && !m_busy; });
+    check_error();
+}
+
+void async_buffer_processor_t::run() noexcept
+{
+    while (true) {
+        osmium::memory::Buffer buffer;
+        {
+            std::unique_lock<std::mutex> lock{m_mutex};
+            m_queue_cond.wait(lock,
+                              [&] { return m_stopped || !m_queue.empty(); });
+            if (m_stopped) {
+                return;
+            }
+            buffer = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_busy = true;
+        }
+
+        std::exception_ptr error;
+        try {
+            m_func(buffer);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> const lock{m_mutex};
+        if (error) {
+            // Nothing added after an error is processed.
+            m_error = error;
+            m_queue.clear();
+        }
+        m_busy = false;
+        m_queue_full_cond.notify_all();
+    }
+}
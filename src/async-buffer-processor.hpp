@@ -0,0 +1,98 @@
+#ifndef OSM2PGSQL_ASYNC_BUFFER_PROCESSOR_HPP
+#define OSM2PGSQL_ASYNC_BUFFER_PROCESSOR_HPP
+
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+/**
+ * \file
+ *
+ * This file contains the definition of the async_buffer_processor_t class.
+ */
+
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/object.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/**
+ * Process OSM objects in a separate thread.
+ *
+ * Objects are copied into an osmium buffer. Full buffers are handed over
+ * through a bounded queue to a worker thread which calls the processing
+ * function on them. Buffers are processed in the order they were added.
+ *
+ * If the processing function throws an exception, all objects not yet
+ * processed are discarded and the exception is rethrown in the calling
+ * thread on later calls to add() or sync().
+ */
+class async_buffer_processor_t
+{
+public:
+    using process_func_t = std::function<void(osmium::memory::Buffer const &)>;
+
+    /// Buffers are handed over when they are filled up to this size.
+    static constexpr std::size_t BUFFER_SIZE = 1024UL * 1024UL;
+
+    /// Maximum number of buffers waiting in the queue.
+    static constexpr std::size_t MAX_QUEUED_BUFFERS = 8;
+
+    explicit async_buffer_processor_t(process_func_t func);
+
+    async_buffer_processor_t(async_buffer_processor_t const &) = delete;
+    async_buffer_processor_t &
+    operator=(async_buffer_processor_t const &) = delete;
+
+    async_buffer_processor_t(async_buffer_processor_t &&) = delete;
+    async_buffer_processor_t &operator=(async_buffer_processor_t &&) = delete;
+
+    /// Stops the worker thread. Objects not yet processed are discarded.
+    ~async_buffer_processor_t() noexcept;
+
+    /// Add a copy of the object for processing.
+    void add(osmium::OSMObject const &object);
+
+    /// Hand over all objects added and wait until they are processed.
+    void sync();
+
+private:
+    void run() noexcept;
+
+    /// Hand over the current buffer to the worker thread.
+    void send_buffer();
+
+    /// Rethrow exception from worker thread. Must be called with lock held.
+    void check_error();
+
+    process_func_t m_func;
+
+    /// Buffer for adding objects, only accessed from calling thread.
+    osmium::memory::Buffer m_buffer;
+
+    std::mutex m_mutex;
+    std::condition_variable m_queue_cond;
+    std::condition_variable m_queue_full_cond;
+    std::deque<osmium::memory::Buffer> m_queue;
+    std::exception_ptr m_error;
+    bool m_busy = false;
+    bool m_stopped = false;
+
+    // This must be the last member, so that everything else is initialized
+    // before the thread starts.
+    std::thread m_thread;
+
+}; // class async_buffer_processor_t
+
+#endif // OSM2PGSQL_ASYNC_BUFFER_PROCESSOR_HPP
@@ -293,6 +293,12 @@ options_t parse_command_line(int argc, char *argv[])
         ->description("Store raw OSM data in the database."
                       " Required if you want to update with --append later.");
 
+    // --rebuild-output
+    app.add_flag("--rebuild-output", options.rebuild_output)
+        ->description("Recreate output tables from the data in the middle "
+                      "of an existing updatable database instead of reading "
+                      "input files.");
+
     // ----------------------------------------------------------------------
     // Database options
     // ----------------------------------------------------------------------
@@ -325,6 +331,21 @@ options_t parse_command_line(int argc, char *argv[])
         ->description("Enable debug logging.")
         ->group("Logging options");
 
+    // --metrics-file
+    app.add_option("--metrics-file", options.metrics_file)
+        ->description("Regularly write metrics in Prometheus text format "
+                      "to FILE.")
+        ->type_name("FILE")
+        ->group("Logging options");
+
+    // --metrics-interval
+    app.add_option("--metrics-interval", options.metrics_interval)
+        ->transform(CLI::Bound(1, 3600))
+        ->description("Interval in seconds in which the metrics file is "
+                      "written (default: 10).")
+        ->type_name("SECONDS")
+        ->group("Logging options");
+
     // ----------------------------------------------------------------------
     // Output options
     // ----------------------------------------------------------------------
@@ -343,6 +364,13 @@ options_t parse_command_line(int argc, char *argv[])
         ->check(CLI::ExistingFile)
         ->group("Output options");
 
+    // --lua-profile
+    app.add_option("--lua-profile", options.lua_profile_file)
+        ->description("Profile Lua code in flex style and write samples in "
+                      "folded stacks format to FILE.")
+        ->type_name("FILE")
+        ->group("Output options");
+
     // ----------------------------------------------------------------------
     // Pgsql output options
     // ----------------------------------------------------------------------
@@ -527,6 +555,20 @@ options_t parse_command_line(int argc, char *argv[])
         ->description("Store tagged nodes in db (new middle db format only).")
         ->group("Middle options");
 
+    // --ram-compress
+    app.add_flag("--ram-compress", options.ram_compress)
+        ->description("Compress objects stored for two-stage processing in "
+                      "the RAM middle (non-slim mode only).")
+        ->group("Middle options");
+
+    // --ram-snapshot
+    app.add_option("--ram-snapshot", options.ram_snapshot_file)
+        ->description("Snapshot file for the RAM middle. Written after import "
+                      "if it doesn't exist, used instead of filling the middle "
+                      "if it does (non-slim mode only).")
+        ->type_name("FILE")
+        ->group("Middle options");
+
     // ----------------------------------------------------------------------
     // Input options
     // ----------------------------------------------------------------------
@@ -571,6 +613,19 @@ options_t parse_command_line(int argc, char *argv[])
         ->type_name("NUM")
         ->group("Advanced options");
 
+    // --memory-budget
+    app.add_option("--memory-budget", options.memory_budget)
+        ->description("Try to keep memory used by caches, buffers, and "
+                      "queues below NUM MB (default: 0 = no budget).")
+        ->type_name("NUM")
+        ->group("Advanced options");
+
+    // --persistent
+    app.add_flag("--persistent", options.persistent)
+        ->description("Keep running and apply change files whose names are "
+                      "read from STDIN, one per line (needs --append).")
+        ->group("Advanced options");
+
     // ----------------------------------------------------------------------
     // Tablespace options
     // ----------------------------------------------------------------------
@@ -619,19 +674,56 @@ options_t parse_command_line(int argc, char *argv[])
         get_logger().set_level(log_level::debug);
     }
 
+    if (app.count("--metrics-interval") && options.metrics_file.empty()) {
+        throw std::runtime_error{
+            "--metrics-interval can only be used with --metrics-file."};
+    }
+
     if (options.append && app.count("--create")) {
         throw std::runtime_error{"--append and --create options can not be "
                                  "used at the same time!"};
     }
 
+    if (options.rebuild_output) {
+        if (options.append || app.count("--create") || options.persistent) {
+            throw std::runtime_error{
+                "--rebuild-output can not be used with --append, --create, "
+                "or --persistent."};
+        }
+        if (options.droptemp) {
+            throw std::runtime_error{
+                "--rebuild-output can not be used with --drop."};
+        }
+        if (!options.input_files.empty()) {
+            throw std::runtime_error{
+                "Input files can not be used with --rebuild-output."};
+        }
+        // The data is in the middle tables in the database.
+        options.slim = true;
+    }
+
     check_options(&options);
 
     if (options.slim) { // slim mode, use database middle
+        if (!options.ram_snapshot_file.empty()) {
+            throw std::runtime_error{
+                "Option --ram-snapshot can not be used in --slim mode."};
+        }
+        if (options.ram_compress) {
+            throw std::runtime_error{
+                "Option --ram-compress can not be used in --slim mode."};
+        }
         options.middle_database_format = 2;
     } else { // non-slim mode, use ram middle
         check_options_non_slim(app);
     }
 
+    if (!options.lua_profile_file.empty() &&
+        options.output_backend != "flex") {
+        throw std::runtime_error{
+            "--lua-profile can only be used with the flex output."};
+    }
+
     if (options.output_backend == "flex") {
         check_options_output_flex(app);
     } else if (options.output_backend == "null") {
@@ -663,7 +755,17 @@ options_t parse_command_line(int argc, char *argv[])
                          "--output-pgsql-schema parameter");
     }
 
-    if (options.input_files.empty()) {
+    if (options.persistent) {
+        if (!options.append) {
+            throw std::runtime_error{
+                "--persistent can only be used with --append."};
+        }
+        if (!options.input_files.empty()) {
+            throw std::runtime_error{
+                "Input files can not be given on the command line with "
+                "--persistent, they are read from STDIN."};
+        }
+    } else if (options.input_files.empty() && !options.rebuild_output) {
         throw std::runtime_error{
             "Missing input file(s). Try 'osm2pgsql --help'."};
     }
@@ -0,0 +1,200 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "compressed-object-store.hpp"
+
+#include "format.hpp"
+#include "ram-snapshot.hpp"
+
+#include <protozero/varint.hpp>
+
+#include <zlib.h>
+
+#include <cassert>
+#include <cstring>
+
+void compressed_object_store_t::add(osmium::OSMObject const &object)
+{
+    if (m_pending.committed() == 0) {
+        m_pending_first_id = object.id();
+    }
+
+    m_pending.add_item(object);
+    m_pending.commit();
+
+    ++m_count;
+    m_raw_size += object.padded_size();
+
+    if (m_pending.committed() >= BLOCK_SIZE) {
+        flush();
+    }
+}
+
+void compressed_object_store_t::flush()
+{
+    auto const raw_size = m_pending.committed();
+    if (raw_size == 0) {
+        return;
+    }
+
+    auto size = ::compressBound(static_cast<uLong>(raw_size));
+    m_compressed.resize(size);
+    auto const result = ::compress2(
+        reinterpret_cast<Bytef *>(m_compressed.data()), &size,
+        m_pending.data(), static_cast<uLong>(raw_size), Z_DEFAULT_COMPRESSION);
+    if (result != Z_OK) {
+        throw fmt_error("Compressing objects failed (zlib error {}).", result);
+    }
+
+    auto const offset =
+        m_data.prepare(2 * protozero::max_varint_length + size);
+    m_data.append_varint(raw_size);
+    m_data.append_varint(size);
+    m_data.append(m_compressed.data(), size);
+    m_index.add(m_pending_first_id, offset);
+
+    m_pending.clear();
+}
+
+bool compressed_object_store_t::get(osmid_t id,
+                                    osmium::memory::Buffer *buffer) const
+{
+    assert(buffer);
+
+    if (m_pending.committed() > 0 && id >= m_pending_first_id) {
+        return find_in(m_pending, id, buffer);
+    }
+
+    auto const offset = m_index.get_block(id);
+    if (offset == ordered_index_t::not_found_value()) {
+        return false;
+    }
+
+    return find_in(*get_block(offset), id, buffer);
+}
+
+bool compressed_object_store_t::find_in(osmium::memory::Buffer const &block,
+                                        osmid_t id,
+                                        osmium::memory::Buffer *buffer)
+{
+    for (auto const &object : block.select<osmium::OSMObject>()) {
+        if (object.id() == id) {
+            buffer->add_item(object);
+            buffer->commit();
+            return true;
+        }
+        if (object.id() > id) {
+            break;
+        }
+    }
+    return false;
+}
+
+compressed_object_store_t::block_t
+compressed_object_store_t::get_block(std::size_t offset) const
+{
+    {
+        std::lock_guard<std::mutex> const guard{m_cache_mutex};
+        for (auto it = m_cache.begin(); it != m_cache.end(); ++it) {
+            if (it->offset == offset) {
+                m_cache.splice(m_cache.begin(), m_cache, it);
+                return it->block;
+            }
+        }
+    }
+
+    // Decompress outside the lock so that other threads are not blocked.
+    // Two threads might decompress the same block at the same time, that's
+    // wasteful but harmless.
+    auto block = decompress_block(offset);
+
+    std::lock_guard<std::mutex> const guard{m_cache_mutex};
+    m_cache.push_front(cache_entry_t{offset, block});
+    if (m_cache.size() > CACHE_SIZE) {
+        m_cache.pop_back();
+    }
+
+    return block;
+}
+
+compressed_object_store_t::block_t
+compressed_object_store_t::decompress_block(std::size_t offset) const
+{
+    char const *data = m_data.data(offset);
+    char const *const end = m_data.end_of(offset);
+
+    auto const raw_size = protozero::decode_varint(&data, end);
+    auto const size = protozero::decode_varint(&data, end);
+    assert(data + size <= end);
+
+    auto block = std::make_shared<osmium::memory::Buffer>(
+        raw_size, osmium::memory::Buffer::auto_grow::no);
+
+    auto dest_size = static_cast<uLongf>(raw_size);
+    auto const result = ::uncompress(
+        block->reserve_space(raw_size), &dest_size,
+        reinterpret_cast<Bytef const *>(data), static_cast<uLong>(size));
+    if (result != Z_OK || dest_size != raw_size) {
+        throw fmt_error("Decompressing objects failed (zlib error {}).",
+                        result);
+    }
+    block->commit();
+
+    return block;
+}
+
+void compressed_object_store_t::clear()
+{
+    m_data.clear();
+    m_index.clear();
+    m_pending = osmium::memory::Buffer{BLOCK_SIZE * 2,
+                                       osmium::memory::Buffer::auto_grow::yes};
+    m_compressed = std::string{};
+    m_count = 0;
+    m_raw_size = 0;
+
+    std::lock_guard<std::mutex> const guard{m_cache_mutex};
+    m_cache.clear();
+}
+
+void compressed_object_store_t::write_snapshot(
+    ram_snapshot_writer_t *writer) const
+{
+    assert(writer);
+
+    m_data.write_snapshot(writer);
+    m_index.write_snapshot(writer);
+
+    writer->write_value<uint64_t>(m_pending.committed());
+    writer->write(m_pending.data(), m_pending.committed());
+    writer->write_value<osmid_t>(m_pending_first_id);
+
+    writer->write_value<uint64_t>(m_count);
+    writer->write_value<uint64_t>(m_raw_size);
+}
+
+void compressed_object_store_t::read_snapshot(ram_snapshot_reader_t *reader)
+{
+    assert(reader);
+    assert(m_count == 0);
+
+    m_data.read_snapshot(reader);
+    m_index.read_snapshot(reader);
+
+    auto const pending_size = reader->read_value<uint64_t>();
+    if (pending_size > 0) {
+        std::memcpy(m_pending.reserve_space(pending_size),
+                    reader->read(pending_size), pending_size);
+        m_pending.commit();
+    }
+    m_pending_first_id = reader->read_value<osmid_t>();
+
+    m_count = reader->read_value<uint64_t>();
+    m_raw_size = reader->read_value<uint64_t>();
+}
@@ -0,0 +1,150 @@
+#ifndef OSM2PGSQL_COMPRESSED_OBJECT_STORE_HPP
+#define OSM2PGSQL_COMPRESSED_OBJECT_STORE_HPP
+
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "ordered-index.hpp"
+#include "osmtypes.hpp"
+#include "segmented-buffer.hpp"
+
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/object.hpp>
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class ram_snapshot_reader_t;
+class ram_snapshot_writer_t;
+
+/**
+ * Store for complete OSM objects (with tags and attributes) of one type
+ * which keeps them compressed in memory.
+ *
+ * Objects are collected into blocks of about BLOCK_SIZE bytes. When a block
+ * is full it is compressed with zlib and added to the data store. The
+ * deflate algorithm removes most of the redundancy of the tags and user
+ * names which tend to repeat a lot in neighbouring objects. The index
+ * points from the first id in each block to the block.
+ *
+ * To get an object, the block containing it is decompressed. A small cache
+ * of recently decompressed blocks makes this cheap if objects are accessed
+ * in roughly id order.
+ *
+ * Ids must be added in strictly ascending order. Getting objects is
+ * thread-safe, adding objects is not.
+ */
+class compressed_object_store_t
+{
+public:
+    /// Size of the uncompressed data in a block from which it is compressed.
+    static constexpr std::size_t BLOCK_SIZE = 64UL * 1024UL;
+
+    /// Maximum number of decompressed blocks in the cache.
+    static constexpr std::size_t CACHE_SIZE = 16;
+
+    /**
+     * Add an object to the store.
+     *
+     * \pre id must be strictly larger than all ids stored before.
+     */
+    void add(osmium::OSMObject const &object);
+
+    /**
+     * Get the object with the specified id and add it to the buffer.
+     *
+     * \returns True if the object was found, false otherwise.
+     */
+    bool get(osmid_t id, osmium::memory::Buffer *buffer) const;
+
+    /// Compress the block currently being filled.
+    void flush();
+
+    /// The number of objects stored.
+    std::size_t size() const noexcept { return m_count; }
+
+    /// The uncompressed size of all objects stored.
+    std::size_t raw_size() const noexcept { return m_raw_size; }
+
+    /// The compressed size of all objects stored.
+    std::size_t compressed_size() const noexcept { return m_data.size(); }
+
+    /// Return the approximate number of bytes used for internal storage.
+    std::size_t used_memory() const noexcept
+    {
+        return m_data.used_memory() + m_index.used_memory() +
+               m_pending.capacity();
+    }
+
+    /// Remove all objects and free the memory.
+    void clear();
+
+    /// Write the contents of this store to a RAM middle snapshot.
+    void write_snapshot(ram_snapshot_writer_t *writer) const;
+
+    /**
+     * Read the contents of this store from a RAM middle snapshot.
+     *
+     * \pre The store must be empty.
+     */
+    void read_snapshot(ram_snapshot_reader_t *reader);
+
+private:
+    using block_t = std::shared_ptr<osmium::memory::Buffer const>;
+
+    struct cache_entry_t
+    {
+        std::size_t offset;
+        block_t block;
+    };
+
+    /// Get the decompressed block at the offset, from the cache if possible.
+    block_t get_block(std::size_t offset) const;
+
+    /// Decompress the block at the offset.
+    block_t decompress_block(std::size_t offset) const;
+
+    /// Find object in the buffer and add it to the output buffer.
+    static bool find_in(osmium::memory::Buffer const &block, osmid_t id,
+                        osmium::memory::Buffer *buffer);
+
+    /// The compressed blocks.
+    segmented_buffer_t m_data;
+
+    /// Index from the first id of each block to the block.
+    ordered_index_t m_index;
+
+    /// The block currently being filled.
+    osmium::memory::Buffer m_pending{BLOCK_SIZE * 2,
+                                     osmium::memory::Buffer::auto_grow::yes};
+
+    /// The id of the first object in the pending block.
+    osmid_t m_pending_first_id = 0;
+
+    /// Temporary buffer used for compressing.
+    std::string m_compressed;
+
+    /// The number of objects stored.
+    std::size_t m_count = 0;
+
+    /// The uncompressed size of all objects stored.
+    std::size_t m_raw_size = 0;
+
+    /// Protects m_cache.
+    mutable std::mutex m_cache_mutex;
+
+    /// Recently used blocks, most recently used first.
+    mutable std::list<cache_entry_t> m_cache;
+
+}; // class compressed_object_store_t
+
+#endif // OSM2PGSQL_COMPRESSED_OBJECT_STORE_HPP
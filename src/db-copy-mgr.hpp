@@ -15,7 +15,9 @@
 #include <string>
 
 #include "db-copy.hpp"
+#include "geom.hpp"
 #include "hex.hpp"
+#include "wkb.hpp"
 
 /**
  * Management class that fills and manages copy buffers.
@@ -68,6 +70,7 @@ public:
         // Replace it with the row delimiter '\n'.
         assert(buf.back() == '\t');
         buf.back() = '\n';
+        ++m_current.rows;
 
         if (m_current.is_full()) {
             m_processor->send_command(std::move(m_current));
@@ -241,6 +244,20 @@ public:
         m_current.buffer += '\t';
     }
 
+    /**
+     * Add a column with the given geometry in WKB hex format.
+     *
+     * The geometry is written as WKB directly into the buffer and then
+     * converted to hex in place.
+     */
+    void add_hex_geom(geom::geometry_t const &geom, bool ensure_multi)
+    {
+        auto const offset = m_current.buffer.size();
+        geom_to_ewkb(&m_current.buffer, geom, ensure_multi);
+        util::encode_hex_in_place(&m_current.buffer, offset);
+        m_current.buffer += '\t';
+    }
+
     /**
      * Mark an OSM object for deletion in the current table.
      *
@@ -11,33 +11,34 @@
 
 #include "format.hpp"
 #include "logging.hpp"
+#include "memory-budget.hpp"
+#include "metrics.hpp"
+#include "pgsql-helper.hpp"
 #include "pgsql.hpp"
 
 #include <cassert>
 #include <cstdlib>
 #include <iterator>
+#include <string>
 #include <stdexcept>
+#include <type_traits>
 
 void db_deleter_by_id_t::delete_rows(std::string const &table,
                                      std::string const &column,
                                      pg_conn_t const &db_connection)
 {
-    fmt::memory_buffer sql;
-    // Each deletable contributes an OSM ID and a comma. The highest node ID
-    // currently has 10 digits, so 15 characters should do for a couple of years.
-    // Add 50 characters for the SQL statement itself.
-    sql.reserve(m_deletables.size() * 15 + 50);
-
-    fmt::format_to(std::back_inserter(sql),
-                   FMT_STRING("DELETE FROM {} WHERE {} IN ("), table, column);
+    assert(!m_deletables.empty());
 
+    // The ids are sent as a single binary array parameter so that the cost
+    // of parsing and planning the DELETE doesn't depend on the number of ids.
+    pg_binary_array_t ids{pg_binary_array_t::INT8_OID, m_deletables.size()};
     for (auto const id : m_deletables) {
-        format_to(std::back_inserter(sql), FMT_STRING("{},"), id);
+        ids.add(id);
     }
-    sql[sql.size() - 1] = ')';
 
-    sql.push_back('\0');
-    db_connection.exec(sql.data());
+    auto const sql = fmt::format(
+        FMT_STRING("DELETE FROM {} WHERE {} = ANY($1::int8[])"), table, column);
+    db_connection.exec_params(sql.c_str(), binary_param_t{ids.data()});
 }
 
 void db_deleter_by_type_and_id_t::delete_rows(std::string const &table,
@@ -46,46 +47,81 @@ void db_deleter_by_type_and_id_t::delete_rows(std::string const &table,
 {
     assert(!m_deletables.empty());
 
-    fmt::memory_buffer sql;
-    // Need a VALUES line for each deletable: type (3 bytes), id (15 bytes),
-    // braces etc. (4 bytes). And additional space for the remainder of the
-    // SQL command.
-    sql.reserve(m_deletables.size() * 22 + 200);
+    pg_binary_array_t ids{pg_binary_array_t::INT8_OID, m_deletables.size()};
+    for (auto const &item : m_deletables) {
+        ids.add(item.osm_id);
+    }
 
-    if (m_has_type) {
-        fmt::format_to(std::back_inserter(sql),
-                       "DELETE FROM {} p USING (VALUES ", table);
+    if (!m_has_type) {
+        auto const sql =
+            fmt::format(FMT_STRING("DELETE FROM {} WHERE {} = ANY($1::int8[])"),
+                        table, column);
+        db_connection.exec_params(sql.c_str(), binary_param_t{ids.data()});
+        return;
+    }
 
-        for (auto const &item : m_deletables) {
-            fmt::format_to(std::back_inserter(sql), FMT_STRING("('{}',{}),"),
-                           item.osm_type, item.osm_id);
-        }
+    pg_binary_array_t types{pg_binary_array_t::BPCHAR_OID,
+                            m_deletables.size()};
+    for (auto const &item : m_deletables) {
+        types.add(item.osm_type);
+    }
 
-        sql.resize(sql.size() - 1);
+    auto const pos = column.find(',');
+    assert(pos != std::string::npos);
+    std::string const type = column.substr(0, pos);
+
+    auto const sql = fmt::format(
+        FMT_STRING("DELETE FROM {} p"
+                   " USING unnest($1::char(1)[], $2::int8[])"
+                   " AS t (osm_type, osm_id)"
+                   " WHERE p.{} = t.osm_type AND p.{} = t.osm_id"),
+        table, type, column.c_str() + pos + 1);
+    db_connection.exec_params(sql.c_str(), binary_param_t{types.data()},
+                              binary_param_t{ids.data()});
+}
 
-        auto const pos = column.find(',');
-        assert(pos != std::string::npos);
-        std::string const type = column.substr(0, pos);
+namespace {
 
-        fmt::format_to(std::back_inserter(sql),
-                       ") AS t (osm_type, osm_id) WHERE"
-                       " p.{} = t.osm_type::char(1) AND p.{} = t.osm_id",
-                       type, column.c_str() + pos + 1);
-    } else {
-        fmt::format_to(std::back_inserter(sql),
-                       FMT_STRING("DELETE FROM {} WHERE {} IN ("), table,
-                       column);
+metrics::gauge_t &queue_length_gauge()
+{
+    static auto &gauge = metrics::gauge(
+        "osm2pgsql_copy_queue_length",
+        "Number of commands waiting in the queues of all COPY threads.");
+    return gauge;
+}
 
-        for (auto const &item : m_deletables) {
-            format_to(std::back_inserter(sql), FMT_STRING("{},"), item.osm_id);
-        }
-        sql[sql.size() - 1] = ')';
-    }
+memory_budget_t::consumer_t &queue_memory()
+{
+    static auto &consumer = get_memory_budget().consumer("COPY queues");
+    return consumer;
+}
 
-    sql.push_back('\0');
-    db_connection.exec(sql.data());
+/// The number of bytes used by the buffer of a command.
+std::size_t command_memory(db_cmd_t const &cmd) noexcept
+{
+    return std::visit(
+        [](auto const &c) -> std::size_t {
+            if constexpr (std::is_base_of_v<db_cmd_copy_t,
+                                            std::decay_t<decltype(c)>>) {
+                return c.buffer.capacity();
+            }
+            return 0;
+        },
+        cmd);
 }
 
+/**
+ * The number of commands allowed in the queue. When memory gets tight only
+ * a single buffer may wait in the queue.
+ */
+std::size_t max_queue_length() noexcept
+{
+    return get_memory_budget().under_pressure() ? 1
+                                                : db_cmd_copy_t::MAX_BUFFERS;
+}
+
+} // anonymous namespace
+
 db_copy_thread_t::db_copy_thread_t(connection_params_t const &connection_params)
 {
     m_worker =
@@ -98,12 +134,23 @@ void db_copy_thread_t::send_command(db_cmd_t &&buffer)
 {
     assert(m_worker.joinable()); // thread must not have been finished
 
+    static auto &blocked_time = metrics::time_counter(
+        "osm2pgsql_copy_queue_blocked_seconds_total",
+        "Time spent waiting for space in a full COPY queue.");
+
+    auto const memory = command_memory(buffer);
+
     std::unique_lock<std::mutex> lock{m_shared.queue_mutex};
-    m_shared.queue_full_cond.wait(lock, [&] {
-        return m_shared.worker_queue.size() < db_cmd_copy_t::MAX_BUFFERS;
-    });
+    if (m_shared.worker_queue.size() >= max_queue_length()) {
+        metrics::scoped_timer_t const timer{&blocked_time};
+        m_shared.queue_full_cond.wait(lock, [&] {
+            return m_shared.worker_queue.size() < max_queue_length();
+        });
+    }
 
     m_shared.worker_queue.push_back(std::move(buffer));
+    queue_length_gauge().add(1);
+    queue_memory().add(memory);
     m_shared.queue_cond.notify_one();
 }
 
@@ -154,14 +201,17 @@ void db_copy_thread_t::thread_t::operator()()
 
                 item = std::move(m_shared->worker_queue.front());
                 m_shared->worker_queue.pop_front();
+                queue_length_gauge().add(-1);
                 m_shared->queue_full_cond.notify_one();
             }
 
+            auto const memory = command_memory(item);
             done = std::visit(
                 [&](auto &&cmd) {
                     return execute(std::forward<decltype(cmd)>(cmd));
                 },
                 item);
+            queue_memory().sub(memory);
         }
 
         finish_copy();
@@ -187,6 +237,9 @@ bool db_copy_thread_t::thread_t::execute(db_cmd_copy_delete_t<DELETER> &cmd)
 
     m_db_connection.copy_send(cmd.buffer, cmd.target->name());
 
+    m_inflight_rows->add(cmd.rows);
+    m_inflight_bytes->add(cmd.buffer.size());
+
     return false;
 }
 
@@ -224,6 +277,14 @@ void db_copy_thread_t::thread_t::start_copy(
     m_db_connection.copy_start(to_string(sql));
 
     m_inflight = target;
+
+    auto const labels = metrics::label("table", target->name());
+    m_inflight_rows = &metrics::counter(
+        "osm2pgsql_copy_rows_total",
+        "Number of rows sent to the database with COPY.", labels);
+    m_inflight_bytes = &metrics::counter(
+        "osm2pgsql_copy_bytes_total",
+        "Number of bytes sent to the database with COPY.", labels);
 }
 
 void db_copy_thread_t::thread_t::finish_copy()
@@ -10,6 +10,7 @@
  * For a full list of authors see the git log.
  */
 
+#include "metrics.hpp"
 #include "osmtypes.hpp"
 #include "pgsql.hpp"
 #include "pgsql-params.hpp"
@@ -161,6 +162,8 @@ struct db_cmd_copy_t
     std::shared_ptr<db_target_descr_t> target;
     /// actual copy buffer
     std::string buffer;
+    /// Number of complete rows in the buffer
+    std::size_t rows = 0;
 
     db_cmd_copy_t() = default;
 
@@ -301,6 +304,11 @@ private:
         // Target for copy operation currently ongoing.
         std::shared_ptr<db_target_descr_t> m_inflight;
 
+        // Metrics for the target of the ongoing copy operation. Looked up
+        // once when the copy starts, not for every buffer sent.
+        metrics::counter_t *m_inflight_rows = nullptr;
+        metrics::counter_t *m_inflight_bytes = nullptr;
+
         // These are shared with the db_copy_thread_t in the main program.
         shared *m_shared;
     };
@@ -11,12 +11,26 @@
 
 #include "format.hpp"
 #include "logging.hpp"
+#include "memory-budget.hpp"
 #include "pgsql.hpp"
 #include "tile.hpp"
 
 #include <cerrno>
 #include <system_error>
 
+namespace {
+
+/// Approximate number of bytes used for each tile in the tile set.
+constexpr std::size_t BYTES_PER_TILE = sizeof(quadkey_t) + 3 * sizeof(void *);
+
+memory_budget_t::consumer_t &tiles_memory()
+{
+    static auto &consumer = get_memory_budget().consumer("expire tiles");
+    return consumer;
+}
+
+} // anonymous namespace
+
 void expire_output_t::add_tiles(
     std::unordered_set<quadkey_t> const &dirty_tiles)
 {
@@ -47,7 +61,9 @@ void expire_output_t::add_tiles(
         return;
     }
 
+    auto const size_before = m_tiles.size();
     m_tiles.insert(dirty_tiles.cbegin(), dirty_tiles.cend());
+    tiles_memory().add((m_tiles.size() - size_before) * BYTES_PER_TILE);
 }
 
 bool expire_output_t::empty() noexcept
@@ -56,6 +72,12 @@ bool expire_output_t::empty() noexcept
     return m_tiles.empty();
 }
 
+std::size_t expire_output_t::size() noexcept
+{
+    std::lock_guard<std::mutex> const guard{*m_tiles_mutex};
+    return m_tiles.size();
+}
+
 quadkey_list_t expire_output_t::get_tiles()
 {
     std::lock_guard<std::mutex> const guard{*m_tiles_mutex};
@@ -64,7 +86,9 @@ quadkey_list_t expire_output_t::get_tiles()
     tile_list.reserve(m_tiles.size());
     tile_list.assign(m_tiles.cbegin(), m_tiles.cend());
     std::sort(tile_list.begin(), tile_list.end());
+    tiles_memory().sub(m_tiles.size() * BYTES_PER_TILE);
     m_tiles.clear();
+    m_overall_tile_limit_reached = false;
 
     return tile_list;
 }
@@ -72,6 +96,8 @@ quadkey_list_t expire_output_t::get_tiles()
 std::size_t
 expire_output_t::output(connection_params_t const &connection_params)
 {
+    std::lock_guard<std::mutex> const guard{*m_output_mutex};
+
     std::size_t num = 0;
     if (!m_filename.empty()) {
         num = output_tiles_to_file(get_tiles());
@@ -131,11 +157,13 @@ std::size_t expire_output_t::output_tiles_to_table(
                               qn);
     }
 
+    pg_pipeline_t pipeline{db_connection};
     auto const count = for_each_tile(
         tiles_at_maxzoom, m_minzoom, m_maxzoom, [&](tile_t const &tile) {
-            db_connection.exec_prepared("insert_tiles", tile.zoom(), tile.x(),
-                                        tile.y());
+            pipeline.exec_prepared("insert_tiles", tile.zoom(), tile.x(),
+                                   tile.y());
         });
+    pipeline.finish();
 
     return count;
 }
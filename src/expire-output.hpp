@@ -81,8 +81,15 @@ public:
 
     bool empty() noexcept;
 
+    /// The number of tiles collected.
+    std::size_t size() noexcept;
+
     void add_tiles(std::unordered_set<quadkey_t> const &dirty_tiles);
 
+    /**
+     * Get the sorted list of expired tiles and clear it. This also resets
+     * the overall tile limit, so the next run starts from scratch.
+     */
     quadkey_list_t get_tiles();
 
     /**
@@ -124,6 +131,13 @@ private:
      */
     std::shared_ptr<std::mutex> m_tiles_mutex = std::make_shared<std::mutex>();
 
+    /**
+     * Makes sure only one thread at a time writes out tiles, when they are
+     * written out early because memory is getting tight.
+     */
+    std::shared_ptr<std::mutex> m_output_mutex =
+        std::make_shared<std::mutex>();
+
     /// This is where we collect all the expired tiles.
     std::unordered_set<quadkey_t> m_tiles;
 
@@ -0,0 +1,418 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "external-id-set.hpp"
+
+#include "format.hpp"
+#include "logging.hpp"
+#include "memory-budget.hpp"
+
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <utility>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#endif
+
+namespace {
+
+/// Number of ids read from a run file at once.
+constexpr std::size_t READ_BUFFER_SIZE = 64UL * 1024UL;
+
+/// Check the memory budget every time this many ids were added.
+constexpr std::size_t BUDGET_CHECK_INTERVAL = 64UL * 1024UL;
+
+memory_budget_t::consumer_t &ids_memory()
+{
+    static auto &consumer = get_memory_budget().consumer("pending id lists");
+    return consumer;
+}
+
+struct file_closer_t
+{
+    void operator()(std::FILE *file) const noexcept { std::fclose(file); }
+};
+
+/**
+ * Seek to the absolute position in the file. Unlike std::fseek() this works
+ * with 64 bit offsets also on systems where long is 32 bit.
+ */
+int seek_to(std::FILE *file, std::uint64_t position) noexcept
+{
+#ifdef _WIN32
+    return _fseeki64(file, static_cast<__int64>(position), SEEK_SET);
+#else
+    return fseeko(file, static_cast<off_t>(position), SEEK_SET);
+#endif
+}
+
+} // anonymous namespace
+
+/// A sorted list of unique ids in a temporary file.
+struct external_id_set_t::run_t
+{
+    std::unique_ptr<std::FILE, file_closer_t> file;
+    std::size_t count = 0;
+
+    run_t() : file(std::tmpfile())
+    {
+        if (!file) {
+            throw fmt_error("Could not create temporary file for id list: {}.",
+                            std::strerror(errno));
+        }
+    }
+
+    void write(osmid_t const *ids, std::size_t num)
+    {
+        if (num == 0) {
+            return;
+        }
+        if (std::fwrite(ids, sizeof(osmid_t), num, file.get()) != num) {
+            throw fmt_error("Writing id list to temporary file failed: {}.",
+                            std::strerror(errno));
+        }
+        count += num;
+    }
+};
+
+external_id_set_t::external_id_set_t(std::size_t max_ids_in_memory)
+: m_max_ids_in_memory(std::max(max_ids_in_memory, std::size_t{1}))
+{}
+
+external_id_set_t::~external_id_set_t() noexcept
+{
+    ids_memory().sub(m_memory_reported);
+}
+
+void external_id_set_t::update_memory_use() noexcept
+{
+    auto const bytes = m_memory.capacity() * sizeof(osmid_t);
+    if (bytes > m_memory_reported) {
+        ids_memory().add(bytes - m_memory_reported);
+    } else {
+        ids_memory().sub(m_memory_reported - bytes);
+    }
+    m_memory_reported = bytes;
+}
+
+void external_id_set_t::push_back(osmid_t id)
+{
+    m_memory.push_back(id);
+    ++m_size;
+    m_sorted = false;
+
+    if (m_memory.size() >= m_max_ids_in_memory) {
+        spill();
+    } else if (m_memory.size() % BUDGET_CHECK_INTERVAL == 0) {
+        update_memory_use();
+        if (m_memory.size() >= MIN_IDS_TO_SPILL &&
+            get_memory_budget().under_pressure()) {
+            spill();
+        }
+    }
+}
+
+void external_id_set_t::add(idlist_t const &ids)
+{
+    for (auto const id : ids) {
+        push_back(id);
+    }
+}
+
+void external_id_set_t::clear()
+{
+    m_memory.clear();
+    m_memory.shrink_to_fit();
+    m_runs.clear();
+    m_size = 0;
+    m_sorted = true;
+    update_memory_use();
+}
+
+void external_id_set_t::spill()
+{
+    assert(!m_sorted || m_runs.empty());
+
+    std::sort(m_memory.begin(), m_memory.end());
+    auto const last = std::unique(m_memory.begin(), m_memory.end());
+    m_memory.erase(last, m_memory.end());
+
+    auto &run = m_runs.emplace_back(std::make_unique<run_t>());
+    run->write(m_memory.data(), m_memory.size());
+    m_memory.clear();
+
+    log_debug("Wrote id list run {} with {} ids to disk.", m_runs.size(),
+              run->count);
+}
+
+void external_id_set_t::append_memory_to_run()
+{
+    assert(m_sorted && m_runs.size() <= 1);
+
+    if (m_runs.empty()) {
+        m_runs.push_back(std::make_unique<run_t>());
+    }
+    m_runs.back()->write(m_memory.data(), m_memory.size());
+    m_memory.clear();
+}
+
+void external_id_set_t::append_sorted(osmid_t id)
+{
+    assert(m_sorted);
+    assert(m_memory.empty() || m_memory.back() < id);
+
+    m_memory.push_back(id);
+    ++m_size;
+
+    if (m_memory.size() >= m_max_ids_in_memory) {
+        append_memory_to_run();
+    }
+}
+
+std::size_t external_id_set_t::read_run(run_t const &run, std::size_t offset,
+                                        std::vector<osmid_t> *buffer)
+{
+    assert(offset <= run.count);
+
+    auto const num = std::min(READ_BUFFER_SIZE, run.count - offset);
+    buffer->resize(num);
+    if (num == 0) {
+        return 0;
+    }
+
+    auto *file = run.file.get();
+    if (std::fflush(file) != 0 ||
+        seek_to(file, static_cast<std::uint64_t>(offset) * sizeof(osmid_t)) !=
+            0 ||
+        std::fread(buffer->data(), sizeof(osmid_t), num, file) != num) {
+        throw fmt_error("Reading id list from temporary file failed: {}.",
+                        std::strerror(errno));
+    }
+    std::fseek(file, 0, SEEK_END);
+
+    return num;
+}
+
+void external_id_set_t::sort_unique()
+{
+    if (m_sorted) {
+        return;
+    }
+
+    if (m_runs.empty()) {
+        std::sort(m_memory.begin(), m_memory.end());
+        auto const last = std::unique(m_memory.begin(), m_memory.end());
+        m_memory.erase(last, m_memory.end());
+        m_size = m_memory.size();
+        m_sorted = true;
+        update_memory_use();
+        return;
+    }
+
+    spill();
+
+    // Merge all runs into a new one, removing duplicates.
+    auto runs = std::move(m_runs);
+    m_runs.clear();
+    m_size = 0;
+    m_sorted = true;
+
+    log_debug("Merging {} id list runs...", runs.size());
+
+    struct input_t
+    {
+        std::vector<osmid_t> buffer;
+        std::size_t offset = 0;
+        std::size_t pos = 0;
+    };
+
+    std::vector<input_t> inputs(runs.size());
+
+    // Min-heap of (id, run index)
+    using entry_t = std::pair<osmid_t, std::size_t>;
+    std::priority_queue<entry_t, std::vector<entry_t>, std::greater<>> heap;
+
+    auto const advance = [&](std::size_t n) {
+        auto &input = inputs[n];
+        if (input.pos == input.buffer.size()) {
+            input.offset += read_run(*runs[n], input.offset, &input.buffer);
+            input.pos = 0;
+            if (input.buffer.empty()) {
+                return;
+            }
+        }
+        heap.emplace(input.buffer[input.pos++], n);
+    };
+
+    for (std::size_t n = 0; n < runs.size(); ++n) {
+        advance(n);
+    }
+
+    bool first = true;
+    osmid_t last = 0;
+    while (!heap.empty()) {
+        auto const [id, n] = heap.top();
+        heap.pop();
+        if (first || last < id) {
+            append_sorted(id);
+            first = false;
+            last = id;
+        }
+        advance(n);
+    }
+
+    update_memory_use();
+}
+
+void external_id_set_t::swap_contents(external_id_set_t *other) noexcept
+{
+    using std::swap;
+    swap(m_memory, other->m_memory);
+    swap(m_runs, other->m_runs);
+    swap(m_size, other->m_size);
+    swap(m_memory_reported, other->m_memory_reported);
+    swap(m_sorted, other->m_sorted);
+}
+
+void external_id_set_t::merge_sorted(external_id_set_t const &other)
+{
+    assert(m_sorted && other.m_sorted);
+
+    external_id_set_t result{m_max_ids_in_memory};
+
+    auto a = reader();
+    auto b = other.reader();
+    osmid_t id_a = 0;
+    osmid_t id_b = 0;
+    bool has_a = a.next(&id_a);
+    bool has_b = b.next(&id_b);
+
+    while (has_a || has_b) {
+        if (!has_b || (has_a && id_a < id_b)) {
+            result.append_sorted(id_a);
+            has_a = a.next(&id_a);
+        } else if (!has_a || id_b < id_a) {
+            result.append_sorted(id_b);
+            has_b = b.next(&id_b);
+        } else {
+            result.append_sorted(id_a);
+            has_a = a.next(&id_a);
+            has_b = b.next(&id_b);
+        }
+    }
+
+    result.update_memory_use();
+    swap_contents(&result);
+}
+
+void external_id_set_t::remove_ids_if_in(external_id_set_t const &other)
+{
+    assert(m_sorted && other.m_sorted);
+
+    if (other.empty()) {
+        return;
+    }
+
+    external_id_set_t result{m_max_ids_in_memory};
+
+    auto a = reader();
+    auto b = other.reader();
+    osmid_t id_a = 0;
+    osmid_t id_b = 0;
+    bool has_b = b.next(&id_b);
+
+    while (a.next(&id_a)) {
+        while (has_b && id_b < id_a) {
+            has_b = b.next(&id_b);
+        }
+        if (!has_b || id_b != id_a) {
+            result.append_sorted(id_a);
+        }
+    }
+
+    result.update_memory_use();
+    swap_contents(&result);
+}
+
+external_id_set_t::reader_t external_id_set_t::reader() const
+{
+    assert(m_sorted);
+    return reader_t{*this};
+}
+
+idlist_t external_id_set_t::to_idlist() const
+{
+    idlist_t list;
+    list.reserve(m_size);
+
+    std::vector<osmid_t> buffer;
+    for (auto const &run : m_runs) {
+        std::size_t offset = 0;
+        while (auto const num = read_run(*run, offset, &buffer)) {
+            offset += num;
+            for (auto const id : buffer) {
+                list.push_back(id);
+            }
+        }
+    }
+    for (auto const id : m_memory) {
+        list.push_back(id);
+    }
+
+    if (!m_sorted || m_runs.size() > 1) {
+        list.sort_unique();
+    }
+
+    return list;
+}
+
+external_id_set_t::reader_t::reader_t(external_id_set_t const &set)
+: m_set(&set), m_in_run(!set.m_runs.empty())
+{
+    assert(set.m_sorted);
+}
+
+bool external_id_set_t::reader_t::next(osmid_t *id)
+{
+    assert(id);
+
+    if (m_done) {
+        return false;
+    }
+
+    if (m_in_run) {
+        if (m_pos == m_buffer.size()) {
+            m_run_offset +=
+                read_run(*m_set->m_runs.front(), m_run_offset, &m_buffer);
+            m_pos = 0;
+        }
+        if (m_pos < m_buffer.size()) {
+            *id = m_buffer[m_pos++];
+            ++m_count;
+            return true;
+        }
+        m_in_run = false;
+        m_buffer = std::vector<osmid_t>{};
+    }
+
+    if (m_memory_pos < m_set->m_memory.size()) {
+        *id = m_set->m_memory[m_memory_pos++];
+        ++m_count;
+        return true;
+    }
+
+    m_done = true;
+    return false;
+}
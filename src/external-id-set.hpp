@@ -0,0 +1,211 @@
+#ifndef OSM2PGSQL_EXTERNAL_ID_SET_HPP
+#define OSM2PGSQL_EXTERNAL_ID_SET_HPP
+
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+/**
+ * \file
+ *
+ * This file contains the definition of the external_id_set_t class.
+ */
+
+#include "idlist.hpp"
+#include "osmtypes.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/**
+ * A set of OSM object ids which can grow larger than the available memory.
+ *
+ * Ids are collected in memory. If there are too many of them or if the
+ * global memory budget gets tight, they are sorted and written out as a
+ * "run" to an anonymous temporary file. Runs are merged lazily when the
+ * sorted ids are needed.
+ *
+ * The interface is similar to the one of idlist_t. Some operations are only
+ * allowed after sort_unique() was called. In this sorted state there is at
+ * most one run on disk and all ids in memory are larger than the ones in
+ * that run.
+ */
+class external_id_set_t
+{
+    struct run_t;
+
+public:
+    /// Maximum number of ids kept in memory before they are written to disk.
+    static constexpr std::size_t DEFAULT_MAX_IDS_IN_MEMORY =
+        32UL * 1024UL * 1024UL;
+
+    /**
+     * If the memory budget is under pressure, ids are written to disk when
+     * there are at least this many in memory.
+     */
+    static constexpr std::size_t MIN_IDS_TO_SPILL = 1024UL * 1024UL;
+
+    /**
+     * Sequential access to the ids in a sorted set in ascending order.
+     * Only one reader may be used on a set at the same time and the set
+     * must not be changed while the reader is in use.
+     */
+    class reader_t
+    {
+    public:
+        explicit reader_t(external_id_set_t const &set);
+
+        /**
+         * Get the next id.
+         *
+         * \returns False if there are no more ids, true otherwise.
+         */
+        bool next(osmid_t *id);
+
+        /// Skip all remaining ids.
+        void finish() noexcept { m_done = true; }
+
+        /// The number of ids read so far.
+        std::size_t count() const noexcept { return m_count; }
+
+    private:
+        external_id_set_t const *m_set;
+        std::vector<osmid_t> m_buffer;
+        std::size_t m_pos = 0;
+        std::size_t m_run_offset = 0;
+        std::size_t m_memory_pos = 0;
+        std::size_t m_count = 0;
+        bool m_in_run;
+        bool m_done = false;
+
+    }; // class reader_t
+
+    explicit external_id_set_t(
+        std::size_t max_ids_in_memory = DEFAULT_MAX_IDS_IN_MEMORY);
+
+    external_id_set_t(external_id_set_t const &) = delete;
+    external_id_set_t &operator=(external_id_set_t const &) = delete;
+
+    external_id_set_t(external_id_set_t &&) = delete;
+    external_id_set_t &operator=(external_id_set_t &&) = delete;
+
+    ~external_id_set_t() noexcept;
+
+    bool empty() const noexcept { return m_size == 0; }
+
+    /**
+     * The number of ids in this set. Before sort_unique() was called this
+     * counts duplicates multiple times.
+     */
+    std::size_t size() const noexcept { return m_size; }
+
+    /// The number of runs currently written to disk.
+    std::size_t num_runs() const noexcept { return m_runs.size(); }
+
+    void push_back(osmid_t id);
+
+    /// Add all ids from the list.
+    void add(idlist_t const &ids);
+
+    /// Remove all ids and temporary files.
+    void clear();
+
+    /**
+     * Sort the ids and remove duplicates. This merges all runs on disk into
+     * a single one.
+     */
+    void sort_unique();
+
+    /**
+     * Merge other set into this one.
+     *
+     * \pre Both sets must be sorted.
+     */
+    void merge_sorted(external_id_set_t const &other);
+
+    /**
+     * Remove all ids in this set that are also in the other set.
+     *
+     * \pre Both sets must be sorted.
+     */
+    void remove_ids_if_in(external_id_set_t const &other);
+
+    /**
+     * Get a reader for the ids in this set.
+     *
+     * \pre The set must be sorted.
+     */
+    reader_t reader() const;
+
+    /**
+     * Call func with an idlist_t for each chunk of at most chunk_size ids.
+     * The ids are in ascending order.
+     *
+     * \pre The set must be sorted.
+     */
+    template <typename FUNC>
+    void for_each_chunk(std::size_t chunk_size, FUNC &&func) const
+    {
+        auto r = reader();
+        idlist_t chunk;
+        chunk.reserve(std::min(chunk_size, m_size));
+        osmid_t id = 0;
+        while (r.next(&id)) {
+            chunk.push_back(id);
+            if (chunk.size() == chunk_size) {
+                func(chunk);
+                chunk.clear();
+            }
+        }
+        if (!chunk.empty()) {
+            func(chunk);
+        }
+    }
+
+    /// Get all ids in this set as sorted list without duplicates.
+    idlist_t to_idlist() const;
+
+private:
+    /**
+     * Read ids from a run starting at offset (counted in ids) into the
+     * buffer replacing its contents.
+     *
+     * \returns The number of ids read.
+     */
+    static std::size_t read_run(run_t const &run, std::size_t offset,
+                                std::vector<osmid_t> *buffer);
+
+    /// Move memory contents into a new run.
+    void spill();
+
+    /// Add id in sorted state, id must be larger than all ids in the set.
+    void append_sorted(osmid_t id);
+
+    /// Write all ids in memory to the end of the (single) run.
+    void append_memory_to_run();
+
+    void swap_contents(external_id_set_t *other) noexcept;
+
+    /// Update the memory budget consumer with our current memory use.
+    void update_memory_use() noexcept;
+
+    std::vector<osmid_t> m_memory;
+    std::vector<std::unique_ptr<run_t>> m_runs;
+    std::size_t m_max_ids_in_memory;
+    std::size_t m_size = 0;
+
+    /// Bytes reported to the memory budget.
+    std::size_t m_memory_reported = 0;
+
+    bool m_sorted = true;
+
+}; // class external_id_set_t
+
+#endif // OSM2PGSQL_EXTERNAL_ID_SET_HPP
@@ -20,8 +20,8 @@ std::string flex_index_t::include_columns() const
     return util::join(m_include_columns, ',', '"', '(', ')');
 }
 
-std::string
-flex_index_t::create_index(std::string const &qualified_table_name) const
+std::string flex_index_t::create_index(std::string const &qualified_table_name,
+                                       bool with_name) const
 {
     util::string_joiner_t joiner{' '};
     joiner.add("CREATE");
@@ -32,7 +32,7 @@ flex_index_t::create_index(std::string const &qualified_table_name) const
 
     joiner.add("INDEX");
 
-    if (!m_name.empty()) {
+    if (with_name && !m_name.empty()) {
         joiner.add(fmt::format(R"("{}")", m_name));
     }
 
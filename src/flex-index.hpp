@@ -10,10 +10,12 @@
  * For a full list of authors see the git log.
  */
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
 /**
@@ -28,6 +30,13 @@ public:
 
     std::string columns() const;
 
+    /// Does this index contain the column (not only as include column)?
+    bool has_column(std::string_view column) const noexcept
+    {
+        return std::find(m_columns.cbegin(), m_columns.cend(), column) !=
+               m_columns.cend();
+    }
+
     /// Set columns (single-column version)
     void set_columns(std::string const &columns)
     {
@@ -88,7 +97,15 @@ public:
 
     void set_is_unique(bool unique) noexcept { m_is_unique = unique; }
 
-    std::string create_index(std::string const &qualified_table_name) const;
+    /**
+     * Build the SQL for creating this index on the specified table.
+     *
+     * \param qualified_table_name Name of the table (with schema).
+     * \param with_name Use the name of this index (if set). Set this to
+     *                  false when creating the index on a partition.
+     */
+    std::string create_index(std::string const &qualified_table_name,
+                             bool with_name = true) const;
 
 private:
     std::vector<std::string> m_columns;
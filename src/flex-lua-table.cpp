@@ -21,6 +21,8 @@
 
 #include <lua.hpp>
 
+#include <algorithm>
+
 namespace {
 
 void check_tablespace(std::string const &tablespace)
@@ -394,6 +396,115 @@ void setup_flex_table_columns(lua_State *lua_state, flex_table_t *table,
     lua_pop(lua_state, 1); // "columns"
 }
 
+void setup_flex_table_partition(lua_State *lua_state, flex_table_t *table)
+{
+    assert(lua_state);
+    assert(table);
+
+    lua_getfield(lua_state, -1, "partition");
+    if (lua_isnil(lua_state, -1)) {
+        lua_pop(lua_state, 1); // "partition"
+        return;
+    }
+
+    if (!lua_istable(lua_state, -1)) {
+        throw fmt_error("The 'partition' field in definition of"
+                        " table '{}' must be a Lua table.",
+                        table->name());
+    }
+
+    std::string const by =
+        luaX_get_table_string(lua_state, "by", -1, "The partition field");
+    lua_pop(lua_state, 1); // "by"
+
+    if (by == "type") {
+        if (!table->has_multicolumn_id_index()) {
+            throw fmt_error("Partitioning table '{}' by type needs ids of"
+                            " type 'any' with a 'type_column'.",
+                            table->name());
+        }
+        table->set_partition_by_type();
+    } else if (by == "id") {
+        if (!table->has_id_column()) {
+            throw fmt_error("Partitioning table '{}' by id needs an id column.",
+                            table->name());
+        }
+        auto const count = luaX_get_table_optional_uint32(
+            lua_state, "count", -1, "The 'count' field of partition", 2, 1024,
+            "2 and 1024");
+        lua_pop(lua_state, 1); // "count"
+        if (count == 0) {
+            throw fmt_error("Partitioning table '{}' by id needs a 'count'.",
+                            table->name());
+        }
+        table->set_partition_by_id(count);
+    } else if (by == "tile") {
+        if (!table->has_geom_column()) {
+            throw fmt_error("Partitioning table '{}' by tile needs a"
+                            " geometry column.",
+                            table->name());
+        }
+        auto const zoom = luaX_get_table_optional_uint32(
+            lua_state, "zoom", -1, "The 'zoom' field of partition", 1, 4,
+            "1 and 4");
+        lua_pop(lua_state, 1); // "zoom"
+        if (zoom == 0) {
+            throw fmt_error("Partitioning table '{}' by tile needs a 'zoom'.",
+                            table->name());
+        }
+        std::string const column = luaX_get_table_string(
+            lua_state, "column", -1, "The partition field", "partition_tile");
+        lua_pop(lua_state, 1); // "column"
+        check_identifier(column, "column names");
+        if (table->find_column_by_name(column)) {
+            throw fmt_error("Column '{}' for partitioning table '{}' already"
+                            " exists.",
+                            column, table->name());
+        }
+        table->set_partition_by_tile(zoom, column);
+    } else {
+        throw fmt_error("Unknown value '{}' for 'by' field of partition"
+                        " (use 'type', 'id', or 'tile').",
+                        by);
+    }
+
+    lua_pop(lua_state, 1); // "partition"
+}
+
+/**
+ * Unique indexes on a partitioned table must contain the partition column,
+ * otherwise PostgreSQL refuses to create them. This can only be checked
+ * after the indexes are set up, because they can use the partition column.
+ */
+void check_partition_indexes(flex_table_t const &table)
+{
+    if (!table.is_partitioned()) {
+        return;
+    }
+
+    auto const &column = table.partition_column_name();
+
+    // The id index contains the id column and, if there is one, the type
+    // column, so it only misses the partition column for tile partitions.
+    if (table.build_unique_id_index() &&
+        table.partition_type() == flex_partition_type::tile) {
+        throw fmt_error("Unique id index on table '{}' must contain the"
+                        " partition column '{}'.",
+                        table.name(), column);
+    }
+
+    auto const it =
+        std::find_if(table.indexes().cbegin(), table.indexes().cend(),
+                     [&](flex_index_t const &index) {
+                         return index.is_unique() && !index.has_column(column);
+                     });
+    if (it != table.indexes().cend()) {
+        throw fmt_error("Unique index on table '{}' must contain the"
+                        " partition column '{}'.",
+                        table.name(), column);
+    }
+}
+
 void setup_flex_table_indexes(lua_State *lua_state, flex_table_t *table,
                               bool updatable)
 {
@@ -460,7 +571,9 @@ int setup_flex_table(lua_State *lua_state, std::vector<flex_table_t> *tables,
     setup_flex_table_id_columns(lua_state, &new_table);
     setup_flex_table_columns(lua_state, &new_table, expire_outputs,
                              append_mode);
+    setup_flex_table_partition(lua_state, &new_table);
     setup_flex_table_indexes(lua_state, &new_table, updatable);
+    check_partition_indexes(new_table);
 
     void *ptr = lua_newuserdata(lua_state, sizeof(std::size_t));
     auto *num = new (ptr) std::size_t{};
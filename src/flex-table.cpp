@@ -9,13 +9,19 @@
 
 #include "flex-table.hpp"
 #include "format.hpp"
+#include "geom-box.hpp"
 #include "logging.hpp"
 #include "pgsql-capabilities.hpp"
 #include "pgsql-helper.hpp"
+#include "tile.hpp"
 #include "util.hpp"
 
+#include <osmium/geom/mercator_projection.hpp>
+
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <future>
 #include <string>
 
 char const *type_to_char(osmium::item_type type) noexcept
@@ -182,9 +188,12 @@ flex_table_t::build_sql_create_table(table_type ttype,
 {
     assert(!m_columns.empty());
 
-    std::string sql =
-        fmt::format("CREATE {} TABLE IF NOT EXISTS {} (",
-                    ttype == table_type::interim ? "UNLOGGED" : "", table_name);
+    // Partitioned tables themselves can't be unlogged, only their
+    // partitions.
+    bool const unlogged = ttype == table_type::interim && !is_partitioned();
+
+    std::string sql = fmt::format("CREATE {} TABLE IF NOT EXISTS {} (",
+                                  unlogged ? "UNLOGGED" : "", table_name);
 
     util::string_joiner_t joiner{','};
     for (auto const &column : m_columns) {
@@ -198,6 +207,54 @@ flex_table_t::build_sql_create_table(table_type ttype,
     sql += joiner();
     sql += ')';
 
+    switch (m_partition_type) {
+    case flex_partition_type::none:
+        if (ttype == table_type::interim) {
+            sql += " WITH (autovacuum_enabled = off)";
+        }
+        break;
+    case flex_partition_type::type:
+    case flex_partition_type::tile:
+        sql += fmt::format(R"( PARTITION BY LIST ("{}"))",
+                           partition_column_name());
+        break;
+    case flex_partition_type::id:
+        sql += fmt::format(R"( PARTITION BY HASH ("{}"))",
+                           partition_column_name());
+        break;
+    }
+
+    sql += tablespace_clause(m_data_tablespace);
+
+    return sql;
+}
+
+std::string flex_table_t::build_sql_create_partition(
+    table_type ttype, std::string const &parent, std::size_t partition,
+    std::string const &partition_name) const
+{
+    assert(is_partitioned());
+    assert(partition < m_num_partitions);
+
+    std::string sql = fmt::format(
+        "CREATE {} TABLE IF NOT EXISTS {} PARTITION OF {} FOR VALUES ",
+        ttype == table_type::interim ? "UNLOGGED" : "", partition_name, parent);
+
+    switch (m_partition_type) {
+    case flex_partition_type::type:
+        sql += fmt::format("IN ('{}')", "NWR"[partition]);
+        break;
+    case flex_partition_type::id:
+        sql += fmt::format("WITH (MODULUS {}, REMAINDER {})", m_num_partitions,
+                           partition);
+        break;
+    case flex_partition_type::tile:
+        sql += fmt::format("IN ({})", partition);
+        break;
+    default:
+        assert(false);
+    }
+
     if (ttype == table_type::interim) {
         sql += " WITH (autovacuum_enabled = off)";
     }
@@ -222,23 +279,36 @@ std::string flex_table_t::build_sql_column_list() const
     return joiner();
 }
 
-std::string flex_table_t::build_sql_create_id_index() const
+std::string
+flex_table_t::build_sql_create_id_index_on(std::string const &table_name) const
 {
     if (m_primary_key_index) {
         auto ts = tablespace_clause(index_tablespace());
         if (!ts.empty()) {
             ts = " USING INDEX" + ts;
         }
-        return fmt::format("ALTER TABLE {} ADD PRIMARY KEY ({}){}", full_name(),
+        return fmt::format("ALTER TABLE {} ADD PRIMARY KEY ({}){}", table_name,
                            id_column_names(), ts);
     }
 
     return fmt::format("CREATE {}INDEX ON {} USING BTREE ({}) {}",
-                       m_build_unique_id_index ? "UNIQUE " : "", full_name(),
+                       m_build_unique_id_index ? "UNIQUE " : "", table_name,
                        id_column_names(),
                        tablespace_clause(index_tablespace()));
 }
 
+std::string flex_table_t::build_sql_create_id_index() const
+{
+    return build_sql_create_id_index_on(full_name());
+}
+
+std::string
+flex_table_t::build_sql_create_partition_id_index(std::size_t partition) const
+{
+    return build_sql_create_id_index_on(
+        qualified_name(schema(), partition_name(partition)));
+}
+
 flex_index_t &flex_table_t::add_index(std::string method)
 {
     return m_indexes.emplace_back(std::move(method));
@@ -263,12 +333,142 @@ void flex_table_t::analyze(pg_conn_t const &db_connection) const
     analyze_table(db_connection, schema(), name());
 }
 
+void flex_table_t::set_partition_by_type() noexcept
+{
+    assert(has_multicolumn_id_index());
+    m_partition_type = flex_partition_type::type;
+    m_num_partitions = 3;
+}
+
+void flex_table_t::set_partition_by_id(std::size_t count) noexcept
+{
+    assert(has_id_column());
+    assert(count > 0);
+    m_partition_type = flex_partition_type::id;
+    m_num_partitions = count;
+}
+
+void flex_table_t::set_partition_by_tile(uint32_t zoom,
+                                         std::string const &column)
+{
+    assert(has_geom_column());
+    m_partition_type = flex_partition_type::tile;
+    m_partition_zoom = zoom;
+    m_num_partitions = 1UL << (2 * zoom);
+
+    add_column(column, "int", "int").set_not_null();
+    m_partition_column = m_columns.size() - 1;
+}
+
+std::string const &flex_table_t::partition_column_name() const noexcept
+{
+    assert(is_partitioned());
+
+    switch (m_partition_type) {
+    case flex_partition_type::id:
+        return m_columns[has_multicolumn_id_index() ? 1 : 0].name();
+    case flex_partition_type::tile:
+        return m_columns[m_partition_column].name();
+    default:
+        break;
+    }
+
+    // Partitioned by type
+    return m_columns[0].name();
+}
+
+std::string flex_table_t::partition_name(std::size_t partition) const
+{
+    return fmt::format("{}_p{}", m_name, partition);
+}
+
+std::string flex_table_t::partition_tmp_name(std::size_t partition) const
+{
+    return fmt::format("{}_tmp_p{}", m_name, partition);
+}
+
+std::size_t flex_table_t::tile_partition(geom::geometry_t const &geom) const
+{
+    assert(m_partition_type == flex_partition_type::tile);
+
+    if (geom.is_null()) {
+        return 0;
+    }
+
+    auto center = geom::envelope(geom).center();
+    if (geom.srid() == PROJ_LATLONG) {
+        auto const c = osmium::geom::lonlat_to_mercator(
+            osmium::geom::Coordinates{
+                center.x(), std::clamp(center.y(),
+                                       -osmium::geom::MERCATOR_MAX_LAT,
+                                       osmium::geom::MERCATOR_MAX_LAT)});
+        center = geom::point_t{c.x, c.y};
+    } else if (geom.srid() != PROJ_SPHERE_MERC) {
+        throw fmt_error("Partitioning table '{}' by tile needs geometries in"
+                        " WGS84 (4326) or Web Mercator (3857) projection.",
+                        m_name);
+    }
+
+    auto const num_tiles = 1UL << m_partition_zoom;
+    auto const tile_num = [&](double c) {
+        auto const n = static_cast<std::size_t>(std::clamp(
+            c / tile_t::EARTH_CIRCUMFERENCE * static_cast<double>(num_tiles),
+            0.0, static_cast<double>(num_tiles - 1)));
+        return n;
+    };
+
+    auto const x = tile_num(center.x() + tile_t::HALF_EARTH_CIRCUMFERENCE);
+    auto const y = tile_num(tile_t::HALF_EARTH_CIRCUMFERENCE - center.y());
+
+    return y * num_tiles + x;
+}
+
 void flex_table_t::enable_id_cache() noexcept { m_with_id_cache = true; }
 
 bool flex_table_t::with_id_cache() const noexcept { return m_with_id_cache; }
 
 namespace {
 
+/**
+ * Run func(db_connection, partition) for all partitions of the table using
+ * up to num_threads threads, each with its own database connection.
+ */
+template <typename FUNC>
+void for_each_partition(flex_table_t const &table,
+                        connection_params_t const &connection_params,
+                        unsigned int num_threads, FUNC const &func)
+{
+    std::atomic<std::size_t> next_partition{0};
+
+    auto const run = [&]() {
+        pg_conn_t const db_connection{connection_params, "out.flex.part"};
+        for (std::size_t n = next_partition++; n < table.num_partitions();
+             n = next_partition++) {
+            func(db_connection, n);
+        }
+    };
+
+    auto const num_workers =
+        std::clamp(table.num_partitions(), std::size_t{1},
+                   static_cast<std::size_t>(std::max(num_threads, 1U)));
+
+    std::vector<std::future<void>> workers;
+    workers.reserve(num_workers);
+    for (std::size_t i = 0; i < num_workers; ++i) {
+        workers.push_back(std::async(std::launch::async, run));
+    }
+
+    for (auto &worker : workers) {
+        try {
+            worker.get();
+        } catch (...) {
+            // Make sure the other workers don't start on new partitions.
+            next_partition = table.num_partitions();
+            throw;
+        }
+    }
+}
+
 void enable_check_trigger(pg_conn_t const &db_connection,
                           flex_table_t const &table)
 {
@@ -289,8 +489,45 @@ void enable_check_trigger(pg_conn_t const &db_connection,
     // remove last " AND "
     checks.resize(checks.size() - 5);
 
-    create_geom_check_trigger(db_connection, table.schema(), table.name(),
-                              checks);
+    // Row triggers on partitioned tables need PostgreSQL 13, so we always
+    // create them on the partitions.
+    if (!table.is_partitioned()) {
+        create_geom_check_trigger(db_connection, table.schema(), table.name(),
+                                  checks);
+        return;
+    }
+
+    for (std::size_t n = 0; n < table.num_partitions(); ++n) {
+        create_geom_check_trigger(db_connection, table.schema(),
+                                  table.partition_name(n), checks);
+    }
+}
+
+void drop_check_trigger(pg_conn_t const &db_connection,
+                        flex_table_t const &table)
+{
+    if (!table.is_partitioned()) {
+        drop_geom_check_trigger(db_connection, table.schema(), table.name());
+        return;
+    }
+
+    for (std::size_t n = 0; n < table.num_partitions(); ++n) {
+        drop_geom_check_trigger(db_connection, table.schema(),
+                                table.partition_name(n));
+    }
+}
+
+void create_partitions(pg_conn_t const &db_connection,
+                       flex_table_t const &table,
+                       flex_table_t::table_type ttype, bool tmp)
+{
+    auto const parent = tmp ? table.full_tmp_name() : table.full_name();
+    for (std::size_t n = 0; n < table.num_partitions(); ++n) {
+        auto const name = tmp ? table.partition_tmp_name(n)
+                              : table.partition_name(n);
+        db_connection.exec(table.build_sql_create_partition(
+            ttype, parent, n, qualified_name(table.schema(), name)));
+    }
 }
 
 } // anonymous namespace
@@ -307,10 +544,17 @@ void table_connection_t::start(pg_conn_t const &db_connection,
                          table().name() + "_tmp");
 
     if (!append) {
-        db_connection.exec(table().build_sql_create_table(
-            table().cluster_by_geom() ? flex_table_t::table_type::interim
-                                      : flex_table_t::table_type::permanent,
-            table().full_name()));
+        auto const ttype = table().cluster_by_geom()
+                               ? flex_table_t::table_type::interim
+                               : flex_table_t::table_type::permanent;
+        db_connection.exec(
+            table().build_sql_create_table(ttype, table().full_name()));
+
+        if (table().is_partitioned()) {
+            log_debug("Creating {} partitions for table '{}'.",
+                      table().num_partitions(), table().name());
+            create_partitions(db_connection, table(), ttype, false);
+        }
 
         enable_check_trigger(db_connection, table());
     }
@@ -318,7 +562,88 @@ void table_connection_t::start(pg_conn_t const &db_connection,
     table().prepare(db_connection);
 }
 
-void table_connection_t::stop(pg_conn_t const &db_connection, bool updateable,
+void table_connection_t::cluster_partitions(
+    pg_conn_t const &db_connection,
+    connection_params_t const &connection_params, unsigned int num_threads,
+    bool updateable)
+{
+    if (table().geom_column().needs_isvalid()) {
+        drop_check_trigger(db_connection, table());
+    }
+
+    log_info("Clustering table '{}' by geometry ({} partitions)...",
+             table().name(), table().num_partitions());
+
+    db_connection.exec(table().build_sql_create_table(
+        flex_table_t::table_type::permanent, table().full_tmp_name()));
+    create_partitions(db_connection, table(),
+                      flex_table_t::table_type::permanent, true);
+
+    std::string const columns = table().build_sql_column_list();
+    auto const geom_column_name = "\"" + table().geom_column().name() + "\"";
+
+    for_each_partition(
+        table(), connection_params, num_threads,
+        [&](pg_conn_t const &conn, std::size_t n) {
+            conn.exec("INSERT INTO {} ({}) SELECT {} FROM {} ORDER BY {}",
+                      qualified_name(table().schema(),
+                                     table().partition_tmp_name(n)),
+                      columns, columns,
+                      qualified_name(table().schema(),
+                                     table().partition_name(n)),
+                      geom_column_name);
+        });
+
+    db_connection.exec("DROP TABLE {}", table().full_name());
+    db_connection.exec(R"(ALTER TABLE {} RENAME TO "{}")",
+                       table().full_tmp_name(), table().name());
+    for (std::size_t n = 0; n < table().num_partitions(); ++n) {
+        db_connection.exec(R"(ALTER TABLE {} RENAME TO "{}")",
+                           qualified_name(table().schema(),
+                                          table().partition_tmp_name(n)),
+                           table().partition_name(n));
+    }
+    m_id_index_created = false;
+
+    if (updateable) {
+        enable_check_trigger(db_connection, table());
+    }
+}
+
+void table_connection_t::create_partition_indexes(
+    pg_conn_t const &db_connection,
+    connection_params_t const &connection_params, unsigned int num_threads,
+    bool with_id_index)
+{
+    log_info("Creating indexes on {} partitions of table '{}'...",
+             table().num_partitions(), table().name());
+
+    for_each_partition(
+        table(), connection_params, num_threads,
+        [&](pg_conn_t const &conn, std::size_t n) {
+            auto const name =
+                qualified_name(table().schema(), table().partition_name(n));
+            for (auto const &index : table().indexes()) {
+                conn.exec(index.create_index(name, false));
+            }
+            if (with_id_index) {
+                conn.exec(table().build_sql_create_partition_id_index(n));
+            }
+        });
+
+    // Creating the indexes on the partitioned table is fast now, because
+    // PostgreSQL attaches the matching indexes on the partitions.
+    for (auto const &index : table().indexes()) {
+        db_connection.exec(index.create_index(table().full_name()));
+    }
+    if (with_id_index) {
+        create_id_index(db_connection);
+    }
+}
+
+void table_connection_t::stop(pg_conn_t const &db_connection,
+                              connection_params_t const &connection_params,
+                              unsigned int num_threads, bool updateable,
                               bool append)
 {
     m_copy_mgr.sync();
@@ -327,10 +652,31 @@ void table_connection_t::stop(pg_conn_t const &db_connection, bool updateable,
         return;
     }
 
+    bool const with_id_index =
+        (table().always_build_id_index() || updateable) &&
+        table().has_id_column();
+
+    if (table().is_partitioned()) {
+        if (table().cluster_by_geom()) {
+            cluster_partitions(db_connection, connection_params, num_threads,
+                               updateable);
+        }
+
+        // The id index could have been created already on the partitioned
+        // table for stage 2 processing. In that case it doesn't need to be
+        // created on the partitions again.
+        create_partition_indexes(db_connection, connection_params,
+                                 num_threads,
+                                 with_id_index && !m_id_index_created);
+
+        log_info("Analyzing table '{}'...", table().name());
+        table().analyze(db_connection);
+        return;
+    }
+
     if (table().cluster_by_geom()) {
         if (table().geom_column().needs_isvalid()) {
-            drop_geom_check_trigger(db_connection, table().schema(),
-                                    table().name());
+            drop_check_trigger(db_connection, table());
         }
 
         log_info("Clustering table '{}' by geometry...", table().name());
@@ -372,8 +718,7 @@ void table_connection_t::stop(pg_conn_t const &db_connection, bool updateable,
         }
     }
 
-    if ((table().always_build_id_index() || updateable) &&
-        table().has_id_column()) {
+    if (with_id_index) {
         create_id_index(db_connection);
     }
 
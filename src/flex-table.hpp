@@ -48,6 +48,18 @@ enum class flex_table_index_type : uint8_t
     tile // index by tile with x and y columns (used for generalized data)
 };
 
+/**
+ * How a flex table is partitioned (using the PostgreSQL declarative
+ * partitioning).
+ */
+enum class flex_partition_type : uint8_t
+{
+    none, // not partitioned
+    type, // list partitioned by the OSM object type column
+    id,   // hash partitioned by the id column
+    tile  // list partitioned by a tile number calculated from the geometry
+};
+
 /**
  * An output table (in the SQL sense) for the flex backend.
  */
@@ -157,8 +169,22 @@ public:
 
     std::string build_sql_column_list() const;
 
+    std::string
+    build_sql_create_partition(table_type ttype, std::string const &parent,
+                               std::size_t partition,
+                               std::string const &partition_name) const;
+
     std::string build_sql_create_id_index() const;
 
+    /**
+     * Build SQL for creating the id index on a single partition of this
+     * table. When the id index is created on the partitioned table later,
+     * PostgreSQL will attach the existing partition indexes instead of
+     * building new ones.
+     */
+    std::string
+    build_sql_create_partition_id_index(std::size_t partition) const;
+
     /// Does this table take objects of the specified type?
     bool matches_type(osmium::item_type type) const noexcept;
 
@@ -209,6 +235,57 @@ public:
 
     bool has_columns_with_expire() const noexcept;
 
+    flex_partition_type partition_type() const noexcept
+    {
+        return m_partition_type;
+    }
+
+    bool is_partitioned() const noexcept
+    {
+        return m_partition_type != flex_partition_type::none;
+    }
+
+    /// Partition by OSM object type. Needs a type column.
+    void set_partition_by_type() noexcept;
+
+    /// Partition by id into the specified number of partitions.
+    void set_partition_by_id(std::size_t count) noexcept;
+
+    /**
+     * Partition by the web mercator tile at the specified zoom level
+     * containing the center of the bounding box of the (first) geometry
+     * column. The tile number is stored in an additional column with
+     * the specified name which is added to the table.
+     */
+    void set_partition_by_tile(uint32_t zoom, std::string const &column);
+
+    std::size_t num_partitions() const noexcept { return m_num_partitions; }
+
+    /**
+     * The name of the column the table is partitioned by. Only valid for
+     * partitioned tables.
+     */
+    std::string const &partition_column_name() const noexcept;
+
+    /// The name of a partition (without schema).
+    std::string partition_name(std::size_t partition) const;
+
+    /// The name of the temporary table for a partition (without schema).
+    std::string partition_tmp_name(std::size_t partition) const;
+
+    /// Is this the column holding the tile number for partitioning?
+    bool is_partition_column(flex_table_column_t const &column) const noexcept
+    {
+        return m_partition_type == flex_partition_type::tile &&
+               &column == &m_columns[m_partition_column];
+    }
+
+    /**
+     * Calculate the partition (tile number) for a geometry. Only valid for
+     * tables partitioned by tile.
+     */
+    std::size_t tile_partition(geom::geometry_t const &geom) const;
+
     std::size_t num() const noexcept { return m_table_num; }
 
     void prepare(pg_conn_t const &db_connection) const;
@@ -220,6 +297,9 @@ public:
     bool with_id_cache() const noexcept;
 
 private:
+    std::string
+    build_sql_create_id_index_on(std::string const &table_name) const;
+
     /// The schema this table is in
     std::string m_schema;
 
@@ -278,6 +358,18 @@ private:
     /// Do we want an ID cache for this table?
     bool m_with_id_cache = false;
 
+    /// How is this table partitioned?
+    flex_partition_type m_partition_type = flex_partition_type::none;
+
+    /// Number of partitions (if partitioned).
+    std::size_t m_num_partitions = 0;
+
+    /// Zoom level of the tiles if partitioned by tile.
+    uint32_t m_partition_zoom = 0;
+
+    /// Index of the column with the tile number if partitioned by tile.
+    std::size_t m_partition_column = std::numeric_limits<std::size_t>::max();
+
 }; // class flex_table_t
 
 class table_connection_t
@@ -295,7 +387,14 @@ public:
 
     void start(pg_conn_t const &db_connection, bool append) const;
 
-    void stop(pg_conn_t const &db_connection, bool updateable, bool append);
+    /**
+     * Finish the import into this table: Cluster the table, create the
+     * indexes and analyze it. Partitioned tables are processed with up to
+     * num_threads database connections in parallel.
+     */
+    void stop(pg_conn_t const &db_connection,
+              connection_params_t const &connection_params,
+              unsigned int num_threads, bool updateable, bool append);
 
     flex_table_t const &table() const noexcept { return *m_table; }
 
@@ -342,6 +441,14 @@ public:
     }
 
 private:
+    void cluster_partitions(pg_conn_t const &db_connection,
+                            connection_params_t const &connection_params,
+                            unsigned int num_threads, bool updateable);
+
+    void create_partition_indexes(pg_conn_t const &db_connection,
+                                  connection_params_t const &connection_params,
+                                  unsigned int num_threads, bool with_id_index);
+
     std::shared_ptr<reprojection_t> m_proj;
 
     flex_table_t *m_table;
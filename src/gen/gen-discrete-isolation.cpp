@@ -136,9 +136,13 @@ FROM {src} WHERE {importance_column} > 0
 
     timer(m_timer_write).start();
     connection().exec("BEGIN");
-    std::size_t n = 0;
-    for (auto const &d : data) {
-        connection().exec_prepared("update", n++, d.di, d.irank, d.id);
+    {
+        pg_pipeline_t pipeline{connection()};
+        std::size_t n = 0;
+        for (auto const &d : data) {
+            pipeline.exec_prepared("update", n++, d.di, d.irank, d.id);
+        }
+        pipeline.finish();
     }
     connection().exec("COMMIT");
     timer(m_timer_write).stop();
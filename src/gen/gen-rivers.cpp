@@ -9,26 +9,26 @@
 
 #include "gen-rivers.hpp"
 
-#include "geom-functions.hpp"
-#include "hex.hpp"
+#include "river-network.hpp"
+
+#include "format.hpp"
 #include "logging.hpp"
 #include "params.hpp"
+#include "pgsql-helper.hpp"
 #include "pgsql.hpp"
 #include "projection.hpp"
-#include "util.hpp"
 #include "wkb.hpp"
 
 #include <algorithm>
-#include <cassert>
-#include <map>
+#include <cstdint>
+#include <string>
 #include <unordered_map>
-#include <vector>
+#include <utility>
 
 gen_rivers_t::gen_rivers_t(pg_conn_t *connection, bool append, params_t *params)
 : gen_base_t(connection, append, params), m_timer_area(add_timer("area")),
   m_timer_prep(add_timer("prep")), m_timer_get(add_timer("get")),
-  m_timer_sort(add_timer("sort")), m_timer_net(add_timer("net")),
-  m_timer_remove(add_timer("remove")), m_timer_width(add_timer("width")),
+  m_timer_net(add_timer("net")), m_timer_width(add_timer("width")),
   m_timer_write(add_timer("write"))
 {
     check_src_dest_table_params_exist();
@@ -41,132 +41,29 @@ gen_rivers_t::gen_rivers_t(pg_conn_t *connection, bool append, params_t *params)
     params->set("qualified_src_areas",
                 qualified_name(get_params().get_string("schema"),
                                get_params().get_string("src_areas")));
-}
-
-namespace {
-
-/// The data for a graph edge in the waterway network.
-struct edge_t
-{
-    // All the points in this edge
-    geom::linestring_t points;
-
-    // Edges can be made from (part) of one or more OSM ways, this is the id
-    // of one of them.
-    osmid_t id = 0;
-
-    // The width of the river along this edge
-    double width = 0.0;
-};
-
-bool operator<(edge_t const &a, edge_t const &b) noexcept
-{
-    assert(a.points.size() > 1 && b.points.size() > 1);
-    if (a.points[0] == b.points[0]) {
-        return a.points[1] < b.points[1];
-    }
-    return a.points[0] < b.points[0];
-}
-
-bool operator<(edge_t const &a, geom::point_t b) noexcept
-{
-    assert(!a.points.empty());
-    return a.points[0] < b;
-}
 
-bool operator<(geom::point_t a, edge_t const &b) noexcept
-{
-    assert(!b.points.empty());
-    return a < b.points[0];
-}
-
-void follow_chain_and_set_width(
-    edge_t const &edge, std::vector<edge_t> *edges,
-    std::map<geom::point_t, uint8_t> const &node_order,
-    geom::linestring_t *seen)
-{
-    assert(!edge.points.empty());
-
-    auto const seen_it =
-        std::find(seen->cbegin(), seen->cend(), edge.points[0]);
-    if (seen_it != seen->cend()) {
-        return; // loop detected
-    }
-
-    seen->push_back(edge.points[0]);
-
-    assert(edge.points.size() > 1);
-    auto const next_point = edge.points.back();
-    if (node_order.at(next_point) > 1) {
-        auto const [s, e] =
-            std::equal_range(edges->begin(), edges->end(), next_point);
-
-        if (std::next(s) == e) {
-            if (s->width < edge.width) {
-                s->width = edge.width;
-                follow_chain_and_set_width(*s, edges, node_order, seen);
-            }
-        } else {
-            for (auto it = s; it != e; ++it) {
-                assert(it->points[0] == next_point);
-                if (it->width < edge.width) {
-                    it->width = edge.width;
-                    auto seen2 = *seen;
-                    follow_chain_and_set_width(*it, edges, node_order, &seen2);
-                }
-            }
+    // If there is an expire list, we keep track of the connected component
+    // each waterway is in so that updates can be limited to the components
+    // touched by the changes.
+    if (params->has("expire_list")) {
+        if (!params->has("zoom")) {
+            throw fmt_error("Missing 'zoom' parameter in generalizer{}.",
+                            context());
         }
+        params->set("zoom", uint_in_range(*params, "zoom", 0, 20, 0));
+
+        params->check_identifier_with_default(
+            "components_table",
+            get_params().get_string("dest_table") + "_components");
+        params->set(
+            "qualified_components_table",
+            qualified_name(get_params().get_string("schema"),
+                           get_params().get_string("components_table")));
+        m_track_components = true;
     }
 }
 
-void assemble_edge(edge_t *edge, std::vector<edge_t> *edges,
-                   std::map<geom::point_t, uint8_t> const &node_order)
-{
-    assert(edge);
-    assert(edges);
-    while (true) {
-        assert(edge->points.size() > 1);
-        geom::point_t const next_point = edge->points.back();
-
-        auto const count = node_order.at(next_point);
-        if (count != 2) {
-            return;
-        }
-
-        auto const [s, e] =
-            std::equal_range(edges->begin(), edges->end(), next_point);
-
-        if (s == e) {
-            return;
-        }
-        assert(e == std::next(s));
-
-        auto const it = s;
-        if (it->points.size() == 1 || &*it == edge) {
-            return;
-        }
-
-        if (it->points[0] != next_point) {
-            return;
-        }
-        assert(it != edges->end());
-
-        edge->width = std::max(edge->width, it->width);
-
-        if (it->points.size() == 2) {
-            edge->points.push_back(it->points.back());
-            it->points.resize(1);
-            it->points.shrink_to_fit();
-        } else {
-            edge->points.insert(edge->points.end(),
-                                std::next(it->points.begin()),
-                                it->points.end());
-            it->points.resize(1);
-            it->points.shrink_to_fit();
-            return;
-        }
-    }
-}
+namespace {
 
 std::string const &get_name(
     std::unordered_map<osmid_t, std::string> const &names, osmid_t id)
@@ -182,10 +79,11 @@ std::string const &get_name(
 } // anonymous namespace
 
 /// Get some stats from source table
-void gen_rivers_t::get_stats()
+void gen_rivers_t::get_stats(params_t const &tmp_params)
 {
-    auto const result =
-        dbexec("SELECT count(*), sum(ST_NumPoints(geom)) FROM {src}");
+    auto const result = dbexec(tmp_params, "SELECT count(*),"
+                                           " sum(ST_NumPoints(geom))"
+                                           " FROM {src} {where_affected}");
 
     m_num_waterways = strtoul(result.get_value(0, 0), nullptr, 10);
     m_num_points = strtoul(result.get_value(0, 1), nullptr, 10);
@@ -194,7 +92,67 @@ void gen_rivers_t::get_stats()
             m_num_points);
 }
 
-void gen_rivers_t::process()
+bool gen_rivers_t::components_table_exists()
+{
+    auto const result =
+        dbexec("SELECT to_regclass('{qualified_components_table}')");
+    return !result.is_null(0, 0);
+}
+
+std::size_t gen_rivers_t::find_affected_waterways()
+{
+    log_gen("Finding waterways affected by changes...");
+
+    dbexec("CREATE TEMP TABLE osm2pgsql_rivers_tiles (box geometry)");
+    dbexec(R"(
+WITH _tiles AS (
+    DELETE FROM "{expire_list}" WHERE zoom = {zoom} RETURNING x, y
+)
+INSERT INTO osm2pgsql_rivers_tiles
+    SELECT ST_TileEnvelope({zoom}, x, y) FROM _tiles
+)");
+
+    // Waterways in the source table in the expired tiles. These are new
+    // or changed.
+    dbexec("CREATE TEMP TABLE osm2pgsql_rivers_changed (id int8)");
+    dbexec(R"(
+INSERT INTO osm2pgsql_rivers_changed
+    SELECT DISTINCT w."{id_column}" FROM {src} w, osm2pgsql_rivers_tiles t
+        WHERE ST_Intersects(w."{geom_column}", t.box)
+)");
+
+    // All waterways in the components touched by the changes. These are
+    // the components the changed waterways were in before and the ones
+    // they are connected to now. Removed waterways are found through the
+    // results in the destination table that were generated from them.
+    dbexec("CREATE TEMP TABLE osm2pgsql_rivers_affected (id int8)");
+    dbexec(R"(
+WITH _touched AS (
+    SELECT id FROM osm2pgsql_rivers_changed
+    UNION
+    SELECT d."{id_column}" FROM {dest} d, osm2pgsql_rivers_tiles t
+        WHERE ST_Intersects(d.geom, t.box)
+    UNION
+    SELECT w."{id_column}" FROM {src} w, {src} c
+        WHERE c."{id_column}" IN (SELECT id FROM osm2pgsql_rivers_changed)
+          AND ST_Intersects(w."{geom_column}", c."{geom_column}")
+)
+INSERT INTO osm2pgsql_rivers_affected
+    SELECT id FROM osm2pgsql_rivers_changed
+    UNION
+    SELECT way_id FROM {qualified_components_table} WHERE component IN
+        (SELECT component FROM {qualified_components_table}
+            WHERE way_id IN (SELECT id FROM _touched))
+)");
+
+    dbexec("ANALYZE osm2pgsql_rivers_affected");
+
+    auto const result =
+        dbexec("SELECT count(*) FROM osm2pgsql_rivers_affected");
+    return std::strtoul(result.get_value(0, 0), nullptr, 10);
+}
+
+void gen_rivers_t::update_widths_from_areas()
 {
     log_gen("Calculate waterway area width...");
     timer(m_timer_area).start();
@@ -213,7 +171,8 @@ void gen_rivers_t::process()
     dbexec(R"(
 WITH _covered_lines AS (
     SELECT "{geom_column}" AS geom, "{id_column}" AS wid FROM {src} w
-        WHERE ST_NumPoints(w."{geom_column}") > 2 AND ST_CoveredBy(w."{geom_column}",
+        WHERE w.width IS NULL AND ST_NumPoints(w."{geom_column}") > 2
+          AND ST_CoveredBy(w."{geom_column}",
             (SELECT ST_Union("{geom_column}") FROM {qualified_src_areas} a
                 WHERE ST_Intersects(w."{geom_column}", a."{geom_column}")))
 ), _intersections AS (
@@ -232,21 +191,42 @@ UPDATE {src} a SET width = l.width
     FROM _glines l WHERE l.wid = a."{id_column}" AND a.width IS NULL
     )");
     timer(m_timer_prep).stop();
+}
 
-    log_gen("Reading waterway lines from database...");
-    get_stats();
+void gen_rivers_t::process()
+{
+    update_widths_from_areas();
+
+    bool incremental = false;
+    if (m_track_components && append_mode()) {
+        if (components_table_exists()) {
+            incremental = true;
+        } else {
+            log_gen("Components table missing, processing all waterways.");
+        }
+    }
 
-    // This vector will initially contain all segments (connection between
-    // two points) from waterway ways. They will later be assembled into
-    // graph edges connecting points where the waterways network branches.
-    std::vector<edge_t> edges;
-    edges.reserve(m_num_points - m_num_waterways);
+    params_t tmp_params;
+    tmp_params.set("where_affected", "");
+    if (incremental) {
+        auto const count = find_affected_waterways();
+        log_gen("Found {} waterways in components affected by changes.",
+                count);
+        if (count == 0) {
+            log_gen("Nothing to do.");
+            return;
+        }
+        tmp_params.set(
+            "where_affected",
+            fmt::format(R"(WHERE "{}" IN)"
+                        " (SELECT id FROM osm2pgsql_rivers_affected)",
+                        get_params().get_string("id_column")));
+    }
 
-    // This stores the order of each node in our graph, i.e. the number of
-    // connections this node has. Order 1 are beginning or end of a waterway,
-    // order 2 is just the continuing waterway, order >= 3 is a branching
-    // point.
-    std::map<geom::point_t, uint8_t> node_order;
+    log_gen("Reading waterway lines from database...");
+    get_stats(tmp_params);
+
+    river_network_t network;
 
     // This is where we keep the names of all waterways indexed by their
     // way id.
@@ -254,86 +234,55 @@ UPDATE {src} a SET width = l.width
 
     timer(m_timer_get).start();
     {
-        auto const result = dbexec(R"(
-SELECT "{id_column}", "{width_column}", "{name_column}", "{geom_column}"
- FROM {src};
+        // Get results in binary format so that we don't have to parse
+        // numbers and hex-encoded geometries.
+        dbprepare("get", tmp_params, R"(
+SELECT "{id_column}"::int8, COALESCE("{width_column}", 0)::float8,
+       "{name_column}", "{geom_column}"
+ FROM {src} {where_affected}
 )");
+        auto const result = connection().exec_prepared_as_binary("get");
 
         for (int i = 0; i < result.num_tuples(); ++i) {
-            auto const id = std::strtol(result.get_value(i, 0), nullptr, 10);
-            auto const width = std::strtod(result.get_value(i, 1), nullptr);
+            auto const id = decode_binary_int8(result.get_value(i, 0));
+            auto const width = decode_binary_float8(result.get_value(i, 1));
             auto const name = result.get(i, 2);
             if (!name.empty()) {
                 names.emplace(id, name);
             }
-            auto const geom = ewkb_to_geom(util::decode_hex(result.get(i, 3)));
+            auto const geom = ewkb_to_geom(result.get(i, 3));
 
             if (geom.is_linestring()) {
-                auto const &ls = geom.get<geom::linestring_t>();
-                geom::for_each_segment(ls,
-                                       [&](geom::point_t a, geom::point_t b) {
-                                           if (a != b) {
-                                               auto &f = edges.emplace_back();
-                                               f.points.push_back(a);
-                                               f.points.push_back(b);
-                                               f.id = id;
-                                               f.width = width;
-                                               node_order[a]++;
-                                               node_order[b]++;
-                                           }
-                                       });
+                network.add_waterway(id, width,
+                                     geom.get<geom::linestring_t>());
             }
         }
     }
     timer(m_timer_get).stop();
-    log_gen("Read {} segments, {} unique points, and {} names.", edges.size(),
-            node_order.size(), names.size());
-
-    if (edges.size() < 2) {
-        log_gen("Found fewer than two segments. Nothing to do.");
-        return;
-    }
 
-    log_gen("Sorting segments...");
-    timer(m_timer_sort).start();
-    std::sort(edges.begin(), edges.end());
-    timer(m_timer_sort).stop();
+    auto const num_threads = static_cast<unsigned int>(
+        std::max(get_params().get_int64("jobs", 1), int64_t{1}));
 
-    log_gen("Assembling edges from segments...");
+    log_gen("Building waterway network...");
     timer(m_timer_net).start();
-    for (auto &edge : edges) {
-        if (edge.points.size() > 1) {
-            assemble_edge(&edge, &edges, node_order);
-        }
-    }
+    network.build(num_threads);
     timer(m_timer_net).stop();
+    log_gen("Network has {} segments, {} unique points, {} edges, and {}"
+            " names.",
+            network.num_segments(), network.num_nodes(), network.num_edges(),
+            names.size());
 
-    log_gen("Removing now empty edges...");
-    timer(m_timer_remove).start();
-    {
-        auto const last =
-            std::remove_if(edges.begin(), edges.end(), [](edge_t const &edge) {
-                return edge.points.size() == 1;
-            });
-        edges.erase(last, edges.end());
-        std::sort(edges.begin(), edges.end());
+    if (!incremental && network.num_segments() < 2) {
+        log_gen("Found fewer than two segments. Nothing to do.");
+        return;
     }
-    timer(m_timer_remove).stop();
-
-    log_gen("Network has {} edges.", edges.size());
 
     log_gen("Propagating 'width' property downstream...");
     timer(m_timer_width).start();
-    for (auto &edge : edges) {
-        assert(!edge.points.empty());
-        geom::linestring_t seen;
-        follow_chain_and_set_width(edge, &edges, node_order, &seen);
-    }
+    network.propagate_widths(num_threads);
     timer(m_timer_width).stop();
-
-    if (append_mode()) {
-        dbexec("TRUNCATE {dest}");
-    }
+    log_gen("Network has {} connected components.",
+            network.num_components());
 
     log_gen("Writing results to destination table...");
     dbprepare("ins", "INSERT INTO {dest} ({id_column}, width, name, geom)"
@@ -341,12 +290,25 @@ SELECT "{id_column}", "{width_column}", "{name_column}", "{geom_column}"
 
     timer(m_timer_write).start();
     connection().exec("BEGIN");
-    for (auto &edge : edges) {
-        geom::geometry_t const geom{std::move(edge.points), PROJ_SPHERE_MERC};
-        auto const wkb = geom_to_ewkb(geom);
-        connection().exec_prepared("ins", edge.id, edge.width,
-                                   get_name(names, edge.id),
+    if (incremental) {
+        dbexec(R"(DELETE FROM {dest} WHERE "{id_column}" IN)"
+               " (SELECT id FROM osm2pgsql_rivers_affected)");
+    } else if (append_mode()) {
+        dbexec("TRUNCATE {dest}");
+    }
+    {
+        pg_pipeline_t pipeline{connection()};
+        network.for_each_edge([&](osmid_t id, double width,
+                                  geom::linestring_t &&points) {
+            geom::geometry_t const geom{std::move(points), PROJ_SPHERE_MERC};
+            auto const wkb = geom_to_ewkb(geom);
+            pipeline.exec_prepared("ins", id, width, get_name(names, id),
                                    binary_param_t(wkb));
+        });
+        pipeline.finish();
+    }
+    if (m_track_components) {
+        write_components(network, incremental);
     }
     connection().exec("COMMIT");
     timer(m_timer_write).stop();
@@ -357,3 +319,36 @@ SELECT "{id_column}", "{width_column}", "{name_column}", "{geom_column}"
 
     log_gen("Done.");
 }
+
+void gen_rivers_t::write_components(river_network_t const &network,
+                                    bool incremental)
+{
+    log_gen("Writing connected components...");
+
+    if (incremental) {
+        dbexec("DELETE FROM {qualified_components_table} WHERE way_id IN"
+               " (SELECT id FROM osm2pgsql_rivers_affected)");
+    } else {
+        // All tiles are up to date after a full run.
+        dbexec(R"(DELETE FROM "{expire_list}" WHERE zoom = {zoom})");
+        dbexec("DROP TABLE IF EXISTS {qualified_components_table}");
+        dbexec("CREATE TABLE {qualified_components_table}"
+               " (way_id int8 NOT NULL, component int8 NOT NULL)");
+    }
+
+    dbprepare("ins_component", "INSERT INTO {qualified_components_table}"
+                               " (way_id, component) VALUES ($1, $2)");
+    {
+        pg_pipeline_t pipeline{connection()};
+        network.for_each_waterway_component(
+            [&](osmid_t id, osmid_t component) {
+                pipeline.exec_prepared("ins_component", id, component);
+            });
+        pipeline.finish();
+    }
+
+    if (!incremental) {
+        dbexec("CREATE INDEX ON {qualified_components_table} (way_id)");
+        dbexec("CREATE INDEX ON {qualified_components_table} (component)");
+    }
+}
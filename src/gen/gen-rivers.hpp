@@ -17,7 +17,17 @@
 
 class params_t;
 class pg_conn_t;
+class river_network_t;
 
+/**
+ * Generalizer for waterway networks: Propagates the width of rivers
+ * downstream so that smaller waterways flowing out of larger ones get the
+ * larger width.
+ *
+ * If the 'expire_list' parameter is set, the connected component of each
+ * waterway is stored in the 'components_table'. In append mode only the
+ * components touched by tiles in the expire list are then recalculated.
+ */
 class gen_rivers_t : public gen_base_t
 {
 public:
@@ -28,19 +38,36 @@ public:
     std::string_view strategy() const noexcept override { return "rivers"; }
 
 private:
-    void get_stats();
+    void get_stats(params_t const &tmp_params);
+
+    /// Update the widths of lines from the waterway areas they are in.
+    void update_widths_from_areas();
+
+    bool components_table_exists();
+
+    /**
+     * Find all waterways in connected components touched by the tiles in
+     * the expire list and store their ids in a temporary table.
+     *
+     * \returns The number of waterways found.
+     */
+    std::size_t find_affected_waterways();
+
+    /// Write the connected component of each waterway into the database.
+    void write_components(river_network_t const &network, bool incremental);
 
     std::size_t m_timer_area;
     std::size_t m_timer_prep;
     std::size_t m_timer_get;
-    std::size_t m_timer_sort;
     std::size_t m_timer_net;
-    std::size_t m_timer_remove;
     std::size_t m_timer_width;
     std::size_t m_timer_write;
 
     std::size_t m_num_waterways = 0;
     std::size_t m_num_points = 0;
+
+    /// Keep track of connected components for incremental updates?
+    bool m_track_components = false;
 };
 
 #endif // OSM2PGSQL_GEN_RIVERS_HPP
@@ -323,6 +323,10 @@ public:
             params.set("schema", m_dbschema);
         }
 
+        if (!params.has("jobs")) {
+            params.set("jobs", m_jobs);
+        }
+
         write_to_debug_log(params, "Params (config):");
 
         log_debug("Connecting to database...");
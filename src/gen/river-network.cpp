@@ -0,0 +1,365 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "river-network.hpp"
+
+#include "format.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <future>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+/**
+ * Run func in num_threads threads (including the current one) and wait for
+ * all of them to finish. Exceptions are propagated.
+ */
+template <typename FUNC>
+void run_in_threads(unsigned int num_threads, FUNC const &func)
+{
+    std::vector<std::future<void>> futures;
+    for (unsigned int n = 1; n < num_threads; ++n) {
+        futures.push_back(std::async(std::launch::async, func));
+    }
+    func();
+    for (auto &future : futures) {
+        future.get();
+    }
+}
+
+/**
+ * Sort items into CSR format: Afterwards the items (indexes 0 to num_items-1)
+ * for node n are in items[offsets[n]] to items[offsets[n + 1] - 1].
+ */
+template <typename NODE_FUNC>
+void build_csr(std::size_t num_nodes, std::size_t num_items,
+               NODE_FUNC const &node_of, std::vector<std::size_t> *offsets,
+               std::vector<std::uint32_t> *items)
+{
+    offsets->assign(num_nodes + 1, 0);
+    for (std::size_t i = 0; i < num_items; ++i) {
+        ++(*offsets)[node_of(i) + 1];
+    }
+    std::partial_sum(offsets->begin(), offsets->end(), offsets->begin());
+
+    std::vector<std::size_t> pos(offsets->begin(), std::prev(offsets->end()));
+    items->resize(num_items);
+    for (std::size_t i = 0; i < num_items; ++i) {
+        (*items)[pos[node_of(i)]++] = static_cast<std::uint32_t>(i);
+    }
+}
+
+} // anonymous namespace
+
+void river_network_t::add_waterway(osmid_t id, double width,
+                                   geom::linestring_t const &points)
+{
+    if (m_waterways.size() == std::numeric_limits<std::uint32_t>::max()) {
+        throw std::runtime_error{"Too many waterways."};
+    }
+
+    m_waterways.push_back({id, width, m_points.size(), points.size(), 0});
+    m_points.insert(m_points.end(), points.cbegin(), points.cend());
+}
+
+void river_network_t::build(unsigned int num_threads)
+{
+    create_nodes(num_threads);
+    create_segments();
+    create_edges();
+}
+
+void river_network_t::create_nodes(unsigned int num_threads)
+{
+    m_nodes.assign(m_points.cbegin(), m_points.cend());
+    std::sort(m_nodes.begin(), m_nodes.end());
+    m_nodes.erase(std::unique(m_nodes.begin(), m_nodes.end()), m_nodes.end());
+    m_nodes.shrink_to_fit();
+
+    if (m_nodes.size() >= std::numeric_limits<node_id_t>::max()) {
+        throw fmt_error("Too many points in waterway network: {}.",
+                        m_nodes.size());
+    }
+
+    // Map all points to their node ids. This is done in chunks in parallel.
+    constexpr std::size_t CHUNK_SIZE = 1024UL * 1024UL;
+    m_point_nodes.resize(m_points.size());
+    std::atomic<std::size_t> next_chunk{0};
+    run_in_threads(num_threads, [&]() {
+        while (true) {
+            auto const begin = CHUNK_SIZE * next_chunk++;
+            if (begin >= m_points.size()) {
+                return;
+            }
+            auto const end = std::min(begin + CHUNK_SIZE, m_points.size());
+            for (auto i = begin; i < end; ++i) {
+                auto const it = std::lower_bound(m_nodes.cbegin(),
+                                                 m_nodes.cend(), m_points[i]);
+                assert(it != m_nodes.cend() && *it == m_points[i]);
+                m_point_nodes[i] =
+                    static_cast<node_id_t>(it - m_nodes.cbegin());
+            }
+        }
+    });
+
+    m_points = geom::point_list_t{};
+}
+
+void river_network_t::create_segments()
+{
+    m_in_degree.assign(m_nodes.size(), 0);
+
+    // Segments are collected as (from, to, waterway) triples and then
+    // sorted into CSR format by their from node.
+    std::vector<node_id_t> from;
+    for (std::size_t w = 0; w < m_waterways.size(); ++w) {
+        auto &waterway = m_waterways[w];
+        if (waterway.num_points > 0) {
+            waterway.first_node = m_point_nodes[waterway.first_point];
+        }
+        auto const end = waterway.first_point + waterway.num_points;
+        for (auto i = waterway.first_point + 1; i < end; ++i) {
+            auto const a = m_point_nodes[i - 1];
+            auto const b = m_point_nodes[i];
+            if (a != b) {
+                from.push_back(a);
+                m_segment_to.push_back(b);
+                m_segment_waterway.push_back(static_cast<std::uint32_t>(w));
+                ++m_in_degree[b];
+            }
+        }
+    }
+    m_point_nodes = std::vector<node_id_t>{};
+    m_num_segments = from.size();
+
+    std::vector<std::uint32_t> order;
+    build_csr(
+        m_nodes.size(), m_num_segments,
+        [&](std::size_t i) { return from[i]; }, &m_segment_offsets, &order);
+    from = std::vector<node_id_t>{};
+
+    std::vector<node_id_t> to(m_num_segments);
+    std::vector<std::uint32_t> waterway(m_num_segments);
+    for (std::size_t i = 0; i < m_num_segments; ++i) {
+        to[i] = m_segment_to[order[i]];
+        waterway[i] = m_segment_waterway[order[i]];
+    }
+    m_segment_to = std::move(to);
+    m_segment_waterway = std::move(waterway);
+}
+
+void river_network_t::add_edge(node_id_t from, std::size_t segment,
+                               std::vector<bool> *visited)
+{
+    auto const waterway = m_segment_waterway[segment];
+    edge_t edge{from,
+                from,
+                waterway,
+                m_waterways[waterway].width,
+                m_edge_points.size(),
+                1};
+    m_edge_points.push_back(from);
+
+    // Follow the chain of segments until we reach a node where the
+    // network branches, starts, or ends, or until we are back where we
+    // started in a loop.
+    while (true) {
+        (*visited)[segment] = true;
+        edge.to = m_segment_to[segment];
+        edge.width = std::max(
+            edge.width, m_waterways[m_segment_waterway[segment]].width);
+        m_edge_points.push_back(edge.to);
+        ++edge.num_points;
+
+        if (!is_through_node(edge.to)) {
+            break;
+        }
+        segment = m_segment_offsets[edge.to];
+        if ((*visited)[segment]) {
+            break;
+        }
+    }
+
+    m_edges.push_back(edge);
+}
+
+void river_network_t::create_edges()
+{
+    std::vector<bool> visited(m_num_segments);
+
+    // Start edges at all nodes that are not in the middle of a chain.
+    for (node_id_t n = 0; n < m_nodes.size(); ++n) {
+        if (!is_through_node(n)) {
+            for (auto s = m_segment_offsets[n]; s < m_segment_offsets[n + 1];
+                 ++s) {
+                add_edge(n, s, &visited);
+            }
+        }
+    }
+
+    // Anything left over is part of a closed loop.
+    for (node_id_t n = 0; n < m_nodes.size(); ++n) {
+        auto const s = m_segment_offsets[n];
+        if (s < m_segment_offsets[n + 1] && !visited[s]) {
+            add_edge(n, s, &visited);
+        }
+    }
+
+    if (m_edges.size() >= std::numeric_limits<std::uint32_t>::max()) {
+        throw fmt_error("Too many edges in waterway network: {}.",
+                        m_edges.size());
+    }
+
+    build_csr(
+        m_nodes.size(), m_edges.size(),
+        [&](std::size_t i) { return m_edges[i].from; }, &m_edge_offsets,
+        &m_edges_by_from);
+
+    // The segments are not needed any more.
+    m_in_degree = std::vector<std::uint32_t>{};
+    m_segment_offsets = std::vector<std::size_t>{};
+    m_segment_to = std::vector<node_id_t>{};
+    m_segment_waterway = std::vector<std::uint32_t>{};
+}
+
+std::vector<std::uint32_t> river_network_t::find_components()
+{
+    // Union-find over the nodes
+    std::vector<node_id_t> parent(m_nodes.size());
+    std::iota(parent.begin(), parent.end(), 0);
+
+    auto const find = [&](node_id_t n) {
+        while (parent[n] != n) {
+            parent[n] = parent[parent[n]];
+            n = parent[n];
+        }
+        return n;
+    };
+
+    // All nodes of an edge are in the same component. The nodes in the
+    // middle of an edge are needed to find the components of waterways.
+    for (auto const &edge : m_edges) {
+        auto const end = edge.first_point + edge.num_points;
+        for (auto i = edge.first_point + 1; i < end; ++i) {
+            auto const a = find(m_edge_points[i - 1]);
+            auto const b = find(m_edge_points[i]);
+            if (a != b) {
+                parent[std::max(a, b)] = std::min(a, b);
+            }
+        }
+    }
+
+    constexpr auto const NONE = std::numeric_limits<std::uint32_t>::max();
+    std::vector<std::uint32_t> root_component(m_nodes.size(), NONE);
+    std::vector<std::uint32_t> components;
+    components.reserve(m_edges.size());
+
+    m_num_components = 0;
+    for (auto const &edge : m_edges) {
+        auto &component = root_component[find(edge.from)];
+        if (component == NONE) {
+            component = static_cast<std::uint32_t>(m_num_components++);
+        }
+        components.push_back(component);
+    }
+
+    // Waterways without any segments get their own components.
+    m_waterway_components.clear();
+    m_waterway_components.reserve(m_waterways.size());
+    for (auto const &waterway : m_waterways) {
+        if (waterway.num_points == 0) {
+            m_waterway_components.push_back(
+                static_cast<std::uint32_t>(m_num_components++));
+            continue;
+        }
+        auto &component = root_component[find(waterway.first_node)];
+        if (component == NONE) {
+            component = static_cast<std::uint32_t>(m_num_components++);
+        }
+        m_waterway_components.push_back(component);
+    }
+
+    m_component_keys.assign(m_num_components,
+                            std::numeric_limits<osmid_t>::max());
+    for (std::size_t i = 0; i < m_waterways.size(); ++i) {
+        auto &key = m_component_keys[m_waterway_components[i]];
+        key = std::min(key, m_waterways[i].id);
+    }
+
+    return components;
+}
+
+void river_network_t::propagate_widths_in_component(
+    std::vector<std::uint32_t> *edges, std::vector<std::uint8_t> *visited)
+{
+    // Edges are used as sources in order of decreasing width. When an edge
+    // is reached for the first time, the source must be the widest edge
+    // upstream of it.
+    std::stable_sort(edges->begin(), edges->end(),
+                     [&](std::uint32_t a, std::uint32_t b) {
+                         return m_edges[a].width > m_edges[b].width;
+                     });
+
+    std::vector<std::uint32_t> stack;
+    for (auto const source : *edges) {
+        if ((*visited)[source]) {
+            continue;
+        }
+        (*visited)[source] = 1;
+        auto const width = m_edges[source].width;
+
+        stack.push_back(source);
+        while (!stack.empty()) {
+            auto const node = m_edges[stack.back()].to;
+            stack.pop_back();
+            for (auto i = m_edge_offsets[node]; i < m_edge_offsets[node + 1];
+                 ++i) {
+                auto const next = m_edges_by_from[i];
+                if (!(*visited)[next]) {
+                    (*visited)[next] = 1;
+                    assert(m_edges[next].width <= width);
+                    m_edges[next].width = width;
+                    stack.push_back(next);
+                }
+            }
+        }
+    }
+}
+
+void river_network_t::propagate_widths(unsigned int num_threads)
+{
+    auto const components = find_components();
+
+    std::vector<std::size_t> offsets;
+    std::vector<std::uint32_t> edges;
+    build_csr(
+        m_num_components, m_edges.size(),
+        [&](std::size_t i) { return components[i]; }, &offsets, &edges);
+
+    // Components are independent of each other, so they can be processed
+    // in parallel. Each thread only touches the edges of its components.
+    std::vector<std::uint8_t> visited(m_edges.size(), 0);
+    std::atomic<std::size_t> next_component{0};
+    run_in_threads(num_threads, [&]() {
+        std::vector<std::uint32_t> component_edges;
+        while (true) {
+            auto const c = next_component++;
+            if (c >= m_num_components) {
+                return;
+            }
+            component_edges.assign(edges.cbegin() + offsets[c],
+                                   edges.cbegin() + offsets[c + 1]);
+            propagate_widths_in_component(&component_edges, &visited);
+        }
+    });
+}
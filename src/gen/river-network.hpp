@@ -0,0 +1,191 @@
+#ifndef OSM2PGSQL_RIVER_NETWORK_HPP
+#define OSM2PGSQL_RIVER_NETWORK_HPP
+
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "geom.hpp"
+#include "osmtypes.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * A directed graph of waterways used by the rivers generalizer.
+ *
+ * All data is kept in flat arrays with integer ids, adjacency is stored
+ * in compressed sparse row (CSR) format: For node n the outgoing items are
+ * found at positions offsets[n] to offsets[n + 1] of a separate array.
+ *
+ * Usage:
+ * 1. Call add_waterway() for all waterways.
+ * 2. Call build() to create nodes (unique points), segments, and edges.
+ *    Edges are chains of segments between the points where the network
+ *    branches (or starts or ends).
+ * 3. Call propagate_widths() to set the width of each edge to the maximum
+ *    width of all edges upstream of it.
+ * 4. Use for_each_edge() to get the results.
+ */
+class river_network_t
+{
+public:
+    /// Add a waterway. Points are in the direction of flow.
+    void add_waterway(osmid_t id, double width,
+                      geom::linestring_t const &points);
+
+    /**
+     * Build the graph from all waterways added. Uses up to num_threads
+     * threads.
+     */
+    void build(unsigned int num_threads);
+
+    /**
+     * Propagate widths downstream. Connected components of the network are
+     * processed in parallel using up to num_threads threads.
+     */
+    void propagate_widths(unsigned int num_threads);
+
+    std::size_t num_waterways() const noexcept { return m_waterways.size(); }
+    std::size_t num_nodes() const noexcept { return m_nodes.size(); }
+    std::size_t num_segments() const noexcept { return m_num_segments; }
+    std::size_t num_edges() const noexcept { return m_edges.size(); }
+    std::size_t num_components() const noexcept { return m_num_components; }
+
+    /**
+     * Call func(id, width, linestring) for each edge. The id is the id of
+     * the waterway the first segment of the edge is from.
+     */
+    template <typename FUNC>
+    void for_each_edge(FUNC &&func) const
+    {
+        for (auto const &edge : m_edges) {
+            geom::linestring_t points;
+            points.reserve(edge.num_points);
+            auto const end = edge.first_point + edge.num_points;
+            for (auto i = edge.first_point; i < end; ++i) {
+                points.push_back(m_nodes[m_edge_points[i]]);
+            }
+            func(m_waterways[edge.waterway].id, edge.width,
+                 std::move(points));
+        }
+    }
+
+    /**
+     * Call func(id, component) for each waterway. The component is
+     * identified by the smallest id of all waterways in it. Only available
+     * after propagate_widths() was called.
+     */
+    template <typename FUNC>
+    void for_each_waterway_component(FUNC &&func) const
+    {
+        for (std::size_t i = 0; i < m_waterways.size(); ++i) {
+            func(m_waterways[i].id,
+                 m_component_keys[m_waterway_components[i]]);
+        }
+    }
+
+private:
+    using node_id_t = std::uint32_t;
+
+    struct waterway_t
+    {
+        osmid_t id;
+        double width;
+        std::size_t first_point;
+        std::size_t num_points;
+
+        /// The node of the first point.
+        node_id_t first_node;
+    };
+
+    struct edge_t
+    {
+        node_id_t from;
+        node_id_t to;
+
+        /// Index into m_waterways of the first segment of this edge.
+        std::uint32_t waterway;
+
+        double width;
+
+        /// The points of this edge are in m_edge_points.
+        std::size_t first_point;
+        std::size_t num_points;
+    };
+
+    void create_nodes(unsigned int num_threads);
+    void create_segments();
+    void create_edges();
+    void add_edge(node_id_t from, std::size_t segment,
+                  std::vector<bool> *visited);
+
+    bool is_through_node(node_id_t node) const noexcept
+    {
+        return m_in_degree[node] == 1 &&
+               m_segment_offsets[node + 1] - m_segment_offsets[node] == 1;
+    }
+
+    /**
+     * Return component id for each edge. Sets m_num_components and the
+     * component for each waterway.
+     */
+    std::vector<std::uint32_t> find_components();
+
+    void propagate_widths_in_component(std::vector<std::uint32_t> *edges,
+                                       std::vector<std::uint8_t> *visited);
+
+    std::vector<waterway_t> m_waterways;
+
+    /// All points of all waterways, only needed until build() is done.
+    geom::point_list_t m_points;
+
+    /// Node ids for all points in m_points, only needed during build().
+    std::vector<node_id_t> m_point_nodes;
+
+    /// The coordinates of each node, sorted.
+    std::vector<geom::point_t> m_nodes;
+
+    /// Number of incoming segments for each node.
+    std::vector<std::uint32_t> m_in_degree;
+
+    /// CSR offsets for outgoing segments of each node.
+    std::vector<std::size_t> m_segment_offsets;
+
+    /// Target node of each segment.
+    std::vector<node_id_t> m_segment_to;
+
+    /// Waterway index of each segment.
+    std::vector<std::uint32_t> m_segment_waterway;
+
+    std::size_t m_num_segments = 0;
+
+    std::vector<edge_t> m_edges;
+
+    /// The nodes of all edges.
+    std::vector<node_id_t> m_edge_points;
+
+    /// CSR offsets for outgoing edges of each node.
+    std::vector<std::size_t> m_edge_offsets;
+
+    /// Edge indexes ordered by the node they start from.
+    std::vector<std::uint32_t> m_edges_by_from;
+
+    std::size_t m_num_components = 0;
+
+    /// Component id of each waterway.
+    std::vector<std::uint32_t> m_waterway_components;
+
+    /// Smallest waterway id in each component.
+    std::vector<osmid_t> m_component_keys;
+
+}; // class river_network_t
+
+#endif // OSM2PGSQL_RIVER_NETWORK_HPP
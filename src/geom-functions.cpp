@@ -158,7 +158,11 @@ public:
         auto &mgeom = m_output->get<multipoint_t>();
         mgeom.reserve(input.num_geometries());
         for (auto const point : input) {
-            mgeom.add_geometry(project(point));
+            mgeom.add_geometry(point);
+        }
+        if (mgeom.num_geometries() > 0) {
+            m_reprojection->reproject_points(&mgeom[0],
+                                             mgeom.num_geometries());
         }
     }
 
@@ -200,10 +204,8 @@ private:
 
     void transform_points(point_list_t *output, point_list_t const &input) const
     {
-        output->reserve(input.size());
-        for (auto const &point : input) {
-            output->push_back(project(point));
-        }
+        output->assign(input.cbegin(), input.cend());
+        m_reprojection->reproject_points(output->data(), output->size());
     }
 
     void transform_polygon(polygon_t *output, polygon_t const &input) const
@@ -13,9 +13,13 @@
 #include "logging.hpp"
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
+#include <limits>
 #include <queue>
+#include <utility>
+#include <vector>
 
 /**
  * \file
@@ -40,88 +44,256 @@ namespace geom {
 
 namespace {
 
-/// Get squared distance from a point p to a segment (a, b).
-double point_to_segment_distance_squared(point_t p, point_t a, point_t b,
-                                         double stretch) noexcept
+/**
+ * Index over all segments of all rings of a polygon used to quickly find
+ * the signed distance from a point to the polygon boundary.
+ *
+ * The segments are stored in ring order with all y coordinates already
+ * multiplied by the stretch factor. Consecutive segments of a ring are
+ * close to each other, so groups of NODE_SIZE segments have small bounding
+ * boxes. On top of those groups a packed tree of bounding boxes is built,
+ * each level having one box for NODE_SIZE boxes of the level below. Queries
+ * descend the tree and skip all subtrees that can not contain a relevant
+ * segment. This makes a distance query roughly logarithmic in the number of
+ * segments instead of linear.
+ */
+class segment_index_t
 {
-    double x = a.x();
-    double y = a.y() * stretch;
-    double dx = b.x() - x;
-    double dy = b.y() * stretch - y;
-
-    if (dx != 0 || dy != 0) {
-        double const t =
-            ((p.x() - x) * dx + (p.y() - y) * dy) / (dx * dx + dy * dy);
-
-        if (t > 1) {
-            x = b.x();
-            y = b.y() * stretch;
-        } else if (t > 0) {
-            x += dx * t;
-            y += dy * t;
+public:
+    segment_index_t(polygon_t const &polygon, double stretch)
+    {
+        add_ring(polygon.outer(), stretch);
+        for (auto const &ring : polygon.inners()) {
+            add_ring(ring, stretch);
         }
+
+        build_tree();
     }
 
-    dx = p.x() - x;
-    dy = p.y() - y;
+    /**
+     * Signed distance from point to polygon boundary. The result is
+     * negative if the point is outside.
+     */
+    double signed_distance(point_t point) const noexcept
+    {
+        if (m_segments.empty()) {
+            return -std::numeric_limits<double>::infinity();
+        }
 
-    return dx * dx + dy * dy;
-}
+        auto const top = m_levels.size() - 1;
 
-/// Get squared distance from a point p to ring.
-bool point_to_ring_distance_squared(point_t point, ring_t const &ring,
-                                    bool inside, double stretch,
-                                    double *min_dist_squared) noexcept
-{
-    std::size_t const len = ring.size();
-
-    for (std::size_t i = 0, j = len - 1; i < len; j = i++) {
-        auto const &a = ring[i];
-        auto const &b = ring[j];
-
-        if (((a.y() * stretch) > point.y()) !=
-                ((b.y() * stretch) > point.y()) &&
-            (point.x() < (b.x() - a.x()) * (point.y() - (a.y() * stretch)) /
-                                 ((b.y() - a.y()) * stretch) +
-                             a.x())) {
-            inside = !inside;
+        double min_dist_squared = std::numeric_limits<double>::infinity();
+        min_distance_squared(point, top, 0, &min_dist_squared);
+
+        bool const inside = is_inside(point, top, 0);
+
+        return (inside ? 1 : -1) * std::sqrt(min_dist_squared);
+    }
+
+private:
+    static constexpr std::size_t NODE_SIZE = 16;
+
+    struct segment_t
+    {
+        double ax;
+        double ay;
+        double bx;
+        double by;
+    };
+
+    struct bbox_t
+    {
+        double min_x = std::numeric_limits<double>::infinity();
+        double min_y = std::numeric_limits<double>::infinity();
+        double max_x = -std::numeric_limits<double>::infinity();
+        double max_y = -std::numeric_limits<double>::infinity();
+
+        void extend(double x, double y) noexcept
+        {
+            min_x = std::min(min_x, x);
+            min_y = std::min(min_y, y);
+            max_x = std::max(max_x, x);
+            max_y = std::max(max_y, y);
         }
 
-        double const dist_squared =
-            point_to_segment_distance_squared(point, a, b, stretch);
-        *min_dist_squared = std::min(dist_squared, *min_dist_squared);
+        void extend(bbox_t const &other) noexcept
+        {
+            extend(other.min_x, other.min_y);
+            extend(other.max_x, other.max_y);
+        }
+
+        /// Squared distance from point to this box (0 if inside).
+        double distance_squared(point_t p) const noexcept
+        {
+            double const dx = std::max({min_x - p.x(), 0.0, p.x() - max_x});
+            double const dy = std::max({min_y - p.y(), 0.0, p.y() - max_y});
+            return dx * dx + dy * dy;
+        }
+    };
+
+    void add_ring(ring_t const &ring, double stretch)
+    {
+        std::size_t const len = ring.size();
+        if (len == 0) {
+            return;
+        }
+
+        for (std::size_t i = 0, j = len - 1; i < len; j = i++) {
+            m_segments.push_back({ring[i].x(), ring[i].y() * stretch,
+                                  ring[j].x(), ring[j].y() * stretch});
+        }
     }
 
-    return inside;
-}
+    void build_tree()
+    {
+        auto &leaves = m_levels.emplace_back();
+        leaves.resize((m_segments.size() + NODE_SIZE - 1) / NODE_SIZE);
+        for (std::size_t i = 0; i < m_segments.size(); ++i) {
+            auto const &s = m_segments[i];
+            leaves[i / NODE_SIZE].extend(s.ax, s.ay);
+            leaves[i / NODE_SIZE].extend(s.bx, s.by);
+        }
 
-/**
- * Signed distance from point to polygon boundary. The result is negative if
- * the point is outside.
- */
-auto point_to_polygon_distance(point_t point, polygon_t const &polygon,
-                               double stretch)
-{
-    double min_dist_squared = std::numeric_limits<double>::infinity();
+        while (m_levels.back().size() > 1) {
+            auto const &below = m_levels.back();
+            std::vector<bbox_t> level((below.size() + NODE_SIZE - 1) /
+                                      NODE_SIZE);
+            for (std::size_t i = 0; i < below.size(); ++i) {
+                level[i / NODE_SIZE].extend(below[i]);
+            }
+            m_levels.push_back(std::move(level));
+        }
+    }
+
+    /// Get squared distance from a point p to a segment.
+    static double segment_distance_squared(point_t p,
+                                           segment_t const &s) noexcept
+    {
+        double x = s.ax;
+        double y = s.ay;
+        double dx = s.bx - x;
+        double dy = s.by - y;
+
+        if (dx != 0 || dy != 0) {
+            double const t =
+                ((p.x() - x) * dx + (p.y() - y) * dy) / (dx * dx + dy * dy);
+
+            if (t > 1) {
+                x = s.bx;
+                y = s.by;
+            } else if (t > 0) {
+                x += dx * t;
+                y += dy * t;
+            }
+        }
 
-    bool inside = point_to_ring_distance_squared(point, polygon.outer(), false,
-                                                 stretch, &min_dist_squared);
+        dx = p.x() - x;
+        dy = p.y() - y;
 
-    for (auto const &ring : polygon.inners()) {
-        inside = point_to_ring_distance_squared(point, ring, inside, stretch,
-                                                &min_dist_squared);
+        return dx * dx + dy * dy;
     }
 
-    return (inside ? 1 : -1) * std::sqrt(min_dist_squared);
-}
+    /**
+     * Update min_dist_squared with the squared distance from the point to
+     * all segments in the subtree with the given node as root. Children are
+     * visited nearest first so that more subtrees can be skipped.
+     */
+    void min_distance_squared(point_t point, std::size_t level,
+                              std::size_t index,
+                              double *min_dist_squared) const noexcept
+    {
+        std::size_t const first = index * NODE_SIZE;
+
+        if (level == 0) {
+            std::size_t const last =
+                std::min(first + NODE_SIZE, m_segments.size());
+            for (std::size_t i = first; i < last; ++i) {
+                *min_dist_squared =
+                    std::min(segment_distance_squared(point, m_segments[i]),
+                             *min_dist_squared);
+            }
+            return;
+        }
+
+        auto const &children = m_levels[level - 1];
+        std::size_t const last = std::min(first + NODE_SIZE, children.size());
+
+        std::array<std::pair<double, std::size_t>, NODE_SIZE> order{};
+        std::size_t count = 0;
+        for (std::size_t i = first; i < last; ++i) {
+            order[count++] = {children[i].distance_squared(point), i};
+        }
+        std::sort(order.begin(), order.begin() + count);
+
+        for (std::size_t i = 0; i < count; ++i) {
+            if (order[i].first >= *min_dist_squared) {
+                break;
+            }
+            min_distance_squared(point, level - 1, order[i].second,
+                                 min_dist_squared);
+        }
+    }
+
+    /**
+     * Find out whether the point is inside the polygon by counting the
+     * crossings of a ray from the point in positive x direction with the
+     * segments in the subtree with the given node as root. Returns true
+     * for an odd number of crossings.
+     */
+    bool is_inside(point_t point, std::size_t level,
+                   std::size_t index) const noexcept
+    {
+        auto const &box = m_levels[level][index];
+
+        // A crossing segment has one end above and one end on or below the
+        // point and crosses to the right of it.
+        if (box.min_y > point.y() || box.max_y <= point.y() ||
+            box.max_x <= point.x()) {
+            return false;
+        }
+
+        std::size_t const first = index * NODE_SIZE;
+        bool inside = false;
+
+        if (level == 0) {
+            std::size_t const last =
+                std::min(first + NODE_SIZE, m_segments.size());
+            for (std::size_t i = first; i < last; ++i) {
+                auto const &s = m_segments[i];
+                if ((s.ay > point.y()) != (s.by > point.y()) &&
+                    (point.x() <
+                     (s.bx - s.ax) * (point.y() - s.ay) / (s.by - s.ay) +
+                         s.ax)) {
+                    inside = !inside;
+                }
+            }
+            return inside;
+        }
+
+        std::size_t const last =
+            std::min(first + NODE_SIZE, m_levels[level - 1].size());
+        for (std::size_t i = first; i < last; ++i) {
+            if (is_inside(point, level - 1, i)) {
+                inside = !inside;
+            }
+        }
+
+        return inside;
+    }
+
+    std::vector<segment_t> m_segments;
+
+    /// Bounding boxes of the tree nodes, level 0 has the segment groups.
+    std::vector<std::vector<bbox_t>> m_levels;
+
+}; // class segment_index_t
 
 struct cell_t
 {
     static constexpr double SQRT2 = 1.4142135623730951;
 
-    cell_t(point_t c, double h, polygon_t const &polygon, double stretch)
-    : center(c), half_size(h),
-      dist(point_to_polygon_distance(center, polygon, stretch)),
+    cell_t(point_t c, double h, segment_index_t const &index)
+    : center(c), half_size(h), dist(index.signed_distance(center)),
       max(dist + half_size * SQRT2)
     {
     }
@@ -137,12 +309,13 @@ struct cell_t
     }
 };
 
-cell_t make_centroid_cell(polygon_t const &polygon, double stretch)
+cell_t make_centroid_cell(polygon_t const &polygon,
+                          segment_index_t const &index, double stretch)
 {
     point_t centroid{0, 0};
     boost::geometry::centroid(polygon, centroid);
     centroid.set_y(stretch * centroid.y());
-    return {centroid, 0, polygon, stretch};
+    return {centroid, 0, index};
 }
 
 } // anonymous namespace
@@ -166,13 +339,15 @@ point_t pole_of_inaccessibility(polygon_t const &polygon, double precision,
         return envelope.min();
     }
 
+    segment_index_t const index{polygon, stretch};
+
     std::priority_queue<cell_t, std::vector<cell_t>> cell_queue;
 
     // cover polygon with initial cells
     if (stretched_envelope.width() == stretched_envelope.height()) {
         double const cell_size = stretched_envelope.width();
         double const h = cell_size / 2.0;
-        cell_queue.emplace(stretched_envelope.center(), h, polygon, stretch);
+        cell_queue.emplace(stretched_envelope.center(), h, index);
     } else if (stretched_envelope.width() < stretched_envelope.height()) {
         double const cell_size = stretched_envelope.width();
         double const h = cell_size / 2.0;
@@ -182,7 +357,7 @@ point_t pole_of_inaccessibility(polygon_t const &polygon, double precision,
             cell_queue.emplace(
                 point_t{stretched_envelope.center().x(),
                         stretched_envelope.min().y() + n * cell_size + h},
-                h, polygon, stretch);
+                h, index);
         }
     } else {
         double const cell_size = stretched_envelope.height();
@@ -193,15 +368,15 @@ point_t pole_of_inaccessibility(polygon_t const &polygon, double precision,
             cell_queue.emplace(
                 point_t{stretched_envelope.min().x() + n * cell_size + h,
                         stretched_envelope.center().y()},
-                h, polygon, stretch);
+                h, index);
         }
     }
 
     // take centroid as the first best guess
-    auto best_cell = make_centroid_cell(polygon, stretch);
+    auto best_cell = make_centroid_cell(polygon, index, stretch);
 
     // second guess: bounding box centroid
-    cell_t const bbox_cell{stretched_envelope.center(), 0, polygon, stretch};
+    cell_t const bbox_cell{stretched_envelope.center(), 0, index};
     if (bbox_cell.dist > best_cell.dist) {
         best_cell = bbox_cell;
     }
@@ -228,7 +403,7 @@ point_t pole_of_inaccessibility(polygon_t const &polygon, double precision,
         for (auto const dy : {-h, h}) {
             for (auto const dx : {-h, h}) {
                 cell_t const c{point_t{center.x() + dx, center.y() + dy}, h,
-                               polygon, stretch};
+                               index};
                 if (c.max > best_cell.dist) {
                     cell_queue.push(c);
                 }
@@ -13,21 +13,76 @@
 #include <cassert>
 #include <stdexcept>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace util {
 
-void encode_hex(std::string const &input, std::string *output)
+namespace {
+
+#ifdef __SSE2__
+/// Convert 16 values in the range 0-15 into ASCII hex characters.
+__m128i nibbles_to_hex(__m128i nibbles) noexcept
 {
-    assert(output);
+    __m128i const gt9 = _mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9));
+    __m128i const digits = _mm_add_epi8(nibbles, _mm_set1_epi8('0'));
+    return _mm_add_epi8(digits,
+                        _mm_and_si128(gt9, _mm_set1_epi8('A' - '0' - 10)));
+}
+#endif
+
+} // anonymous namespace
+
+void encode_hex_in_place(std::string *data, std::size_t offset)
+{
+    assert(data);
+    assert(offset <= data->size());
 
     constexpr char const *const LOOKUP_HEX = "0123456789ABCDEF";
 
-    for (auto const c : input) {
-        unsigned int const num = static_cast<unsigned char>(c);
-        (*output) += LOOKUP_HEX[(num >> 4U) & 0xfU];
-        (*output) += LOOKUP_HEX[num & 0xfU];
+    std::size_t n = data->size() - offset;
+    data->resize(offset + (n * 2));
+    char *const out = data->data() + offset;
+
+    // The conversion is done from back to front so that the input bytes
+    // are always read before their place is overwritten with the output.
+
+#ifdef __SSE2__
+    __m128i const mask = _mm_set1_epi8(0x0f);
+    for (; n >= 16; n -= 16) {
+        // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+        __m128i const in =
+            _mm_loadu_si128(reinterpret_cast<__m128i const *>(out + n - 16));
+        __m128i const hi =
+            nibbles_to_hex(_mm_and_si128(_mm_srli_epi16(in, 4), mask));
+        __m128i const lo = nibbles_to_hex(_mm_and_si128(in, mask));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + (2 * n) - 32),
+                         _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + (2 * n) - 16),
+                         _mm_unpackhi_epi8(hi, lo));
+        // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+    }
+#endif
+
+    while (n > 0) {
+        --n;
+        unsigned int const num = static_cast<unsigned char>(out[n]);
+        out[2 * n] = LOOKUP_HEX[(num >> 4U) & 0xfU];
+        out[(2 * n) + 1] = LOOKUP_HEX[num & 0xfU];
     }
 }
 
+void encode_hex(std::string const &input, std::string *output)
+{
+    assert(output);
+
+    auto const offset = output->size();
+    output->reserve(offset + (input.size() * 2));
+    output->append(input);
+    encode_hex_in_place(output, offset);
+}
+
 std::string encode_hex(std::string const &input)
 {
     std::string result;
@@ -63,13 +118,13 @@ std::string decode_hex(std::string_view hex_string)
         throw std::runtime_error{"Invalid wkb: Not a valid hex string"};
     }
 
-    std::string wkb;
-    wkb.reserve(hex_string.size() / 2);
+    std::string wkb(hex_string.size() / 2, '\0');
 
-    // NOLINTNEXTLINE(llvm-qualified-auto, readability-qualified-auto)
-    for (auto hex = hex_string.cbegin(); hex != hex_string.cend();) {
-        unsigned int const c = decode_hex_char(*hex++);
-        wkb += static_cast<char>((c << 4U) | decode_hex_char(*hex++));
+    char const *hex = hex_string.data();
+    for (auto &out : wkb) {
+        unsigned int const c = decode_hex_char(hex[0]);
+        out = static_cast<char>((c << 4U) | decode_hex_char(hex[1]));
+        hex += 2;
     }
 
     return wkb;
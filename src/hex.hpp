@@ -10,7 +10,9 @@
  * For a full list of authors see the git log.
  */
 
+#include <cstddef>
 #include <string>
+#include <string_view>
 
 namespace util {
 
@@ -30,6 +32,20 @@ void encode_hex(std::string const &in, std::string *out);
  */
 [[nodiscard]] std::string encode_hex(std::string const &in);
 
+/**
+ * Convert the content of the string starting at the given offset to hex
+ * in place. The string will grow by the number of bytes converted.
+ *
+ * This allows writing binary data to the end of a buffer first and then
+ * converting it without needing a temporary string.
+ *
+ * \param data Pointer to the string.
+ * \param offset Offset of the first byte to convert.
+ *
+ * \pre \code offset <= data->size() \endcode
+ */
+void encode_hex_in_place(std::string *data, std::size_t offset);
+
 /**
  * Decode one hex character (0-9A-F or 0-9a-f) and return its value.
  * Returns 0 for characters that are not hex characters.
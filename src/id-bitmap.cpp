@@ -0,0 +1,283 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "id-bitmap.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <cassert>
+#include <iterator>
+#include <utility>
+
+bool id_bitmap_t::contains(osmid_t id) const noexcept
+{
+    auto const key = key_of(id);
+    auto const it = std::lower_bound(
+        m_containers.cbegin(), m_containers.cend(), key,
+        [](container_t const &c, std::uint64_t k) { return c.key < k; });
+    if (it == m_containers.cend() || it->key != key) {
+        return false;
+    }
+
+    auto const low = low_of(id);
+    if (it->is_bitmap()) {
+        return (it->bitmap[low >> 6U] >> (low & 63U)) & 1U;
+    }
+    return std::binary_search(it->array.cbegin(), it->array.cend(), low);
+}
+
+std::size_t id_bitmap_t::used_memory() const noexcept
+{
+    std::size_t mem = m_containers.capacity() * sizeof(container_t);
+    for (auto const &container : m_containers) {
+        mem += container.array.capacity() * sizeof(std::uint16_t) +
+               container.bitmap.capacity() * sizeof(std::uint64_t);
+    }
+    return mem;
+}
+
+void id_bitmap_t::clear() noexcept
+{
+    m_containers.clear();
+    m_containers.shrink_to_fit();
+    m_size = 0;
+}
+
+std::size_t id_bitmap_t::count_trailing_zeros(std::uint64_t word) noexcept
+{
+    assert(word != 0);
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<std::size_t>(__builtin_ctzll(word));
+#else
+    std::size_t n = 0;
+    while ((word & 1U) == 0) {
+        word >>= 1U;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+void id_bitmap_t::to_bitmap(container_t *container)
+{
+    container->bitmap.assign(BITMAP_WORDS, 0);
+    for (auto const low : container->array) {
+        container->bitmap[low >> 6U] |= 1ULL << (low & 63U);
+    }
+    container->array = std::vector<std::uint16_t>{};
+}
+
+void id_bitmap_t::to_array(container_t *container)
+{
+    std::vector<std::uint16_t> array;
+    array.reserve(container->count);
+    for (std::size_t i = 0; i < BITMAP_WORDS; ++i) {
+        auto word = container->bitmap[i];
+        while (word != 0) {
+            array.push_back(
+                static_cast<std::uint16_t>(i * 64 + count_trailing_zeros(word)));
+            word &= word - 1;
+        }
+    }
+    container->array = std::move(array);
+    container->bitmap = std::vector<std::uint64_t>{};
+}
+
+void id_bitmap_t::add_to_container(container_t *container,
+                                   std::vector<std::uint16_t> const &lows)
+{
+    if (!container->is_bitmap() &&
+        container->count + lows.size() > MAX_ARRAY_SIZE) {
+        to_bitmap(container);
+    }
+
+    if (container->is_bitmap()) {
+        for (auto const low : lows) {
+            auto &word = container->bitmap[low >> 6U];
+            auto const bit = 1ULL << (low & 63U);
+            if ((word & bit) == 0) {
+                word |= bit;
+                ++container->count;
+            }
+        }
+        return;
+    }
+
+    if (container->array.empty()) {
+        container->array = lows;
+    } else if (container->array.back() < lows.front()) {
+        container->array.insert(container->array.end(), lows.cbegin(),
+                                lows.cend());
+    } else {
+        std::vector<std::uint16_t> merged;
+        merged.reserve(container->array.size() + lows.size());
+        std::set_union(container->array.cbegin(), container->array.cend(),
+                       lows.cbegin(), lows.cend(), std::back_inserter(merged));
+        container->array = std::move(merged);
+    }
+    container->count = container->array.size();
+}
+
+void id_bitmap_t::remove_from_container(container_t *container,
+                                        std::vector<std::uint16_t> const &lows)
+{
+    if (container->is_bitmap()) {
+        for (auto const low : lows) {
+            auto &word = container->bitmap[low >> 6U];
+            auto const bit = 1ULL << (low & 63U);
+            if (word & bit) {
+                word &= ~bit;
+                --container->count;
+            }
+        }
+        if (container->count <= MAX_ARRAY_SIZE) {
+            to_array(container);
+        }
+        return;
+    }
+
+    std::vector<std::uint16_t> remaining;
+    remaining.reserve(container->array.size());
+    std::set_difference(container->array.cbegin(), container->array.cend(),
+                        lows.cbegin(), lows.cend(),
+                        std::back_inserter(remaining));
+    container->array = std::move(remaining);
+    container->count = container->array.size();
+}
+
+void id_bitmap_t::merge_containers(container_t *container, container_t &&other)
+{
+    if (!container->is_bitmap() && !other.is_bitmap()) {
+        add_to_container(container, other.array);
+        return;
+    }
+
+    if (!container->is_bitmap()) {
+        std::swap(*container, other);
+    }
+
+    if (!other.is_bitmap()) {
+        add_to_container(container, other.array);
+        return;
+    }
+
+    container->count = 0;
+    for (std::size_t i = 0; i < BITMAP_WORDS; ++i) {
+        container->bitmap[i] |= other.bitmap[i];
+        container->count += static_cast<std::size_t>(
+            std::bitset<64>{container->bitmap[i]}.count());
+    }
+}
+
+void id_bitmap_t::add_sorted(idlist_t const &ids)
+{
+    if (ids.empty()) {
+        return;
+    }
+
+    std::vector<container_t> result;
+    result.reserve(m_containers.size());
+
+    auto cit = m_containers.begin();
+    std::vector<std::uint16_t> lows;
+    auto it = ids.cbegin();
+    while (it != ids.cend()) {
+        auto const key = key_of(*it);
+
+        lows.clear();
+        for (; it != ids.cend() && key_of(*it) == key; ++it) {
+            lows.push_back(low_of(*it));
+        }
+
+        for (; cit != m_containers.end() && cit->key < key; ++cit) {
+            result.push_back(std::move(*cit));
+        }
+
+        if (cit != m_containers.end() && cit->key == key) {
+            result.push_back(std::move(*cit));
+            ++cit;
+        } else {
+            result.emplace_back().key = key;
+        }
+
+        auto &container = result.back();
+        m_size -= container.count;
+        add_to_container(&container, lows);
+        m_size += container.count;
+    }
+
+    std::move(cit, m_containers.end(), std::back_inserter(result));
+    m_containers = std::move(result);
+}
+
+void id_bitmap_t::remove_sorted(idlist_t const &ids)
+{
+    auto cit = m_containers.begin();
+    std::vector<std::uint16_t> lows;
+    auto it = ids.cbegin();
+    while (it != ids.cend() && cit != m_containers.end()) {
+        auto const key = key_of(*it);
+
+        lows.clear();
+        for (; it != ids.cend() && key_of(*it) == key; ++it) {
+            lows.push_back(low_of(*it));
+        }
+
+        cit = std::lower_bound(
+            cit, m_containers.end(), key,
+            [](container_t const &c, std::uint64_t k) { return c.key < k; });
+        if (cit != m_containers.end() && cit->key == key) {
+            m_size -= cit->count;
+            remove_from_container(&*cit, lows);
+            m_size += cit->count;
+        }
+    }
+
+    m_containers.erase(std::remove_if(m_containers.begin(),
+                                      m_containers.end(),
+                                      [](container_t const &c) {
+                                          return c.count == 0;
+                                      }),
+                       m_containers.end());
+}
+
+void id_bitmap_t::merge(id_bitmap_t &&other)
+{
+    if (empty()) {
+        std::swap(m_containers, other.m_containers);
+        std::swap(m_size, other.m_size);
+        return;
+    }
+
+    std::vector<container_t> result;
+    result.reserve(m_containers.size() + other.m_containers.size());
+
+    auto ait = m_containers.begin();
+    auto bit = other.m_containers.begin();
+    while (ait != m_containers.end() && bit != other.m_containers.end()) {
+        if (ait->key < bit->key) {
+            result.push_back(std::move(*ait++));
+        } else if (bit->key < ait->key) {
+            result.push_back(std::move(*bit++));
+        } else {
+            merge_containers(&*ait, std::move(*bit++));
+            result.push_back(std::move(*ait++));
+        }
+    }
+    std::move(ait, m_containers.end(), std::back_inserter(result));
+    std::move(bit, other.m_containers.end(), std::back_inserter(result));
+
+    m_containers = std::move(result);
+    m_size = 0;
+    for (auto const &container : m_containers) {
+        m_size += container.count;
+    }
+
+    other.clear();
+}
@@ -0,0 +1,159 @@
+#ifndef OSM2PGSQL_ID_BITMAP_HPP
+#define OSM2PGSQL_ID_BITMAP_HPP
+
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "idlist.hpp"
+#include "osmtypes.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * A compressed set of OSM ids in the style of "roaring bitmaps".
+ *
+ * The id space is split into blocks of 2^16 ids. For each block containing
+ * at least one id there is a container which stores the lower 16 bits of
+ * the ids either as a sorted array (2 bytes per id) or, if there are more
+ * than MAX_ARRAY_SIZE ids in the block, as a bitmap (8 kB per block). This
+ * needs a lot less memory than a plain list of ids and membership tests
+ * are fast.
+ *
+ * Ids are added and removed in batches from sorted lists, this is much
+ * faster than changing the set one id at a time.
+ */
+class id_bitmap_t
+{
+public:
+    /// Is the id in the set?
+    bool contains(osmid_t id) const noexcept;
+
+    /// The number of ids in the set.
+    std::size_t size() const noexcept { return m_size; }
+
+    bool empty() const noexcept { return m_size == 0; }
+
+    /// Return the approximate number of bytes used for internal storage.
+    std::size_t used_memory() const noexcept;
+
+    /// Remove all ids from the set and free the memory.
+    void clear() noexcept;
+
+    /**
+     * Add all ids in the list to the set.
+     *
+     * \pre The list must be sorted and without duplicates.
+     */
+    void add_sorted(idlist_t const &ids);
+
+    /**
+     * Remove all ids in the list from the set.
+     *
+     * \pre The list must be sorted and without duplicates.
+     */
+    void remove_sorted(idlist_t const &ids);
+
+    /// Add all ids from another set to this set.
+    void merge(id_bitmap_t &&other);
+
+    /// Call func with each id in the set in order.
+    template <typename FUNC>
+    void for_each(FUNC &&func) const
+    {
+        for (auto const &container : m_containers) {
+            if (container.is_bitmap()) {
+                for (std::size_t i = 0; i < BITMAP_WORDS; ++i) {
+                    auto word = container.bitmap[i];
+                    while (word != 0) {
+                        auto const bit = count_trailing_zeros(word);
+                        func(to_id(container.key, i * 64 + bit));
+                        word &= word - 1;
+                    }
+                }
+            } else {
+                for (auto const low : container.array) {
+                    func(to_id(container.key, low));
+                }
+            }
+        }
+    }
+
+private:
+    /**
+     * Blocks with up to this many ids are stored as arrays, larger blocks
+     * as bitmaps. This is the point at which the bitmap becomes smaller.
+     */
+    static constexpr std::size_t MAX_ARRAY_SIZE = 4096;
+
+    /// Number of 64 bit words in the bitmap of one block.
+    static constexpr std::size_t BITMAP_WORDS = (1UL << 16U) / 64;
+
+    struct container_t
+    {
+        /// The upper 48 bits of all ids in this container.
+        std::uint64_t key = 0;
+
+        /// Number of ids in this container.
+        std::size_t count = 0;
+
+        /// Sorted lower 16 bits of ids (if this is not a bitmap).
+        std::vector<std::uint16_t> array;
+
+        /// Bitmap of lower 16 bits of ids (empty if this is an array).
+        std::vector<std::uint64_t> bitmap;
+
+        bool is_bitmap() const noexcept { return !bitmap.empty(); }
+    };
+
+    /**
+     * Ids are mapped to unsigned numbers so that the order (including
+     * negative ids) is kept.
+     */
+    static std::uint64_t to_unsigned(osmid_t id) noexcept
+    {
+        return static_cast<std::uint64_t>(id) ^ (1ULL << 63U);
+    }
+
+    static std::uint64_t key_of(osmid_t id) noexcept
+    {
+        return to_unsigned(id) >> 16U;
+    }
+
+    static std::uint16_t low_of(osmid_t id) noexcept
+    {
+        return static_cast<std::uint16_t>(to_unsigned(id) & 0xffffU);
+    }
+
+    static osmid_t to_id(std::uint64_t key, std::size_t low) noexcept
+    {
+        return static_cast<osmid_t>(((key << 16U) | low) ^ (1ULL << 63U));
+    }
+
+    static std::size_t count_trailing_zeros(std::uint64_t word) noexcept;
+
+    static void to_bitmap(container_t *container);
+    static void to_array(container_t *container);
+
+    static void add_to_container(container_t *container,
+                                 std::vector<std::uint16_t> const &lows);
+    static void remove_from_container(container_t *container,
+                                      std::vector<std::uint16_t> const &lows);
+    static void merge_containers(container_t *container, container_t &&other);
+
+    /// Containers sorted by key.
+    std::vector<container_t> m_containers;
+
+    /// Overall number of ids.
+    std::size_t m_size = 0;
+
+}; // class id_bitmap_t
+
+#endif // OSM2PGSQL_ID_BITMAP_HPP
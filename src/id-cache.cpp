@@ -0,0 +1,120 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "id-cache.hpp"
+
+#include "memory-budget.hpp"
+
+#include <algorithm>
+
+namespace {
+
+memory_budget_t::consumer_t &id_caches_memory()
+{
+    static auto &consumer = get_memory_budget().consumer("id caches");
+    return consumer;
+}
+
+} // anonymous namespace
+
+id_cache_t::~id_cache_t() noexcept { id_caches_memory().sub(m_memory_used); }
+
+void id_cache_t::update_memory_usage() noexcept
+{
+    if (!get_memory_budget().accounting_enabled()) {
+        return;
+    }
+
+    std::size_t const used = m_ids.used_memory() +
+                             m_source_ids.used_memory() +
+                             m_added.size() * sizeof(osmid_t) +
+                             m_removed.size() * sizeof(m_removed[0]);
+
+    if (used > m_memory_used) {
+        id_caches_memory().add(used - m_memory_used);
+    } else {
+        id_caches_memory().sub(m_memory_used - used);
+    }
+    m_memory_used = used;
+}
+
+void id_cache_t::add(osmid_t id)
+{
+    std::lock_guard<std::mutex> const guard{m_mutex};
+    m_added.push_back(id);
+    if (m_memory_sampler.due()) {
+        update_memory_usage();
+    }
+}
+
+void id_cache_t::remove(osmid_t id)
+{
+    std::lock_guard<std::mutex> const guard{m_mutex};
+    m_removed.emplace_back(id, m_added.size());
+    if (m_memory_sampler.due()) {
+        update_memory_usage();
+    }
+}
+
+void id_cache_t::add_from_source(idlist_t &&ids)
+{
+    ids.sort_unique();
+    m_source_ids.add_sorted(ids);
+    update_memory_usage();
+}
+
+void id_cache_t::commit()
+{
+    if (!m_source_ids.empty()) {
+        m_ids.merge(std::move(m_source_ids));
+    }
+
+    if (m_removed.empty()) {
+        if (!m_added.empty()) {
+            m_added.sort_unique();
+            m_ids.add_sorted(m_added);
+            m_added = idlist_t{};
+        }
+        update_memory_usage();
+        return;
+    }
+
+    // For each removed id we only need the time of its last removal.
+    std::sort(m_removed.begin(), m_removed.end());
+    idlist_t removed;
+    std::vector<std::pair<osmid_t, std::size_t>> last_removal;
+    for (auto const &r : m_removed) {
+        if (!last_removal.empty() && last_removal.back().first == r.first) {
+            last_removal.back().second = r.second;
+        } else {
+            last_removal.push_back(r);
+            removed.push_back(r.first);
+        }
+    }
+    m_removed.clear();
+    m_removed.shrink_to_fit();
+
+    // Only keep the adds which happened after the last removal of an id.
+    idlist_t added;
+    for (std::size_t i = 0; i < m_added.size(); ++i) {
+        auto const id = m_added[i];
+        auto const it = std::lower_bound(
+            last_removal.cbegin(), last_removal.cend(), id,
+            [](auto const &r, osmid_t id) noexcept { return r.first < id; });
+        if (it == last_removal.cend() || it->first != id || i >= it->second) {
+            added.push_back(id);
+        }
+    }
+    m_added = idlist_t{};
+    added.sort_unique();
+
+    m_ids.remove_sorted(removed);
+    m_ids.add_sorted(added);
+    update_memory_usage();
+}
@@ -0,0 +1,102 @@
+#ifndef OSM2PGSQL_ID_CACHE_HPP
+#define OSM2PGSQL_ID_CACHE_HPP
+
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "id-bitmap.hpp"
+#include "idlist.hpp"
+#include "memory-budget.hpp"
+#include "osmtypes.hpp"
+
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**
+ * Cache of the ids in a flex table that has the id cache enabled. Used to
+ * answer the in_id_cache() calls from Lua.
+ *
+ * Ids added or removed while processing data are not visible immediately,
+ * they are collected and only applied (in the order they happened) when
+ * commit() is called. This way lookups can always work on a sorted list.
+ * Adding and removing ids is thread-safe, all other functions must only be
+ * called when no other thread uses the cache.
+ */
+class id_cache_t
+{
+public:
+    id_cache_t() = default;
+
+    id_cache_t(id_cache_t const &) = delete;
+    id_cache_t &operator=(id_cache_t const &) = delete;
+
+    id_cache_t(id_cache_t &&) = delete;
+    id_cache_t &operator=(id_cache_t &&) = delete;
+
+    ~id_cache_t() noexcept;
+
+    /// Add an id. Visible after the next commit().
+    void add(osmid_t id);
+
+    /// Remove an id. Visible after the next commit().
+    void remove(osmid_t id);
+
+    /**
+     * Add ids from an external source (like the database table). Can be
+     * called several times, the ids don't have to be in any order. Visible
+     * after the next commit().
+     */
+    void add_from_source(idlist_t &&ids);
+
+    /// Apply all changes since the last commit.
+    void commit();
+
+    /**
+     * Is the id in the cache?
+     *
+     * Only finds ids committed with commit().
+     */
+    bool contains(osmid_t id) const { return m_ids.contains(id); }
+
+    /// The number of ids in the cache (after the last commit).
+    std::size_t size() const noexcept { return m_ids.size(); }
+
+private:
+    /// Update the memory accounting after the cache changed.
+    void update_memory_usage() noexcept;
+
+    /// All committed ids.
+    id_bitmap_t m_ids;
+
+    /// Ids added with add_from_source() since the last commit.
+    id_bitmap_t m_source_ids;
+
+    /// Ids added since the last commit in the order they were added.
+    idlist_t m_added;
+
+    /**
+     * Ids removed since the last commit together with the size of m_added
+     * at the time of removal. This tells us which adds happened after the
+     * removal.
+     */
+    std::vector<std::pair<osmid_t, std::size_t>> m_removed;
+
+    std::mutex m_mutex;
+
+    /// Only update memory accounting every so often in add() and remove().
+    memory_sampler_t m_memory_sampler;
+
+    /// The number of bytes accounted for in the memory budget.
+    std::size_t m_memory_used = 0;
+
+}; // class id_cache_t
+
+#endif // OSM2PGSQL_ID_CACHE_HPP
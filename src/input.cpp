@@ -7,9 +7,15 @@
  * For a full list of authors see the git log.
  */
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <memory>
+#include <mutex>
 #include <queue>
 #include <stdexcept>
+#include <thread>
 #include <vector>
 
 #include <osmium/io/any_input.hpp>
@@ -18,6 +24,7 @@
 #include "format.hpp"
 #include "input.hpp"
 #include "logging.hpp"
+#include "metrics.hpp"
 #include "osmdata.hpp"
 #include "progress-display.hpp"
 
@@ -61,19 +68,59 @@ type_id check_input(type_id const &last, osmium::OSMObject const &object)
 
 namespace {
 
+/// Maximum number of buffers read ahead for each data source.
+constexpr std::size_t MAX_QUEUED_BUFFERS = 4;
+
+bool same_type_and_id(osmium::OSMObject const &a,
+                      osmium::OSMObject const &b) noexcept
+{
+    return a.type() == b.type() && a.id() == b.id();
+}
+
+/**
+ * Order objects by type, id, version, and timestamp. If all of those are
+ * the same, a deleted object is ordered after a visible one, so that the
+ * delete wins when only the last version of an object is used.
+ */
+bool object_order_less(osmium::OSMObject const &a,
+                       osmium::OSMObject const &b) noexcept
+{
+    if (a < b) {
+        return true;
+    }
+    if (b < a) {
+        return false;
+    }
+    return a.visible() && !b.visible();
+}
+
 /**
  * A data source is where we get the OSM objects from, one at a time. It
- * wraps the osmium::io::Reader.
+ * wraps the osmium::io::Reader. The reader and the checks for ordering of
+ * the input data run in their own thread which hands over the buffers
+ * through a bounded queue.
  */
 class data_source_t
 {
 public:
     explicit data_source_t(osmium::io::File const &file)
-    : m_reader(std::make_unique<osmium::io::Reader>(file))
-    {
-        get_next_nonempty_buffer();
-        m_last = check_input(m_last, *m_it);
-    }
+    : m_thread([this, file]() { run(file); })
+    {}
+
+    data_source_t(data_source_t const &) = delete;
+    data_source_t &operator=(data_source_t const &) = delete;
+
+    data_source_t(data_source_t &&) = delete;
+    data_source_t &operator=(data_source_t &&) = delete;
+
+    ~data_source_t() noexcept { stop(); }
+
+    /**
+     * Wait for the first object from this source.
+     *
+     * \returns False if there are no objects in this source.
+     */
+    bool start() { return get_next_buffer(); }
 
     bool empty() const noexcept { return !m_buffer; }
 
@@ -82,13 +129,10 @@ public:
         assert(!empty());
         ++m_it;
 
-        while (m_it == m_end) {
-            if (!get_next_nonempty_buffer()) {
-                return false;
-            }
+        if (m_it == m_end) {
+            return get_next_buffer();
         }
 
-        m_last = check_input(m_last, *m_it);
         return true;
     }
 
@@ -98,34 +142,181 @@ public:
         return &*m_it;
     }
 
-    std::size_t offset() const noexcept { return m_reader->offset(); }
+    void close() noexcept { stop(); }
+
+    /**
+     * The number of older object versions skipped in this source. Only
+     * valid after close() was called.
+     */
+    std::size_t num_skipped() const noexcept { return m_num_skipped; }
 
-    void close()
+private:
+    /**
+     * This is run in the thread reading and checking the data.
+     *
+     * Change files can contain several versions of the same object. In that
+     * case only the newest version is kept and the others are removed from
+     * the buffers. Because the last object in a buffer can be superseded by
+     * an object in the next buffer, buffers are only handed over once the
+     * next buffer with an object that is kept has been read.
+     */
+    void run(osmium::io::File const &file) noexcept
     {
-        m_reader->close();
-        m_reader.reset();
+        try {
+            bool const coalesce = file.has_multiple_object_versions();
+            osmium::io::Reader reader{file};
+            type_id last = {osmium::item_type::node, 0};
+
+            osmium::memory::Buffer pending;
+            bool pending_has_removed = false;
+
+            // The newest version of the last object seen. It is either in
+            // the pending or in the current buffer.
+            osmium::OSMObject *newest = nullptr;
+
+            while (osmium::memory::Buffer buffer = reader.read()) {
+                bool has_objects = false;
+                bool has_removed = false;
+                bool newest_in_buffer = false;
+                for (auto &object : buffer.select<osmium::OSMObject>()) {
+                    if (coalesce && newest &&
+                        same_type_and_id(*newest, object)) {
+                        ++m_num_skipped;
+                        if (object_order_less(object, *newest)) {
+                            object.set_removed(true);
+                            has_removed = true;
+                            continue;
+                        }
+                        newest->set_removed(true);
+                        if (newest_in_buffer) {
+                            has_removed = true;
+                        } else {
+                            pending_has_removed = true;
+                        }
+                    } else {
+                        last = check_input(last, object);
+                    }
+                    newest = &object;
+                    newest_in_buffer = true;
+                    has_objects = true;
+                }
+
+                if (!has_objects) {
+                    continue;
+                }
+                if (pending &&
+                    !push(std::move(pending), pending_has_removed)) {
+                    return;
+                }
+                pending = std::move(buffer);
+                pending_has_removed = has_removed;
+            }
+
+            if (pending && !push(std::move(pending), pending_has_removed)) {
+                return;
+            }
+            reader.close();
+        } catch (...) {
+            std::lock_guard<std::mutex> const lock{m_mutex};
+            m_error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> const lock{m_mutex};
+        m_eof = true;
+        m_queue_cond.notify_one();
     }
 
-private:
-    bool get_next_nonempty_buffer()
+    /**
+     * Add buffer to the queue, waiting if it is full. If has_removed is set,
+     * removed objects are purged from the buffer first.
+     *
+     * \returns False if the source was stopped.
+     */
+    bool push(osmium::memory::Buffer &&buffer, bool has_removed)
     {
-        while ((m_buffer = m_reader->read())) {
-            m_it = m_buffer.begin<osmium::OSMObject>();
-            m_end = m_buffer.end<osmium::OSMObject>();
-            if (m_it != m_end) {
+        if (has_removed) {
+            buffer.purge_removed();
+            if (buffer.select<osmium::OSMObject>().empty()) {
                 return true;
             }
         }
-        return false;
+
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_queue_full_cond.wait(lock, [&] {
+            return m_stopped || m_queue.size() < MAX_QUEUED_BUFFERS;
+        });
+
+        if (m_stopped) {
+            return false;
+        }
+
+        m_queue.push_back(std::move(buffer));
+        m_queue_cond.notify_one();
+        return true;
+    }
+
+    /**
+     * Wait for the next buffer from the reader thread. Rethrows any
+     * exception from that thread.
+     *
+     * \returns False at the end of the data.
+     */
+    bool get_next_buffer()
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_queue_cond.wait(lock, [&] { return m_eof || !m_queue.empty(); });
+
+        if (m_queue.empty()) {
+            m_buffer = osmium::memory::Buffer{};
+            if (m_error) {
+                std::rethrow_exception(m_error);
+            }
+            return false;
+        }
+
+        m_buffer = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_queue_full_cond.notify_one();
+
+        m_it = m_buffer.begin<osmium::OSMObject>();
+        m_end = m_buffer.end<osmium::OSMObject>();
+        return true;
+    }
+
+    void stop() noexcept
+    {
+        {
+            std::lock_guard<std::mutex> const lock{m_mutex};
+            m_stopped = true;
+            m_queue.clear();
+        }
+        m_queue_full_cond.notify_one();
+
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
     }
 
     using iterator = osmium::memory::Buffer::t_iterator<osmium::OSMObject>;
 
-    std::unique_ptr<osmium::io::Reader> m_reader;
     osmium::memory::Buffer m_buffer;
     iterator m_it;
     iterator m_end;
-    type_id m_last = {osmium::item_type::node, 0};
+
+    std::mutex m_mutex;
+    std::condition_variable m_queue_cond;
+    std::condition_variable m_queue_full_cond;
+    std::deque<osmium::memory::Buffer> m_queue;
+    std::exception_ptr m_error;
+    bool m_eof = false;
+    bool m_stopped = false;
+
+    /// Only accessed from the reader thread until it is finished.
+    std::size_t m_num_skipped = 0;
+
+    // This must be the last member, so that everything else is initialized
+    // before the thread starts.
+    std::thread m_thread;
 
 }; // class data_source_t
 
@@ -142,8 +333,6 @@ public:
 
     osmium::OSMObject const &object() const noexcept { return *m_object; }
 
-    osmium::OSMObject &object() noexcept { return *m_object; }
-
     data_source_t *data_source() const noexcept { return m_source; }
 
     friend bool operator<(queue_element_t const &lhs,
@@ -153,20 +342,7 @@ public:
         // id (and earlier versions of the same object) to come first, but
         // the priority queue expects largest first. So we need to reverse the
         // comparison here.
-        return lhs.object() > rhs.object();
-    }
-
-    friend bool operator==(queue_element_t const &lhs,
-                           queue_element_t const &rhs) noexcept
-    {
-        return lhs.object().type() == rhs.object().type() &&
-               lhs.object().id() == rhs.object().id();
-    }
-
-    friend bool operator!=(queue_element_t const &lhs,
-                           queue_element_t const &rhs) noexcept
-    {
-        return !(lhs == rhs);
+        return object_order_less(rhs.object(), lhs.object());
     }
 
 private:
@@ -197,10 +373,12 @@ public:
             if (m_last_type == osmium::item_type::node) {
                 m_osmdata->after_nodes();
                 m_progress->start_way_counter();
+                end_phase("nodes");
             }
             if (object->type() == osmium::item_type::relation) {
                 m_osmdata->after_ways();
                 m_progress->start_relation_counter();
+                end_phase("ways");
             }
             m_last_type = object->type();
         }
@@ -213,22 +391,39 @@ public:
         switch (m_last_type) {
         case osmium::item_type::node:
             m_osmdata->after_nodes();
+            end_phase("nodes");
             // fallthrough
         case osmium::item_type::way:
             m_osmdata->after_ways();
+            end_phase("ways");
             break;
         default:
             break;
         }
 
         m_osmdata->after_relations();
+        end_phase("relations");
         m_progress->print_summary();
     }
 
 private:
+    /// Add the time since the end of the last phase to the phase metrics.
+    void end_phase(char const *phase)
+    {
+        auto const now = std::chrono::steady_clock::now();
+        metrics::add_duration(
+            &metrics::time_counter("osm2pgsql_phase_seconds_total",
+                                   "Time spent in processing phases.",
+                                   metrics::label("phase", phase)),
+            now - m_phase_start);
+        m_phase_start = now;
+    }
+
     osmdata_t *m_osmdata;
     progress_display_t *m_progress;
     osmium::item_type m_last_type = osmium::item_type::node;
+    std::chrono::steady_clock::time_point m_phase_start =
+        std::chrono::steady_clock::now();
     bool m_append;
 }; // class input_context_t
 
@@ -258,45 +453,71 @@ file_info process_single_file(osmium::io::File const &file, osmdata_t *osmdata,
     return finfo;
 }
 
-file_info process_multiple_files(std::vector<osmium::io::File> const &files,
-                                 osmdata_t *osmdata,
-                                 progress_display_t *progress, bool append)
+/**
+ * Process objects from all files in order. If there are several versions
+ * of an object in the files, only the newest one is used.
+ */
+file_info process_files_merged(std::vector<osmium::io::File> const &files,
+                               osmdata_t *osmdata, progress_display_t *progress,
+                               bool append)
 {
     file_info finfo;
 
-    std::vector<data_source_t> data_sources;
+    // Start all readers first, so that they can work in parallel.
+    std::vector<std::unique_ptr<data_source_t>> data_sources;
     data_sources.reserve(files.size());
-
-    std::priority_queue<queue_element_t> queue;
-
     for (osmium::io::File const &file : files) {
-        data_sources.emplace_back(file);
+        data_sources.push_back(std::make_unique<data_source_t>(file));
+    }
 
-        if (!data_sources.back().empty()) {
-            queue.emplace(data_sources.back().get(), &data_sources.back());
+    std::priority_queue<queue_element_t> queue;
+    for (auto &data_source : data_sources) {
+        if (data_source->start()) {
+            queue.emplace(data_source->get(), data_source.get());
         }
     }
 
+    std::size_t num_skipped = 0;
     input_context_t ctx{osmdata, progress, append};
     while (!queue.empty()) {
-        auto element = queue.top();
+        auto *source = queue.top().data_source();
         queue.pop();
-        if (queue.empty() || element != queue.top()) {
-            ctx.apply(&element.object());
-            if (element.object().timestamp() > finfo.last_timestamp) {
-                finfo.last_timestamp = element.object().timestamp();
+
+        // Take objects from this source for as long as they come before
+        // the objects from all other sources, so that the priority queue
+        // only has to be updated when we switch between sources. If there
+        // are several versions of an object, only the last one is used.
+        bool has_more = true;
+        do {
+            auto *object = source->get();
+            if (queue.empty() ||
+                !same_type_and_id(*object, queue.top().object())) {
+                ctx.apply(object);
+                if (object->timestamp() > finfo.last_timestamp) {
+                    finfo.last_timestamp = object->timestamp();
+                }
+            } else {
+                ++num_skipped;
             }
-        }
+            has_more = source->next();
+        } while (has_more &&
+                 (queue.empty() ||
+                  object_order_less(*source->get(), queue.top().object())));
 
-        auto *source = element.data_source();
-        if (source->next()) {
+        if (has_more) {
             queue.emplace(source->get(), source);
         }
     }
     ctx.eof();
 
     for (auto &data_source : data_sources) {
-        data_source.close();
+        data_source->close();
+        num_skipped += data_source->num_skipped();
+    }
+
+    if (num_skipped > 0) {
+        log_info("Skipped {} older versions of objects in the input.",
+                 num_skipped);
     }
 
     return finfo;
@@ -342,9 +563,11 @@ file_info process_files(std::vector<osmium::io::File> const &files,
 
     progress_display_t progress{show_progress};
 
-    if (files.size() == 1) {
+    // A single change file can contain several versions of the same object
+    // which are merged like the objects from multiple files.
+    if (files.size() == 1 && !files.front().has_multiple_object_versions()) {
         return process_single_file(files.front(), osmdata, &progress, append);
     }
 
-    return process_multiple_files(files, osmdata, &progress, append);
+    return process_files_merged(files, osmdata, &progress, append);
 }
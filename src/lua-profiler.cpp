@@ -0,0 +1,160 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "lua-profiler.hpp"
+
+#include "format.hpp"
+
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// Unique key for lua registry
+char const OSM2PGSQL_LUA_PROFILER = 0;
+
+void *registry_key() noexcept
+{
+    return const_cast<char *>(&OSM2PGSQL_LUA_PROFILER);
+}
+
+/**
+ * Frames in the folded stacks format are separated by semicolons and the
+ * sample count is separated from the stack by a space, so we can't have
+ * semicolons or newlines in frame names.
+ */
+void append_sanitized(std::string *out, char const *str)
+{
+    for (; *str != '\0'; ++str) {
+        char const c = *str;
+        out->push_back((c == ';' || c == '\n' || c == '\r') ? '_' : c);
+    }
+}
+
+void append_frame(std::string *out, lua_Debug const &ar)
+{
+    out->push_back(';');
+
+    if (std::strcmp(ar.what, "C") == 0) {
+        out->append("[C] ");
+        append_sanitized(out, ar.name ? ar.name : "?");
+        return;
+    }
+
+    if (ar.name) {
+        append_sanitized(out, ar.name);
+    } else if (std::strcmp(ar.what, "main") == 0) {
+        out->append("main chunk");
+    } else {
+        out->append(fmt::format("function@{}", ar.linedefined));
+    }
+
+    out->append(" (");
+    append_sanitized(out, ar.short_src);
+    out->append(fmt::format(":{})", ar.currentline));
+}
+
+} // anonymous namespace
+
+lua_profiler_t::lua_profiler_t(lua_State *lua_state, int sample_interval)
+: m_lua_state(lua_state), m_sample_interval(sample_interval)
+{
+    assert(lua_state);
+    assert(sample_interval > 0);
+
+    lua_pushlightuserdata(m_lua_state, registry_key());
+    lua_pushlightuserdata(m_lua_state, this);
+    lua_rawset(m_lua_state, LUA_REGISTRYINDEX);
+
+    lua_sethook(m_lua_state, hook, LUA_MASKCOUNT, m_sample_interval);
+}
+
+lua_profiler_t::~lua_profiler_t() noexcept
+{
+    lua_sethook(m_lua_state, nullptr, 0, 0);
+
+    lua_pushlightuserdata(m_lua_state, registry_key());
+    lua_pushnil(m_lua_state);
+    lua_rawset(m_lua_state, LUA_REGISTRYINDEX);
+}
+
+void lua_profiler_t::start(std::string_view root)
+{
+    m_root = root;
+    m_active = true;
+}
+
+void lua_profiler_t::hook(lua_State *lua_state, lua_Debug * /*ar*/)
+{
+    lua_pushlightuserdata(lua_state, registry_key());
+    lua_rawget(lua_state, LUA_REGISTRYINDEX);
+    auto *const profiler =
+        static_cast<lua_profiler_t *>(lua_touserdata(lua_state, -1));
+    lua_pop(lua_state, 1);
+
+    if (!profiler || !profiler->m_active) {
+        return;
+    }
+
+    // We must not let exceptions escape into the Lua interpreter. If
+    // something goes wrong here we just lose a sample.
+    try {
+        profiler->sample(lua_state);
+    } catch (...) {
+    }
+}
+
+void lua_profiler_t::sample(lua_State *lua_state)
+{
+    // Walk the stack from the outermost function (highest level) to the
+    // innermost one (level 0) which is the one currently running.
+    std::vector<lua_Debug> frames;
+    lua_Debug ar;
+    for (int level = 0; lua_getstack(lua_state, level, &ar); ++level) {
+        frames.push_back(ar);
+    }
+
+    m_stack = m_root;
+    for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+        lua_getinfo(lua_state, "Sln", &*it);
+        append_frame(&m_stack, *it);
+    }
+
+    ++m_stacks[m_stack];
+    ++m_num_samples;
+}
+
+std::string lua_profiler_t::to_folded() const
+{
+    std::string out;
+    for (auto const &[stack, count] : m_stacks) {
+        out.append(stack);
+        out.append(fmt::format(" {}\n", count));
+    }
+    return out;
+}
+
+void lua_profiler_t::write(std::string const &filename) const
+{
+    auto const data = to_folded();
+
+    auto *const file = std::fopen(filename.c_str(), "w");
+    if (!file) {
+        throw fmt_error("Could not open Lua profile file '{}': {}.", filename,
+                        std::strerror(errno));
+    }
+
+    auto const written = std::fwrite(data.data(), 1, data.size(), file);
+    if (std::fclose(file) != 0 || written != data.size()) {
+        throw fmt_error("Error writing Lua profile file '{}'.", filename);
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef OSM2PGSQL_LUA_PROFILER_HPP
+#define OSM2PGSQL_LUA_PROFILER_HPP
+
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include <lua.hpp>
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <string_view>
+
+/**
+ * A sampling profiler for Lua code.
+ *
+ * A Lua debug hook is called every sample_interval VM instructions for
+ * the whole lifetime of the profiler. It is installed only once, so that
+ * the instruction count carries over from one call into Lua to the next
+ * and short calls get their fair share of samples. While the profiler is
+ * active (between start() and stop()) the hook records the current Lua
+ * call stack, otherwise it does nothing. Samples are aggregated by stack
+ * and can be written out in the "folded stacks" format understood by
+ * flamegraph tools (one line per stack with the frames separated by
+ * semicolons followed by the number of samples).
+ *
+ * Because samples are taken based on the number of instructions executed,
+ * time spent in C functions called from Lua is not visible. When using
+ * LuaJIT, count hooks are not called while compiled code (traces) runs,
+ * so only code run by the interpreter is sampled.
+ *
+ * Only one profiler can be used with any Lua state and the profiler must
+ * only be used while holding the lock on the Lua state.
+ */
+class lua_profiler_t
+{
+public:
+    /// Default number of Lua VM instructions between samples.
+    static constexpr int DEFAULT_SAMPLE_INTERVAL = 10000;
+
+    explicit lua_profiler_t(lua_State *lua_state,
+                            int sample_interval = DEFAULT_SAMPLE_INTERVAL);
+
+    lua_profiler_t(lua_profiler_t const &) = delete;
+    lua_profiler_t &operator=(lua_profiler_t const &) = delete;
+
+    lua_profiler_t(lua_profiler_t &&) = delete;
+    lua_profiler_t &operator=(lua_profiler_t &&) = delete;
+
+    ~lua_profiler_t() noexcept;
+
+    /**
+     * Start sampling.
+     *
+     * \param root Frame(s) prepended to all stacks sampled until stop() is
+     *             called, usually the OSM object type and the name of the
+     *             callback. Use semicolons to separate several frames.
+     */
+    void start(std::string_view root);
+
+    /// Stop sampling.
+    void stop() noexcept { m_active = false; }
+
+    /// The number of samples taken so far.
+    std::size_t num_samples() const noexcept { return m_num_samples; }
+
+    /// Return all samples in folded stacks format.
+    std::string to_folded() const;
+
+    /// Write all samples in folded stacks format to a file.
+    void write(std::string const &filename) const;
+
+private:
+    static void hook(lua_State *lua_state, lua_Debug *ar);
+
+    void sample(lua_State *lua_state);
+
+    lua_State *m_lua_state;
+    int m_sample_interval;
+
+    /// Number of samples for each stack.
+    std::map<std::string, std::size_t> m_stacks;
+
+    std::string m_root;
+    std::string m_stack;
+    std::size_t m_num_samples = 0;
+    bool m_active = false;
+
+}; // class lua_profiler_t
+
+#endif // OSM2PGSQL_LUA_PROFILER_HPP
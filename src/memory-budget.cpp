@@ -0,0 +1,92 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "memory-budget.hpp"
+
+#include "logging.hpp"
+#include "metrics.hpp"
+
+#include <utility>
+
+namespace {
+
+constexpr std::size_t MBYTE = 1024UL * 1024UL;
+
+} // anonymous namespace
+
+memory_budget_t::consumer_t::consumer_t(memory_budget_t *budget,
+                                        std::string name)
+: m_budget(budget),
+  m_gauge(&metrics::gauge("osm2pgsql_memory_consumer_bytes",
+                          "Memory used by the larger data structures.",
+                          metrics::label("consumer", name))),
+  m_name(std::move(name))
+{}
+
+void memory_budget_t::consumer_t::update(std::size_t delta) noexcept
+{
+    m_gauge->set(static_cast<double>(used()));
+
+    auto const before =
+        m_budget->m_used.fetch_add(delta, std::memory_order_relaxed);
+    auto const lim = m_budget->limit();
+
+    // Warn only once when the budget is exceeded for the first time.
+    if (lim == 0 || before + delta < lim || before >= lim ||
+        m_budget->m_warned.exchange(true)) {
+        return;
+    }
+
+    try {
+        log_warn("Memory budget of {}MB exceeded (while adding to '{}').",
+                 lim / MBYTE, m_name);
+    } catch (...) {
+        // ignore errors while logging
+    }
+}
+
+memory_budget_t::consumer_t &memory_budget_t::consumer(std::string_view name)
+{
+    std::lock_guard<std::mutex> const guard{m_mutex};
+
+    for (auto &consumer : m_consumers) {
+        if (consumer.name() == name) {
+            return consumer;
+        }
+    }
+
+    return m_consumers.emplace_back(this, std::string{name});
+}
+
+void memory_budget_t::log_usage() const
+{
+    auto const lim = limit();
+
+    std::lock_guard<std::mutex> const guard{m_mutex};
+
+    if (lim == 0) {
+        for (auto const &consumer : m_consumers) {
+            log_debug("Memory used by {}: {}MB", consumer.name(),
+                      consumer.used() / MBYTE);
+        }
+        return;
+    }
+
+    log_info("Memory budget: {}MB, currently used: {}MB", lim / MBYTE,
+             used() / MBYTE);
+    for (auto const &consumer : m_consumers) {
+        log_info("  {}: {}MB", consumer.name(), consumer.used() / MBYTE);
+    }
+}
+
+memory_budget_t &get_memory_budget() noexcept
+{
+    static memory_budget_t budget;
+    return budget;
+}
@@ -0,0 +1,213 @@
+#ifndef OSM2PGSQL_MEMORY_BUDGET_HPP
+#define OSM2PGSQL_MEMORY_BUDGET_HPP
+
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+/**
+ * \file
+ *
+ * Central accounting for the memory used by the larger in-memory data
+ * structures (caches, buffers, queues) in osm2pgsql.
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace metrics {
+class gauge_t;
+} // namespace metrics
+
+/**
+ * Keeps track of the memory used by the different parts of osm2pgsql and
+ * compares it against a configured global budget.
+ *
+ * Components register as a consumer and keep the number of bytes they use
+ * up to date. They can then ask whether memory gets tight and adapt, for
+ * instance by not caching any more data or by flushing data out early.
+ *
+ * All functions are thread-safe.
+ */
+class memory_budget_t
+{
+public:
+    /**
+     * Percentage of the budget from which on we consider memory to be
+     * tight, see under_pressure().
+     */
+    static constexpr std::size_t PRESSURE_PERCENT = 90;
+
+    /**
+     * A consumer of memory. Consumers are identified by name. Several
+     * instances of a component (for instance in different threads) can
+     * share the same consumer using add() and sub() to update it.
+     */
+    class consumer_t
+    {
+    public:
+        consumer_t(memory_budget_t *budget, std::string name);
+
+        std::string const &name() const noexcept { return m_name; }
+
+        /// The number of bytes currently used by this consumer.
+        std::size_t used() const noexcept
+        {
+            return m_used.load(std::memory_order_relaxed);
+        }
+
+        /// Set the number of bytes used by this consumer.
+        void set(std::size_t bytes) noexcept
+        {
+            update(bytes - m_used.exchange(bytes, std::memory_order_relaxed));
+        }
+
+        /// Add to the number of bytes used by this consumer.
+        void add(std::size_t bytes) noexcept
+        {
+            m_used.fetch_add(bytes, std::memory_order_relaxed);
+            update(bytes);
+        }
+
+        /// Subtract from the number of bytes used by this consumer.
+        void sub(std::size_t bytes) noexcept
+        {
+            m_used.fetch_sub(bytes, std::memory_order_relaxed);
+            update(-bytes);
+        }
+
+    private:
+        /// Propagate a change (modulo 2^n) to the overall sum.
+        void update(std::size_t delta) noexcept;
+
+        memory_budget_t *m_budget;
+        metrics::gauge_t *m_gauge;
+        std::string m_name;
+        std::atomic<std::size_t> m_used{0};
+
+    }; // class consumer_t
+
+    memory_budget_t() = default;
+
+    memory_budget_t(memory_budget_t const &) = delete;
+    memory_budget_t &operator=(memory_budget_t const &) = delete;
+
+    memory_budget_t(memory_budget_t &&) = delete;
+    memory_budget_t &operator=(memory_budget_t &&) = delete;
+
+    ~memory_budget_t() = default;
+
+    /// Set the budget in bytes. 0 means there is no limit.
+    void set_limit(std::size_t bytes) noexcept
+    {
+        m_limit.store(bytes, std::memory_order_relaxed);
+    }
+
+    /// The budget in bytes. 0 means there is no limit.
+    std::size_t limit() const noexcept
+    {
+        return m_limit.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Keep track of the memory used even if there is no limit, so that it
+     * can be reported in the metrics.
+     */
+    void enable_accounting() noexcept
+    {
+        m_accounting.store(true, std::memory_order_relaxed);
+    }
+
+    /**
+     * Do consumers need to keep their memory use up to date? This is the
+     * case if there is a limit or if accounting was enabled explicitly.
+     * Consumers should skip any work needed to find out how much memory
+     * they use otherwise.
+     */
+    bool accounting_enabled() const noexcept
+    {
+        return limit() > 0 || m_accounting.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Get the consumer with the specified name, create it if it doesn't
+     * exist yet. The reference stays valid as long as this object exists.
+     */
+    consumer_t &consumer(std::string_view name);
+
+    /// The number of bytes used by all consumers together.
+    std::size_t used() const noexcept
+    {
+        return m_used.load(std::memory_order_relaxed);
+    }
+
+    /// Is there a limit and are we close to it?
+    bool under_pressure() const noexcept
+    {
+        auto const lim = limit();
+        return lim > 0 && used() >= lim / 100 * PRESSURE_PERCENT;
+    }
+
+    /// Is there a limit and have we reached it?
+    bool exceeded() const noexcept
+    {
+        auto const lim = limit();
+        return lim > 0 && used() >= lim;
+    }
+
+    /// Write memory usage of all consumers to the log.
+    void log_usage() const;
+
+private:
+    std::atomic<std::size_t> m_limit{0};
+    std::atomic<std::size_t> m_used{0};
+    std::atomic<bool> m_accounting{false};
+    std::atomic<bool> m_warned{false};
+
+    /// Protects m_consumers.
+    mutable std::mutex m_mutex;
+
+    /// The consumers. This is a list so that references stay valid.
+    std::list<consumer_t> m_consumers;
+
+}; // class memory_budget_t
+
+/// The global memory budget used by all parts of osm2pgsql.
+memory_budget_t &get_memory_budget() noexcept;
+
+/**
+ * For consumers whose memory use changes with every object processed.
+ * Finding out how much memory is used and checking the budget is only
+ * worth it every so often, due() returns true every INTERVAL calls, but
+ * only if memory accounting is enabled at all. Not thread-safe, every
+ * thread needs its own instance.
+ */
+class memory_sampler_t
+{
+public:
+    static constexpr std::size_t INTERVAL = 1024;
+
+    bool due() noexcept
+    {
+        if (++m_count < INTERVAL) {
+            return false;
+        }
+        m_count = 0;
+        return get_memory_budget().accounting_enabled();
+    }
+
+private:
+    std::size_t m_count = 0;
+
+}; // class memory_sampler_t
+
+#endif // OSM2PGSQL_MEMORY_BUDGET_HPP
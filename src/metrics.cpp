@@ -0,0 +1,261 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "metrics.hpp"
+
+#include "format.hpp"
+#include "logging.hpp"
+
+#include <osmium/util/memory.hpp>
+
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <utility>
+
+namespace metrics {
+
+namespace {
+
+enum class metric_type
+{
+    counter,
+    time_counter,
+    gauge
+};
+
+struct metric_t
+{
+    std::string name;
+    std::string help;
+    std::string labels;
+    metric_type type;
+    std::unique_ptr<counter_t> counter;
+    std::unique_ptr<gauge_t> gauge;
+};
+
+class registry_t
+{
+public:
+    metric_t &get(std::string_view name, std::string_view help,
+                  std::string_view labels, metric_type type)
+    {
+        std::string key{name};
+        key += '{';
+        key += labels;
+
+        std::lock_guard<std::mutex> const guard{m_mutex};
+
+        auto it = m_metrics.find(key);
+        if (it != m_metrics.end()) {
+            return it->second;
+        }
+
+        metric_t metric{std::string{name}, std::string{help},
+                        std::string{labels}, type, nullptr, nullptr};
+        if (type == metric_type::gauge) {
+            metric.gauge = std::make_unique<gauge_t>();
+        } else {
+            metric.counter = std::make_unique<counter_t>();
+        }
+
+        return m_metrics.emplace(std::move(key), std::move(metric))
+            .first->second;
+    }
+
+    std::string to_text()
+    {
+        std::string out;
+        std::string_view last_name;
+
+        std::lock_guard<std::mutex> const guard{m_mutex};
+
+        // The map is sorted by name first, so all metrics with the same
+        // name are next to each other.
+        for (auto const &[key, metric] : m_metrics) {
+            if (metric.name != last_name) {
+                last_name = metric.name;
+                fmt::format_to(std::back_inserter(out), "# HELP {} {}\n",
+                               metric.name, metric.help);
+                fmt::format_to(std::back_inserter(out), "# TYPE {} {}\n",
+                               metric.name,
+                               metric.type == metric_type::gauge ? "gauge"
+                                                                 : "counter");
+            }
+
+            out += metric.name;
+            if (!metric.labels.empty()) {
+                out += '{';
+                out += metric.labels;
+                out += '}';
+            }
+
+            switch (metric.type) {
+            case metric_type::counter:
+                fmt::format_to(std::back_inserter(out), " {}\n",
+                               metric.counter->value());
+                break;
+            case metric_type::time_counter:
+                fmt::format_to(
+                    std::back_inserter(out), " {:.6f}\n",
+                    static_cast<double>(metric.counter->value()) / 1e9);
+                break;
+            case metric_type::gauge:
+                fmt::format_to(std::back_inserter(out), " {}\n",
+                               metric.gauge->value());
+                break;
+            }
+        }
+
+        return out;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::map<std::string, metric_t> m_metrics;
+
+}; // class registry_t
+
+registry_t &registry()
+{
+    static registry_t reg;
+    return reg;
+}
+
+void update_memory_usage()
+{
+    constexpr double MBYTE = 1024.0 * 1024.0;
+    osmium::MemoryUsage const mem;
+
+    gauge("osm2pgsql_memory_current_bytes",
+          "Current memory usage (only available on Linux).")
+        .set(mem.current() * MBYTE);
+    gauge("osm2pgsql_memory_peak_bytes",
+          "Peak memory usage (only available on Linux).")
+        .set(mem.peak() * MBYTE);
+}
+
+} // anonymous namespace
+
+namespace detail {
+
+std::atomic<bool> timing_enabled{false};
+
+} // namespace detail
+
+void set_timing_enabled(bool enabled) noexcept
+{
+    detail::timing_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+counter_t &counter(std::string_view name, std::string_view help,
+                   std::string_view labels)
+{
+    return *registry().get(name, help, labels, metric_type::counter).counter;
+}
+
+counter_t &time_counter(std::string_view name, std::string_view help,
+                        std::string_view labels)
+{
+    return *registry()
+                .get(name, help, labels, metric_type::time_counter)
+                .counter;
+}
+
+gauge_t &gauge(std::string_view name, std::string_view help,
+               std::string_view labels)
+{
+    return *registry().get(name, help, labels, metric_type::gauge).gauge;
+}
+
+std::string label(std::string_view key, std::string_view value)
+{
+    std::string result{key};
+    result += "=\"";
+    for (auto const c : value) {
+        if (c == '\\' || c == '"') {
+            result += '\\';
+            result += c;
+        } else if (c == '\n') {
+            result += "\\n";
+        } else {
+            result += c;
+        }
+    }
+    result += '"';
+    return result;
+}
+
+std::string to_prometheus_text()
+{
+    update_memory_usage();
+    return registry().to_text();
+}
+
+void write_to_file(std::string const &filename)
+{
+    auto const data = to_prometheus_text();
+    std::string const tmp_filename = filename + ".tmp";
+
+    auto *file = std::fopen(tmp_filename.c_str(), "w");
+    if (!file) {
+        throw fmt_error("Could not open metrics file '{}'.", tmp_filename);
+    }
+
+    auto const written = std::fwrite(data.data(), 1, data.size(), file);
+    if (std::fclose(file) != 0 || written != data.size()) {
+        throw fmt_error("Could not write metrics file '{}'.", tmp_filename);
+    }
+
+    std::filesystem::rename(tmp_filename, filename);
+}
+
+file_writer_t::file_writer_t(std::string filename,
+                             std::chrono::seconds interval)
+: m_filename(std::move(filename)), m_interval(interval),
+  m_thread(&file_writer_t::run, this)
+{
+    set_timing_enabled(true);
+}
+
+file_writer_t::~file_writer_t() noexcept
+{
+    {
+        std::lock_guard<std::mutex> const guard{m_mutex};
+        m_done = true;
+    }
+    m_cond.notify_one();
+    m_thread.join();
+
+    write();
+    set_timing_enabled(false);
+}
+
+void file_writer_t::run()
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    while (!m_cond.wait_for(lock, m_interval, [&] { return m_done; })) {
+        write();
+    }
+}
+
+void file_writer_t::write() const noexcept
+{
+    try {
+        write_to_file(m_filename);
+    } catch (std::exception const &e) {
+        log_warn("Writing metrics failed: {}", e.what());
+    } catch (...) {
+        log_warn("Writing metrics failed.");
+    }
+}
+
+} // namespace metrics
@@ -0,0 +1,218 @@
+#ifndef OSM2PGSQL_METRICS_HPP
+#define OSM2PGSQL_METRICS_HPP
+
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+/**
+ * \file
+ *
+ * Runtime metrics (counters and gauges) which can be written out in the
+ * Prometheus text format.
+ *
+ * Metrics are registered by name (and optional labels) on first use and
+ * live until the end of the program. Looking up a metric is relatively
+ * expensive, so code in hot paths should look them up once and keep the
+ * reference around, for instance in a function-local static variable.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace metrics {
+
+/// A monotonically increasing counter.
+class counter_t
+{
+public:
+    void add(std::uint64_t value = 1) noexcept
+    {
+        m_value.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    std::uint64_t value() const noexcept
+    {
+        return m_value.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<std::uint64_t> m_value{0};
+
+}; // class counter_t
+
+/// A value that can go up and down.
+class gauge_t
+{
+public:
+    void set(double value) noexcept
+    {
+        m_value.store(value, std::memory_order_relaxed);
+    }
+
+    void add(double value) noexcept
+    {
+        double old = m_value.load(std::memory_order_relaxed);
+        while (!m_value.compare_exchange_weak(old, old + value,
+                                              std::memory_order_relaxed)) {
+        }
+    }
+
+    double value() const noexcept
+    {
+        return m_value.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<double> m_value{0.0};
+
+}; // class gauge_t
+
+/**
+ * Get the counter with the specified name and labels, create it if it
+ * doesn't exist yet.
+ *
+ * \param name Name of the metric, must be a valid Prometheus metric name.
+ * \param help Description of the metric.
+ * \param labels Labels in Prometheus format without the curly braces
+ *               (use label() to create them), can be empty.
+ */
+counter_t &counter(std::string_view name, std::string_view help,
+                   std::string_view labels = {});
+
+/**
+ * Get the counter for durations with the specified name and labels, create
+ * it if it doesn't exist yet. Durations are added in nanoseconds but
+ * written out in seconds.
+ */
+counter_t &time_counter(std::string_view name, std::string_view help,
+                        std::string_view labels = {});
+
+/**
+ * Get the gauge with the specified name and labels, create it if it doesn't
+ * exist yet.
+ */
+gauge_t &gauge(std::string_view name, std::string_view help,
+               std::string_view labels = {});
+
+/// Create a label string key="value" with the value properly escaped.
+std::string label(std::string_view key, std::string_view value);
+
+/// Add a duration to a time counter.
+template <typename REP, typename PERIOD>
+void add_duration(counter_t *counter,
+                  std::chrono::duration<REP, PERIOD> duration) noexcept
+{
+    counter->add(static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+            .count()));
+}
+
+namespace detail {
+
+extern std::atomic<bool> timing_enabled;
+
+} // namespace detail
+
+/**
+ * Are durations measured? This is only the case if the metrics are written
+ * out, otherwise scoped timers don't read the clock at all.
+ */
+inline bool timing_enabled() noexcept
+{
+    return detail::timing_enabled.load(std::memory_order_relaxed);
+}
+
+/// Enable or disable measuring durations with scoped timers.
+void set_timing_enabled(bool enabled) noexcept;
+
+/**
+ * Add the time between construction and destruction to a time counter.
+ * Does nothing if timing is not enabled.
+ */
+class scoped_timer_t
+{
+public:
+    explicit scoped_timer_t(counter_t *counter) noexcept
+    : m_counter(timing_enabled() ? counter : nullptr)
+    {
+        if (m_counter) {
+            m_start = std::chrono::steady_clock::now();
+        }
+    }
+
+    scoped_timer_t(scoped_timer_t const &) = delete;
+    scoped_timer_t &operator=(scoped_timer_t const &) = delete;
+
+    scoped_timer_t(scoped_timer_t &&) = delete;
+    scoped_timer_t &operator=(scoped_timer_t &&) = delete;
+
+    ~scoped_timer_t() noexcept
+    {
+        if (m_counter) {
+            add_duration(m_counter,
+                         std::chrono::steady_clock::now() - m_start);
+        }
+    }
+
+private:
+    counter_t *m_counter;
+    std::chrono::steady_clock::time_point m_start;
+
+}; // class scoped_timer_t
+
+/// Get all metrics in Prometheus text format.
+std::string to_prometheus_text();
+
+/**
+ * Write all metrics in Prometheus text format to a file. The file is
+ * written to a temporary file first and then renamed, so readers will
+ * always see a complete file.
+ */
+void write_to_file(std::string const &filename);
+
+/**
+ * Writes all metrics to a file in regular intervals in a background thread
+ * and once more when it is destroyed. Timing is enabled while the writer
+ * exists.
+ */
+class file_writer_t
+{
+public:
+    file_writer_t(std::string filename, std::chrono::seconds interval);
+
+    file_writer_t(file_writer_t const &) = delete;
+    file_writer_t &operator=(file_writer_t const &) = delete;
+
+    file_writer_t(file_writer_t &&) = delete;
+    file_writer_t &operator=(file_writer_t &&) = delete;
+
+    ~file_writer_t() noexcept;
+
+private:
+    void run();
+    void write() const noexcept;
+
+    std::string m_filename;
+    std::chrono::seconds m_interval;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_done = false;
+    std::thread m_thread;
+
+}; // class file_writer_t
+
+} // namespace metrics
+
+#endif // OSM2PGSQL_METRICS_HPP
@@ -22,6 +22,7 @@
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
 
@@ -35,6 +36,7 @@
 #include "idlist.hpp"
 #include "json-writer.hpp"
 #include "logging.hpp"
+#include "metrics.hpp"
 #include "middle-pgsql.hpp"
 #include "node-locations.hpp"
 #include "node-persistent-cache.hpp"
@@ -70,6 +72,39 @@ void load_id_list(pg_conn_t const &db_connection, std::string const &table,
     }
 }
 
+/// Metrics for one kind of query against the middle tables.
+struct query_metrics_t
+{
+    metrics::counter_t *calls;
+    metrics::counter_t *time;
+};
+
+query_metrics_t query_metrics(std::string_view query)
+{
+    auto const labels = metrics::label("query", query);
+    return {&metrics::counter("osm2pgsql_middle_queries_total",
+                              "Number of queries against the middle tables.",
+                              labels),
+            &metrics::time_counter(
+                "osm2pgsql_middle_query_seconds_total",
+                "Time spent in queries against the middle tables.", labels)};
+}
+
+void count_node_cache_lookups(std::size_t hits, std::size_t misses) noexcept
+{
+    static auto &hit_counter = metrics::counter(
+        "osm2pgsql_node_cache_lookups_total",
+        "Number of node location lookups in the node cache.",
+        metrics::label("result", "hit"));
+    static auto &miss_counter = metrics::counter(
+        "osm2pgsql_node_cache_lookups_total",
+        "Number of node location lookups in the node cache.",
+        metrics::label("result", "miss"));
+
+    hit_counter.add(hits);
+    miss_counter.add(misses);
+}
+
 } // anonymous namespace
 
 middle_pgsql_t::table_desc_t::table_desc_t(options_t const &options,
@@ -407,9 +442,16 @@ std::size_t middle_query_pgsql_t::get_way_node_locations_db(
     }
 
     if (id_list.empty()) {
+        count_node_cache_lookups(count, 0);
         return count;
     }
 
+    count_node_cache_lookups(count, nodes->size() - count);
+
+    static auto const metric = query_metrics("node_list");
+    metric.calls->add();
+    metrics::scoped_timer_t const timer{metric.time};
+
     // get any remaining nodes from the DB
     // Nodes must have been written back at this point.
     auto const res = m_db_connection.exec_prepared("get_node_list", id_list());
@@ -444,46 +486,71 @@ void middle_pgsql_t::node(osmium::Node const &node)
         }
         node_set(node);
     }
+
+    if (m_store_options.nodes) {
+        m_db_writer.add(node);
+    }
 }
 
 void middle_pgsql_t::way(osmium::Way const &way)
 {
     assert(m_middle_state == middle_state::way);
 
-    if (way.deleted()) {
-        way_delete(way.id());
-    } else {
-        if (m_options->append) {
-            way_delete(way.id());
-        }
-        way_set(way);
-    }
+    m_db_writer.add(way);
 }
 
 void middle_pgsql_t::relation(osmium::Relation const &relation)
 {
     assert(m_middle_state == middle_state::relation);
 
-    if (relation.deleted()) {
-        relation_delete(relation.id());
-    } else {
-        if (m_options->append) {
-            relation_delete(relation.id());
+    m_db_writer.add(relation);
+}
+
+void middle_pgsql_t::write_objects(osmium::memory::Buffer const &buffer)
+{
+    for (auto const &object : buffer.select<osmium::OSMObject>()) {
+        switch (object.type()) {
+        case osmium::item_type::node:
+            write_node(static_cast<osmium::Node const &>(object));
+            break;
+        case osmium::item_type::way:
+            write_way(static_cast<osmium::Way const &>(object));
+            break;
+        case osmium::item_type::relation:
+            write_relation(static_cast<osmium::Relation const &>(object));
+            break;
+        default:
+            break;
         }
-        relation_set(relation);
     }
 }
 
 void middle_pgsql_t::node_set(osmium::Node const &node)
 {
-    m_cache->set(node.id(), node.location());
+    if (!m_cache_stopped) {
+        m_cache->set(node.id(), node.location());
+        if (m_cache_memory_sampler.due()) {
+            m_cache_memory->set(m_cache->used_memory());
+            if (get_memory_budget().exceeded()) {
+                log_info("Memory budget exceeded, no more nodes will be added "
+                         "to the node cache.");
+                m_cache_stopped = true;
+            }
+        }
+    }
 
     if (m_persistent_cache) {
         m_persistent_cache->set(node.id(), node.location());
     }
+}
 
-    if (!m_store_options.nodes) {
-        return;
+void middle_pgsql_t::write_node(osmium::Node const &node)
+{
+    if (node.deleted() || m_options->append) {
+        write_delete(m_tables.nodes(), node.id());
+        if (node.deleted()) {
+            return;
+        }
     }
 
     if (!m_store_options.untagged_nodes && node.tags().empty()) {
@@ -506,10 +573,13 @@ std::size_t middle_query_pgsql_t::get_way_node_locations_flatnodes(
     osmium::WayNodeList *nodes) const
 {
     std::size_t count = 0;
+    std::size_t hits = 0;
 
     for (auto &n : *nodes) {
         auto loc = m_cache->get(n.ref());
-        if (!loc.valid() && n.ref() >= 0) {
+        if (loc.valid()) {
+            ++hits;
+        } else if (n.ref() >= 0) {
             loc = m_persistent_cache->get(n.ref());
         }
         n.set_location(loc);
@@ -518,11 +588,17 @@ std::size_t middle_query_pgsql_t::get_way_node_locations_flatnodes(
         }
     }
 
+    count_node_cache_lookups(hits, nodes->size() - hits);
+
     return count;
 }
 
 osmium::Location middle_query_pgsql_t::get_node_location_db(osmid_t id) const
 {
+    static auto const metric = query_metrics("node_location");
+    metric.calls->add();
+    metrics::scoped_timer_t const timer{metric.time};
+
     auto const res = m_db_connection.exec_prepared("get_node_location", id);
     if (res.num_tuples() == 0) {
         return osmium::Location{};
@@ -545,9 +621,11 @@ osmium::Location middle_query_pgsql_t::get_node_location(osmid_t id) const
 {
     auto const loc = m_cache->get(id);
     if (loc.valid()) {
+        count_node_cache_lookups(1, 0);
         return loc;
     }
 
+    count_node_cache_lookups(0, 1);
     return m_persistent_cache ? get_node_location_flatnodes(id)
                               : get_node_location_db(id);
 }
@@ -565,9 +643,14 @@ void middle_pgsql_t::node_delete(osmid_t osm_id)
     if (m_persistent_cache) {
         m_persistent_cache->set(osm_id, osmium::Location{});
     }
+}
 
-    if (m_store_options.nodes && osm_id <= m_tables.nodes().max_id()) {
-        m_db_copy.new_line(m_tables.nodes().copy_target());
+void middle_pgsql_t::write_delete(table_desc_t const &table, osmid_t osm_id)
+{
+    assert(m_options->append);
+
+    if (osm_id <= table.max_id()) {
+        m_db_copy.new_line(table.copy_target());
         m_db_copy.delete_object(osm_id);
     }
 }
@@ -698,8 +781,15 @@ INSERT INTO osm2pgsql_changed_relations
     parent_relations->sort_unique();
 }
 
-void middle_pgsql_t::way_set(osmium::Way const &way)
+void middle_pgsql_t::write_way(osmium::Way const &way)
 {
+    if (way.deleted() || m_options->append) {
+        write_delete(m_tables.ways(), way.id());
+        if (way.deleted()) {
+            return;
+        }
+    }
+
     m_db_copy.new_line(m_tables.ways().copy_target());
 
     m_db_copy.add_column(way.id());
@@ -756,6 +846,26 @@ void build_way(osmid_t id, pg_result_t const &res, int res_num, int offset,
     pgsql_parse_json_tags(res.get_value(res_num, offset + 1), buffer, &builder);
 }
 
+/**
+ * Build relation in buffer from database results.
+ */
+void build_relation(osmid_t id, pg_result_t const &res, int res_num,
+                    int offset, osmium::memory::Buffer *buffer,
+                    bool with_attributes)
+{
+    osmium::builder::RelationBuilder builder{*buffer};
+    builder.set_id(id);
+
+    if (with_attributes) {
+        set_attributes_on_builder(&builder, res, res_num, offset);
+    }
+
+    pgsql_parse_json_members(res.get_value(res_num, offset + 0), buffer,
+                             &builder);
+    pgsql_parse_json_tags(res.get_value(res_num, offset + 1), buffer,
+                          &builder);
+}
+
 } // anonymous namespace
 
 bool middle_query_pgsql_t::node_get(osmid_t id,
@@ -764,6 +874,10 @@ bool middle_query_pgsql_t::node_get(osmid_t id,
     assert(buffer);
 
     if (m_store_options.nodes) {
+        static auto const metric = query_metrics("node");
+        metric.calls->add();
+        metrics::scoped_timer_t const timer{metric.time};
+
         auto const res = m_db_connection.exec_prepared("get_node", id);
 
         if (res.num_tuples() == 1) {
@@ -797,6 +911,10 @@ bool middle_query_pgsql_t::way_get(osmid_t id,
 {
     assert(buffer);
 
+    static auto const metric = query_metrics("way");
+    metric.calls->add();
+    metrics::scoped_timer_t const timer{metric.time};
+
     auto const res = m_db_connection.exec_prepared("get_way", id);
 
     if (res.num_tuples() != 1) {
@@ -831,6 +949,10 @@ middle_query_pgsql_t::rel_members_get(osmium::Relation const &rel,
 
         // ...and get those ways from database
         if (!way_ids.empty()) {
+            static auto const metric = query_metrics("way_list");
+            metric.calls->add();
+            metrics::scoped_timer_t const timer{metric.time};
+
             res = m_db_connection.exec_prepared("get_way_list", way_ids());
             wayidspg = get_ids_from_result(res);
         }
@@ -863,18 +985,15 @@ middle_query_pgsql_t::rel_members_get(osmium::Relation const &rel,
     return members_found;
 }
 
-void middle_pgsql_t::way_delete(osmid_t osm_id)
+void middle_pgsql_t::write_relation(osmium::Relation const &rel)
 {
-    assert(m_options->append);
-
-    if (osm_id <= m_tables.ways().max_id()) {
-        m_db_copy.new_line(m_tables.ways().copy_target());
-        m_db_copy.delete_object(osm_id);
+    if (rel.deleted() || m_options->append) {
+        write_delete(m_tables.relations(), rel.id());
+        if (rel.deleted()) {
+            return;
+        }
     }
-}
 
-void middle_pgsql_t::relation_set(osmium::Relation const &rel)
-{
     m_db_copy.new_line(m_tables.relations().copy_target());
     m_db_copy.add_column(rel.id());
 
@@ -896,36 +1015,93 @@ bool middle_query_pgsql_t::relation_get(osmid_t id,
 {
     assert(buffer);
 
+    static auto const metric = query_metrics("relation");
+    metric.calls->add();
+    metrics::scoped_timer_t const timer{metric.time};
+
     auto const res = m_db_connection.exec_prepared("get_rel", id);
 
     if (res.num_tuples() == 0) {
         return false;
     }
 
-    {
-        osmium::builder::RelationBuilder builder{*buffer};
-        builder.set_id(id);
+    build_relation(id, res, 0, 0, buffer, m_store_options.with_attributes);
+    buffer->commit();
+
+    return true;
+}
 
-        if (m_store_options.with_attributes) {
-            set_attributes_on_builder(&builder, res, 0, 0);
+std::pair<osmid_t, osmid_t>
+middle_query_pgsql_t::get_id_range(osmium::item_type type) const
+{
+    pg_result_t res;
+    switch (type) {
+    case osmium::item_type::node:
+        if (!m_store_options.nodes) {
+            return {0, 0};
         }
+        res = m_db_connection.exec_prepared("get_node_id_range");
+        break;
+    case osmium::item_type::way:
+        res = m_db_connection.exec_prepared("get_way_id_range");
+        break;
+    default: // osmium::item_type::relation
+        assert(type == osmium::item_type::relation);
+        res = m_db_connection.exec_prepared("get_rel_id_range");
+    }
 
-        pgsql_parse_json_members(res.get_value(0, 0), buffer, &builder);
-        pgsql_parse_json_tags(res.get_value(0, 1), buffer, &builder);
+    if (res.is_null(0, 0)) {
+        return {0, 0};
     }
-    buffer->commit();
 
-    return true;
+    return {osmium::string_to_object_id(res.get_value(0, 0)),
+            osmium::string_to_object_id(res.get_value(0, 1))};
 }
 
-void middle_pgsql_t::relation_delete(osmid_t osm_id)
+std::size_t
+middle_query_pgsql_t::get_objects_in_range(osmium::item_type type,
+                                           osmid_t from, osmid_t to,
+                                           osmium::memory::Buffer *buffer) const
 {
-    assert(m_options->append);
+    assert(buffer);
 
-    if (osm_id <= m_tables.relations().max_id()) {
-        m_db_copy.new_line(m_tables.relations().copy_target());
-        m_db_copy.delete_object(osm_id);
+    static auto const metric = query_metrics("range");
+    metric.calls->add();
+    metrics::scoped_timer_t const timer{metric.time};
+
+    pg_result_t res;
+    switch (type) {
+    case osmium::item_type::node:
+        if (!m_store_options.nodes) {
+            return 0;
+        }
+        res = m_db_connection.exec_prepared("get_node_range", from, to);
+        break;
+    case osmium::item_type::way:
+        res = m_db_connection.exec_prepared("get_way_range", from, to);
+        break;
+    default: // osmium::item_type::relation
+        assert(type == osmium::item_type::relation);
+        res = m_db_connection.exec_prepared("get_rel_range", from, to);
     }
+
+    bool const with_attributes = m_store_options.with_attributes;
+    for (int i = 0; i < res.num_tuples(); ++i) {
+        auto const id = osmium::string_to_object_id(res.get_value(i, 0));
+        switch (type) {
+        case osmium::item_type::node:
+            build_node(id, res, i, 1, buffer, with_attributes);
+            break;
+        case osmium::item_type::way:
+            build_way(id, res, i, 1, buffer, with_attributes);
+            break;
+        default: // osmium::item_type::relation
+            build_relation(id, res, i, 1, buffer, with_attributes);
+        }
+        buffer->commit();
+    }
+
+    return static_cast<std::size_t>(res.num_tuples());
 }
 
 void middle_pgsql_t::after_nodes()
@@ -935,6 +1111,7 @@ void middle_pgsql_t::after_nodes()
     m_middle_state = middle_state::way;
 #endif
 
+    m_db_writer.sync();
     m_db_copy.sync();
     if (!m_options->append && m_store_options.nodes) {
         auto const &table = m_tables.nodes();
@@ -951,6 +1128,7 @@ void middle_pgsql_t::after_ways()
     m_middle_state = middle_state::relation;
 #endif
 
+    m_db_writer.sync();
     m_db_copy.sync();
     if (!m_options->append) {
         auto const &table = m_tables.ways();
@@ -965,6 +1143,7 @@ void middle_pgsql_t::after_relations()
     m_middle_state = middle_state::done;
 #endif
 
+    m_db_writer.sync();
     m_db_copy.sync();
     if (!m_options->append) {
         auto const &table = m_tables.relations();
@@ -979,8 +1158,11 @@ void middle_pgsql_t::after_relations()
         }
     }
 
-    // release the copy thread and its database connection
-    m_copy_thread->finish();
+    // release the copy thread and its database connection (unless we
+    // need it again for the next change file)
+    if (!m_options->persistent) {
+        m_copy_thread->finish();
+    }
 }
 
 middle_query_pgsql_t::middle_query_pgsql_t(
@@ -997,6 +1179,19 @@ middle_query_pgsql_t::middle_query_pgsql_t(
     m_db_connection.set_config("max_parallel_workers_per_gather", "0");
 }
 
+void middle_pgsql_t::init_max_ids()
+{
+    // Remember the maximum OSM ids in the middle tables. This is a very
+    // fast operation due to the index on the table. Later when we need
+    // to delete entries, we don't have to bother with entries that are
+    // definitely not in the table.
+    if (m_store_options.nodes) {
+        m_tables.nodes().init_max_id(m_db_connection);
+    }
+    m_tables.ways().init_max_id(m_db_connection);
+    m_tables.relations().init_max_id(m_db_connection);
+}
+
 void middle_pgsql_t::start()
 {
     assert(m_middle_state == middle_state::constructed);
@@ -1010,15 +1205,7 @@ void middle_pgsql_t::start()
         m_db_connection.set_config("jit_above_cost", "-1");
         m_db_connection.set_config("max_parallel_workers_per_gather", "0");
 
-        // Remember the maximum OSM ids in the middle tables. This is a very
-        // fast operation due to the index on the table. Later when we need
-        // to delete entries, we don't have to bother with entries that are
-        // definitely not in the table.
-        if (m_store_options.nodes) {
-            m_tables.nodes().init_max_id(m_db_connection);
-        }
-        m_tables.ways().init_max_id(m_db_connection);
-        m_tables.relations().init_max_id(m_db_connection);
+        init_max_ids();
         return;
     }
 
@@ -1159,11 +1346,28 @@ void middle_pgsql_t::build_relation_member_indexes()
         }));
 }
 
+void middle_pgsql_t::start_round()
+{
+    middle_t::start_round();
+
+    // The last change file might have added objects with larger ids.
+    init_max_ids();
+
+    // The node cache needs ids in order, but the ids in the next change
+    // file start from the beginning again.
+    m_cache->clear();
+    m_cache_memory->set(0);
+    m_cache_stopped = false;
+}
+
 void middle_pgsql_t::stop()
 {
     assert(m_middle_state == middle_state::done);
 
+    m_copy_thread->finish();
+
     m_cache.reset();
+    m_cache_memory->set(0);
     m_persistent_cache.reset();
 
     if (m_options->droptemp) {
@@ -1233,9 +1437,13 @@ middle_pgsql_t::middle_pgsql_t(std::shared_ptr<thread_pool_t> thread_pool,
 : middle_t(std::move(thread_pool)), m_options(options),
   m_cache(std::make_unique<node_locations_t>(
       static_cast<std::size_t>(options->cache) * 1024UL * 1024UL)),
+  m_cache_memory(&get_memory_budget().consumer("node cache")),
   m_db_connection(m_options->connection_params, "middle.main"),
   m_copy_thread(std::make_shared<db_copy_thread_t>(options->connection_params)),
-  m_db_copy(m_copy_thread), m_append(options->append)
+  m_db_copy(m_copy_thread), m_append(options->append),
+  m_db_writer([this](osmium::memory::Buffer const &buffer) {
+      write_objects(buffer);
+  })
 {
     m_store_options.with_attributes = options->extra_attributes;
 
@@ -1296,6 +1504,18 @@ std::shared_ptr<middle_query_t> middle_pgsql_t::get_query_instance()
                             " FROM {schema}\"{prefix}_nodes\" o"
                             " {users_table_access}"
                             " WHERE o.id = $1::int8"));
+
+        mid->prepare("get_node_id_range",
+                     render_template("SELECT min(id), max(id)"
+                                     " FROM {schema}\"{prefix}_nodes\""));
+
+        mid->prepare(
+            "get_node_range",
+            render_template("SELECT o.id, lon, lat, tags{attribute_columns_use}"
+                            " FROM {schema}\"{prefix}_nodes\" o"
+                            " {users_table_access}"
+                            " WHERE o.id >= $1::int8 AND o.id < $2::int8"
+                            " ORDER BY o.id"));
     }
 
     mid->prepare("get_way",
@@ -1317,5 +1537,29 @@ std::shared_ptr<middle_query_t> middle_pgsql_t::get_query_instance()
                                  " {users_table_access}"
                                  " WHERE o.id = $1::int8"));
 
+    mid->prepare("get_way_id_range",
+                 render_template("SELECT min(id), max(id)"
+                                 " FROM {schema}\"{prefix}_ways\""));
+
+    mid->prepare(
+        "get_way_range",
+        render_template("SELECT o.id, nodes, tags{attribute_columns_use}"
+                        " FROM {schema}\"{prefix}_ways\" o"
+                        " {users_table_access}"
+                        " WHERE o.id >= $1::int8 AND o.id < $2::int8"
+                        " ORDER BY o.id"));
+
+    mid->prepare("get_rel_id_range",
+                 render_template("SELECT min(id), max(id)"
+                                 " FROM {schema}\"{prefix}_rels\""));
+
+    mid->prepare(
+        "get_rel_range",
+        render_template("SELECT o.id, members, tags{attribute_columns_use}"
+                        " FROM {schema}\"{prefix}_rels\" o"
+                        " {users_table_access}"
+                        " WHERE o.id >= $1::int8 AND o.id < $2::int8"
+                        " ORDER BY o.id"));
+
     return std::shared_ptr<middle_query_t>(mid.release());
 }
@@ -23,8 +23,10 @@
 
 #include <osmium/index/nwr_array.hpp>
 
+#include "async-buffer-processor.hpp"
 #include "db-copy-mgr.hpp"
 #include "idlist.hpp"
+#include "memory-budget.hpp"
 #include "middle.hpp"
 #include "params.hpp"
 #include "pgsql.hpp"
@@ -71,6 +73,13 @@ public:
     bool relation_get(osmid_t id,
                       osmium::memory::Buffer *buffer) const override;
 
+    std::pair<osmid_t, osmid_t>
+    get_id_range(osmium::item_type type) const override;
+
+    std::size_t
+    get_objects_in_range(osmium::item_type type, osmid_t from, osmid_t to,
+                         osmium::memory::Buffer *buffer) const override;
+
     void prepare(std::string const &stmt, std::string const &sql_cmd) const;
 
 private:
@@ -94,6 +103,8 @@ struct middle_pgsql_t : public middle_t
     void start() override;
     void stop() override;
 
+    void start_round() override;
+
     void wait() override;
 
     void node(osmium::Node const &node) override;
@@ -161,11 +172,16 @@ private:
     void node_set(osmium::Node const &node);
     void node_delete(osmid_t id);
 
-    void way_set(osmium::Way const &way);
-    void way_delete(osmid_t id);
+    /**
+     * Write objects in the buffer to the database. This is called from the
+     * thread of m_db_writer.
+     */
+    void write_objects(osmium::memory::Buffer const &buffer);
 
-    void relation_set(osmium::Relation const &rel);
-    void relation_delete(osmid_t id);
+    void write_node(osmium::Node const &node);
+    void write_way(osmium::Way const &way);
+    void write_relation(osmium::Relation const &rel);
+    void write_delete(table_desc_t const &table, osmid_t osm_id);
 
     void copy_attributes(osmium::OSMObject const &obj);
     void copy_tags(osmium::OSMObject const &obj);
@@ -173,6 +189,8 @@ private:
     void write_users_table();
     void update_users_table();
 
+    void init_max_ids();
+
     std::string render_template(std::string_view templ) const;
     void dbexec(std::string_view templ) const;
 
@@ -187,6 +205,12 @@ private:
     std::shared_ptr<node_locations_t> m_cache;
     std::shared_ptr<node_persistent_cache_t> m_persistent_cache;
 
+    /// Memory accounting for the node cache.
+    memory_budget_t::consumer_t *m_cache_memory;
+
+    /// Only update memory accounting every so often in node_set().
+    memory_sampler_t m_cache_memory_sampler;
+
     pg_conn_t m_db_connection;
 
     // middle keeps its own thread for writing to the database.
@@ -199,6 +223,19 @@ private:
     params_t m_params;
 
     bool m_append;
+
+    /**
+     * Set when the memory budget was exceeded. No more nodes are added to
+     * the node cache then.
+     */
+    bool m_cache_stopped = false;
+
+    /**
+     * Objects are encoded for the database in a separate thread. This must
+     * be the last member, so that the thread is stopped before anything it
+     * uses is destroyed.
+     */
+    async_buffer_processor_t m_db_writer;
 };
 
 #endif // OSM2PGSQL_MIDDLE_PGSQL_HPP
@@ -13,56 +13,154 @@
 #include "node-persistent-cache.hpp"
 #include "options.hpp"
 #include "output-requirements.hpp"
+#include "ram-snapshot.hpp"
+#include "util.hpp"
 
 #include <osmium/builder/osm_object_builder.hpp>
 #include <osmium/util/delta.hpp>
 
-// Workaround: This must be included before buffer_string.hpp due to a missing
-// include in the upstream code. https://github.com/mapbox/protozero/pull/104
-#include <protozero/config.hpp>
-
-#include <protozero/buffer_string.hpp>
 #include <protozero/varint.hpp>
 
 #include <cassert>
+#include <chrono>
+#include <filesystem>
 #include <memory>
+#include <new>
+#include <string>
+#include <system_error>
 
 namespace {
 
-void add_delta_encoded_way_node_list(std::string *data,
-                                     osmium::WayNodeList const &wnl)
+/// Written at the start of each snapshot file to identify it.
+constexpr char const *const SNAPSHOT_MAGIC = "osm2pgsql-middle-ram";
+
+/// Increment this when the snapshot format changes.
+constexpr uint32_t const SNAPSHOT_VERSION = 4;
+
+/**
+ * What we remember about an input or flat node file in the snapshot to make
+ * sure the snapshot is only used with the files it was created from.
+ */
+struct file_id_t
+{
+    std::string name;
+    uint64_t size = 0;
+    int64_t mtime = 0;
+
+    bool operator==(file_id_t const &other) const noexcept
+    {
+        return name == other.name && size == other.size &&
+               mtime == other.mtime;
+    }
+};
+
+file_id_t get_file_id(std::string const &filename)
+{
+    file_id_t id{filename};
+
+    // There is nothing we can check when reading from STDIN.
+    if (filename == "-") {
+        return id;
+    }
+
+    std::filesystem::path const path{filename};
+    std::error_code ec;
+    auto const size = std::filesystem::file_size(path, ec);
+    if (!ec) {
+        id.size = size;
+    }
+
+    auto const mtime = std::filesystem::last_write_time(path, ec);
+    if (!ec) {
+        id.mtime = std::chrono::duration_cast<std::chrono::seconds>(
+                       mtime.time_since_epoch())
+                       .count();
+    }
+
+    return id;
+}
+
+void write_file_id(ram_snapshot_writer_t *writer, file_id_t const &id)
+{
+    writer->write_string(id.name);
+    writer->write_value<uint64_t>(id.size);
+    writer->write_value<int64_t>(id.mtime);
+}
+
+file_id_t read_file_id(ram_snapshot_reader_t *reader)
+{
+    file_id_t id;
+    reader->read_string(&id.name);
+    id.size = reader->read_value<uint64_t>();
+    id.mtime = reader->read_value<int64_t>();
+    return id;
+}
+
+/// Add way node list to data and return the offset where it was added.
+std::size_t add_delta_encoded_way_node_list(segmented_buffer_t *data,
+                                            osmium::WayNodeList const &wnl)
 {
     assert(data);
 
+    auto const offset =
+        data->prepare((wnl.size() + 1) * protozero::max_varint_length);
+
     // Add number of nodes in list
-    protozero::add_varint_to_buffer(data, wnl.size());
+    data->append_varint(wnl.size());
 
     // Add delta encoded node ids
     osmium::DeltaEncode<osmid_t> delta;
     for (auto const &nr : wnl) {
-        protozero::add_varint_to_buffer(
-            data, protozero::encode_zigzag64(delta.update(nr.ref())));
+        data->append_varint(protozero::encode_zigzag64(delta.update(nr.ref())));
     }
+
+    return offset;
 }
 
-void get_delta_encoded_way_nodes_list(std::string const &data,
+/**
+ * Way node list builder which can add many node refs at once. Adding them
+ * one by one is expensive, because osmium has to check the buffer space and
+ * update the sizes of the list and the way for each of them.
+ */
+class way_node_list_builder_t : public osmium::builder::WayNodeListBuilder
+{
+public:
+    explicit way_node_list_builder_t(osmium::builder::Builder &parent)
+    : osmium::builder::WayNodeListBuilder(parent)
+    {}
+
+    /**
+     * Reserve space for count node refs in the list. The caller must
+     * construct all node refs in that space.
+     */
+    osmium::NodeRef *reserve_node_refs(std::size_t count)
+    {
+        auto const size = count * sizeof(osmium::NodeRef);
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        auto *refs = reinterpret_cast<osmium::NodeRef *>(reserve_space(size));
+        add_size(static_cast<osmium::memory::item_size_type>(size));
+        return refs;
+    }
+};
+
+void get_delta_encoded_way_nodes_list(segmented_buffer_t const &data,
                                       std::size_t offset,
                                       osmium::builder::WayBuilder *builder)
 {
     assert(builder);
 
-    char const *begin = data.data() + offset;
-    char const *const end = data.data() + data.size();
+    char const *begin = data.data(offset);
+    char const *const end = data.end_of(offset);
 
-    auto count = protozero::decode_varint(&begin, end);
+    auto const count = protozero::decode_varint(&begin, end);
 
     osmium::DeltaDecode<osmid_t> delta;
-    osmium::builder::WayNodeListBuilder wnl_builder{*builder};
-    while (count > 0) {
+    way_node_list_builder_t wnl_builder{*builder};
+    auto *const refs = wnl_builder.reserve_node_refs(count);
+    for (std::size_t i = 0; i < count; ++i) {
         auto const val =
             protozero::decode_zigzag64(protozero::decode_varint(&begin, end));
-        wnl_builder.add_node_ref(delta.update(val));
-        --count;
+        new (&refs[i]) osmium::NodeRef{delta.update(val)};
     }
 }
 
@@ -78,10 +176,17 @@ middle_ram_t::middle_ram_t(std::shared_ptr<thread_pool_t> thread_pool,
         m_store_options.untagged_nodes = true;
     }
 
+    m_store_options.compress = options->ram_compress;
+
     if (!options->flat_node_file.empty()) {
         m_persistent_cache = std::make_shared<node_persistent_cache_t>(
             options->flat_node_file, !options->append, options->droptemp);
+        m_flat_node_file = options->flat_node_file;
+        m_drop_flat_nodes = options->droptemp;
     }
+
+    m_snapshot_file = options->ram_snapshot_file;
+    m_input_files = options->input_files;
 }
 
 void middle_ram_t::set_requirements(output_requirements const &requirements)
@@ -107,12 +212,168 @@ void middle_ram_t::set_requirements(output_requirements const &requirements)
     log_debug("  untagged_nodes: {}", m_store_options.untagged_nodes);
     log_debug("  ways: {}", m_store_options.ways);
     log_debug("  relations: {}", m_store_options.relations);
+    log_debug("  compress: {}", m_store_options.compress);
+
+    if (!m_snapshot_file.empty() && std::filesystem::exists(m_snapshot_file)) {
+        read_snapshot();
+        update_memory_usage();
+    }
+}
+
+uint32_t middle_ram_t::snapshot_flags() const noexcept
+{
+    return m_store_options.flags() | (m_persistent_cache ? 1U << 31U : 0U);
+}
+
+void middle_ram_t::write_snapshot() const
+{
+    log_info("Writing RAM middle snapshot to '{}'...", m_snapshot_file);
+    util::timer_t timer;
+
+    ram_snapshot_writer_t writer{m_snapshot_file};
+
+    writer.write_string(SNAPSHOT_MAGIC);
+    writer.write_value<uint32_t>(SNAPSHOT_VERSION);
+    writer.write_value<uint32_t>(snapshot_flags());
+
+    writer.write_value<uint32_t>(
+        static_cast<uint32_t>(m_input_files.size()));
+    for (auto const &filename : m_input_files) {
+        write_file_id(&writer, get_file_id(filename));
+    }
+
+    if (m_persistent_cache) {
+        write_file_id(&writer, get_file_id(m_flat_node_file));
+    }
+
+    m_node_locations.write_snapshot(&writer);
+
+    m_way_nodes_data.write_snapshot(&writer);
+    m_way_nodes_index.write_snapshot(&writer);
+
+    m_object_data.write_snapshot(&writer);
+    for (auto const &index : m_object_index) {
+        index.write_snapshot(&writer);
+    }
+    for (auto const &store : m_compressed_objects) {
+        store.write_snapshot(&writer);
+    }
+
+    writer.commit();
+
+    log_info("Writing RAM middle snapshot took {}.",
+             util::human_readable_duration(timer.stop()));
+}
+
+void middle_ram_t::read_snapshot()
+{
+    log_info("Reading RAM middle snapshot from '{}'...", m_snapshot_file);
+    util::timer_t timer;
+
+    ram_snapshot_reader_t reader{m_snapshot_file};
+
+    std::string magic;
+    reader.read_string(&magic);
+    if (magic != SNAPSHOT_MAGIC) {
+        throw fmt_error("File '{}' is not a RAM middle snapshot.",
+                        m_snapshot_file);
+    }
+
+    auto const version = reader.read_value<uint32_t>();
+    if (version != SNAPSHOT_VERSION) {
+        throw fmt_error("RAM middle snapshot '{}' has version {}, but this "
+                        "version of osm2pgsql needs version {}. Remove it to "
+                        "create a new one.",
+                        m_snapshot_file, version, SNAPSHOT_VERSION);
+    }
+
+    if (reader.read_value<uint32_t>() != snapshot_flags()) {
+        throw fmt_error("RAM middle snapshot '{}' was created with different "
+                        "settings (style, --extra-attributes, --ram-compress, "
+                        "or --flat-nodes). Remove it to create a new one.",
+                        m_snapshot_file);
+    }
+
+    auto const num_files = reader.read_value<uint32_t>();
+    bool same_input = num_files == m_input_files.size();
+    for (uint32_t n = 0; n < num_files; ++n) {
+        auto const id = read_file_id(&reader);
+        if (same_input && !(id == get_file_id(m_input_files[n]))) {
+            same_input = false;
+        }
+    }
+    if (!same_input) {
+        throw fmt_error("RAM middle snapshot '{}' was created from different "
+                        "input files (or they have changed since). Remove it "
+                        "to create a new one.",
+                        m_snapshot_file);
+    }
+
+    // The node locations are not in the snapshot but in the flat node file,
+    // so it has to be the same file as when the snapshot was created.
+    if (m_persistent_cache &&
+        !(read_file_id(&reader) == get_file_id(m_flat_node_file))) {
+        throw fmt_error("RAM middle snapshot '{}' was created with a "
+                        "different flat node file (or it has changed "
+                        "since). Remove it to create a new one.",
+                        m_snapshot_file);
+    }
+
+    m_node_locations.read_snapshot(&reader);
+
+    m_way_nodes_data.read_snapshot(&reader);
+    m_way_nodes_index.read_snapshot(&reader);
+
+    m_object_data.read_snapshot(&reader);
+    for (auto &index : m_object_index) {
+        index.read_snapshot(&reader);
+    }
+    for (auto &store : m_compressed_objects) {
+        store.read_snapshot(&reader);
+    }
+
+    if (!reader.at_end()) {
+        throw fmt_error("RAM middle snapshot '{}' has trailing data.",
+                        m_snapshot_file);
+    }
+
+    m_from_snapshot = true;
+
+    log_info("Reading RAM middle snapshot took {}. Data in the middle will "
+             "not be updated from the input files.",
+             util::human_readable_duration(timer.stop()));
+}
+
+void middle_ram_t::remove_snapshot() const
+{
+    std::error_code ec;
+    if (!std::filesystem::remove(m_snapshot_file, ec)) {
+        if (ec) {
+            log_warn("Failed to remove RAM middle snapshot '{}': {}.",
+                     m_snapshot_file, ec.message());
+        }
+        return;
+    }
+
+    log_info("Removed RAM middle snapshot '{}', because the flat node file "
+             "is removed (--drop).",
+             m_snapshot_file);
 }
 
 void middle_ram_t::stop()
 {
     assert(m_middle_state == middle_state::done);
 
+    if (!m_snapshot_file.empty()) {
+        if (m_drop_flat_nodes) {
+            // The flat node file is removed when this middle is destroyed
+            // and the snapshot is useless without it.
+            remove_snapshot();
+        } else if (!m_from_snapshot) {
+            write_snapshot();
+        }
+    }
+
     constexpr auto MBYTE = 1024 * 1024;
 
     if (m_persistent_cache) {
@@ -125,17 +386,21 @@ void middle_ram_t::stop()
                   m_node_locations.used_memory() / MBYTE);
     }
 
-    log_debug("Middle 'ram': Way nodes data: size={} capacity={} bytes={}M",
+    log_debug("Middle 'ram': Way nodes data: size={} capacity={} "
+              "segments={} bytes={}M",
               m_way_nodes_data.size(), m_way_nodes_data.capacity(),
-              m_way_nodes_data.capacity() / MBYTE);
+              m_way_nodes_data.num_segments(),
+              m_way_nodes_data.used_memory() / MBYTE);
 
     log_debug("Middle 'ram': Way nodes index: size={} capacity={} bytes={}M",
               m_way_nodes_index.size(), m_way_nodes_index.capacity(),
               m_way_nodes_index.used_memory() / MBYTE);
 
-    log_debug("Middle 'ram': Object data: size={} capacity={} bytes={}M",
-              m_object_buffer.committed(), m_object_buffer.capacity(),
-              m_object_buffer.capacity() / MBYTE);
+    log_debug("Middle 'ram': Object data: size={} capacity={} segments={} "
+              "bytes={}M",
+              m_object_data.size(), m_object_data.capacity(),
+              m_object_data.num_segments(),
+              m_object_data.used_memory() / MBYTE);
 
     std::size_t index_size = 0;
     std::size_t index_capacity = 0;
@@ -148,30 +413,77 @@ void middle_ram_t::stop()
     log_debug("Middle 'ram': Object indexes: size={} capacity={} bytes={}M",
               index_size, index_capacity, index_mem / MBYTE);
 
+    if (m_store_options.compress) {
+        std::size_t size = 0;
+        std::size_t raw_size = 0;
+        std::size_t compressed_size = 0;
+        std::size_t mem = 0;
+        for (auto const &store : m_compressed_objects) {
+            size += store.size();
+            raw_size += store.raw_size();
+            compressed_size += store.compressed_size();
+            mem += store.used_memory();
+        }
+        log_debug("Middle 'ram': Compressed objects: size={} raw={}M "
+                  "compressed={}M bytes={}M",
+                  size, raw_size / MBYTE, compressed_size / MBYTE,
+                  mem / MBYTE);
+    }
+
     log_debug("Middle 'ram': Memory used overall: {}MBytes",
-              (m_node_locations.used_memory() + m_way_nodes_data.capacity() +
-               m_way_nodes_index.used_memory() + m_object_buffer.capacity() +
-               index_mem) /
-                  MBYTE);
+              used_memory() / MBYTE);
 
     m_node_locations.clear();
 
     m_way_nodes_index.clear();
     m_way_nodes_data.clear();
-    m_way_nodes_data.shrink_to_fit();
 
-    m_object_buffer = osmium::memory::Buffer{};
+    m_object_data.clear();
 
     for (auto &index : m_object_index) {
         index.clear();
     }
+
+    for (auto &store : m_compressed_objects) {
+        store.clear();
+    }
+
+    m_memory->set(0);
+}
+
+std::size_t middle_ram_t::used_memory() const noexcept
+{
+    std::size_t mem = m_node_locations.used_memory() +
+                      m_way_nodes_data.used_memory() +
+                      m_way_nodes_index.used_memory() +
+                      m_object_data.used_memory();
+    for (auto const &index : m_object_index) {
+        mem += index.used_memory();
+    }
+    for (auto const &store : m_compressed_objects) {
+        mem += store.used_memory();
+    }
+    return mem;
+}
+
+void middle_ram_t::update_memory_usage() noexcept
+{
+    if (get_memory_budget().accounting_enabled()) {
+        m_memory->set(used_memory());
+    }
 }
 
 void middle_ram_t::store_object(osmium::OSMObject const &object)
 {
-    auto const offset = m_object_buffer.committed();
-    m_object_buffer.add_item(object);
-    m_object_buffer.commit();
+    if (m_store_options.compress) {
+        m_compressed_objects(object.type()).add(object);
+        return;
+    }
+
+    auto const offset = m_object_data.prepare(object.padded_size());
+    // Objects are padded, so all of them will be properly aligned.
+    assert(offset % osmium::memory::align_bytes == 0);
+    m_object_data.append(object.data(), object.padded_size());
     m_object_index(object.type()).add(object.id(), offset);
 }
 
@@ -180,11 +492,15 @@ bool middle_ram_t::get_object(osmium::item_type type, osmid_t id,
 {
     assert(buffer);
 
+    if (m_store_options.compress) {
+        return m_compressed_objects(type).get(id, buffer);
+    }
+
     auto const offset = m_object_index(type).get(id);
     if (offset == ordered_index_t::not_found_value()) {
         return false;
     }
-    buffer->add_item(m_object_buffer.get<osmium::memory::Item>(offset));
+    buffer->add_item(stored_object<osmium::memory::Item>(offset));
     buffer->commit();
     return true;
 }
@@ -194,6 +510,10 @@ void middle_ram_t::node(osmium::Node const &node)
     assert(m_middle_state == middle_state::node);
     assert(node.visible());
 
+    if (m_from_snapshot) {
+        return;
+    }
+
     if (m_store_options.locations) {
         if (m_persistent_cache) {
             m_persistent_cache->set(node.id(), node.location());
@@ -206,6 +526,10 @@ void middle_ram_t::node(osmium::Node const &node)
         (!node.tags().empty() || m_store_options.untagged_nodes)) {
         store_object(node);
     }
+
+    if (m_memory_sampler.due()) {
+        m_memory->set(used_memory());
+    }
 }
 
 void middle_ram_t::way(osmium::Way const &way)
@@ -213,15 +537,23 @@ void middle_ram_t::way(osmium::Way const &way)
     assert(m_middle_state == middle_state::way);
     assert(way.visible());
 
+    if (m_from_snapshot) {
+        return;
+    }
+
     if (m_store_options.way_nodes) {
-        auto const offset = m_way_nodes_data.size();
-        add_delta_encoded_way_node_list(&m_way_nodes_data, way.nodes());
+        auto const offset =
+            add_delta_encoded_way_node_list(&m_way_nodes_data, way.nodes());
         m_way_nodes_index.add(way.id(), offset);
     }
 
     if (m_store_options.ways) {
         store_object(way);
     }
+
+    if (m_memory_sampler.due()) {
+        m_memory->set(used_memory());
+    }
 }
 
 void middle_ram_t::relation(osmium::Relation const &relation)
@@ -229,9 +561,17 @@ void middle_ram_t::relation(osmium::Relation const &relation)
     assert(m_middle_state == middle_state::relation);
     assert(relation.visible());
 
+    if (m_from_snapshot) {
+        return;
+    }
+
     if (m_store_options.relations) {
         store_object(relation);
     }
+
+    if (m_memory_sampler.due()) {
+        m_memory->set(used_memory());
+    }
 }
 
 void middle_ram_t::after_nodes()
@@ -244,6 +584,23 @@ void middle_ram_t::after_nodes()
     if (!m_persistent_cache) {
         m_node_locations.log_stats();
     }
+
+    m_compressed_objects.nodes().flush();
+    update_memory_usage();
+}
+
+void middle_ram_t::after_ways()
+{
+    middle_t::after_ways();
+    m_compressed_objects.ways().flush();
+    update_memory_usage();
+}
+
+void middle_ram_t::after_relations()
+{
+    middle_t::after_relations();
+    m_compressed_objects.relations().flush();
+    update_memory_usage();
 }
 
 osmium::Location middle_ram_t::get_node_location(osmid_t id) const
@@ -340,14 +697,10 @@ middle_ram_t::rel_members_get(osmium::Relation const &rel,
 
         switch (member.type()) {
         case osmium::item_type::node:
-            if (m_store_options.nodes) {
-                auto const offset = m_object_index.nodes().get(member.ref());
-                if (offset != ordered_index_t::not_found_value()) {
-                    buffer->add_item(m_object_buffer.get<osmium::Node>(offset));
-                    buffer->commit();
-                    ++count;
-                    continue;
-                }
+            if (m_store_options.nodes &&
+                get_object(osmium::item_type::node, member.ref(), buffer)) {
+                ++count;
+                continue;
             }
             {
                 osmium::builder::NodeBuilder builder{*buffer};
@@ -358,10 +711,7 @@ middle_ram_t::rel_members_get(osmium::Relation const &rel,
             break;
         case osmium::item_type::way:
             if (m_store_options.ways) {
-                auto const offset = m_object_index.ways().get(member.ref());
-                if (offset != ordered_index_t::not_found_value()) {
-                    buffer->add_item(m_object_buffer.get<osmium::Way>(offset));
-                    buffer->commit();
+                if (get_object(osmium::item_type::way, member.ref(), buffer)) {
                     ++count;
                 }
             } else if (m_store_options.way_nodes) {
@@ -377,15 +727,10 @@ middle_ram_t::rel_members_get(osmium::Relation const &rel,
             }
             break;
         default: // osmium::item_type::relation
-            if (m_store_options.relations) {
-                auto const offset =
-                    m_object_index.relations().get(member.ref());
-                if (offset != ordered_index_t::not_found_value()) {
-                    buffer->add_item(
-                        m_object_buffer.get<osmium::Relation>(offset));
-                    buffer->commit();
-                    ++count;
-                }
+            if (m_store_options.relations &&
+                get_object(osmium::item_type::relation, member.ref(),
+                           buffer)) {
+                ++count;
             }
         }
     }
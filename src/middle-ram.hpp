@@ -10,10 +10,13 @@
  * For a full list of authors see the git log.
  */
 
+#include "compressed-object-store.hpp"
+#include "memory-budget.hpp"
 #include "middle.hpp"
 #include "node-locations.hpp"
 #include "osmtypes.hpp"
 #include "ordered-index.hpp"
+#include "segmented-buffer.hpp"
 
 #include <osmium/index/nwr_array.hpp>
 #include <osmium/memory/buffer.hpp>
@@ -21,9 +24,11 @@
 
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 class node_persistent_cache_t;
 class thread_pool_t;
@@ -31,7 +36,8 @@ class thread_pool_t;
 /**
  * Implementation of middle for importing small to medium sized files into a
  * non-updateable database. It works completely in memory, no data is written
- * to disk.
+ * to disk. (Unless a snapshot file is used, see write_snapshot() and
+ * read_snapshot().)
  *
  * The following traits of OSM objects can be stored. All are optional:
  * - Node locations for building geometries of ways.
@@ -63,6 +69,8 @@ public:
     void relation(osmium::Relation const &) override;
 
     void after_nodes() override;
+    void after_ways() override;
+    void after_relations() override;
 
     osmium::Location get_node_location(osmid_t id) const override;
 
@@ -103,6 +111,18 @@ private:
 
         // Store relations (with tags, attributes, and members) in object store.
         bool relations = false;
+
+        // Use compressed object store instead of the normal object store.
+        bool compress = false;
+
+        /// All options as bit field, used to check snapshot compatibility.
+        uint32_t flags() const noexcept
+        {
+            return (locations ? 1U : 0U) | (way_nodes ? 2U : 0U) |
+                   (nodes ? 4U : 0U) | (untagged_nodes ? 8U : 0U) |
+                   (ways ? 16U : 0U) | (relations ? 32U : 0U) |
+                   (compress ? 64U : 0U);
+        }
     };
 
     void store_object(osmium::OSMObject const &object);
@@ -110,28 +130,80 @@ private:
     bool get_object(osmium::item_type type, osmid_t id,
                     osmium::memory::Buffer *buffer) const;
 
+    /// Get object stored at the specified offset in the object store.
+    template <typename T>
+    T const &stored_object(std::size_t offset) const noexcept
+    {
+        return *reinterpret_cast<T const *>(m_object_data.data(offset));
+    }
+
+    /// Write all data stored in this middle into the snapshot file.
+    void write_snapshot() const;
+
+    /// Read all data stored in this middle from the snapshot file.
+    void read_snapshot();
+
+    /// Remove the snapshot file (if it exists).
+    void remove_snapshot() const;
+
+    /// Bit field of store options and flat node file use.
+    uint32_t snapshot_flags() const noexcept;
+
+    /// Return the approximate number of bytes used for all data.
+    std::size_t used_memory() const noexcept;
+
+    /// Update the memory accounting (if it is enabled).
+    void update_memory_usage() noexcept;
+
     /// For storing the location of all nodes.
     node_locations_t m_node_locations;
 
     /// For storing the node lists of all ways.
-    std::string m_way_nodes_data;
+    segmented_buffer_t m_way_nodes_data;
 
     /// The index for accessing way nodes.
     ordered_index_t m_way_nodes_index;
 
-    /// Buffer for all OSM objects we store.
-    osmium::memory::Buffer m_object_buffer{
-        1024UL * 1024UL, osmium::memory::Buffer::auto_grow::yes};
+    /// Storage for all OSM objects we store.
+    segmented_buffer_t m_object_data;
 
-    /// Indexes into object buffer.
+    /// Indexes into object storage.
     osmium::nwr_array<ordered_index_t> m_object_index;
 
+    /// Compressed object stores (used instead of the above if enabled).
+    osmium::nwr_array<compressed_object_store_t> m_compressed_objects;
+
     /// Options for this middle.
     middle_ram_options m_store_options;
 
+    /// Memory accounting for all data in this middle.
+    memory_budget_t::consumer_t *m_memory =
+        &get_memory_budget().consumer("RAM middle");
+
+    /// Only update memory accounting every so often while adding objects.
+    memory_sampler_t m_memory_sampler;
+
     /// File cache
     std::shared_ptr<node_persistent_cache_t> m_persistent_cache;
 
+    /// Name of the flat node file (recorded in the snapshot).
+    std::string m_flat_node_file;
+
+    /// Set if the flat node file is removed at the end (--drop).
+    bool m_drop_flat_nodes = false;
+
+    /// Name of snapshot file (empty if snapshots are not used).
+    std::string m_snapshot_file;
+
+    /// Names of the input files (recorded in the snapshot).
+    std::vector<std::string> m_input_files;
+
+    /**
+     * Set if the data was read from a snapshot. Nothing will be added to
+     * the middle in that case.
+     */
+    bool m_from_snapshot = false;
+
 }; // class middle_ram_t
 
 #endif // OSM2PGSQL_MIDDLE_RAM_HPP
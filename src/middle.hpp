@@ -12,9 +12,12 @@
 
 #include <osmium/memory/buffer.hpp>
 #include <osmium/osm/entity_bits.hpp>
+#include <osmium/osm/item_type.hpp>
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <utility>
 
 #include "osmtypes.hpp"
 #include "thread-pool.hpp"
@@ -99,6 +102,32 @@ struct middle_query_t : std::enable_shared_from_this<middle_query_t>
      */
     virtual bool relation_get(osmid_t id,
                               osmium::memory::Buffer *buffer) const = 0;
+
+    /**
+     * Get the smallest and largest id of the objects of the specified type
+     * stored in the middle. Returns (0, 0) if there are no objects of that
+     * type or the middle doesn't support this.
+     */
+    virtual std::pair<osmid_t, osmid_t>
+    get_id_range(osmium::item_type /*type*/) const
+    {
+        return {0, 0};
+    }
+
+    /**
+     * Retrieves all objects of the specified type with ids in the range
+     * [from, to) and stores them in the given osmium buffer ordered by id.
+     * Ways are retrieved without node locations.
+     *
+     * \return The number of objects retrieved
+     */
+    virtual std::size_t get_objects_in_range(osmium::item_type /*type*/,
+                                             osmid_t /*from*/, osmid_t /*to*/,
+                                             osmium::memory::Buffer * /*buffer*/)
+        const
+    {
+        return 0;
+    }
 };
 
 /**
@@ -160,6 +189,18 @@ public:
 #endif
     }
 
+    /**
+     * Called in persistent mode before processing the next change file. The
+     * middle has to be ready to get new data after this.
+     */
+    virtual void start_round()
+    {
+        assert(m_middle_state == middle_state::done);
+#ifndef NDEBUG
+        m_middle_state = middle_state::node;
+#endif
+    }
+
     virtual void get_node_parents(idlist_t const & /*changed_nodes*/,
                                   idlist_t * /*parent_ways*/,
                                   idlist_t * /*parent_relations*/) const
@@ -10,16 +10,34 @@
 #include "node-locations.hpp"
 
 #include "logging.hpp"
+#include "ram-snapshot.hpp"
 
-// Workaround: This must be included before buffer_string.hpp due to a missing
-// include in the upstream code. https://github.com/mapbox/protozero/pull/104
-#include <protozero/config.hpp>
-
-#include <protozero/buffer_string.hpp>
 #include <protozero/varint.hpp>
 
 #include <cassert>
 
+namespace {
+
+/**
+ * Use smaller segments for small stores so that we don't allocate much more
+ * memory than allowed.
+ */
+std::size_t segment_size_for(std::size_t max_size) noexcept
+{
+    std::size_t size = segmented_buffer_t::DEFAULT_SEGMENT_SIZE;
+    while (size > segmented_buffer_t::MIN_SEGMENT_SIZE && size > max_size / 8) {
+        size >>= 1U;
+    }
+    return size;
+}
+
+} // anonymous namespace
+
+node_locations_t::node_locations_t(std::size_t max_size)
+: m_data(segment_size_for(max_size)), m_max_size(max_size)
+{
+}
+
 bool node_locations_t::set(osmid_t id, osmium::Location location)
 {
     if (used_memory() >= m_max_size && will_resize()) {
@@ -30,18 +48,18 @@ bool node_locations_t::set(osmid_t id, osmium::Location location)
         m_did.clear();
         m_dx.clear();
         m_dy.clear();
-        m_index.add(id, m_data.size());
+        m_index.add(id, m_data.prepare(max_bytes_per_block()));
     }
 
     auto const delta = m_did.update(id);
     // Always true because ids in input must be unique and ordered
     assert(delta > 0);
-    protozero::add_varint_to_buffer(&m_data, static_cast<uint64_t>(delta));
+    m_data.append_varint(static_cast<uint64_t>(delta));
 
-    protozero::add_varint_to_buffer(
-        &m_data, protozero::encode_zigzag64(m_dx.update(location.x())));
-    protozero::add_varint_to_buffer(
-        &m_data, protozero::encode_zigzag64(m_dy.update(location.y())));
+    m_data.append_varint(
+        protozero::encode_zigzag64(m_dx.update(location.x())));
+    m_data.append_varint(
+        protozero::encode_zigzag64(m_dy.update(location.y())));
 
     ++m_count;
 
@@ -55,10 +73,8 @@ osmium::Location node_locations_t::get(osmid_t id) const
         return osmium::Location{};
     }
 
-    assert(offset < m_data.size());
-
-    char const *begin = m_data.data() + offset;
-    char const *const end = m_data.data() + m_data.size();
+    char const *begin = m_data.data(offset);
+    char const *const end = m_data.end_of(offset);
 
     osmium::DeltaDecode<osmid_t> did;
     osmium::DeltaDecode<int64_t> dx;
@@ -89,13 +105,38 @@ void node_locations_t::log_stats()
     log_debug("  bytes overall: {}MB", used_memory() / MBYTE);
     log_debug("  data capacity: {}MB", m_data.capacity() / MBYTE);
     log_debug("  data size: {}MB", m_data.size() / MBYTE);
+    log_debug("  data segments: {}", m_data.num_segments());
     log_debug("  index used memory: {}MB", m_index.used_memory() / MBYTE);
 }
 
 void node_locations_t::clear()
 {
     m_data.clear();
-    m_data.shrink_to_fit();
     m_index.clear();
     m_count = 0;
 }
+
+void node_locations_t::write_snapshot(ram_snapshot_writer_t *writer) const
+{
+    assert(writer);
+
+    m_index.write_snapshot(writer);
+    m_data.write_snapshot(writer);
+    writer->write_value<uint64_t>(m_count);
+    writer->write_value<osmid_t>(m_did.value());
+    writer->write_value<int64_t>(m_dx.value());
+    writer->write_value<int64_t>(m_dy.value());
+}
+
+void node_locations_t::read_snapshot(ram_snapshot_reader_t *reader)
+{
+    assert(reader);
+    assert(m_count == 0);
+
+    m_index.read_snapshot(reader);
+    m_data.read_snapshot(reader);
+    m_count = reader->read_value<uint64_t>();
+    m_did.update(reader->read_value<osmid_t>());
+    m_dx.update(reader->read_value<int64_t>());
+    m_dy.update(reader->read_value<int64_t>());
+}
@@ -12,6 +12,7 @@
 
 #include "ordered-index.hpp"
 #include "osmtypes.hpp"
+#include "segmented-buffer.hpp"
 
 #include <osmium/osm/location.hpp>
 #include <osmium/util/delta.hpp>
@@ -19,7 +20,9 @@
 #include <cstddef>
 #include <cstdint>
 #include <limits>
-#include <string>
+
+class ram_snapshot_reader_t;
+class ram_snapshot_writer_t;
 
 /**
  * Node locations storage. This implementation encodes ids and locations
@@ -29,7 +32,8 @@
  * Internally nodes are stored in blocks of `block_size` (id, location) pairs.
  * Ids inside a block and the x and y coordinates of each location are first
  * delta encoded and then stored as varints. To access a stored location the
- * block must be decoded until the id is found.
+ * block must be decoded until the id is found. Blocks never straddle segments
+ * of the underlying segmented buffer.
  *
  * Ids must be added in strictly ascending order.
  */
@@ -44,9 +48,7 @@ public:
      * specified here.
      */
     explicit node_locations_t(
-        std::size_t max_size = std::numeric_limits<std::size_t>::max())
-    : m_max_size(max_size)
-    {}
+        std::size_t max_size = std::numeric_limits<std::size_t>::max());
 
     /**
      * Store a node location.
@@ -68,7 +70,7 @@ public:
     /// Return the approximate number of bytes used for internal storage.
     std::size_t used_memory() const noexcept
     {
-        return m_data.capacity() + m_index.used_memory();
+        return m_data.used_memory() + m_index.used_memory();
     }
 
     /// Dump information about memory usage to debug log
@@ -80,6 +82,17 @@ public:
      */
     void clear();
 
+    /// Write the contents of this store to a RAM middle snapshot.
+    void write_snapshot(ram_snapshot_writer_t *writer) const;
+
+    /**
+     * Read the contents of this store from a RAM middle snapshot. More
+     * locations can be added after that.
+     *
+     * \pre The store must be empty.
+     */
+    void read_snapshot(ram_snapshot_reader_t *reader);
+
 private:
     /**
      * The block size used for internal blocks. The larger the block size
@@ -98,14 +111,21 @@ private:
         return 10UL /*max varint length*/ * 3UL /*id, x, y*/;
     }
 
+    /// The maximum number of bytes a block will need in storage.
+    constexpr static std::size_t max_bytes_per_block() noexcept
+    {
+        return BLOCK_SIZE * max_bytes_per_entry();
+    }
+
     bool will_resize() const noexcept
     {
-        return m_index.will_resize() ||
-               (m_data.size() + max_bytes_per_entry() >= m_data.capacity());
+        return first_entry_in_block() &&
+               (m_index.will_resize() ||
+                m_data.will_grow(max_bytes_per_block()));
     }
 
     ordered_index_t m_index;
-    std::string m_data;
+    segmented_buffer_t m_data;
 
     /// Maximum size in bytes this object may allocate.
     std::size_t m_max_size;
@@ -78,8 +78,17 @@ struct options_t
     /// Name of the flat node file used. Empty if flat node file is not enabled.
     std::string flat_node_file;
 
+    /// Name of the snapshot file for the RAM middle. Empty if not enabled.
+    std::string ram_snapshot_file;
+
     std::string tag_transform_script;
 
+    /// Name of the file metrics are written to. Empty if not enabled.
+    std::string metrics_file;
+
+    /// Name of the file the Lua profile is written to. Empty if not enabled.
+    std::string lua_profile_file;
+
     /// File name to output expired tiles list to
     std::string expire_tiles_filename{"dirty_tiles"};
 
@@ -107,6 +116,12 @@ struct options_t
 
     unsigned int num_procs = 1;
 
+    /// Memory budget in MB for the larger data structures (0 = no budget).
+    unsigned int memory_budget = 0;
+
+    /// Interval in seconds in which the metrics file is written.
+    unsigned int metrics_interval = 10;
+
     /**
      * Middle database format:
      * 0 = non-slim mode, no database middle (ram middle)
@@ -122,10 +137,14 @@ struct options_t
      */
     bool middle_with_nodes = false;
 
+    /// Compress OSM objects stored in the RAM middle.
+    bool ram_compress = false;
+
     /// add an additional hstore column with objects key/value pairs, and what type of hstore column
     hstore_column hstore_mode = hstore_column::none;
 
     bool append = false;                      ///< Append to existing data
+    bool rebuild_output = false;              ///< Rebuild output from middle
     bool slim = false;                        ///< In slim mode
     bool extra_attributes = false;
     bool keep_coastlines = false;
@@ -142,6 +161,7 @@ struct options_t
     bool reproject_area = false;
 
     bool parallel_indexing = true;
+    bool persistent = false; ///< Apply change files read from STDIN
     bool pass_prompt = false;
 }; // struct options_t
 
@@ -9,6 +9,8 @@
 
 #include "ordered-index.hpp"
 
+#include "ram-snapshot.hpp"
+
 #include <algorithm>
 #include <cassert>
 
@@ -70,3 +72,43 @@ ordered_index_t::get_internal(osmid_t id) const noexcept
 
     return {rit->from + it->id, rit->offset_from + it->offset};
 }
+
+void ordered_index_t::write_snapshot(ram_snapshot_writer_t *writer) const
+{
+    assert(writer);
+
+    writer->write_value<uint64_t>(m_block_size);
+    writer->write_value<uint64_t>(m_capacity);
+    writer->write_value<uint64_t>(m_size);
+    writer->write_value<uint64_t>(m_ranges.size());
+
+    for (auto const &range : m_ranges) {
+        writer->write_value<osmid_t>(range.from);
+        writer->write_value<osmid_t>(range.to);
+        writer->write_value<uint64_t>(range.offset_from);
+        writer->write_value<uint64_t>(range.index.capacity());
+        writer->write_vector(range.index);
+    }
+}
+
+void ordered_index_t::read_snapshot(ram_snapshot_reader_t *reader)
+{
+    assert(reader);
+    assert(m_ranges.empty());
+
+    m_block_size = reader->read_value<uint64_t>();
+    m_capacity = reader->read_value<uint64_t>();
+    m_size = reader->read_value<uint64_t>();
+
+    auto const num_ranges = reader->read_value<uint64_t>();
+    m_ranges.reserve(num_ranges);
+    for (std::size_t i = 0; i < num_ranges; ++i) {
+        auto const from = reader->read_value<osmid_t>();
+        auto const to = reader->read_value<osmid_t>();
+        auto const offset_from = reader->read_value<uint64_t>();
+        auto const capacity = reader->read_value<uint64_t>();
+        auto &range = m_ranges.emplace_back(from, offset_from, capacity);
+        range.to = to;
+        reader->read_vector(&range.index);
+    }
+}
@@ -18,6 +18,9 @@
 #include <utility>
 #include <vector>
 
+class ram_snapshot_reader_t;
+class ram_snapshot_writer_t;
+
 /**
  * This class implements a memory-efficient ordered index for lookups from OSM
  * ids to an "offset" into some kind of primary datastore. Adding to the index
@@ -153,6 +156,16 @@ public:
     /// Return true if adding an entry to the index will make it resize.
     bool will_resize() const noexcept { return m_size + 1 >= m_capacity; }
 
+    /// Write the contents of this index to a RAM middle snapshot.
+    void write_snapshot(ram_snapshot_writer_t *writer) const;
+
+    /**
+     * Read the contents of this index from a RAM middle snapshot.
+     *
+     * \pre The index must be empty.
+     */
+    void read_snapshot(ram_snapshot_reader_t *reader);
+
 private:
     struct second_level_index_entry
     {
@@ -10,6 +10,8 @@
 #include "command-line-parser.hpp"
 #include "input.hpp"
 #include "logging.hpp"
+#include "memory-budget.hpp"
+#include "metrics.hpp"
 #include "middle.hpp"
 #include "options.hpp"
 #include "osmdata.hpp"
@@ -22,8 +24,10 @@
 
 #include <osmium/util/memory.hpp>
 
+#include <chrono>
 #include <exception>
 #include <filesystem>
+#include <iostream>
 #include <memory>
 #include <string>
 #include <utility>
@@ -37,6 +41,8 @@ namespace {
  */
 void show_memory_usage()
 {
+    get_memory_budget().log_usage();
+
     osmium::MemoryUsage const mem;
     if (mem.peak() != 0) {
         log_debug("Overall memory usage: peak={}MByte current={}MByte",
@@ -82,6 +88,122 @@ file_info run(options_t const &options, properties_t *properties)
     return finfo;
 }
 
+void update_current_timestamp(properties_t *properties,
+                              file_info const &finfo)
+{
+    if (!finfo.last_timestamp.valid()) {
+        return;
+    }
+
+    auto const current_timestamp =
+        properties->get_string("current_timestamp", "");
+
+    if (current_timestamp.empty() ||
+        (finfo.last_timestamp > osmium::Timestamp{current_timestamp})) {
+        properties->set_string("current_timestamp",
+                               finfo.last_timestamp.to_iso());
+    }
+}
+
+/**
+ * Persistent mode: Read names of change files from STDIN, one per line, and
+ * apply them one after the other. The middle, the output (including its
+ * clones, Lua states, id caches, prepared statements, and database
+ * connections) and the thread pool are only set up once and kept around
+ * until STDIN is closed.
+ */
+void run_persistent(options_t const &options, properties_t *properties)
+{
+    auto thread_pool = std::make_shared<thread_pool_t>(
+        options.parallel_indexing ? options.num_procs : 1U);
+    log_debug("Started pool with {} threads.", thread_pool->num_threads());
+
+    auto middle = create_middle(thread_pool, options);
+    middle->start();
+
+    auto output = output_t::create_output(middle->get_query_instance(),
+                                          thread_pool, options, *properties);
+
+    middle->set_requirements(output->get_requirements());
+
+    osmdata_t osmdata{middle, output, options};
+
+    log_info("Waiting for names of change files on STDIN...");
+
+    std::size_t num_files = 0;
+    std::string filename;
+    while (std::getline(std::cin, filename)) {
+        if (filename.empty()) {
+            continue;
+        }
+
+        util::timer_t timer;
+        log_info("Processing change file '{}'...", filename);
+
+        auto const files = prepare_input_files({filename},
+                                               options.input_format, true);
+
+        if (num_files > 0) {
+            osmdata.start_round();
+        }
+        ++num_files;
+
+        auto const finfo = process_files(files, &osmdata, true,
+                                         get_logger().show_progress());
+        osmdata.finish_round();
+
+        update_current_timestamp(properties, finfo);
+        properties->store();
+
+        show_memory_usage();
+        log_info("Processing change file '{}' took {}.", filename,
+                 util::human_readable_duration(timer.stop()));
+    }
+
+    if (num_files == 0) {
+        // Nothing was read, but we still have to go through all the stages
+        // to shut down properly.
+        process_files({}, &osmdata, true, false);
+    }
+
+    log_info("Applied {} change files.", num_files);
+
+    osmdata.stop();
+}
+
+/**
+ * Rebuild the output tables from the data in the middle. The middle is
+ * used in append mode (so its tables are kept as they are), the output
+ * in create mode.
+ */
+void run_rebuild_output(options_t const &options, properties_t *properties)
+{
+    auto thread_pool = std::make_shared<thread_pool_t>(
+        options.parallel_indexing ? options.num_procs : 1U);
+    log_debug("Started pool with {} threads.", thread_pool->num_threads());
+
+    options_t middle_options{options};
+    middle_options.append = true;
+
+    auto middle = create_middle(thread_pool, middle_options);
+    middle->start();
+
+    auto output = output_t::create_output(middle->get_query_instance(),
+                                          thread_pool, options, *properties);
+
+    middle->set_requirements(output->get_requirements());
+
+    osmdata_t osmdata{middle, output, options};
+
+    osmdata.process_middle();
+
+    show_memory_usage();
+
+    // Process marked objects (stage 2). Cluster database tables and create
+    // indexes.
+    osmdata.stop();
+}
+
 void check_db(options_t const &options)
 {
     pg_conn_t const db_connection{options.connection_params, "check"};
@@ -345,12 +467,25 @@ int main(int argc, char *argv[])
 
         util::timer_t timer_overall;
 
+        get_memory_budget().set_limit(std::size_t{options.memory_budget} *
+                                      1024UL * 1024UL);
+
+        std::unique_ptr<metrics::file_writer_t> metrics_writer;
+        if (!options.metrics_file.empty()) {
+            // Memory use is part of the metrics, so track it even if
+            // there is no memory budget.
+            get_memory_budget().enable_accounting();
+            metrics_writer = std::make_unique<metrics::file_writer_t>(
+                options.metrics_file,
+                std::chrono::seconds{options.metrics_interval});
+        }
+
         check_db(options);
 
         properties_t properties{options.connection_params,
                                 options.middle_dbschema};
 
-        if (options.append) {
+        if (options.append || options.rebuild_output) {
             if (!properties.load()) {
                 throw std::runtime_error{
                     "Did not find table 'osm2pgsql_properties' in database. "
@@ -360,18 +495,13 @@ int main(int argc, char *argv[])
             check_and_update_properties(&properties, &options);
             properties.store();
 
-            auto const finfo = run(options, &properties);
-
-            if (finfo.last_timestamp.valid()) {
-                auto const current_timestamp =
-                    properties.get_string("current_timestamp", "");
-
-                if (current_timestamp.empty() ||
-                    (finfo.last_timestamp >
-                     osmium::Timestamp{current_timestamp})) {
-                    properties.set_string("current_timestamp",
-                                          finfo.last_timestamp.to_iso());
-                }
+            if (options.rebuild_output) {
+                run_rebuild_output(options, &properties);
+            } else if (options.persistent) {
+                run_persistent(options, &properties);
+            } else {
+                auto const finfo = run(options, &properties);
+                update_current_timestamp(&properties, finfo);
             }
         } else {
             set_option_defaults(&options);
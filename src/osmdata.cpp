@@ -7,18 +7,22 @@
  * For a full list of authors see the git log.
  */
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
 #include <functional>
 #include <future>
 #include <memory>
 #include <mutex>
+#include <string_view>
 #include <utility>
 #include <vector>
 
 #include "db-copy.hpp"
 #include "format.hpp"
 #include "logging.hpp"
+#include "metrics.hpp"
 #include "middle.hpp"
 #include "options.hpp"
 #include "osmdata.hpp"
@@ -30,15 +34,43 @@ osmdata_t::osmdata_t(std::shared_ptr<middle_t> mid,
 : m_mid(std::move(mid)), m_output(std::move(output)),
   m_connection_params(options.connection_params), m_bbox(options.bbox),
   m_num_procs(options.num_procs), m_append(options.append),
-  m_droptemp(options.droptemp)
+  m_droptemp(options.droptemp),
+  m_defer_relations(!options.append && options.slim &&
+                    options.num_procs > 1 && options.extra_attributes)
 {
     assert(m_mid);
     assert(m_output);
     m_output->start();
 }
 
+osmdata_t::~osmdata_t() = default;
+
+namespace {
+
+/// Number of ids sent to the middle at once when looking up parents.
+constexpr std::size_t PARENTS_CHUNK_SIZE = 1024UL * 1024UL;
+
+metrics::counter_t &objects_counter(std::string_view type)
+{
+    return metrics::counter("osm2pgsql_objects_total",
+                            "Number of OSM objects read from the input.",
+                            metrics::label("type", type));
+}
+
+metrics::counter_t &phase_counter(std::string_view phase)
+{
+    return metrics::time_counter("osm2pgsql_phase_seconds_total",
+                                 "Time spent in processing phases.",
+                                 metrics::label("phase", phase));
+}
+
+} // anonymous namespace
+
 void osmdata_t::node(osmium::Node const &node)
 {
+    static auto &counter = objects_counter("node");
+    counter.add();
+
     if (node.visible()) {
         if (!node.location().valid()) {
             log_warn("Ignored node {} (version {}) with invalid location.",
@@ -82,15 +114,35 @@ void osmdata_t::after_nodes()
     }
 
     if (!m_changed_nodes.empty()) {
-        m_mid->get_node_parents(m_changed_nodes, &m_ways_pending_tracker,
-                                &m_rels_pending_tracker);
+        m_changed_nodes.sort_unique();
+        m_changed_nodes.for_each_chunk(
+            PARENTS_CHUNK_SIZE, [&](idlist_t const &changed_nodes) {
+                idlist_t parent_ways;
+                idlist_t parent_relations;
+                m_mid->get_node_parents(changed_nodes, &parent_ways,
+                                        &parent_relations);
+                m_ways_pending_tracker.add(parent_ways);
+                m_rels_pending_tracker.add(parent_relations);
+            });
         m_changed_nodes.clear();
-        m_changed_nodes.shrink_to_fit();
     }
 }
 
+void osmdata_t::get_way_parents(external_id_set_t const &changed_ways)
+{
+    changed_ways.for_each_chunk(
+        PARENTS_CHUNK_SIZE, [&](idlist_t const &ways) {
+            idlist_t parent_relations;
+            m_mid->get_way_parents(ways, &parent_relations);
+            m_rels_pending_tracker.add(parent_relations);
+        });
+}
+
 void osmdata_t::way(osmium::Way &way)
 {
+    static auto &counter = objects_counter("way");
+    counter.add();
+
     m_mid->way(way);
 
     if (way.deleted()) {
@@ -122,7 +174,10 @@ void osmdata_t::after_ways()
         return;
     }
 
+    m_ways_pending_tracker.sort_unique();
+
     if (!m_changed_ways.empty()) {
+        m_changed_ways.sort_unique();
         if (!m_ways_pending_tracker.empty()) {
             // Remove ids from changed ways in the input data from
             // m_ways_pending_tracker, because they have already been
@@ -134,20 +189,22 @@ void osmdata_t::after_ways()
             m_changed_ways.merge_sorted(m_ways_pending_tracker);
         }
 
-        m_mid->get_way_parents(m_changed_ways, &m_rels_pending_tracker);
+        get_way_parents(m_changed_ways);
 
         m_changed_ways.clear();
-        m_changed_ways.shrink_to_fit();
         return;
     }
 
     if (!m_ways_pending_tracker.empty()) {
-        m_mid->get_way_parents(m_ways_pending_tracker, &m_rels_pending_tracker);
+        get_way_parents(m_ways_pending_tracker);
     }
 }
 
 void osmdata_t::relation(osmium::Relation const &rel)
 {
+    static auto &counter = objects_counter("relation");
+    counter.add();
+
     if (rel.members().size() > 32767) {
         log_warn(
             "Relation id {} ignored, because it has more than 32767 members",
@@ -169,30 +226,11 @@ void osmdata_t::relation(osmium::Relation const &rel)
     if (m_append) {
         m_output->relation_modify(rel);
         m_changed_relations.push_back(rel.id());
-    } else {
+    } else if (!m_defer_relations) {
         m_output->relation_add(rel);
     }
 }
 
-void osmdata_t::after_relations()
-{
-    m_mid->after_relations();
-    m_output->after_relations();
-
-    if (m_append) {
-        // Remove ids from changed relations in the input data from
-        // m_rels_pending_tracker, because they have already been processed.
-        m_rels_pending_tracker.remove_ids_if_in(m_changed_relations);
-
-        m_changed_relations.clear();
-        m_changed_relations.shrink_to_fit();
-    }
-
-    m_output->sync();
-}
-
-namespace {
-
 /**
  * After all objects in a change file have been processed, all objects
  * depending on the changed objects must also be processed. This class
@@ -217,52 +255,184 @@ public:
             auto copy_thread =
                 std::make_shared<db_copy_thread_t>(connection_params);
             m_clones.push_back(m_output->clone(midq, copy_thread));
+            m_middle_queries.push_back(midq);
         }
     }
 
     /**
-     * Process all ways in the list.
+     * Process all ways in the set.
      *
-     * \param list List of way ids to work on. The list is moved into the
-     *             function.
+     * \param ids Set of way ids to work on. The ids are streamed from the
+     *            set to the worker threads.
      */
-    void process_ways(idlist_t &&list)
+    void process_ways(external_id_set_t *ids)
     {
-        process_queue("way", std::move(list), &output_t::pending_way);
+        process_queue("way", ids, &output_t::pending_way);
     }
 
     /**
-     * Process all relations in the list.
+     * Process all relations in the set.
      *
-     * \param list List of relation ids to work on. The list is moved into the
-     *             function.
+     * \param ids Set of relation ids to work on. The ids are streamed from
+     *            the set to the worker threads.
      */
-    void process_relations(idlist_t &&list)
+    void process_relations(external_id_set_t *ids)
     {
-        process_queue("relation", std::move(list), &output_t::pending_relation);
+        process_queue("relation", ids, &output_t::pending_relation);
     }
 
     /**
-     * Process all relations in the list in stage1c.
+     * Process all relations in the set in stage1c.
      *
-     * \param list List of relation ids to work on. The list is moved into the
-     *             function.
+     * \param ids Set of relation ids to work on. The ids are streamed from
+     *            the set to the worker threads.
+     */
+    void process_relations_stage1c(external_id_set_t *ids)
+    {
+        process_queue("relation", ids, &output_t::pending_relation_stage1c);
+    }
+
+    /**
+     * Process all objects of the specified type stored in the middle. The
+     * id space is split into ranges which are read from the middle and
+     * processed by the worker threads.
      */
-    void process_relations_stage1c(idlist_t &&list)
+    void process_from_middle(osmium::item_type type)
     {
-        process_queue("relation", std::move(list),
-                      &output_t::pending_relation_stage1c);
+        auto const [min_id, max_id] =
+            m_middle_queries.front()->get_id_range(type);
+        if (min_id == 0 && max_id == 0) {
+            log_info("No {}s in middle.", osmium::item_type_to_name(type));
+            return;
+        }
+
+        std::vector<id_range_t> ranges;
+        auto const range_size = middle_range_size(type);
+        for (osmid_t from = min_id; from <= max_id; from += range_size) {
+            ranges.push_back({from, std::min(from + range_size, max_id + 1)});
+        }
+        // Ranges are taken from the back, so reverse to process them in
+        // order of increasing ids.
+        std::reverse(ranges.begin(), ranges.end());
+
+        util::timer_t timer;
+
+        log_info("Processing {}s with ids {} to {} from middle in {} ranges "
+                 "(using {} threads)",
+                 osmium::item_type_to_name(type), min_id, max_id,
+                 ranges.size(), m_clones.size());
+
+        std::atomic<std::size_t> count{0};
+
+        std::vector<std::future<void>> workers;
+        workers.reserve(m_clones.size());
+        for (std::size_t i = 0; i < m_clones.size(); ++i) {
+            workers.push_back(std::async(
+                std::launch::async, run_ranges, std::cref(m_clones[i]),
+                std::cref(*m_middle_queries[i]), type, &ranges, &m_mutex,
+                &count));
+        }
+
+        for (auto &worker : workers) {
+            try {
+                worker.get();
+            } catch (...) {
+                // Drain the queue, so that the other workers finish early.
+                m_mutex.lock();
+                ranges.clear();
+                m_mutex.unlock();
+                throw;
+            }
+        }
+
+        timer.stop();
+
+        log_info("Processing {} {}s from middle took {} at a rate of {:.2f}/s",
+                 count.load(), osmium::item_type_to_name(type),
+                 util::human_readable_duration(timer.elapsed()),
+                 timer.per_second(count.load()));
     }
 
 private:
-    /// Get the next id from the queue.
-    static osmid_t pop_id(idlist_t *queue, std::mutex *mutex)
+    struct id_range_t
+    {
+        osmid_t from;
+        osmid_t to;
+    };
+
+    /**
+     * The number of ids in each range read from the middle. Ranges are
+     * chosen so that each range contains a decent number of objects given
+     * the typical id density in OSM data.
+     */
+    static osmid_t middle_range_size(osmium::item_type type) noexcept
+    {
+        switch (type) {
+        case osmium::item_type::node:
+            return 1000000;
+        case osmium::item_type::way:
+            return 100000;
+        default:
+            return 10000;
+        }
+    }
+
+    /// Get the next range from the queue. Returns false if there is none.
+    static bool pop_range(std::vector<id_range_t> *queue, std::mutex *mutex,
+                          id_range_t *range)
+    {
+        std::lock_guard<std::mutex> const lock{*mutex};
+        if (queue->empty()) {
+            return false;
+        }
+        *range = queue->back();
+        queue->pop_back();
+        return true;
+    }
+
+    /**
+     * Runs in the worker threads: As long as there are any, get ranges from
+     * the queue, read all objects in that range from the middle and let the
+     * output process them.
+     */
+    static void run_ranges(std::shared_ptr<output_t> const &output,
+                           middle_query_t const &mid, osmium::item_type type,
+                           std::vector<id_range_t> *queue, std::mutex *mutex,
+                           std::atomic<std::size_t> *count)
+    {
+        osmium::memory::Buffer buffer{1024UL * 1024UL,
+                                      osmium::memory::Buffer::auto_grow::yes};
+        id_range_t range{};
+        while (pop_range(queue, mutex, &range)) {
+            *count += mid.get_objects_in_range(type, range.from, range.to,
+                                               &buffer);
+            for (auto &object : buffer.select<osmium::OSMObject>()) {
+                switch (type) {
+                case osmium::item_type::node:
+                    output->node_add(static_cast<osmium::Node &>(object));
+                    break;
+                case osmium::item_type::way:
+                    output->way_add(static_cast<osmium::Way *>(&object));
+                    break;
+                default:
+                    output->relation_add(
+                        static_cast<osmium::Relation &>(object));
+                }
+            }
+            buffer.clear();
+        }
+        output->sync();
+    }
+
+    /// Get the next id from the queue. Returns 0 if there is none.
+    static osmid_t pop_id(external_id_set_t::reader_t *queue,
+                          std::mutex *mutex)
     {
         osmid_t id = 0;
 
         std::lock_guard<std::mutex> const lock{*mutex};
-        if (!queue->empty()) {
-            id = queue->pop_id();
+        if (!queue->next(&id)) {
+            id = 0;
         }
 
         return id;
@@ -275,8 +445,9 @@ private:
      * Runs in the worker threads: As long as there are any, get ids from
      * the queue and let the output process it by calling "func".
      */
-    static void run(std::shared_ptr<output_t> const &output, idlist_t *queue,
-                    std::mutex *mutex, output_member_fn_ptr func)
+    static void run(std::shared_ptr<output_t> const &output,
+                    external_id_set_t::reader_t *queue, std::mutex *mutex,
+                    output_member_fn_ptr func)
     {
         while (osmid_t const id = pop_id(queue, mutex)) {
             (output.get()->*func)(id);
@@ -285,12 +456,13 @@ private:
     }
 
     /// Runs in a worker thread: Update progress display once per second.
-    static void print_stats(idlist_t *queue, std::mutex *mutex)
+    static void print_stats(external_id_set_t::reader_t *queue,
+                            std::size_t ids_queued, std::mutex *mutex)
     {
         std::size_t queue_size = 0;
         do {
             mutex->lock();
-            queue_size = queue->size();
+            queue_size = ids_queued - queue->count();
             mutex->unlock();
 
             if (get_logger().show_progress()) {
@@ -301,10 +473,12 @@ private:
         } while (queue_size > 0);
     }
 
-    void process_queue(char const *type, idlist_t list,
+    void process_queue(char const *type, external_id_set_t *ids,
                        output_member_fn_ptr function)
     {
-        auto const ids_queued = list.size();
+        ids->sort_unique();
+        auto const ids_queued = ids->size();
+        auto queue = ids->reader();
 
         util::timer_t timer;
 
@@ -313,7 +487,8 @@ private:
             // when only few items need to be processed.
             log_info("Going over {} pending {}s", ids_queued, type);
 
-            for (auto const oid : list) {
+            osmid_t oid = 0;
+            while (queue.next(&oid)) {
                 (m_clones[0].get()->*function)(oid);
             }
             m_clones[0]->sync();
@@ -325,11 +500,11 @@ private:
             workers.reserve(m_clones.size() + 1);
             for (auto const &clone : m_clones) {
                 workers.push_back(std::async(std::launch::async, run,
-                                             std::cref(clone), &list, &m_mutex,
-                                             function));
+                                             std::cref(clone), &queue,
+                                             &m_mutex, function));
             }
-            workers.push_back(
-                std::async(std::launch::async, print_stats, &list, &m_mutex));
+            workers.push_back(std::async(std::launch::async, print_stats,
+                                         &queue, ids_queued, &m_mutex));
 
             for (auto &worker : workers) {
                 try {
@@ -337,7 +512,7 @@ private:
                 } catch (...) {
                     // Drain the queue, so that the other workers finish early.
                     m_mutex.lock();
-                    list.clear();
+                    queue.finish();
                     m_mutex.unlock();
                     throw;
                 }
@@ -359,6 +534,9 @@ private:
     /// Clones of output, one clone per thread.
     std::vector<std::shared_ptr<output_t>> m_clones;
 
+    /// Middle query instances used by the clones.
+    std::vector<std::shared_ptr<middle_query_t>> m_middle_queries;
+
     /// The output.
     std::shared_ptr<output_t> m_output;
 
@@ -366,23 +544,48 @@ private:
     std::mutex m_mutex;
 };
 
-} // anonymous namespace
+multithreaded_processor_t &osmdata_t::processor()
+{
+    if (!m_processor) {
+        m_processor = std::make_unique<multithreaded_processor_t>(
+            m_connection_params, m_mid, m_output, m_num_procs);
+    }
+    return *m_processor;
+}
 
-void osmdata_t::process_dependents()
+void osmdata_t::after_relations()
 {
-    multithreaded_processor_t proc{m_connection_params, m_mid, m_output,
-                                   m_num_procs};
+    m_mid->after_relations();
+
+    if (m_defer_relations) {
+        processor().process_from_middle(osmium::item_type::relation);
+    }
+
+    m_output->after_relations();
+
+    if (m_append) {
+        // Remove ids from changed relations in the input data from
+        // m_rels_pending_tracker, because they have already been processed.
+        m_rels_pending_tracker.sort_unique();
+        m_changed_relations.sort_unique();
+        m_rels_pending_tracker.remove_ids_if_in(m_changed_relations);
+
+        m_changed_relations.clear();
+    }
 
+    m_output->sync();
+}
+
+void osmdata_t::process_dependents()
+{
     // stage 1b processing: process parents of changed objects
-    if (!m_ways_pending_tracker.empty() || !m_rels_pending_tracker.empty()) {
-        if (!m_ways_pending_tracker.empty()) {
-            m_ways_pending_tracker.sort_unique();
-            proc.process_ways(std::move(m_ways_pending_tracker));
-        }
-        if (!m_rels_pending_tracker.empty()) {
-            m_rels_pending_tracker.sort_unique();
-            proc.process_relations(std::move(m_rels_pending_tracker));
-        }
+    if (!m_ways_pending_tracker.empty()) {
+        processor().process_ways(&m_ways_pending_tracker);
+        m_ways_pending_tracker.clear();
+    }
+    if (!m_rels_pending_tracker.empty()) {
+        processor().process_relations(&m_rels_pending_tracker);
+        m_rels_pending_tracker.clear();
     }
 
     // stage 1c processing: mark parent relations of marked objects as changed
@@ -393,28 +596,69 @@ void osmdata_t::process_dependents()
     }
 
     // process parent relations of marked nodes and ways
-    idlist_t rels_pending_tracker{};
-    m_mid->get_node_parents(marked_nodes, nullptr, &rels_pending_tracker);
-    m_mid->get_way_parents(marked_ways, &rels_pending_tracker);
+    idlist_t parent_relations{};
+    m_mid->get_node_parents(marked_nodes, nullptr, &parent_relations);
+    m_mid->get_way_parents(marked_ways, &parent_relations);
 
-    if (rels_pending_tracker.empty()) {
+    if (parent_relations.empty()) {
         return;
     }
 
-    rels_pending_tracker.sort_unique();
-    proc.process_relations_stage1c(std::move(rels_pending_tracker));
+    external_id_set_t rels_pending_tracker;
+    rels_pending_tracker.add(parent_relations);
+    processor().process_relations_stage1c(&rels_pending_tracker);
+}
+
+void osmdata_t::process_middle()
+{
+    processor().process_from_middle(osmium::item_type::node);
+    m_mid->after_nodes();
+    m_output->after_nodes();
+
+    processor().process_from_middle(osmium::item_type::way);
+    m_mid->after_ways();
+    m_output->after_ways();
+
+    processor().process_from_middle(osmium::item_type::relation);
+    m_mid->after_relations();
+    m_output->after_relations();
+
+    m_output->sync();
+}
+
+void osmdata_t::start_round()
+{
+    m_mid->start_round();
+    m_output->start_round();
+}
+
+void osmdata_t::finish_round()
+{
+    assert(m_append);
+    process_dependents();
+    m_output->reprocess_marked();
+    m_output->finish_round();
 }
 
 void osmdata_t::stop()
 {
     if (m_append) {
+        metrics::scoped_timer_t const timer{&phase_counter("dependents")};
         process_dependents();
     }
 
+    // The output clones used for processing dependents are not needed any
+    // more. This also closes their database connections.
+    m_processor.reset();
+
     // Run stage 2 processing: Reprocess objects marked in stage 1 (if any).
-    m_output->reprocess_marked();
+    {
+        metrics::scoped_timer_t const timer{&phase_counter("stage2")};
+        m_output->reprocess_marked();
+    }
 
     // Run postprocessing on database: Clustering and index creation.
+    metrics::scoped_timer_t const timer{&phase_counter("postprocessing")};
     m_output->free_middle_references();
 
     if (m_droptemp) {
@@ -23,11 +23,13 @@
 #include <osmium/handler.hpp>
 #include <osmium/osm/box.hpp>
 
+#include "external-id-set.hpp"
 #include "idlist.hpp"
 #include "osmtypes.hpp"
 #include "pgsql-params.hpp"
 
 class middle_t;
+class multithreaded_processor_t;
 class output_t;
 struct options_t;
 
@@ -44,6 +46,14 @@ public:
     osmdata_t(std::shared_ptr<middle_t> mid, std::shared_ptr<output_t> output,
               options_t const &options);
 
+    osmdata_t(osmdata_t const &) = delete;
+    osmdata_t &operator=(osmdata_t const &) = delete;
+
+    osmdata_t(osmdata_t &&) = delete;
+    osmdata_t &operator=(osmdata_t &&) = delete;
+
+    ~osmdata_t();
+
     void node(osmium::Node const &node);
     void way(osmium::Way &way);
     void relation(osmium::Relation const &rel);
@@ -58,24 +68,54 @@ public:
      */
     void stop();
 
+    /**
+     * Process all objects stored in the middle with the output instead of
+     * reading them from input files. This replaces reading the input files
+     * (stage 1a), it must be followed by a call to stop().
+     */
+    void process_middle();
+
+    /**
+     * Used in persistent mode: Prepare for reading the next change file.
+     */
+    void start_round();
+
+    /**
+     * Used in persistent mode: Run stages 1b, 1c, and 2 after a change file
+     * was read, but keep everything around for the next change file. The
+     * final call to stop() is still needed at the end.
+     */
+    void finish_round();
+
     // These getters are needed only for tests
-    idlist_t const &get_pending_way_ids() const noexcept
+    idlist_t get_pending_way_ids() const
     {
-        return m_ways_pending_tracker;
+        return m_ways_pending_tracker.to_idlist();
     }
 
-    idlist_t const &get_pending_relation_ids() const noexcept
+    idlist_t get_pending_relation_ids() const
     {
-        return m_rels_pending_tracker;
+        return m_rels_pending_tracker.to_idlist();
     }
 
 private:
+    /**
+     * Add parent relations of the ways in the set to the pending relations.
+     */
+    void get_way_parents(external_id_set_t const &changed_ways);
+
     /**
      * Run stage 1b and stage 1c processing: Process dependent objects in
      * append mode.
      */
     void process_dependents();
 
+    /**
+     * Get the processor for dependent objects. It is created on first use
+     * and kept around until stop() is called.
+     */
+    multithreaded_processor_t &processor();
+
     /**
      * In append mode all new and changed nodes will be added to this. After
      * all nodes are read this is used to figure out which parent ways and
@@ -83,8 +123,11 @@ private:
      * because all ways and relations that referenced deleted nodes must be in
      * the change file, too, and so we don't have to find out which ones they
      * are.
+     *
+     * This and the other id sets below can get very large when applying
+     * big change files, so they are written to disk if needed.
      */
-    idlist_t m_changed_nodes;
+    external_id_set_t m_changed_nodes;
 
     /**
      * In append mode all new and changed ways will be added to this. After
@@ -93,21 +136,23 @@ private:
      * relations that referenced deleted ways must be in the change file, too,
      * and so we don't have to find out which ones they are.
      */
-    idlist_t m_changed_ways;
+    external_id_set_t m_changed_ways;
 
     /**
      * In append mode all new and changed relations will be added to this.
      * This is then used to remove already processed relations from the
      * pending list.
      */
-    idlist_t m_changed_relations;
+    external_id_set_t m_changed_relations;
 
-    idlist_t m_ways_pending_tracker;
-    idlist_t m_rels_pending_tracker;
+    external_id_set_t m_ways_pending_tracker;
+    external_id_set_t m_rels_pending_tracker;
 
     std::shared_ptr<middle_t> m_mid;
     std::shared_ptr<output_t> m_output;
 
+    std::unique_ptr<multithreaded_processor_t> m_processor;
+
     connection_params_t m_connection_params;
 
     // Bounding box for node import (or invalid Box if everything should be
@@ -117,6 +162,16 @@ private:
     unsigned int m_num_procs;
     bool m_append;
     bool m_droptemp;
+
+    /**
+     * Relations are not handed to the output while reading the input, but
+     * processed from the middle in parallel after all relations are read.
+     * Used on import in slim mode with more than one thread. Only done if
+     * the attributes are stored in the middle, otherwise they would be
+     * missing in the relations read back. Note that the tags of those
+     * relations come back from the middle sorted by key.
+     */
+    bool m_defer_relations;
 };
 
 #endif // OSM2PGSQL_OSMDATA_HPP
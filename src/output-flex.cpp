@@ -23,12 +23,16 @@
 #include "geom-from-osm.hpp"
 #include "logging.hpp"
 #include "lua-init.hpp"
+#include "lua-profiler.hpp"
 #include "lua-setup.hpp"
 #include "lua-utils.hpp"
+#include "memory-budget.hpp"
+#include "metrics.hpp"
 #include "middle.hpp"
 #include "options.hpp"
 #include "osmtypes.hpp"
 #include "pgsql-capabilities.hpp"
+#include "pgsql-helper.hpp"
 #include "pgsql.hpp"
 #include "projection.hpp"
 #include "properties.hpp"
@@ -37,6 +41,7 @@
 #include "util.hpp"
 #include "wkb.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
@@ -53,6 +58,25 @@ namespace {
 // Mutex used to coordinate access to Lua code
 std::mutex lua_mutex;
 
+// Lock the Lua mutex and record how long we had to wait for it.
+std::unique_lock<std::mutex> lock_lua()
+{
+    static auto &wait_time = metrics::time_counter(
+        "osm2pgsql_lua_lock_wait_seconds_total",
+        "Time spent waiting for access to the Lua interpreter.");
+
+    metrics::scoped_timer_t const timer{&wait_time};
+    return std::unique_lock<std::mutex>{lua_mutex};
+}
+
+// Update the memory accounting for the Lua interpreter.
+void update_lua_memory(lua_State *lua_state)
+{
+    static auto &consumer = get_memory_budget().consumer("Lua");
+    consumer.set(static_cast<std::size_t>(lua_gc(lua_state, LUA_GCCOUNT, 0)) *
+                 1024UL);
+}
+
 // Lua can't call functions on C++ objects directly. This macro defines simple
 // C "trampoline" functions which are called from Lua which get the current
 // context (the output_flex_t object) and call the respective function on the
@@ -104,6 +128,14 @@ prepared_lua_function_t::prepared_lua_function_t(lua_State *lua_state,
         m_name = name;
         m_nresults = nresults;
         m_calling_context = context;
+
+        auto const labels = metrics::label("function", name);
+        m_calls = &metrics::counter("osm2pgsql_lua_calls_total",
+                                    "Number of calls to Lua callbacks.",
+                                    labels);
+        m_time = &metrics::time_counter("osm2pgsql_lua_seconds_total",
+                                        "Time spent in Lua callbacks.",
+                                        labels);
         return;
     }
 
@@ -276,6 +308,40 @@ void flush_tables(std::vector<table_connection_t> &table_connections)
     }
 }
 
+/**
+ * Load all ids from the id column of a table into an id cache. The ids are
+ * read in binary format through a cursor in chunks, so they never have to
+ * be in memory all at once in uncompressed form.
+ */
+void load_id_cache(pg_conn_t const &db_connection, flex_table_t const &table,
+                   id_cache_t *cache)
+{
+    constexpr std::size_t CHUNK_SIZE = 5'000'000;
+
+    db_connection.exec("BEGIN");
+    db_connection.exec("DECLARE id_cache_cursor BINARY CURSOR FOR"
+                       " SELECT \"{}\"::int8 FROM {}",
+                       table.id_column_names(), table.full_name());
+
+    while (true) {
+        auto const result =
+            db_connection.exec("FETCH {} FROM id_cache_cursor", CHUNK_SIZE);
+        if (result.num_tuples() == 0) {
+            break;
+        }
+
+        idlist_t ids;
+        ids.reserve(static_cast<std::size_t>(result.num_tuples()));
+        for (int i = 0; i < result.num_tuples(); ++i) {
+            ids.push_back(decode_binary_int8(result.get_value(i, 0)));
+        }
+        cache->add_from_source(std::move(ids));
+    }
+
+    db_connection.exec("CLOSE id_cache_cursor");
+    db_connection.exec("COMMIT");
+}
+
 void create_expire_tables(std::vector<expire_output_t> const &expire_outputs,
                           connection_params_t const &connection_params)
 {
@@ -581,6 +647,13 @@ int output_flex_t::app_as_multipolygon()
         return 1;
     }
 
+    auto const *multipolygon = m_relation_cache.multipolygon();
+    if (multipolygon) {
+        auto *geom = create_lua_geometry_object(lua_state());
+        *geom = *multipolygon;
+        return 1;
+    }
+
     m_relation_cache.add_members(middle());
 
     auto *geom = create_lua_geometry_object(lua_state());
@@ -694,6 +767,7 @@ bool output_flex_t::relation_cache_t::init(middle_query_t const &middle,
 {
     m_relation_buffer.clear();
     m_members_buffer.clear();
+    m_has_multipolygon = false;
 
     if (!middle.relation_get(id, &m_relation_buffer)) {
         return false;
@@ -706,6 +780,7 @@ void output_flex_t::relation_cache_t::init(osmium::Relation const &relation)
 {
     m_relation_buffer.clear();
     m_members_buffer.clear();
+    m_has_multipolygon = false;
 
     m_relation = &relation;
 }
@@ -735,6 +810,15 @@ bool output_flex_t::relation_cache_t::add_members(middle_query_t const &middle)
     return true;
 }
 
+void output_flex_t::relation_cache_t::add_multipolygon(
+    middle_query_t const &middle, osmium::memory::Buffer *area_buffer)
+{
+    add_members(middle);
+    geom::create_multipolygon(&m_multipolygon, *m_relation, m_members_buffer,
+                              area_buffer);
+    m_has_multipolygon = true;
+}
+
 osmium::OSMObject const *
 output_flex_t::check_and_get_context_object(flex_table_t const &table)
 {
@@ -763,6 +847,17 @@ output_flex_t::check_and_get_context_object(flex_table_t const &table)
     return nullptr;
 }
 
+std::size_t output_flex_t::get_tile_partition(flex_table_t const &table)
+{
+    lua_getfield(lua_state(), -1, table.geom_column().name().c_str());
+    auto const *const geom = lua_type(lua_state(), -1) == LUA_TUSERDATA
+                                 ? unpack_geometry(lua_state(), -1)
+                                 : nullptr;
+    auto const partition = geom ? table.tile_partition(*geom) : 0;
+    lua_pop(lua_state(), 1);
+    return partition;
+}
+
 int output_flex_t::table_insert()
 {
     if (m_disable_insert) {
@@ -795,7 +890,7 @@ int output_flex_t::table_insert()
     osmid_t const id = object ? table.map_id(objtype, object->id()) : 0;
 
     if (object && table.with_id_cache()) {
-        get_id_cache(table).push_back(id);
+        get_id_cache(table).add(id);
     }
 
     table_connection.new_line();
@@ -818,6 +913,8 @@ int output_flex_t::table_insert()
                                     column.name());
                 }
                 copy_mgr->add_column(id);
+            } else if (table.is_partition_column(column)) {
+                copy_mgr->add_column(get_tile_partition(table));
             } else {
                 flex_write_column(lua_state(), &m_geometry_cache, copy_mgr,
                                   column);
@@ -884,41 +981,71 @@ int output_flex_t::table_in_id_cache()
 
 void output_flex_t::call_lua_function(prepared_lua_function_t func)
 {
+    func.calls()->add();
+    metrics::scoped_timer_t const timer{func.time()};
+
     lua_pushvalue(lua_state(), func.index());
-    if (luaX_pcall(lua_state(), 0, func.nresults())) {
+    if (m_lua_profiler) {
+        m_lua_profiler->start(fmt::format("osm2pgsql.{}", func.name()));
+    }
+    auto const status = luaX_pcall(lua_state(), 0, func.nresults());
+    if (m_lua_profiler) {
+        m_lua_profiler->stop();
+    }
+    if (status) {
         throw fmt_error("Failed to execute Lua function 'osm2pgsql.{}': {}.",
                         func.name(), lua_tostring(lua_state(), -1));
     }
+
+    if (m_lua_memory_sampler.due()) {
+        update_lua_memory(lua_state());
+    }
 }
 
 void output_flex_t::call_lua_function(prepared_lua_function_t func,
                                       osmium::OSMObject const &object)
 {
+    func.calls()->add();
+    metrics::scoped_timer_t const timer{func.time()};
+
     m_calling_context = func.context();
 
     lua_pushvalue(lua_state(), func.index());          // the function to call
     push_osm_object_to_lua_stack(lua_state(), object); // the single argument
 
     luaX_set_context(lua_state(), this);
-    if (luaX_pcall(lua_state(), 1, func.nresults())) {
+    if (m_lua_profiler) {
+        m_lua_profiler->start(
+            fmt::format("{};osm2pgsql.{}",
+                        osmium::item_type_to_name(object.type()), func.name()));
+    }
+    auto const status = luaX_pcall(lua_state(), 1, func.nresults());
+    if (m_lua_profiler) {
+        m_lua_profiler->stop();
+    }
+    if (status) {
         throw fmt_error("Failed to execute Lua function 'osm2pgsql.{}': {}.",
                         func.name(), lua_tostring(lua_state(), -1));
     }
 
+    if (m_lua_memory_sampler.due()) {
+        update_lua_memory(lua_state());
+    }
+
     m_calling_context = calling_context::main;
 }
 
 void output_flex_t::get_mutex_and_call_lua_function(
     prepared_lua_function_t func)
 {
-    std::lock_guard<std::mutex> const guard{lua_mutex};
+    auto const guard = lock_lua();
     call_lua_function(func);
 }
 
 void output_flex_t::get_mutex_and_call_lua_function(
     prepared_lua_function_t func, osmium::OSMObject const &object)
 {
-    std::lock_guard<std::mutex> const guard{lua_mutex};
+    auto const guard = lock_lua();
     call_lua_function(func, object);
 }
 
@@ -949,7 +1076,7 @@ void output_flex_t::select_relation_members()
 
     // We can not use get_mutex_and_call_lua_function() here, because we need
     // the mutex to stick around as long as we are looking at the Lua stack.
-    std::lock_guard<std::mutex> const guard{lua_mutex};
+    auto const guard = lock_lua();
     call_lua_function(m_select_relation_members, m_relation_cache.get());
 
     // If the function returned nil there is nothing to be marked.
@@ -995,6 +1122,22 @@ void output_flex_t::process_relation()
     }
 }
 
+void output_flex_t::add_relation_multipolygon()
+{
+    if (!m_process_relation) {
+        return;
+    }
+
+    // Multipolygons are assembled here before the Lua function is called,
+    // so that this (potentially expensive) work happens outside the Lua
+    // mutex and can run in all threads in parallel.
+    char const *const type = m_relation_cache.get().tags()["type"];
+    if (type && (std::strcmp(type, "multipolygon") == 0 ||
+                 std::strcmp(type, "boundary") == 0)) {
+        m_relation_cache.add_multipolygon(middle(), &m_area_buffer);
+    }
+}
+
 void output_flex_t::pending_relation(osmid_t id)
 {
     if (!m_process_relation && !m_process_untagged_relation &&
@@ -1008,6 +1151,7 @@ void output_flex_t::pending_relation(osmid_t id)
 
     select_relation_members();
     delete_from_tables(osmium::item_type::relation, id);
+    add_relation_multipolygon();
     process_relation();
     expire_geoms_from_cache(true);
 }
@@ -1045,24 +1189,18 @@ void output_flex_t::after_nodes()
     for (auto &table : *m_tables) {
         if (table.with_id_cache()) {
             auto &cache = get_id_cache(table);
-            if (get_options()->append) {
+            if (get_options()->append && !m_id_caches_loaded) {
                 log_debug("Initializing cache for table '{}' from database...",
                           table.name());
-                auto const result = m_db_connection.exec(
-                    "SELECT \"{}\" FROM {}", table.id_column_names(),
-                    table.full_name());
-
-                cache.reserve(result.num_tuples());
-                for (int i = 0; i < result.num_tuples(); ++i) {
-                    cache.push_back(
-                        osmium::string_to_object_id(result.get_value(i, 0)));
-                }
+                load_id_cache(m_db_connection, table, &cache);
             }
-            cache.sort_unique();
+            cache.commit();
             log_debug("Cache for table '{}' initialized with {} entries.",
                       table.name(), cache.size());
         }
     }
+
+    m_id_caches_loaded = true;
 }
 
 void output_flex_t::after_ways()
@@ -1089,12 +1227,46 @@ void output_flex_t::stop()
         table.task_set(thread_pool().submit([&]() {
             pg_conn_t const db_connection{get_options()->connection_params,
                                           "out.flex.stop"};
-            table.stop(db_connection,
+            table.stop(db_connection, get_options()->connection_params,
+                       get_options()->num_procs,
                        get_options()->slim && !get_options()->droptemp,
                        get_options()->append);
         }));
     }
 
+    write_expire_outputs();
+
+    if (m_lua_profiler) {
+        auto const &filename = get_options()->lua_profile_file;
+        log_info("Writing Lua profile ({} samples) to '{}'.",
+                 m_lua_profiler->num_samples(), filename);
+        m_lua_profiler->write(filename);
+    }
+}
+
+void output_flex_t::start_round()
+{
+    lua_getglobal(lua_state(), "osm2pgsql");
+    lua_pushinteger(lua_state(), 1);
+    lua_setfield(lua_state(), -2, "stage");
+    lua_pop(lua_state(), 1); // osm2pgsql
+}
+
+void output_flex_t::finish_round()
+{
+    sync();
+
+    for (auto &table : *m_tables) {
+        if (table.with_id_cache()) {
+            get_id_cache(table).commit();
+        }
+    }
+
+    write_expire_outputs();
+}
+
+void output_flex_t::write_expire_outputs()
+{
     assert(m_expire_outputs->size() == m_expire_tiles.size());
     for (std::size_t i = 0; i < m_expire_outputs->size(); ++i) {
         if (!(*m_expire_outputs)[i].empty()) {
@@ -1108,6 +1280,41 @@ void output_flex_t::stop()
     }
 }
 
+void output_flex_t::write_expire_outputs_if_memory_is_tight()
+{
+    // Writing out tiles is expensive, so only do it if there are enough
+    // tiles to free a sizable amount of memory.
+    constexpr std::size_t MIN_TILES_TO_WRITE = 1'000'000;
+
+    if (m_is_clone || !get_memory_budget().under_pressure()) {
+        return;
+    }
+
+    if (std::none_of(m_expire_outputs->begin(), m_expire_outputs->end(),
+                     [](expire_output_t &eo) {
+                         return eo.size() >= MIN_TILES_TO_WRITE;
+                     })) {
+        return;
+    }
+
+    // Tiles must not be handed out before the data they were expired for
+    // is in the database. Otherwise a renderer could re-render them from
+    // the old data and would never be told about them again.
+    sync();
+
+    for (std::size_t i = 0; i < m_expire_outputs->size(); ++i) {
+        auto &eo = (*m_expire_outputs)[i];
+        if (eo.size() >= MIN_TILES_TO_WRITE) {
+            std::size_t const count =
+                eo.output(get_options()->connection_params);
+
+            log_info("Memory is getting tight, wrote {} entries to expire "
+                     "output [{}] early.",
+                     count, i);
+        }
+    }
+}
+
 void output_flex_t::wait()
 {
     std::exception_ptr eptr;
@@ -1166,6 +1373,7 @@ void output_flex_t::relation_add(osmium::Relation const &relation)
     if (func) {
         m_relation_cache.init(relation);
         select_relation_members();
+        add_relation_multipolygon();
         get_mutex_and_call_lua_function(func, relation);
     }
 
@@ -1197,6 +1405,10 @@ void output_flex_t::delete_from_table(table_connection_t *table_connection,
         }
     }
 
+    if (table_connection->table().with_id_cache()) {
+        get_id_cache(table_connection->table()).remove(id);
+    }
+
     table_connection->delete_rows_with(type, id);
 }
 
@@ -1305,6 +1517,7 @@ output_flex_t::output_flex_t(output_flex_t const *other,
   m_db_connection(get_options()->connection_params, "out.flex.thread"),
   m_stage2_way_ids(other->m_stage2_way_ids),
   m_copy_thread(std::move(copy_thread)), m_lua_state(other->m_lua_state),
+  m_lua_profiler(other->m_lua_profiler),
   m_area_buffer(1024, osmium::memory::Buffer::auto_grow::yes),
   m_process_node(other->m_process_node), m_process_way(other->m_process_way),
   m_process_relation(other->m_process_relation),
@@ -1316,7 +1529,7 @@ output_flex_t::output_flex_t(output_flex_t const *other,
   m_process_deleted_relation(other->m_process_deleted_relation),
   m_select_relation_members(other->m_select_relation_members),
   m_after_nodes(other->m_after_nodes), m_after_ways(other->m_after_ways),
-  m_after_relations(other->m_after_relations)
+  m_after_relations(other->m_after_relations), m_is_clone(true)
 {
     for (auto &table : *m_tables) {
         table.prepare(m_db_connection);
@@ -1349,6 +1562,11 @@ output_flex_t::output_flex_t(std::shared_ptr<middle_query_t> const &mid,
 {
     init_lua(options.style, properties);
 
+    if (!options.lua_profile_file.empty()) {
+        log_info("Lua profiling enabled.");
+        m_lua_profiler = std::make_shared<lua_profiler_t>(lua_state());
+    }
+
     // If the osm2pgsql.select_relation_members() Lua function is defined
     // it means we need two-stage processing which in turn means we need
     // the full nodes and ways stored in the middle.
@@ -1511,6 +1729,10 @@ void output_flex_t::expire_geoms_from_cache(bool enable_diff_expire)
     }
 
     m_geometry_cache.clear();
+
+    if (m_expire_memory_sampler.due()) {
+        write_expire_outputs_if_memory_is_tight();
+    }
 }
 
 idlist_t const &output_flex_t::get_marked_node_ids()
@@ -16,8 +16,10 @@
 #include "flex-table-column.hpp"
 #include "flex-table.hpp"
 #include "geom.hpp"
+#include "id-cache.hpp"
 #include "idlist.hpp"
 #include "locator.hpp"
+#include "memory-budget.hpp"
 #include "output.hpp"
 
 #include <osmium/osm/item_type.hpp>
@@ -33,9 +35,14 @@
 class db_copy_thread_t;
 class db_deleter_by_type_and_id_t;
 class geom_transform_t;
+class lua_profiler_t;
 class thread_pool_t;
 struct options_t;
 
+namespace metrics {
+class counter_t;
+} // namespace metrics
+
 /**
  * When C++ code is called from the Lua code we sometimes need to know
  * in what context this happens. These are the possible contexts.
@@ -83,11 +90,19 @@ public:
 
     calling_context context() const noexcept { return m_calling_context; }
 
+    /// Metric counting the calls of this function.
+    metrics::counter_t *calls() const noexcept { return m_calls; }
+
+    /// Metric adding up the time spent in this function.
+    metrics::counter_t *time() const noexcept { return m_time; }
+
     /// Is this function defined in the users Lua code?
     explicit operator bool() const noexcept { return m_index != 0; }
 
 private:
     char const *m_name = nullptr;
+    metrics::counter_t *m_calls = nullptr;
+    metrics::counter_t *m_time = nullptr;
     int m_index = 0;
     int m_nresults = 0;
     calling_context m_calling_context = calling_context::main;
@@ -126,6 +141,9 @@ public:
     void after_ways() override;
     void after_relations() override;
 
+    void start_round() override;
+    void finish_round() override;
+
     void wait() override;
 
     idlist_t const &get_marked_node_ids() override;
@@ -179,6 +197,23 @@ public:
 private:
     void select_relation_members();
 
+    /// Write all expired tiles to the expire outputs.
+    void write_expire_outputs();
+
+    /**
+     * Write out expired tiles early if memory is getting tight and there
+     * are enough of them to make a difference. The data in the tables is
+     * committed first, so that nobody reading the expired tiles can see
+     * the old data. Only done in the main instance, not in clones.
+     */
+    void write_expire_outputs_if_memory_is_tight();
+
+    /**
+     * Get the partition number for tables partitioned by tile from the
+     * geometry in the row data on top of the Lua stack.
+     */
+    std::size_t get_tile_partition(flex_table_t const &table);
+
     /// Call a Lua function that was "prepared" earlier.
     void call_lua_function(prepared_lua_function_t func);
 
@@ -197,6 +232,12 @@ private:
 
     void process_relation();
 
+    /**
+     * Assemble the multipolygon geometry for the relation in the relation
+     * cache if the relation looks like it needs one.
+     */
+    void add_relation_multipolygon();
+
     void init_lua(std::string const &filename, properties_t const &properties);
 
     void check_context_and_state(char const *name, char const *context,
@@ -229,10 +270,10 @@ private:
         if (table.num() >= m_id_caches.size()) {
             m_id_caches.resize(table.num() + 1);
         }
-        m_id_caches[table.num()] = std::make_shared<idlist_t>();
+        m_id_caches[table.num()] = std::make_shared<id_cache_t>();
     }
 
-    idlist_t &get_id_cache(flex_table_t const &table)
+    id_cache_t &get_id_cache(flex_table_t const &table)
     {
         auto& c = m_id_caches[table.num()];
         assert(c);
@@ -268,6 +309,23 @@ private:
          */
         bool add_members(middle_query_t const &middle);
 
+        /**
+         * Assemble the (multi)polygon geometry of the relation and keep it
+         * for later calls to as_multipolygon(). Adds the members to the
+         * cache if that hasn't happened yet.
+         */
+        void add_multipolygon(middle_query_t const &middle,
+                              osmium::memory::Buffer *area_buffer);
+
+        /**
+         * Get the (multi)polygon geometry assembled in add_multipolygon()
+         * or nullptr if it wasn't called for this relation.
+         */
+        geom::geometry_t const *multipolygon() const noexcept
+        {
+            return m_has_multipolygon ? &m_multipolygon : nullptr;
+        }
+
         osmium::Relation const &get() const noexcept { return *m_relation; }
 
         osmium::memory::Buffer const &members_buffer() const noexcept
@@ -284,6 +342,8 @@ private:
         osmium::memory::Buffer m_members_buffer{
             32768, osmium::memory::Buffer::auto_grow::yes};
         osmium::Relation const *m_relation = nullptr;
+        geom::geometry_t m_multipolygon;
+        bool m_has_multipolygon = false;
 
     }; // relation_cache_t
 
@@ -296,7 +356,13 @@ private:
     std::shared_ptr<std::vector<expire_output_t>> m_expire_outputs =
         std::make_shared<std::vector<expire_output_t>>();
 
-    std::vector<std::shared_ptr<idlist_t>> m_id_caches;
+    std::vector<std::shared_ptr<id_cache_t>> m_id_caches;
+
+    /**
+     * Set after the id caches have been initialized from the database. In
+     * persistent mode they are kept up to date from then on.
+     */
+    bool m_id_caches_loaded = false;
 
     std::vector<table_connection_t> m_table_connections;
 
@@ -314,6 +380,11 @@ private:
     // accessed while protected using the lua_mutex.
     std::shared_ptr<lua_State> m_lua_state;
 
+    // The Lua profiler (if enabled). This is shared between all clones of
+    // the output and must only be accessed while protected using the
+    // lua_mutex.
+    std::shared_ptr<lua_profiler_t> m_lua_profiler;
+
     // Caches for old and new geometries from a single OSM object
     geometry_cache_t m_geometry_cache;
 
@@ -350,6 +421,19 @@ private:
      * insert() command.
      */
     bool m_disable_insert = false;
+
+    /// Only update the memory used by Lua every so often.
+    memory_sampler_t m_lua_memory_sampler;
+
+    /// Only check whether expire outputs must be written every so often.
+    memory_sampler_t m_expire_memory_sampler;
+
+    /**
+     * Set in clones. Clones run in parallel to each other and share the
+     * expire outputs, so those may contain tiles for data another clone
+     * hasn't committed yet.
+     */
+    bool m_is_clone = false;
 };
 
 int lua_trampoline_table_insert(lua_State *lua_state);
@@ -175,6 +175,17 @@ void output_pgsql_t::stop()
         }));
     }
 
+    write_expire_output();
+}
+
+void output_pgsql_t::finish_round()
+{
+    sync();
+    write_expire_output();
+}
+
+void output_pgsql_t::write_expire_output()
+{
     if (get_options()->expire_tiles_zoom_min > 0) {
         auto const count = m_expire_output.output(connection_params_t{});
         log_info("Wrote {} entries to expired tiles list", count);
@@ -64,6 +64,8 @@ public:
     void stop() override;
     void sync() override;
 
+    void finish_round() override;
+
     void wait() override;
 
     void pending_way(osmid_t id) override;
@@ -95,6 +97,9 @@ private:
     void pgsql_delete_way_from_output(osmid_t osm_id);
     void pgsql_delete_relation_from_output(osmid_t osm_id);
 
+    /// Write expired tiles to the expire output (if enabled).
+    void write_expire_output();
+
     std::unique_ptr<tagtransform_t> m_tagtransform;
 
     //enable output of a generated way_area tag to either hstore or its own column
@@ -68,6 +68,18 @@ public:
     virtual void after_ways() {}
     virtual void after_relations() {}
 
+    /**
+     * Called in persistent mode before processing of each change file
+     * except the first one.
+     */
+    virtual void start_round() {}
+
+    /**
+     * Called in persistent mode after all processing of a change file is
+     * done instead of stop().
+     */
+    virtual void finish_round() {}
+
     virtual void wait() {}
 
     virtual idlist_t const &get_marked_node_ids()
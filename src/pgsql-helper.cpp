@@ -14,6 +14,7 @@
 #include "pgsql-capabilities.hpp"
 
 #include <cassert>
+#include <cstring>
 
 idlist_t get_ids_from_result(pg_result_t const &result)
 {
@@ -29,6 +30,59 @@ idlist_t get_ids_from_result(pg_result_t const &result)
     return ids;
 }
 
+std::int64_t decode_binary_int8(char const *data) noexcept
+{
+    std::uint64_t value = 0;
+    for (std::size_t i = 0; i < 8; ++i) {
+        value = (value << 8U) | static_cast<unsigned char>(data[i]);
+    }
+    return static_cast<std::int64_t>(value);
+}
+
+double decode_binary_float8(char const *data) noexcept
+{
+    auto const bits = static_cast<std::uint64_t>(decode_binary_int8(data));
+    double value = 0.0;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+pg_binary_array_t::pg_binary_array_t(std::uint32_t element_oid,
+                                     std::size_t num_elements)
+{
+    // Header with dimensions (4), has-null flag (4), element type (4), and
+    // for the single dimension the size (4) and lower bound (4). Each element
+    // needs a length field (4) plus at most 8 bytes for the value.
+    m_data.reserve(20 + num_elements * 12);
+
+    add_uint32(1);
+    add_uint32(0);
+    add_uint32(element_oid);
+    add_uint32(static_cast<std::uint32_t>(num_elements));
+    add_uint32(1);
+}
+
+void pg_binary_array_t::add_uint32(std::uint32_t value)
+{
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        m_data += static_cast<char>((value >> shift) & 0xffU);
+    }
+}
+
+void pg_binary_array_t::add(std::int64_t value)
+{
+    auto const v = static_cast<std::uint64_t>(value);
+    add_uint32(8);
+    add_uint32(static_cast<std::uint32_t>(v >> 32U));
+    add_uint32(static_cast<std::uint32_t>(v & 0xffffffffU));
+}
+
+void pg_binary_array_t::add(char value)
+{
+    add_uint32(1);
+    m_data += value;
+}
+
 void create_geom_check_trigger(pg_conn_t const &db_connection,
                                std::string const &schema,
                                std::string const &table,
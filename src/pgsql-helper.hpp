@@ -13,6 +13,8 @@
 #include "idlist.hpp"
 #include "osmtypes.hpp"
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 class pg_conn_t;
@@ -27,6 +29,45 @@ class pg_result_t;
  */
 idlist_t get_ids_from_result(pg_result_t const &result);
 
+/**
+ * Decode an int8 value returned by PostgreSQL in binary format (8 bytes in
+ * network byte order).
+ */
+std::int64_t decode_binary_int8(char const *data) noexcept;
+
+/**
+ * Decode a float8 value returned by PostgreSQL in binary format (8 bytes
+ * IEEE 754 in network byte order).
+ */
+double decode_binary_float8(char const *data) noexcept;
+
+/**
+ * Builder for one-dimensional arrays in the PostgreSQL binary format. The
+ * result can be sent to the database as a binary_param_t which avoids
+ * formatting and parsing large lists of values as SQL text.
+ *
+ * Call add() exactly num_elements times after construction.
+ */
+class pg_binary_array_t
+{
+public:
+    /// Element type OIDs for arrays we use.
+    static constexpr std::uint32_t INT8_OID = 20;
+    static constexpr std::uint32_t BPCHAR_OID = 1042;
+
+    pg_binary_array_t(std::uint32_t element_oid, std::size_t num_elements);
+
+    void add(std::int64_t value);
+    void add(char value);
+
+    std::string const &data() const noexcept { return m_data; }
+
+private:
+    void add_uint32(std::uint32_t value);
+
+    std::string m_data;
+};
+
 void create_geom_check_trigger(pg_conn_t const &db_connection,
                                std::string const &schema,
                                std::string const &table,
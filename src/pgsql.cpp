@@ -51,12 +51,19 @@ PGconn *open_connection(connection_params_t const &connection_params,
     return PQconnectdbParams(keywords.data(), values.data(), 1);
 }
 
-std::string concat_params(int num_params, char const *const *param_values)
+std::string concat_params(int num_params, char const *const *param_values,
+                          int const *param_formats)
 {
     util::string_joiner_t joiner{','};
 
     for (int i = 0; i < num_params; ++i) {
-        joiner.add(param_values[i] ? param_values[i] : "<NULL>");
+        if (!param_values[i]) {
+            joiner.add("<NULL>");
+        } else if (param_formats[i]) {
+            joiner.add("<BINARY>");
+        } else {
+            joiner.add(param_values[i]);
+        }
     }
 
     return joiner();
@@ -209,27 +216,33 @@ void pg_conn_t::prepare_internal(std::string const &stmt,
     }
 }
 
-pg_result_t pg_conn_t::exec_prepared_internal(char const *stmt, int num_params,
-                                              char const *const *param_values,
-                                              int *param_lengths,
-                                              int *param_formats,
-                                              int result_format) const
+pg_result_t pg_conn_t::exec_params_internal(char const *stmt, bool prepared,
+                                            int num_params,
+                                            char const *const *param_values,
+                                            int *param_lengths,
+                                            int *param_formats,
+                                            int result_format) const
 {
     assert(m_conn);
 
     if (get_logger().log_sql()) {
-        log_sql("(C{}) EXECUTE {}({})", m_connection_id, stmt,
-                concat_params(num_params, param_values));
+        log_sql("(C{}) {} {}({})", m_connection_id,
+                prepared ? "EXECUTE" : "QUERY", stmt,
+                concat_params(num_params, param_values, param_formats));
     }
 
-    pg_result_t res{PQexecPrepared(m_conn.get(), stmt, num_params, param_values,
-                                   param_lengths, param_formats,
-                                   result_format)};
+    pg_result_t res{
+        prepared ? PQexecPrepared(m_conn.get(), stmt, num_params, param_values,
+                                  param_lengths, param_formats, result_format)
+                 : PQexecParams(m_conn.get(), stmt, num_params, nullptr,
+                                param_values, param_lengths, param_formats,
+                                result_format)};
 
     auto const status = res.status();
     if (status != PGRES_COMMAND_OK && status != PGRES_TUPLES_OK) {
-        log_error("SQL command failed: EXECUTE {}({})", stmt,
-                  concat_params(num_params, param_values));
+        log_error("SQL command failed: {} {}({})",
+                  prepared ? "EXECUTE" : "QUERY", stmt,
+                  concat_params(num_params, param_values, param_formats));
         throw fmt_error("Database error: {} ({})", error_msg(),
                         std::underlying_type_t<ExecStatusType>(status));
     }
@@ -237,6 +250,135 @@ pg_result_t pg_conn_t::exec_prepared_internal(char const *stmt, int num_params,
     return res;
 }
 
+pg_pipeline_t::pg_pipeline_t(pg_conn_t const &db_connection,
+                             std::size_t max_in_flight)
+: m_db_connection(&db_connection), m_max_in_flight(max_in_flight)
+{
+    assert(m_max_in_flight > 0);
+
+#ifdef LIBPQ_HAS_PIPELINING
+    if (PQenterPipelineMode(m_db_connection->m_conn.get()) != 1) {
+        throw fmt_error("Entering pipeline mode failed: {}",
+                        m_db_connection->error_msg());
+    }
+    log_sql("(C{}) Entered pipeline mode", m_db_connection->m_connection_id);
+    m_active = true;
+#endif
+}
+
+pg_pipeline_t::~pg_pipeline_t() noexcept
+{
+    try {
+        finish();
+    } catch (...) {
+        // Errors have been reported if finish() was called explicitly.
+        // Otherwise we are cleaning up after another exception anyway.
+    }
+}
+
+void pg_pipeline_t::send_prepared(result_callback_t &&callback,
+                                  char const *stmt, int num_params,
+                                  char const *const *param_values,
+                                  int *param_lengths, int *param_formats)
+{
+    if (get_logger().log_sql()) {
+        log_sql("(C{}) EXECUTE {}({})", m_db_connection->m_connection_id,
+                stmt, concat_params(num_params, param_values, param_formats));
+    }
+
+#ifdef LIBPQ_HAS_PIPELINING
+    assert(m_active);
+    if (PQsendQueryPrepared(m_db_connection->m_conn.get(), stmt, num_params,
+                            param_values, param_lengths, param_formats,
+                            0) != 1) {
+        throw fmt_error("Sending prepared statement '{}' failed: {}", stmt,
+                        m_db_connection->error_msg());
+    }
+
+    m_callbacks.push_back(std::move(callback));
+    if (m_callbacks.size() >= m_max_in_flight) {
+        sync_and_process_results();
+    }
+#else
+    auto const res = m_db_connection->exec_params_internal(
+        stmt, true, num_params, param_values, param_lengths, param_formats, 0);
+    if (callback) {
+        callback(res);
+    }
+#endif
+}
+
+void pg_pipeline_t::sync_and_process_results()
+{
+#ifdef LIBPQ_HAS_PIPELINING
+    auto *conn = m_db_connection->m_conn.get();
+
+    if (PQpipelineSync(conn) != 1) {
+        throw fmt_error("Pipeline sync failed: {}",
+                        m_db_connection->error_msg());
+    }
+
+    // Read results for all statements even after an error, otherwise the
+    // connection would be left in an unusable state.
+    std::string error;
+    while (!m_callbacks.empty()) {
+        auto const callback = std::move(m_callbacks.front());
+        m_callbacks.pop_front();
+
+        // Each statement yields one result followed by a nullptr.
+        pg_result_t const res{PQgetResult(conn)};
+        auto const status = res.status();
+        if (status == PGRES_COMMAND_OK || status == PGRES_TUPLES_OK) {
+            if (callback && error.empty()) {
+                callback(res);
+            }
+        } else if (error.empty()) {
+            error = status == PGRES_PIPELINE_ABORTED
+                        ? "Pipeline aborted"
+                        : res.error_msg();
+        }
+        while (pg_result_t{PQgetResult(conn)}) {
+        }
+    }
+
+    pg_result_t const sync{PQgetResult(conn)};
+    if (sync.status() != PGRES_PIPELINE_SYNC) {
+        throw fmt_error("Unexpected result in pipeline: {}",
+                        m_db_connection->error_msg());
+    }
+
+    if (!error.empty()) {
+        throw fmt_error("Database error in pipeline: {}", error);
+    }
+#endif
+}
+
+void pg_pipeline_t::finish()
+{
+    if (!m_active) {
+        return;
+    }
+
+#ifdef LIBPQ_HAS_PIPELINING
+    m_active = false;
+
+    // Always leave pipeline mode, even if there was an error.
+    auto *conn = m_db_connection->m_conn.get();
+    try {
+        sync_and_process_results();
+    } catch (...) {
+        PQexitPipelineMode(conn);
+        throw;
+    }
+
+    if (PQexitPipelineMode(conn) != 1) {
+        throw fmt_error("Leaving pipeline mode failed: {}",
+                        m_db_connection->error_msg());
+    }
+    log_sql("(C{}) Left pipeline mode", m_db_connection->m_connection_id);
+#endif
+}
+
 std::string tablespace_clause(std::string const &name)
 {
     std::string sql;
@@ -25,6 +25,8 @@
 #include <atomic>
 #include <cassert>
 #include <cstdint>
+#include <deque>
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
@@ -67,6 +69,12 @@ public:
         return PQgetisnull(m_result.get(), row, col) != 0;
     }
 
+    /// Get the error message associated with this result (if any).
+    char const *error_msg() const noexcept
+    {
+        return PQresultErrorMessage(m_result.get());
+    }
+
     /// Return the number of INSERTed, UPDATEd, or DELETEed rows.
     std::size_t affected_rows() const noexcept;
 
@@ -216,8 +224,25 @@ public:
     template <typename... TArgs>
     pg_result_t exec_prepared(char const *stmt, TArgs &&...params) const
     {
-        return exec_prepared_with_result_format(stmt, false,
-                                                std::forward<TArgs>(params)...);
+        return exec_with_params(stmt, true, false,
+                                std::forward<TArgs>(params)...);
+    }
+
+    /**
+     * Run the specified SQL command with parameters ($1, $2, ...) and return
+     * the results in text format. The parameters are sent separately from
+     * the command, so there is no need to format them into the SQL text.
+     *
+     * \param sql The SQL command.
+     * \param params Any number of arguments (will be converted to strings
+     *               if necessary).
+     * \throws exception if the command failed.
+     */
+    template <typename... TArgs>
+    pg_result_t exec_params(char const *sql, TArgs &&...params) const
+    {
+        return exec_with_params(sql, false, false,
+                                std::forward<TArgs>(params)...);
     }
 
     /**
@@ -233,8 +258,8 @@ public:
     pg_result_t exec_prepared_as_binary(char const *stmt,
                                         TArgs &&...params) const
     {
-        return exec_prepared_with_result_format(stmt, true,
-                                                std::forward<TArgs>(params)...);
+        return exec_with_params(stmt, true, true,
+                                std::forward<TArgs>(params)...);
     }
 
     /**
@@ -257,13 +282,14 @@ private:
     void prepare_internal(std::string const &stmt,
                           std::string const &sql) const;
 
-    pg_result_t exec_prepared_internal(char const *stmt, int num_params,
-                                       char const *const *param_values,
-                                       int *param_lengths, int *param_formats,
-                                       int result_format) const;
+    pg_result_t exec_params_internal(char const *stmt, bool prepared,
+                                     int num_params,
+                                     char const *const *param_values,
+                                     int *param_lengths, int *param_formats,
+                                     int result_format) const;
 
     /**
-     * Helper for pg_conn_t::exec_prepared_with_result_format() function. Used
+     * Helper for pg_conn_t::with_params() function. Used
      * to find out how many buffers we need. Must always be in sync with the
      * to_str() function below.
      */
@@ -279,7 +305,7 @@ private:
     }
 
     /**
-     * Helper for pg_conn_t::exec_prepared_with_result_format() function. All
+     * Helper for pg_conn_t::with_params() function. All
      * parameters to that function are given to the to_str() function which
      * will pass through string-like parameters and convert other parameters to
      * strings.
@@ -302,9 +328,11 @@ private:
     }
 
     /**
-     * Run the named prepared SQL statement and return the results.
+     * Run the named prepared SQL statement or the SQL command and return the
+     * results.
      *
-     * \param stmt The name of the prepared statement.
+     * \param stmt The name of the prepared statement or the SQL command.
+     * \param prepared Is stmt the name of a prepared statement?
      * \param result_as_binary Ask for the resuls to be returned in binary
      *                         format.
      * \param params Any number of arguments (will be converted to strings
@@ -312,9 +340,28 @@ private:
      * \throws exception if the command failed.
      */
     template <typename... TArgs>
-    pg_result_t exec_prepared_with_result_format(char const *stmt,
-                                                 bool result_as_binary,
-                                                 TArgs &&...params) const
+    pg_result_t exec_with_params(char const *stmt, bool prepared,
+                                 bool result_as_binary,
+                                 TArgs &&...params) const
+    {
+        return with_params(
+            [&](int num_params, char const *const *param_values,
+                int *param_lengths, int *param_formats) {
+                return exec_params_internal(stmt, prepared, num_params,
+                                            param_values, param_lengths,
+                                            param_formats,
+                                            result_as_binary ? 1 : 0);
+            },
+            std::forward<TArgs>(params)...);
+    }
+
+    /**
+     * Convert all parameters into the form libpq needs and call func with
+     * the number of parameters and the arrays of values, lengths, and
+     * formats.
+     */
+    template <typename FUNC, typename... TArgs>
+    static auto with_params(FUNC &&func, TArgs &&...params)
     {
         // We have to convert all non-string parameters into strings and
         // store them somewhere. We use the exec_params vector for this.
@@ -327,8 +374,8 @@ private:
         std::vector<std::string> exec_params;
         exec_params.reserve(TOTAL_BUFFERS_NEEDED);
 
-        std::array<int, sizeof...(params)> lengths = {0};
-        std::array<int, sizeof...(params)> bins = {0};
+        std::array<int, sizeof...(params)> lengths{};
+        std::array<int, sizeof...(params)> bins{};
 
         // This array holds the pointers to all parameter strings, either
         // to the original string parameters or to the recently converted
@@ -340,11 +387,12 @@ private:
                                         &bins.at(m++),
                                         std::forward<TArgs>(params))...};
 
-        return exec_prepared_internal(stmt, sizeof...(params),
-                                      param_ptrs.data(), lengths.data(),
-                                      bins.data(), result_as_binary ? 1 : 0);
+        return func(static_cast<int>(sizeof...(params)), param_ptrs.data(),
+                    lengths.data(), bins.data());
     }
 
+    friend class pg_pipeline_t;
+
     struct pg_conn_deleter_t
     {
         void operator()(PGconn *p) const noexcept { PQfinish(p); }
@@ -359,6 +407,102 @@ private:
     std::uint32_t m_connection_id;
 };
 
+/**
+ * Send many prepared statements over a connection without waiting for the
+ * result of each one before sending the next (libpq pipeline mode). This
+ * saves a network round trip per statement which matters a lot if the
+ * database is on a different host.
+ *
+ * At most max_in_flight statements are sent before the pipeline is synced
+ * and all outstanding results are read. Results are handed to the callbacks
+ * (if any) in the order the statements were sent. Use this only for
+ * statements with small results, like INSERTs or UPDATEs.
+ *
+ * While the pipeline is active no other commands can be run on the
+ * connection. Call finish() to wait for all results and end pipeline mode.
+ *
+ * If libpq doesn't support pipelining (versions before 14), statements are
+ * executed synchronously.
+ */
+class pg_pipeline_t
+{
+public:
+    using result_callback_t = std::function<void(pg_result_t const &)>;
+
+    static constexpr std::size_t DEFAULT_MAX_IN_FLIGHT = 1000;
+
+    explicit pg_pipeline_t(pg_conn_t const &db_connection,
+                           std::size_t max_in_flight = DEFAULT_MAX_IN_FLIGHT);
+
+    pg_pipeline_t(pg_pipeline_t const &) = delete;
+    pg_pipeline_t &operator=(pg_pipeline_t const &) = delete;
+
+    pg_pipeline_t(pg_pipeline_t &&) = delete;
+    pg_pipeline_t &operator=(pg_pipeline_t &&) = delete;
+
+    ~pg_pipeline_t() noexcept;
+
+    /**
+     * Queue the named prepared SQL statement ignoring its result.
+     *
+     * \param stmt The name of the prepared statement.
+     * \param params Any number of arguments (will be converted to strings
+     *               if necessary).
+     * \throws exception if this or an earlier command failed.
+     */
+    template <typename... TArgs>
+    void exec_prepared(char const *stmt, TArgs &&...params)
+    {
+        exec_prepared_with_result({}, stmt, std::forward<TArgs>(params)...);
+    }
+
+    /**
+     * Queue the named prepared SQL statement. The callback will be called
+     * with the result (in text format) once it is available.
+     *
+     * \param callback Function called with the result.
+     * \param stmt The name of the prepared statement.
+     * \param params Any number of arguments (will be converted to strings
+     *               if necessary).
+     * \throws exception if this or an earlier command failed.
+     */
+    template <typename... TArgs>
+    void exec_prepared_with_result(result_callback_t callback,
+                                   char const *stmt, TArgs &&...params)
+    {
+        pg_conn_t::with_params(
+            [&](int num_params, char const *const *param_values,
+                int *param_lengths, int *param_formats) {
+                send_prepared(std::move(callback), stmt, num_params,
+                              param_values, param_lengths, param_formats);
+            },
+            std::forward<TArgs>(params)...);
+    }
+
+    /**
+     * Wait for all outstanding results and end pipeline mode.
+     *
+     * \throws exception if any command failed.
+     */
+    void finish();
+
+private:
+    void send_prepared(result_callback_t &&callback, char const *stmt,
+                       int num_params, char const *const *param_values,
+                       int *param_lengths, int *param_formats);
+
+    void sync_and_process_results();
+
+    pg_conn_t const *m_db_connection;
+
+    /// Callbacks (possibly empty) for all statements sent but not processed.
+    std::deque<result_callback_t> m_callbacks;
+
+    std::size_t m_max_in_flight;
+
+    bool m_active = false;
+};
+
 /**
  * Return a TABLESPACE clause with the specified tablespace name or an empty
  * string if the name is empty.
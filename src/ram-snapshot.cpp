@@ -0,0 +1,132 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "ram-snapshot.hpp"
+
+#include "format.hpp"
+#include "logging.hpp"
+
+#include <osmium/util/file.hpp>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <filesystem>
+#include <system_error>
+#include <utility>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+int open_snapshot_file(std::string const &filename)
+{
+    int flags = O_RDONLY; // NOLINT(hicpp-signed-bitwise)
+#ifdef _WIN32
+    flags |= O_BINARY; // NOLINT(hicpp-signed-bitwise)
+#endif
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    int const fd = open(filename.c_str(), flags);
+    if (fd < 0) {
+        throw std::system_error{
+            errno, std::system_category(),
+            fmt::format("Unable to open RAM middle snapshot '{}'", filename)};
+    }
+
+    if (osmium::file_size(fd) == 0) {
+        close(fd);
+        throw fmt_error("RAM middle snapshot '{}' is empty.", filename);
+    }
+
+    return fd;
+}
+
+} // anonymous namespace
+
+ram_snapshot_writer_t::ram_snapshot_writer_t(std::string filename)
+: m_filename(std::move(filename)), m_tmp_filename(m_filename + ".tmp")
+{
+    m_file = std::fopen(m_tmp_filename.c_str(), "wb");
+    if (m_file == nullptr) {
+        throw std::system_error{errno, std::system_category(),
+                                fmt::format("Unable to create '{}'",
+                                            m_tmp_filename)};
+    }
+}
+
+ram_snapshot_writer_t::~ram_snapshot_writer_t() noexcept
+{
+    if (m_file == nullptr) {
+        return;
+    }
+
+    std::fclose(m_file);
+
+    std::error_code ec{};
+    std::filesystem::remove(m_tmp_filename, ec);
+}
+
+void ram_snapshot_writer_t::write(void const *data, std::size_t size)
+{
+    if (size == 0) {
+        return;
+    }
+
+    if (std::fwrite(data, size, 1, m_file) != 1) {
+        throw std::system_error{errno, std::system_category(),
+                                fmt::format("Error writing to '{}'",
+                                            m_tmp_filename)};
+    }
+}
+
+void ram_snapshot_writer_t::commit()
+{
+    auto *file = m_file;
+    m_file = nullptr;
+    if (std::fclose(file) != 0) {
+        std::error_code ec{};
+        std::filesystem::remove(m_tmp_filename, ec);
+        throw std::system_error{errno, std::system_category(),
+                                fmt::format("Error writing to '{}'",
+                                            m_tmp_filename)};
+    }
+
+    std::filesystem::rename(m_tmp_filename, m_filename);
+}
+
+ram_snapshot_reader_t::ram_snapshot_reader_t(std::string filename)
+: m_filename(std::move(filename)), m_fd(open_snapshot_file(m_filename)),
+  m_mapping(osmium::file_size(m_fd),
+            osmium::util::MemoryMapping::mapping_mode::readonly, m_fd)
+{}
+
+ram_snapshot_reader_t::~ram_snapshot_reader_t() noexcept
+{
+    try {
+        m_mapping.unmap();
+    } catch (...) {
+        // exception ignored on purpose
+    }
+    close(m_fd);
+}
+
+char const *ram_snapshot_reader_t::read(std::size_t size)
+{
+    if (size > m_mapping.size() - m_offset) {
+        throw fmt_error("RAM middle snapshot '{}' is truncated.", m_filename);
+    }
+
+    char const *data = m_mapping.get_addr<char>() + m_offset;
+    m_offset += size;
+    return data;
+}
@@ -0,0 +1,145 @@
+#ifndef OSM2PGSQL_RAM_SNAPSHOT_HPP
+#define OSM2PGSQL_RAM_SNAPSHOT_HPP
+
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+/**
+ * \file
+ *
+ * Classes for writing and reading snapshot files of the RAM middle.
+ *
+ * A snapshot file contains a header followed by the raw contents of the
+ * data structures of the RAM middle. All values are stored in native byte
+ * order, so a snapshot can only be used on the machine type it was
+ * created on.
+ */
+
+#include <osmium/util/memory_mapping.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Write a RAM middle snapshot file. The data is written into a temporary
+ * file first which is renamed to the final name in commit(). If commit()
+ * is never called, the temporary file is removed.
+ */
+class ram_snapshot_writer_t
+{
+public:
+    explicit ram_snapshot_writer_t(std::string filename);
+
+    ram_snapshot_writer_t(ram_snapshot_writer_t const &) = delete;
+    ram_snapshot_writer_t &operator=(ram_snapshot_writer_t const &) = delete;
+
+    ram_snapshot_writer_t(ram_snapshot_writer_t &&) = delete;
+    ram_snapshot_writer_t &operator=(ram_snapshot_writer_t &&) = delete;
+
+    ~ram_snapshot_writer_t() noexcept;
+
+    void write(void const *data, std::size_t size);
+
+    template <typename T>
+    void write_value(T value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value);
+        write(&value, sizeof(T));
+    }
+
+    void write_string(std::string const &str)
+    {
+        write_value<uint64_t>(str.size());
+        write(str.data(), str.size());
+    }
+
+    template <typename T>
+    void write_vector(std::vector<T> const &vec)
+    {
+        static_assert(std::is_trivially_copyable<T>::value);
+        write_value<uint64_t>(vec.size());
+        write(vec.data(), vec.size() * sizeof(T));
+    }
+
+    /// Close the file and move it into its final place.
+    void commit();
+
+private:
+    std::string m_filename;
+    std::string m_tmp_filename;
+    std::FILE *m_file = nullptr;
+}; // class ram_snapshot_writer_t
+
+/**
+ * Read a RAM middle snapshot file. The file is memory mapped and the data
+ * is copied out of the mapping in large blocks.
+ */
+class ram_snapshot_reader_t
+{
+public:
+    explicit ram_snapshot_reader_t(std::string filename);
+
+    ram_snapshot_reader_t(ram_snapshot_reader_t const &) = delete;
+    ram_snapshot_reader_t &operator=(ram_snapshot_reader_t const &) = delete;
+
+    ram_snapshot_reader_t(ram_snapshot_reader_t &&) = delete;
+    ram_snapshot_reader_t &operator=(ram_snapshot_reader_t &&) = delete;
+
+    ~ram_snapshot_reader_t() noexcept;
+
+    /**
+     * Get a pointer to the next "size" bytes in the mapping and advance
+     * the read position.
+     *
+     * \throws std::runtime_error if the file is too short.
+     */
+    char const *read(std::size_t size);
+
+    template <typename T>
+    T read_value()
+    {
+        static_assert(std::is_trivially_copyable<T>::value);
+        T value;
+        std::memcpy(&value, read(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    void read_string(std::string *str)
+    {
+        auto const size = read_value<uint64_t>();
+        str->assign(read(size), size);
+    }
+
+    template <typename T>
+    void read_vector(std::vector<T> *vec)
+    {
+        static_assert(std::is_trivially_copyable<T>::value);
+        auto const size = read_value<uint64_t>();
+        vec->resize(size);
+        std::memcpy(vec->data(), read(size * sizeof(T)), size * sizeof(T));
+    }
+
+    /// Has all data been read?
+    bool at_end() const noexcept { return m_offset == m_mapping.size(); }
+
+    std::string const &filename() const noexcept { return m_filename; }
+
+private:
+    std::string m_filename;
+    int m_fd = -1;
+    osmium::util::MemoryMapping m_mapping;
+    std::size_t m_offset = 0;
+}; // class ram_snapshot_reader_t
+
+#endif // OSM2PGSQL_RAM_SNAPSHOT_HPP
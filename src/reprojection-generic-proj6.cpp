@@ -3,34 +3,38 @@
 
 #include <proj.h>
 
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
 namespace {
 
 /**
- * Generic projection using proj library (version 6 and above).
+ * The PROJ context and transformations for one target SRS. A PROJ context
+ * must not be used from several threads at the same time, so each thread
+ * gets its own set of these objects, see transformations_for().
  */
-class generic_reprojection_t : public reprojection_t
+class proj_transformations_t
 {
 public:
-    explicit generic_reprojection_t(int srs)
+    explicit proj_transformations_t(int srs)
     : m_target_srs(srs), m_context(proj_context_create()),
       m_transformation(create_transformation(PROJ_LATLONG, srs)),
       m_transformation_tile(create_transformation(srs, PROJ_SPHERE_MERC))
     {}
 
-    geom::point_t reproject(geom::point_t point) const noexcept override
-    {
-        return transform(m_transformation.get(), point);
-    }
+    int target_srs() const noexcept { return m_target_srs; }
 
-    geom::point_t target_to_tile(geom::point_t point) const override
+    PJ *transformation() const noexcept { return m_transformation.get(); }
+
+    PJ *transformation_tile() const noexcept
     {
-        return transform(m_transformation_tile.get(), point);
+        return m_transformation_tile.get();
     }
 
-    int target_srs() const noexcept override { return m_target_srs; }
-
-    char const *target_desc() const noexcept override { return ""; }
-
 private:
     struct pj_context_deleter_t
     {
@@ -77,6 +81,97 @@ private:
         return trans_vis;
     }
 
+    int m_target_srs;
+    std::unique_ptr<PJ_CONTEXT, pj_context_deleter_t> m_context;
+    std::unique_ptr<PJ, pj_deleter_t> m_transformation;
+
+    /**
+     * The projection used for tiles. Currently this is fixed to be Spherical
+     * Mercator. You will usually have tiles in the same projection as used
+     * for PostGIS, but it is theoretically possible to have your PostGIS data
+     * in, say, lat/lon but still create tiles in Spherical Mercator.
+     */
+    std::unique_ptr<PJ, pj_deleter_t> m_transformation_tile;
+};
+
+/**
+ * Get the PROJ transformations for the target SRS for the current thread.
+ * They are created on first use in each thread. Lookups don't need any
+ * locking.
+ */
+proj_transformations_t const &transformations_for(int srs)
+{
+    // In almost all cases there will be only one or two projections used, so
+    // storing them in a vector and doing linear search is totally fine.
+    thread_local std::vector<std::unique_ptr<proj_transformations_t>>
+        registry;
+
+    for (auto const &t : registry) {
+        if (t->target_srs() == srs) {
+            return *t;
+        }
+    }
+
+    return *registry.emplace_back(
+        std::make_unique<proj_transformations_t>(srs));
+}
+
+/**
+ * Generic projection using proj library (version 6 and above).
+ *
+ * Objects of this class can be used from several threads at the same time,
+ * each thread uses its own PROJ context.
+ */
+class generic_reprojection_t : public reprojection_t
+{
+public:
+    explicit generic_reprojection_t(int srs) : m_target_srs(srs)
+    {
+        // Create transformations for this thread now, so that invalid
+        // projections are detected early.
+        transformations_for(srs);
+    }
+
+    geom::point_t reproject(geom::point_t point) const override
+    {
+        return transform(transformations_for(m_target_srs).transformation(),
+                         point);
+    }
+
+    void reproject_points(geom::point_t *points,
+                          std::size_t count) const override
+    {
+        static_assert(std::is_standard_layout<geom::point_t>::value);
+        static_assert(sizeof(geom::point_t) == 2 * sizeof(double));
+
+        if (count == 0) {
+            return;
+        }
+
+        // The x and y coordinates are transformed in place directly in
+        // the point array using strides, so this is a single call into
+        // PROJ for all points.
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        auto *const x = reinterpret_cast<double *>(points);
+        std::size_t const stride = sizeof(geom::point_t);
+
+        proj_trans_generic(
+            transformations_for(m_target_srs).transformation(), PJ_FWD, x,
+            stride, count, x + 1, stride, count, nullptr, 0, 0, nullptr, 0,
+            0);
+    }
+
+    geom::point_t target_to_tile(geom::point_t point) const override
+    {
+        return transform(
+            transformations_for(m_target_srs).transformation_tile(), point);
+    }
+
+    int target_srs() const noexcept override { return m_target_srs; }
+
+    char const *target_desc() const noexcept override { return ""; }
+
+private:
     static geom::point_t transform(PJ *transformation,
                                    geom::point_t point) noexcept
     {
@@ -93,16 +188,6 @@ private:
     }
 
     int m_target_srs;
-    std::unique_ptr<PJ_CONTEXT, pj_context_deleter_t> m_context;
-    std::unique_ptr<PJ, pj_deleter_t> m_transformation;
-
-    /**
-     * The projection used for tiles. Currently this is fixed to be Spherical
-     * Mercator. You will usually have tiles in the same projection as used
-     * for PostGIS, but it is theoretically possible to have your PostGIS data
-     * in, say, lat/lon but still create tiles in Spherical Mercator.
-     */
-    std::unique_ptr<PJ, pj_deleter_t> m_transformation_tile;
 };
 
 } // anonymous namespace
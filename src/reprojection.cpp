@@ -36,6 +36,10 @@ public:
         return point;
     }
 
+    void reproject_points(geom::point_t * /*points*/,
+                          std::size_t /*count*/) const noexcept override
+    {}
+
     geom::point_t target_to_tile(geom::point_t point) const noexcept override
     {
         return lonlat2merc(point);
@@ -54,6 +58,16 @@ public:
         return lonlat2merc(coords);
     }
 
+    void reproject_points(geom::point_t *points,
+                          std::size_t count) const noexcept override
+    {
+        // Tight loop without virtual calls, so the compiler can inline
+        // and vectorize as much as possible.
+        for (std::size_t i = 0; i < count; ++i) {
+            points[i] = lonlat2merc(points[i]);
+        }
+    }
+
     geom::point_t target_to_tile(geom::point_t c) const noexcept override
     {
         return c;
@@ -69,6 +83,14 @@ public:
 
 } // anonymous namespace
 
+void reprojection_t::reproject_points(geom::point_t *points,
+                                      std::size_t count) const
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        points[i] = reproject(points[i]);
+    }
+}
+
 std::shared_ptr<reprojection_t> reprojection_t::create_projection(int srs)
 {
     switch (srs) {
@@ -91,7 +113,8 @@ reprojection_t const &get_projection(int srs)
 {
     // In almost all cases there will be only one or two projections used, so
     // storing them in a vector and doing linear search is totally fine.
-    static std::vector<std::shared_ptr<reprojection_t>> projections;
+    // Each thread has its own registry, so no locking is needed.
+    thread_local std::vector<std::shared_ptr<reprojection_t>> projections;
 
     for (auto const &p : projections) {
         if (p->target_srs() == srs) {
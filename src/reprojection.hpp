@@ -19,6 +19,7 @@
 #include "geom.hpp"
 #include "projection.hpp"
 
+#include <cstddef>
 #include <memory>
 #include <string>
 
@@ -47,6 +48,15 @@ public:
      */
     virtual geom::point_t reproject(geom::point_t point) const = 0;
 
+    /**
+     * Reproject "count" points starting at "points" in place from the
+     * source projection lat/lon (EPSG:4326) to target projection. This
+     * does the same as calling reproject() on each point, but is much
+     * faster for larger numbers of points.
+     */
+    virtual void reproject_points(geom::point_t *points,
+                                  std::size_t count) const;
+
     /**
      * Converts coordinates from target projection to tile projection
      * (EPSG:3857)
@@ -74,8 +84,9 @@ private:
 std::string get_proj_version();
 
 /**
- * Get projection object for given srs. Objects are only created once and
- * then cached.
+ * Get projection object for given srs. Objects are only created once per
+ * thread and then cached. The returned reference must only be used in the
+ * thread that called this function.
  */
 reprojection_t const &get_projection(int srs);
 
@@ -0,0 +1,173 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include "segmented-buffer.hpp"
+
+#include "format.hpp"
+#include "ram-snapshot.hpp"
+
+#include <protozero/varint.hpp>
+
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+bool is_power_of_two(std::size_t value) noexcept
+{
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+} // anonymous namespace
+
+segmented_buffer_t::segmented_buffer_t(std::size_t segment_size)
+: m_mask(segment_size - 1)
+{
+    if (segment_size < MIN_SEGMENT_SIZE || !is_power_of_two(segment_size)) {
+        throw fmt_error("Invalid segment size {}: must be a power of two "
+                        "and at least {}.",
+                        segment_size, MIN_SEGMENT_SIZE);
+    }
+
+    while ((1ULL << m_shift) < segment_size) {
+        ++m_shift;
+    }
+}
+
+void segmented_buffer_t::add_segment(std::size_t size)
+{
+    // Round up to a multiple of the segment size.
+    auto const capacity = (size + m_mask) & ~m_mask;
+    auto const num_slots = capacity >> m_shift;
+
+    auto mapping =
+        std::make_unique<osmium::util::AnonymousMemoryMapping>(capacity);
+
+#ifdef MADV_HUGEPAGE
+    // Huge pages reduce TLB misses on random access to large segments. This
+    // is only a hint and failure is not an error.
+    madvise(mapping->get_addr<char>(), capacity, MADV_HUGEPAGE);
+#endif
+
+    m_current = m_segments.size();
+    auto &segment = m_segments.emplace_back();
+    segment.data = mapping->get_addr<char>();
+    segment.capacity = capacity;
+    segment.mapping = std::move(mapping);
+
+    // Oversized segments take up more than one slot so that offsets stay
+    // strictly increasing.
+    m_segments.resize(m_segments.size() + num_slots - 1);
+
+    m_capacity += capacity;
+}
+
+std::size_t segmented_buffer_t::prepare(std::size_t max_size)
+{
+    if (will_grow(max_size)) {
+        add_segment(max_size);
+    }
+
+    return (m_current << m_shift) + m_segments[m_current].used;
+}
+
+void segmented_buffer_t::append(void const *data, std::size_t size)
+{
+    assert(!m_segments.empty());
+    auto &segment = m_segments[m_current];
+    assert(segment.used + size <= segment.capacity);
+
+    std::memcpy(segment.data + segment.used, data, size);
+    segment.used += size;
+    m_size += size;
+}
+
+void segmented_buffer_t::append_varint(std::uint64_t value)
+{
+    assert(!m_segments.empty());
+    auto &segment = m_segments[m_current];
+    assert(segment.used + protozero::max_varint_length <= segment.capacity);
+
+    auto const length =
+        static_cast<std::size_t>(protozero::add_varint_to_buffer(
+            segment.data + segment.used, value));
+    segment.used += length;
+    m_size += length;
+}
+
+std::size_t segmented_buffer_t::num_segments() const noexcept
+{
+    std::size_t count = 0;
+    for (auto const &segment : m_segments) {
+        if (segment.mapping) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+void segmented_buffer_t::clear() noexcept
+{
+    m_segments.clear();
+    m_segments.shrink_to_fit();
+    m_current = 0;
+    m_size = 0;
+    m_capacity = 0;
+}
+
+void segmented_buffer_t::write_snapshot(ram_snapshot_writer_t *writer) const
+{
+    assert(writer);
+
+    writer->write_value<uint64_t>(segment_size());
+    writer->write_value<uint64_t>(m_segments.size());
+    for (auto const &segment : m_segments) {
+        writer->write_value<uint64_t>(segment.capacity);
+        writer->write_value<uint64_t>(segment.used);
+        writer->write(segment.data, segment.used);
+    }
+}
+
+void segmented_buffer_t::read_snapshot(ram_snapshot_reader_t *reader)
+{
+    assert(reader);
+    assert(m_segments.empty());
+
+    auto const segment_size = reader->read_value<uint64_t>();
+    if (segment_size != this->segment_size()) {
+        throw fmt_error("RAM middle snapshot '{}' has segment size {}, "
+                        "expected {}.",
+                        reader->filename(), segment_size,
+                        this->segment_size());
+    }
+
+    auto const num_slots = reader->read_value<uint64_t>();
+    while (m_segments.size() < num_slots) {
+        auto const capacity = reader->read_value<uint64_t>();
+        auto const used = reader->read_value<uint64_t>();
+        if (capacity == 0 || used > capacity) {
+            throw fmt_error("RAM middle snapshot '{}' is corrupt.",
+                            reader->filename());
+        }
+        add_segment(capacity);
+        auto &segment = m_segments[m_current];
+        std::memcpy(segment.data, reader->read(used), used);
+        segment.used = used;
+        m_size += used;
+
+        // Skip the slots taken up by an oversized segment.
+        for (auto n = (capacity >> m_shift) - 1; n > 0; --n) {
+            reader->read_value<uint64_t>();
+            reader->read_value<uint64_t>();
+        }
+    }
+}
@@ -0,0 +1,174 @@
+#ifndef OSM2PGSQL_SEGMENTED_BUFFER_HPP
+#define OSM2PGSQL_SEGMENTED_BUFFER_HPP
+
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include <osmium/util/memory_mapping.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class ram_snapshot_reader_t;
+class ram_snapshot_writer_t;
+
+/**
+ * A growing byte store made up of fixed-size segments of anonymous memory.
+ *
+ * Unlike a std::string or an auto-growing osmium buffer, this never
+ * reallocates and copies existing data when it grows, it just maps another
+ * segment. So growing is cheap and the memory needed never goes above the
+ * data stored plus one segment.
+ *
+ * Data is appended in "entries". Before appending an entry, prepare() must be
+ * called with the maximum size of that entry. If the entry doesn't fit into
+ * the current segment, a new segment is started, so entries never straddle
+ * segments and can be accessed through a plain pointer. Entries larger than
+ * the segment size get a segment of their own.
+ *
+ * Offsets returned by prepare() encode the segment number in the upper bits
+ * and the position inside the segment in the lower bits. They are strictly
+ * increasing as data is added.
+ */
+class segmented_buffer_t
+{
+public:
+    /// Default segment size (64 MiB).
+    static constexpr std::size_t DEFAULT_SEGMENT_SIZE = 64UL * 1024UL * 1024UL;
+
+    /// Smallest allowed segment size.
+    static constexpr std::size_t MIN_SEGMENT_SIZE = 4096;
+
+    /**
+     * Constructor.
+     *
+     * \param segment_size Size of each segment in bytes. Must be a power of
+     *                     two and at least
+     *                     MIN_SEGMENT_SIZE.
+     */
+    explicit segmented_buffer_t(
+        std::size_t segment_size = DEFAULT_SEGMENT_SIZE);
+
+    /**
+     * Make sure an entry of up to max_size bytes can be appended and return
+     * the offset where it will start.
+     */
+    std::size_t prepare(std::size_t max_size);
+
+    /**
+     * Would prepare() with this size need to allocate a new segment?
+     * Entries must start in the first slot of a segment, so this is also
+     * true if an oversized segment is filled beyond that.
+     */
+    bool will_grow(std::size_t max_size) const noexcept
+    {
+        if (m_segments.empty()) {
+            return true;
+        }
+        auto const &segment = m_segments[m_current];
+        return segment.used + max_size > segment.capacity ||
+               segment.used > m_mask;
+    }
+
+    /// Append data to the current entry.
+    void append(void const *data, std::size_t size);
+
+    /// Append a varint to the current entry.
+    void append_varint(std::uint64_t value);
+
+    /// Get pointer to the data at the specified offset.
+    char const *data(std::size_t offset) const noexcept
+    {
+        assert((offset >> m_shift) < m_segments.size());
+        auto const &segment = m_segments[offset >> m_shift];
+        assert((offset & m_mask) < segment.used);
+        return segment.data + (offset & m_mask);
+    }
+
+    /**
+     * Get pointer to the end of the data stored in the segment containing
+     * the specified offset.
+     */
+    char const *end_of(std::size_t offset) const noexcept
+    {
+        assert((offset >> m_shift) < m_segments.size());
+        auto const &segment = m_segments[offset >> m_shift];
+        return segment.data + segment.used;
+    }
+
+    /// The number of bytes stored.
+    std::size_t size() const noexcept { return m_size; }
+
+    bool empty() const noexcept { return m_size == 0; }
+
+    /// The number of bytes allocated.
+    std::size_t capacity() const noexcept { return m_capacity; }
+
+    /// The number of segments allocated.
+    std::size_t num_segments() const noexcept;
+
+    std::size_t segment_size() const noexcept { return m_mask + 1; }
+
+    /// Return the approximate number of bytes used for internal storage.
+    std::size_t used_memory() const noexcept
+    {
+        return m_capacity + m_segments.capacity() * sizeof(segment_t);
+    }
+
+    /// Remove all data and free the memory.
+    void clear() noexcept;
+
+    /// Write the contents of this buffer to a RAM middle snapshot.
+    void write_snapshot(ram_snapshot_writer_t *writer) const;
+
+    /**
+     * Read the contents of this buffer from a RAM middle snapshot. More
+     * data can be added after that.
+     *
+     * \pre The buffer must be empty.
+     */
+    void read_snapshot(ram_snapshot_reader_t *reader);
+
+private:
+    struct segment_t
+    {
+        /**
+         * The memory of this segment. This is empty for the slots taken up
+         * by the tail end of an oversized segment.
+         */
+        std::unique_ptr<osmium::util::AnonymousMemoryMapping> mapping;
+
+        char *data = nullptr;
+        std::size_t used = 0;
+        std::size_t capacity = 0;
+    };
+
+    /**
+     * Add a new segment with space for at least size bytes and make it the
+     * current segment.
+     */
+    void add_segment(std::size_t size);
+
+    std::vector<segment_t> m_segments;
+
+    /// The index of the segment we are currently appending to.
+    std::size_t m_current = 0;
+
+    std::size_t m_size = 0;
+    std::size_t m_capacity = 0;
+
+    unsigned int m_shift = 0;
+    std::size_t m_mask = 0;
+
+}; // class segmented_buffer_t
+
+#endif // OSM2PGSQL_SEGMENTED_BUFFER_HPP
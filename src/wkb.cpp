@@ -12,6 +12,7 @@
 #include "format.hpp"
 #include "overloaded.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cstdint>
@@ -194,113 +195,168 @@ void write_collection(std::string *data, geom::collection_t const &geom,
     }
 }
 
+constexpr std::size_t SIZE_HEADER = 1UL + 4UL; // byte order + type
+constexpr std::size_t SIZE_SRID = 4UL;
+constexpr std::size_t SIZE_LENGTH = 4UL;
+constexpr std::size_t SIZE_COORDINATE_PAIR = 2UL * sizeof(double);
+
+/**
+ * Functions to calculate the size of the WKB encoding of a geometry
+ * (without SRID). Used to allocate the memory for the encoding in one go.
+ */
+std::size_t wkb_size(geom::nullgeom_t const & /*geom*/) noexcept { return 0; }
+
+std::size_t wkb_size(geom::point_t const & /*geom*/) noexcept
+{
+    return SIZE_HEADER + SIZE_COORDINATE_PAIR;
+}
+
+std::size_t wkb_size_points(geom::point_list_t const &points) noexcept
+{
+    return SIZE_LENGTH + points.size() * SIZE_COORDINATE_PAIR;
+}
+
+std::size_t wkb_size(geom::linestring_t const &geom) noexcept
+{
+    return SIZE_HEADER + wkb_size_points(geom);
+}
+
+std::size_t wkb_size(geom::polygon_t const &geom) noexcept
+{
+    std::size_t size =
+        SIZE_HEADER + SIZE_LENGTH + wkb_size_points(geom.outer());
+    for (auto const &ring : geom.inners()) {
+        size += wkb_size_points(ring);
+    }
+    return size;
+}
+
+std::size_t wkb_size(geom::geometry_t const &geom) noexcept;
+
+template <typename T>
+std::size_t wkb_size(geom::multigeometry_t<T> const &geom) noexcept
+{
+    std::size_t size = SIZE_HEADER + SIZE_LENGTH;
+    for (auto const &item : geom) {
+        size += wkb_size(item);
+    }
+    return size;
+}
+
+std::size_t wkb_size(geom::geometry_t const &geom) noexcept
+{
+    return geom.visit([](auto const &g) { return wkb_size(g); });
+}
+
 class make_ewkb_visitor_t
 {
 public:
-    make_ewkb_visitor_t(uint32_t srid, bool ensure_multi) noexcept
-    : m_srid(srid), m_ensure_multi(ensure_multi)
+    make_ewkb_visitor_t(std::string *data, uint32_t srid,
+                        bool ensure_multi) noexcept
+    : m_data(data), m_srid(srid), m_ensure_multi(ensure_multi)
     {}
 
-    std::string operator()(geom::nullgeom_t const & /*geom*/) const
-    {
-        return {};
-    }
+    void operator()(geom::nullgeom_t const & /*geom*/) const {}
 
-    std::string operator()(geom::point_t const &geom) const
+    void operator()(geom::point_t const &geom) const
     {
-        constexpr std::size_t SIZE_POINT_HEADER_WITH_SRID = 1UL + 4UL + 4UL;
-        constexpr std::size_t SIZE_POINT =
-            SIZE_POINT_HEADER_WITH_SRID + SIZE_COORDINATE_PAIR;
-
-        std::string data;
+        auto const size = reserve(geom, m_ensure_multi);
 
         if (m_ensure_multi) {
-            write_header(&data, wkb_multi_point, m_srid);
-            write_length(&data, 1);
-            write_point(&data, geom);
+            write_header(m_data, wkb_multi_point, m_srid);
+            write_length(m_data, 1);
+            write_point(m_data, geom);
         } else {
-            data.reserve(SIZE_POINT);
-            write_point(&data, geom, m_srid);
-            assert(data.size() == SIZE_POINT);
+            write_point(m_data, geom, m_srid);
         }
 
-        return data;
+        assert(m_data->size() == size);
     }
 
-    std::string operator()(geom::linestring_t const &geom) const
+    void operator()(geom::linestring_t const &geom) const
     {
-        constexpr std::size_t SIZE_HEADER_WITH_COUNT = 1UL + 4UL + 4UL;
-        constexpr std::size_t SIZE_HEADER_WITH_COUNT_AND_SRID =
-            SIZE_HEADER_WITH_COUNT + 4UL;
-
-        std::string data;
-
-        std::size_t const coords_size = geom.size() * SIZE_COORDINATE_PAIR;
+        auto const size = reserve(geom, m_ensure_multi);
 
         if (m_ensure_multi) {
-            data.reserve(SIZE_HEADER_WITH_COUNT_AND_SRID +
-                         SIZE_HEADER_WITH_COUNT + coords_size);
-            write_header(&data, wkb_multi_line, m_srid);
-            write_length(&data, 1);
-            write_linestring(&data, geom);
-            assert(data.size() == SIZE_HEADER_WITH_COUNT_AND_SRID +
-                                      SIZE_HEADER_WITH_COUNT + coords_size);
+            write_header(m_data, wkb_multi_line, m_srid);
+            write_length(m_data, 1);
+            write_linestring(m_data, geom);
         } else {
-            data.reserve(SIZE_HEADER_WITH_COUNT_AND_SRID + coords_size);
-            write_linestring(&data, geom, m_srid);
-            assert(data.size() ==
-                   SIZE_HEADER_WITH_COUNT_AND_SRID + coords_size);
+            write_linestring(m_data, geom, m_srid);
         }
 
-        return data;
+        assert(m_data->size() == size);
     }
 
-    std::string operator()(geom::polygon_t const &geom) const
+    void operator()(geom::polygon_t const &geom) const
     {
-        std::string data;
+        auto const size = reserve(geom, m_ensure_multi);
 
         if (m_ensure_multi) {
-            write_header(&data, wkb_multi_polygon, m_srid);
-            write_length(&data, 1);
-            write_polygon(&data, geom);
+            write_header(m_data, wkb_multi_polygon, m_srid);
+            write_length(m_data, 1);
+            write_polygon(m_data, geom);
         } else {
-            write_polygon(&data, geom, m_srid);
+            write_polygon(m_data, geom, m_srid);
         }
 
-        return data;
+        assert(m_data->size() == size);
     }
 
-    std::string operator()(geom::multipoint_t const &geom) const
+    void operator()(geom::multipoint_t const &geom) const
     {
-        std::string data;
-        write_multipoint(&data, geom, m_srid);
-        return data;
+        auto const size = reserve(geom, false);
+        write_multipoint(m_data, geom, m_srid);
+        assert(m_data->size() == size);
     }
 
-    std::string operator()(geom::multilinestring_t const &geom) const
+    void operator()(geom::multilinestring_t const &geom) const
     {
-        std::string data;
-        write_multilinestring(&data, geom, m_srid);
-        return data;
+        auto const size = reserve(geom, false);
+        write_multilinestring(m_data, geom, m_srid);
+        assert(m_data->size() == size);
     }
 
-    std::string operator()(geom::multipolygon_t const &geom) const
+    void operator()(geom::multipolygon_t const &geom) const
     {
-        std::string data;
-        write_multipolygon(&data, geom, m_srid);
-        return data;
+        auto const size = reserve(geom, false);
+        write_multipolygon(m_data, geom, m_srid);
+        assert(m_data->size() == size);
     }
 
-    std::string operator()(geom::collection_t const &geom) const
+    void operator()(geom::collection_t const &geom) const
     {
-        std::string data;
-        write_collection(&data, geom, m_srid);
-        return data;
+        auto const size = reserve(geom, false);
+        write_collection(m_data, geom, m_srid);
+        assert(m_data->size() == size);
     }
 
 private:
-    static constexpr std::size_t SIZE_COORDINATE_PAIR = 2UL * sizeof(double);
+    /**
+     * Make sure there is enough space in the output string for the EWKB
+     * encoding of the geometry including the SRID. If "wrap" is set, the
+     * geometry is wrapped in a multi geometry.
+     *
+     * \returns The size the output string will have after the geometry
+     *          has been added.
+     */
+    template <typename T>
+    std::size_t reserve(T const &geom, bool wrap) const
+    {
+        std::size_t size = m_data->size() + wkb_size(geom);
+        if (wrap) {
+            size += SIZE_HEADER + SIZE_LENGTH;
+        }
+        if (m_srid) {
+            size += SIZE_SRID;
+        }
+        if (size > m_data->capacity()) {
+            m_data->reserve(std::max(size, 2 * m_data->capacity()));
+        }
+        return size;
+    }
 
+    std::string *m_data;
     uint32_t m_srid;
     bool m_ensure_multi;
 
@@ -570,10 +626,19 @@ private:
 
 } // namespace ewkb
 
+void geom_to_ewkb(std::string *data, geom::geometry_t const &geom,
+                  bool ensure_multi)
+{
+    assert(data);
+    geom.visit(ewkb::make_ewkb_visitor_t{
+        data, static_cast<uint32_t>(geom.srid()), ensure_multi});
+}
+
 std::string geom_to_ewkb(geom::geometry_t const &geom, bool ensure_multi)
 {
-    return geom.visit(ewkb::make_ewkb_visitor_t{
-        static_cast<uint32_t>(geom.srid()), ensure_multi});
+    std::string data;
+    geom_to_ewkb(&data, geom, ensure_multi);
+    return data;
 }
 
 geom::geometry_t ewkb_to_geom(std::string_view wkb)
@@ -31,6 +31,16 @@
 [[nodiscard]] std::string geom_to_ewkb(geom::geometry_t const &geom,
                                        bool ensure_multi = false);
 
+/**
+ * Convert single geometry to EWKB and append it to an existing string.
+ *
+ * \param data Pointer to output string
+ * \param geom Input geometry
+ * \param ensure_multi Wrap non-multi geometries in multi geometries
+ */
+void geom_to_ewkb(std::string *data, geom::geometry_t const &geom,
+                  bool ensure_multi = false);
+
 /**
  * Convert EWKB geometry to geometry object. If the input is empty, a null
  * geometry is returned. If the WKB can not be parsed, an exception is thrown.
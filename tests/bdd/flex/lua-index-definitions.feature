@@ -588,3 +588,95 @@ Feature: Index definitions in Lua file
         Then statement mytable_indexes returns
             | indexdef!re                                | is_primary |
             | CREATE UNIQUE INDEX .* USING .*\(node_id\) | True       |
+
+    Scenario: Unique index on table partitioned by id needs the id column
+        Given the input file 'liechtenstein-2013-08-03.osm.pbf'
+        And the lua style
+            """
+            local t = osm2pgsql.define_table({
+                name = 'mytable',
+                ids = { type = 'node', id_column = 'node_id' },
+                columns = {
+                    { column = 'name', type = 'text' },
+                },
+                indexes = {
+                    { column = 'name', method = 'btree', unique = true }
+                },
+                partition = { by = 'id', count = 2 }
+            })
+            """
+        When running osm2pgsql flex
+        Then execution fails
+        And the error output contains
+            """
+            Unique index on table 'mytable' must contain the partition column 'node_id'.
+            """
+
+    Scenario: Unique index on table partitioned by type needs the type column
+        Given the input file 'liechtenstein-2013-08-03.osm.pbf'
+        And the lua style
+            """
+            local t = osm2pgsql.define_table({
+                name = 'mytable',
+                ids = { type = 'any', id_column = 'osm_id', type_column = 'osm_type' },
+                columns = {
+                    { column = 'name', type = 'text' },
+                },
+                indexes = {
+                    { column = { 'osm_id', 'name' }, method = 'btree', unique = true }
+                },
+                partition = { by = 'type' }
+            })
+            """
+        When running osm2pgsql flex
+        Then execution fails
+        And the error output contains
+            """
+            Unique index on table 'mytable' must contain the partition column 'osm_type'.
+            """
+
+    Scenario: Unique id index on table partitioned by tile doesn't work
+        Given the input file 'liechtenstein-2013-08-03.osm.pbf'
+        And the lua style
+            """
+            local t = osm2pgsql.define_table({
+                name = 'mytable',
+                ids = { type = 'node', id_column = 'node_id', create_index = 'unique' },
+                columns = {
+                    { column = 'geom', type = 'point' },
+                },
+                partition = { by = 'tile', zoom = 1 }
+            })
+            """
+        When running osm2pgsql flex
+        Then execution fails
+        And the error output contains
+            """
+            Unique id index on table 'mytable' must contain the partition column 'partition_tile'.
+            """
+
+    Scenario: Unique index with the partition column works on partitioned table
+        Given the input file 'liechtenstein-2013-08-03.osm.pbf'
+        And the lua style
+            """
+            local t = osm2pgsql.define_table({
+                name = 'mytable',
+                ids = { type = 'node', id_column = 'node_id' },
+                columns = {
+                    { column = 'geom', type = 'point' },
+                },
+                indexes = {
+                    { column = { 'node_id', 'partition_tile' }, method = 'btree', unique = true }
+                },
+                partition = { by = 'tile', zoom = 1 }
+            })
+
+            function osm2pgsql.process_node(object)
+                t:insert({ geom = object:as_point() })
+            end
+            """
+        When running osm2pgsql flex
+        Then table mytable has 1562 rows
+        Then statement mytable_indexes returns
+            | indexdef!re |
+            | CREATE UNIQUE INDEX .* USING btree \(node_id, partition_tile\) |
@@ -0,0 +1,172 @@
+Feature: Generalization of river networks
+
+    Background:
+        Given the lua style
+            """
+            local expire = osm2pgsql.define_expire_output({
+                table = 'osm2pgsql_test_expire',
+                maxzoom = 10,
+            })
+
+            local waterways = osm2pgsql.define_way_table('osm2pgsql_test_waterways', {
+                { column = 'width', type = 'real' },
+                { column = 'name', type = 'text' },
+                { column = 'geom', type = 'linestring', not_null = true,
+                  expire = { { output = expire } } },
+            })
+
+            osm2pgsql.define_way_table('osm2pgsql_test_waterway_areas', {
+                { column = 'width', type = 'real' },
+                { column = 'geom', type = 'polygon', not_null = true },
+            })
+
+            osm2pgsql.define_table({
+                name = 'osm2pgsql_test_rivers',
+                columns = {
+                    { column = 'way_id', type = 'int8' },
+                    { column = 'width', type = 'real' },
+                    { column = 'name', type = 'text' },
+                    { column = 'geom', type = 'linestring', not_null = true },
+                }
+            })
+
+            function osm2pgsql.process_way(object)
+                if object.tags.waterway then
+                    waterways:insert({
+                        width = tonumber(object.tags.width),
+                        name = object.tags.name,
+                        geom = object:as_linestring()
+                    })
+                end
+            end
+
+            function osm2pgsql.process_gen()
+                osm2pgsql.run_gen('rivers', {
+                    name = 'rivers',
+                    debug = true,
+                    src_table = 'osm2pgsql_test_waterways',
+                    dest_table = 'osm2pgsql_test_rivers',
+                    src_areas = 'osm2pgsql_test_waterway_areas',
+                    expire_list = 'osm2pgsql_test_expire',
+                    zoom = 10,
+                })
+            end
+            """
+        And the OSM data
+            """
+            n1 v1 x1.0 y1.2
+            n2 v1 x1.2 y1.2
+            n3 v1 x1.1 y1.1
+            n4 v1 x1.1 y1.0
+            n11 v1 x20.0 y20.2
+            n12 v1 x20.2 y20.2
+            n13 v1 x20.1 y20.1
+            n14 v1 x20.1 y20.0
+            w1 v1 Twaterway=river,width=5 Nn1,n3
+            w2 v1 Twaterway=river,width=1 Nn2,n3
+            w3 v1 Twaterway=river,width=1 Nn3,n4
+            w11 v1 Twaterway=river,width=2 Nn11,n13
+            w12 v1 Twaterway=river,width=1 Nn12,n13
+            w13 v1 Twaterway=river,width=1 Nn13,n14
+            """
+        When running osm2pgsql flex with parameters
+            | --slim |
+        Then execution is successful
+
+        When running osm2pgsql-gen with parameters
+            | --log-level=debug |
+        Then execution is successful
+        And table osm2pgsql_test_rivers contains exactly
+            | way_id | width!:.0f |
+            | 1      | 5          |
+            | 2      | 1          |
+            | 3      | 5          |
+            | 11     | 2          |
+            | 12     | 1          |
+            | 13     | 2          |
+        And table osm2pgsql_test_rivers_components contains exactly
+            | way_id | component |
+            | 1      | 1         |
+            | 2      | 1         |
+            | 3      | 1         |
+            | 11     | 11        |
+            | 12     | 11        |
+            | 13     | 11        |
+
+    Scenario: Only components touched by changes are recomputed
+        Given the OSM data
+            """
+            w12 v2 Twaterway=river,width=8 Nn12,n13
+            """
+        When running osm2pgsql flex with parameters
+            | --slim | -a |
+        Then execution is successful
+
+        When running osm2pgsql-gen with parameters
+            | -a | --log-level=debug |
+        Then execution is successful
+        And the error output contains
+            """
+            Found 3 waterways in components affected by changes.
+            """
+        And table osm2pgsql_test_rivers contains exactly
+            | way_id | width!:.0f |
+            | 1      | 5          |
+            | 2      | 1          |
+            | 3      | 5          |
+            | 11     | 2          |
+            | 12     | 8          |
+            | 13     | 8          |
+        And table osm2pgsql_test_expire has 0 rows
+
+        # Without the components table all waterways are processed again,
+        # which must give the same result as the incremental run.
+        When deleting table osm2pgsql_test_rivers_components
+        And running osm2pgsql-gen with parameters
+            | -a | --log-level=debug |
+        Then execution is successful
+        And the error output contains
+            """
+            Components table missing, processing all waterways.
+            """
+        And table osm2pgsql_test_rivers contains exactly
+            | way_id | width!:.0f |
+            | 1      | 5          |
+            | 2      | 1          |
+            | 3      | 5          |
+            | 11     | 2          |
+            | 12     | 8          |
+            | 13     | 8          |
+        And table osm2pgsql_test_rivers_components contains exactly
+            | way_id | component |
+            | 1      | 1         |
+            | 2      | 1         |
+            | 3      | 1         |
+            | 11     | 11        |
+            | 12     | 11        |
+            | 13     | 11        |
+
+    Scenario: Changes to a component don't touch other components
+        Given the OSM data
+            """
+            w2 v2 Twaterway=river,width=9 Nn2,n3
+            """
+        When running osm2pgsql flex with parameters
+            | --slim | -a |
+        Then execution is successful
+
+        When running osm2pgsql-gen with parameters
+            | -a | --log-level=debug |
+        Then execution is successful
+        And the error output contains
+            """
+            Found 3 waterways in components affected by changes.
+            """
+        And table osm2pgsql_test_rivers contains exactly
+            | way_id | width!:.0f |
+            | 1      | 5          |
+            | 2      | 9          |
+            | 3      | 9          |
+            | 11     | 2          |
+            | 12     | 1          |
+            | 13     | 2          |
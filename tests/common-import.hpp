@@ -156,6 +156,76 @@ public:
         osmdata.stop();
     }
 
+    /**
+     * Rebuild the output tables from the middle tables of an earlier
+     * import (like the --rebuild-output command line option).
+     */
+    void run_rebuild_output(options_t options)
+    {
+        options.connection_params.merge_with(m_db.connection_params());
+
+        properties_t const properties{options.connection_params,
+                                      options.middle_dbschema};
+
+        options_t middle_options{options};
+        middle_options.append = true;
+
+        auto thread_pool = std::make_shared<thread_pool_t>(1U);
+        auto middle = create_middle(thread_pool, middle_options);
+        middle->start();
+
+        auto output = output_t::create_output(middle->get_query_instance(),
+                                              thread_pool, options, properties);
+
+        middle->set_requirements(output->get_requirements());
+
+        osmdata_t osmdata{middle, output, options};
+        osmdata.process_middle();
+        osmdata.stop();
+    }
+
+    /**
+     * Apply several change files one after the other in the same process
+     * (like the --persistent command line option).
+     */
+    void run_rounds(options_t options,
+                    std::initializer_list<std::string> input_data,
+                    std::string const &format = "opl")
+    {
+        options.connection_params.merge_with(m_db.connection_params());
+        options.append = true;
+        options.persistent = true;
+
+        properties_t const properties{options.connection_params,
+                                      options.middle_dbschema};
+
+        auto thread_pool = std::make_shared<thread_pool_t>(1U);
+        auto middle = create_middle(thread_pool, options);
+        middle->start();
+
+        auto output = output_t::create_output(middle->get_query_instance(),
+                                              thread_pool, options, properties);
+
+        middle->set_requirements(output->get_requirements());
+
+        osmdata_t osmdata{middle, output, options};
+
+        bool first = true;
+        for (auto const &data : input_data) {
+            if (!first) {
+                osmdata.start_round();
+            }
+            first = false;
+
+            std::vector<osmium::io::File> const files{
+                osmium::io::File{data.data(), data.size(), format}};
+            process_files(files, &osmdata, true, false);
+            osmdata.finish_round();
+        }
+
+        osmdata.stop();
+    }
+
     void run_import(options_t options, char const *data,
                     std::string const &format = "opl")
     {
@@ -0,0 +1,26 @@
+
+local rels = osm2pgsql.define_relation_table('osm2pgsql_test_attributes', {
+    { column = 'version', type = 'int' },
+    { column = 'timestamp', type = 'int8' },
+    { column = 'changeset', type = 'int8' },
+    { column = 'uid', type = 'int' },
+    { column = 'user', type = 'text' },
+    { column = 'tags', type = 'jsonb' },
+    { column = 'geom', type = 'geometry' }
+})
+
+function osm2pgsql.process_relation(object)
+    local geom
+    if object.tags.type == 'multipolygon' then
+        geom = object:as_multipolygon()
+    end
+    rels:insert({
+        version = object.version,
+        timestamp = object.timestamp,
+        changeset = object.changeset,
+        uid = object.uid,
+        user = object.user,
+        tags = object.tags,
+        geom = geom
+    })
+end
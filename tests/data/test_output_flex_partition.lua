@@ -0,0 +1,65 @@
+local tables = {}
+
+tables.plain = osm2pgsql.define_table{
+    name = 'osm2pgsql_test_plain',
+    ids = { type = 'any', id_column = 'osm_id', type_column = 'osm_type' },
+    columns = {
+        { column = 'name', type = 'text' },
+        { column = 'geom', type = 'geometry' },
+    }
+}
+
+tables.by_type = osm2pgsql.define_table{
+    name = 'osm2pgsql_test_by_type',
+    ids = { type = 'any', id_column = 'osm_id', type_column = 'osm_type' },
+    columns = {
+        { column = 'name', type = 'text' },
+        { column = 'geom', type = 'geometry' },
+    },
+    partition = { by = 'type' }
+}
+
+tables.by_id = osm2pgsql.define_table{
+    name = 'osm2pgsql_test_by_id',
+    ids = { type = 'any', id_column = 'osm_id', type_column = 'osm_type',
+            create_index = 'primary_key' },
+    columns = {
+        { column = 'name', type = 'text' },
+        { column = 'geom', type = 'geometry' },
+    },
+    partition = { by = 'id', count = 4 }
+}
+
+tables.by_tile = osm2pgsql.define_table{
+    name = 'osm2pgsql_test_by_tile',
+    ids = { type = 'any', id_column = 'osm_id', type_column = 'osm_type' },
+    columns = {
+        { column = 'name', type = 'text' },
+        { column = 'geom', type = 'geometry' },
+    },
+    partition = { by = 'tile', zoom = 2, column = 'tile' }
+}
+
+local function insert(geom, tags)
+    for _, t in pairs(tables) do
+        t:insert({ name = tags.name, geom = geom })
+    end
+end
+
+function osm2pgsql.process_node(object)
+    if object.tags.name then
+        insert(object:as_point(), object.tags)
+    end
+end
+
+function osm2pgsql.process_way(object)
+    if object.tags.name then
+        insert(object:as_linestring(), object.tags)
+    end
+end
+
+function osm2pgsql.process_relation(object)
+    if object.tags.name and object.tags.type == 'multipolygon' then
+        insert(object:as_multipolygon(), object.tags)
+    end
+end
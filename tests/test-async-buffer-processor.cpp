@@ -0,0 +1,71 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include <catch.hpp>
+
+#include "async-buffer-processor.hpp"
+
+#include "common-buffer.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+TEST_CASE("sync on empty async buffer processor", "[NoDB]")
+{
+    std::size_t calls = 0;
+    async_buffer_processor_t processor{
+        [&](osmium::memory::Buffer const &) { ++calls; }};
+
+    processor.sync();
+    REQUIRE(calls == 0);
+}
+
+TEST_CASE("async buffer processor keeps order of objects", "[NoDB]")
+{
+    std::vector<osmid_t> ids;
+    async_buffer_processor_t processor{
+        [&](osmium::memory::Buffer const &buffer) {
+            for (auto const &object : buffer.select<osmium::OSMObject>()) {
+                ids.push_back(object.id());
+            }
+        }};
+
+    test_buffer_t buffer;
+    for (osmid_t id = 1; id <= 50000; ++id) {
+        processor.add(buffer.add_node("n" + std::to_string(id) +
+                                      " Tname=Some_name_to_fill_buffers"));
+    }
+    processor.add(buffer.add_way("w1 Nn1,n2"));
+    processor.sync();
+
+    REQUIRE(ids.size() == 50001);
+    for (std::size_t i = 0; i < 50000; ++i) {
+        REQUIRE(ids[i] == static_cast<osmid_t>(i + 1));
+    }
+    REQUIRE(ids.back() == 1);
+
+    // can be used again after sync
+    processor.add(buffer.add_node("n60000"));
+    processor.sync();
+    REQUIRE(ids.size() == 50002);
+    REQUIRE(ids.back() == 60000);
+}
+
+TEST_CASE("async buffer processor reports errors", "[NoDB]")
+{
+    async_buffer_processor_t processor{[](osmium::memory::Buffer const &) {
+        throw std::runtime_error{"processing failed"};
+    }};
+
+    test_buffer_t buffer;
+    processor.add(buffer.add_node("n1"));
+    REQUIRE_THROWS_WITH(processor.sync(), "processing failed");
+    REQUIRE_THROWS_WITH(processor.sync(), "processing failed");
+}
@@ -0,0 +1,133 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include <catch.hpp>
+
+#include "compressed-object-store.hpp"
+#include "ram-snapshot.hpp"
+
+#include "common-buffer.hpp"
+#include "common-cleanup.hpp"
+
+#include <string>
+
+namespace {
+
+std::string tags_for(osmid_t id)
+{
+    return "highway=residential,name=Street_" + std::to_string(id);
+}
+
+void fill_store(compressed_object_store_t *store, osmid_t max_id)
+{
+    test_buffer_t buffer;
+    for (osmid_t id = 1; id <= max_id; ++id) {
+        auto const &way = buffer.add_way(
+            "w" + std::to_string(id * 2) + " Nn" + std::to_string(id) + ",n" +
+            std::to_string(id + 1) + " T" + tags_for(id * 2));
+        store->add(way);
+    }
+}
+
+void check_way(compressed_object_store_t const &store, osmid_t id)
+{
+    osmium::memory::Buffer buffer{1024, osmium::memory::Buffer::auto_grow::yes};
+    REQUIRE(store.get(id, &buffer));
+    auto const &way = buffer.get<osmium::Way>(0);
+    REQUIRE(way.id() == id);
+    REQUIRE(way.nodes().size() == 2);
+    REQUIRE(way.nodes()[0].ref() == id / 2);
+    REQUIRE(way.tags().get_value_by_key("name") ==
+            "Street_" + std::to_string(id));
+}
+
+} // anonymous namespace
+
+TEST_CASE("empty compressed object store", "[NoDB]")
+{
+    compressed_object_store_t const store;
+    osmium::memory::Buffer buffer{1024, osmium::memory::Buffer::auto_grow::yes};
+
+    REQUIRE(store.size() == 0);
+    REQUIRE_FALSE(store.get(1, &buffer));
+    REQUIRE(buffer.committed() == 0);
+}
+
+TEST_CASE("compressed object store with pending block only", "[NoDB]")
+{
+    compressed_object_store_t store;
+    fill_store(&store, 10);
+
+    REQUIRE(store.size() == 10);
+    REQUIRE(store.compressed_size() == 0);
+
+    check_way(store, 2);
+    check_way(store, 20);
+
+    osmium::memory::Buffer buffer{1024, osmium::memory::Buffer::auto_grow::yes};
+    REQUIRE_FALSE(store.get(3, &buffer));
+    REQUIRE_FALSE(store.get(22, &buffer));
+    REQUIRE(buffer.committed() == 0);
+}
+
+TEST_CASE("compressed object store with many blocks", "[NoDB]")
+{
+    compressed_object_store_t store;
+    fill_store(&store, 10000);
+    store.flush();
+
+    REQUIRE(store.size() == 10000);
+    REQUIRE(store.compressed_size() > 0);
+    REQUIRE(store.compressed_size() < store.raw_size() / 2);
+
+    // access in order
+    for (osmid_t id = 2; id <= 20000; id += 2) {
+        check_way(store, id);
+    }
+
+    // access out of order
+    for (osmid_t id = 20000; id > 0; id -= 998) {
+        check_way(store, id);
+    }
+
+    osmium::memory::Buffer buffer{1024, osmium::memory::Buffer::auto_grow::yes};
+    REQUIRE_FALSE(store.get(0, &buffer));
+    REQUIRE_FALSE(store.get(5001, &buffer));
+    REQUIRE_FALSE(store.get(20002, &buffer));
+    REQUIRE(buffer.committed() == 0);
+
+    store.clear();
+    REQUIRE(store.size() == 0);
+    REQUIRE_FALSE(store.get(2, &buffer));
+}
+
+TEST_CASE("compressed object store snapshot", "[NoDB]")
+{
+    std::string const snapshot_file = "test_compressed_object_store.snapshot";
+    testing::cleanup::file_t const snapshot_cleaner{snapshot_file};
+
+    {
+        compressed_object_store_t store;
+        fill_store(&store, 5000);
+
+        ram_snapshot_writer_t writer{snapshot_file};
+        store.write_snapshot(&writer);
+        writer.commit();
+    }
+
+    ram_snapshot_reader_t reader{snapshot_file};
+    compressed_object_store_t store;
+    store.read_snapshot(&reader);
+    REQUIRE(reader.at_end());
+
+    REQUIRE(store.size() == 5000);
+    check_way(store, 2);
+    check_way(store, 5000);
+    check_way(store, 10000);
+}
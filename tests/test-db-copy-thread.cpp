@@ -154,3 +154,48 @@ TEST_CASE("db_copy_thread_t with db_deleter_by_id_t")
         REQUIRE(table_count(conn, "WHERE id = 12") == 1);
     }
 }
+
+TEST_CASE("db_copy_thread_t with db_deleter_by_type_and_id_t")
+{
+    auto const conn = db.connect();
+    conn.exec("DROP TABLE IF EXISTS test_copy_thread");
+    conn.exec("CREATE TABLE test_copy_thread (osm_type char(1), id int8)");
+
+    auto const table = std::make_shared<db_target_descr_t>(
+        "public", "test_copy_thread", "osm_type,id");
+
+    db_copy_thread_t t{db.connection_params()};
+    using cmd_copy_t = db_cmd_copy_delete_t<db_deleter_by_type_and_id_t>;
+
+    cmd_copy_t cmd{table};
+    cmd.buffer += "N\t42\nW\t42\nN\t43\nR\t1\n";
+    t.send_command(std::move(cmd));
+    t.sync_and_wait();
+
+    SECTION("delete by type and id")
+    {
+        cmd = cmd_copy_t{table};
+        cmd.add_deletable('W', 42);
+        cmd.add_deletable('R', 1);
+        cmd.add_deletable('N', 99);
+
+        t.send_command(std::move(cmd));
+        t.sync_and_wait();
+
+        REQUIRE(table_count(conn) == 2);
+        REQUIRE(table_count(conn, "WHERE osm_type = 'N' AND id = 42") == 1);
+        REQUIRE(table_count(conn, "WHERE osm_type = 'W'") == 0);
+    }
+
+    SECTION("delete and add the same")
+    {
+        cmd = cmd_copy_t{table};
+        cmd.add_deletable('N', 43);
+        cmd.buffer += "N\t43\n";
+
+        t.send_command(std::move(cmd));
+        t.finish();
+
+        REQUIRE(table_count(conn, "WHERE id = 43") == 1);
+    }
+}
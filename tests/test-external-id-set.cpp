@@ -0,0 +1,150 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include <catch.hpp>
+
+#include "external-id-set.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+std::vector<osmid_t> read_all(external_id_set_t const &set)
+{
+    std::vector<osmid_t> ids;
+    auto reader = set.reader();
+    osmid_t id = 0;
+    while (reader.next(&id)) {
+        ids.push_back(id);
+    }
+    REQUIRE(reader.count() == ids.size());
+    return ids;
+}
+
+} // anonymous namespace
+
+TEST_CASE("empty external id set", "[NoDB]")
+{
+    external_id_set_t set;
+    REQUIRE(set.empty());
+    REQUIRE(set.size() == 0);
+
+    set.sort_unique();
+    REQUIRE(read_all(set).empty());
+    REQUIRE(set.to_idlist().empty());
+}
+
+TEST_CASE("external id set in memory", "[NoDB]")
+{
+    external_id_set_t set;
+    for (osmid_t const id : {5, 3, 7, 3, 1, 5}) {
+        set.push_back(id);
+    }
+    REQUIRE(set.size() == 6);
+    REQUIRE(set.num_runs() == 0);
+
+    set.sort_unique();
+    REQUIRE(set.size() == 4);
+    REQUIRE(read_all(set) == std::vector<osmid_t>{1, 3, 5, 7});
+    REQUIRE(set.to_idlist() == idlist_t{1, 3, 5, 7});
+}
+
+TEST_CASE("external id set spilled to disk", "[NoDB]")
+{
+    external_id_set_t set{10};
+
+    // Add ids 0 to 999 in a scrambled order and some twice.
+    for (osmid_t i = 0; i < 1000; ++i) {
+        set.push_back((i * 7) % 1000);
+    }
+    for (osmid_t i = 0; i < 1000; i += 3) {
+        set.push_back(i);
+    }
+    REQUIRE(set.num_runs() > 1);
+
+    REQUIRE(set.to_idlist().size() == 1000);
+
+    set.sort_unique();
+    REQUIRE(set.num_runs() == 1);
+    REQUIRE(set.size() == 1000);
+
+    auto const ids = read_all(set);
+    REQUIRE(ids.size() == 1000);
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+        REQUIRE(ids[i] == static_cast<osmid_t>(i));
+    }
+
+    set.clear();
+    REQUIRE(set.empty());
+    REQUIRE(set.num_runs() == 0);
+}
+
+TEST_CASE("external id set operations", "[NoDB]")
+{
+    external_id_set_t a{4};
+    external_id_set_t b{4};
+
+    for (osmid_t i = 1; i <= 20; ++i) {
+        a.push_back(i * 2);
+    }
+    for (osmid_t i = 1; i <= 20; ++i) {
+        b.push_back(i * 3);
+    }
+    a.sort_unique();
+    b.sort_unique();
+
+    SECTION("merge sorted")
+    {
+        a.merge_sorted(b);
+        auto const ids = read_all(a);
+        REQUIRE(ids.size() == 20 + 20 - 6);
+        REQUIRE(a.size() == ids.size());
+        REQUIRE(std::is_sorted(ids.begin(), ids.end()));
+        REQUIRE(ids.front() == 2);
+        REQUIRE(ids.back() == 60);
+    }
+
+    SECTION("remove ids")
+    {
+        a.remove_ids_if_in(b);
+        auto const ids = read_all(a);
+        REQUIRE(ids.size() == 20 - 6);
+        REQUIRE(a.size() == ids.size());
+        for (auto const id : ids) {
+            REQUIRE(id % 2 == 0);
+            REQUIRE(id % 3 != 0);
+        }
+    }
+
+    SECTION("chunks")
+    {
+        std::vector<std::size_t> sizes;
+        osmid_t last = 0;
+        a.for_each_chunk(7, [&](idlist_t const &chunk) {
+            sizes.push_back(chunk.size());
+            for (auto const id : chunk) {
+                REQUIRE(id > last);
+                last = id;
+            }
+        });
+        REQUIRE(sizes == std::vector<std::size_t>{7, 7, 6});
+    }
+
+    SECTION("adding to sorted set")
+    {
+        a.push_back(3);
+        a.push_back(100);
+        a.sort_unique();
+        auto const ids = read_all(a);
+        REQUIRE(ids.size() == 22);
+        REQUIRE(ids[1] == 3);
+        REQUIRE(ids.back() == 100);
+    }
+}
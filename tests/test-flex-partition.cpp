@@ -0,0 +1,150 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include <catch.hpp>
+
+#include "flex-table.hpp"
+#include "geom.hpp"
+
+#include <string>
+
+namespace {
+
+bool contains(std::string const &str, std::string const &part)
+{
+    return str.find(part) != std::string::npos;
+}
+
+} // anonymous namespace
+
+TEST_CASE("unpartitioned interim table is unlogged", "[NoDB]")
+{
+    flex_table_t table{"public", "test", 0};
+    table.add_column("id", "id_num", "");
+    table.add_column("geom", "geometry", "");
+
+    REQUIRE_FALSE(table.is_partitioned());
+
+    auto const sql = table.build_sql_create_table(
+        flex_table_t::table_type::interim, table.full_name());
+    REQUIRE(contains(sql, "CREATE UNLOGGED TABLE"));
+    REQUIRE(contains(sql, "WITH (autovacuum_enabled = off)"));
+    REQUIRE_FALSE(contains(sql, "PARTITION"));
+}
+
+TEST_CASE("table partitioned by id", "[NoDB]")
+{
+    flex_table_t table{"public", "test", 0};
+    table.add_column("id", "id_num", "");
+    table.add_column("geom", "geometry", "");
+    table.set_partition_by_id(4);
+
+    REQUIRE(table.is_partitioned());
+    REQUIRE(table.partition_type() == flex_partition_type::id);
+    REQUIRE(table.partition_column_name() == "id");
+    REQUIRE(table.num_partitions() == 4);
+    REQUIRE(table.partition_name(2) == "test_p2");
+    REQUIRE(table.partition_tmp_name(2) == "test_tmp_p2");
+
+    auto const sql = table.build_sql_create_table(
+        flex_table_t::table_type::interim, table.full_name());
+    REQUIRE_FALSE(contains(sql, "UNLOGGED"));
+    REQUIRE_FALSE(contains(sql, "autovacuum_enabled"));
+    REQUIRE(contains(sql, R"() PARTITION BY HASH ("id"))"));
+
+    auto const partition = table.build_sql_create_partition(
+        flex_table_t::table_type::interim, table.full_name(), 3,
+        R"("public"."test_p3")");
+    REQUIRE(contains(partition, R"(CREATE UNLOGGED TABLE IF NOT EXISTS )"
+                                R"("public"."test_p3" PARTITION OF )"
+                                R"("public"."test" FOR VALUES )"
+                                R"(WITH (MODULUS 4, REMAINDER 3))"));
+    REQUIRE(contains(partition, "WITH (autovacuum_enabled = off)"));
+
+    auto const permanent = table.build_sql_create_partition(
+        flex_table_t::table_type::permanent, table.full_name(), 0,
+        R"("public"."test_p0")");
+    REQUIRE_FALSE(contains(permanent, "UNLOGGED"));
+    REQUIRE_FALSE(contains(permanent, "autovacuum_enabled"));
+
+    REQUIRE(contains(table.build_sql_create_partition_id_index(1),
+                     R"(INDEX ON "public"."test_p1" USING BTREE (id))"));
+}
+
+TEST_CASE("table partitioned by type", "[NoDB]")
+{
+    flex_table_t table{"public", "test", 0};
+    table.add_column("osm_type", "id_type", "");
+    table.add_column("osm_id", "id_num", "");
+    table.set_partition_by_type();
+
+    REQUIRE(table.partition_column_name() == "osm_type");
+    REQUIRE(table.num_partitions() == 3);
+
+    auto const sql = table.build_sql_create_table(
+        flex_table_t::table_type::permanent, table.full_name());
+    REQUIRE(contains(sql, R"() PARTITION BY LIST ("osm_type"))"));
+
+    auto const partition = table.build_sql_create_partition(
+        flex_table_t::table_type::permanent, table.full_name(), 1,
+        R"("public"."test_p1")");
+    REQUIRE(contains(partition, "FOR VALUES IN ('W')"));
+}
+
+TEST_CASE("table partitioned by tile", "[NoDB]")
+{
+    flex_table_t table{"public", "test", 0};
+    table.add_column("id", "id_num", "");
+    table.add_column("geom", "geometry", "");
+    table.set_partition_by_tile(1, "part");
+
+    REQUIRE(table.num_partitions() == 4);
+    REQUIRE(table.num_columns() == 3);
+    REQUIRE(table.partition_column_name() == "part");
+
+    auto const &column = table.columns().back();
+    REQUIRE(column.name() == "part");
+    REQUIRE(table.is_partition_column(column));
+    REQUIRE_FALSE(table.is_partition_column(table.columns().front()));
+
+    auto const sql = table.build_sql_create_table(
+        flex_table_t::table_type::permanent, table.full_name());
+    REQUIRE(contains(sql, R"() PARTITION BY LIST ("part"))"));
+
+    auto const partition = table.build_sql_create_partition(
+        flex_table_t::table_type::permanent, table.full_name(), 2,
+        R"("public"."test_p2")");
+    REQUIRE(contains(partition, "FOR VALUES IN (2)"));
+
+    // Tiles are numbered row by row from the top left
+    REQUIRE(table.tile_partition(geom::geometry_t{geom::point_t{-90, 45}}) ==
+            0);
+    REQUIRE(table.tile_partition(geom::geometry_t{geom::point_t{90, 45}}) ==
+            1);
+    REQUIRE(table.tile_partition(geom::geometry_t{geom::point_t{-90, -45}}) ==
+            2);
+    REQUIRE(table.tile_partition(geom::geometry_t{geom::point_t{90, -45}}) ==
+            3);
+
+    // Coordinates outside the valid range are clamped
+    REQUIRE(table.tile_partition(geom::geometry_t{geom::point_t{180, -90}}) ==
+            3);
+
+    REQUIRE(table.tile_partition(geom::geometry_t{
+                geom::point_t{1000.0, -1000.0}, PROJ_SPHERE_MERC}) == 3);
+
+    // The center of the bounding box is used
+    geom::geometry_t line{geom::linestring_t{{-100, 10}, {10, 20}}};
+    REQUIRE(table.tile_partition(line) == 0);
+
+    REQUIRE(table.tile_partition(geom::geometry_t{}) == 0);
+
+    REQUIRE_THROWS(
+        table.tile_partition(geom::geometry_t{geom::point_t{1, 2}, 2056}));
+}
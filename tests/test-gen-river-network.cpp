@@ -0,0 +1,241 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include <catch.hpp>
+
+#include "gen/river-network.hpp"
+
+#include <map>
+#include <utility>
+
+namespace {
+
+struct edge_result_t
+{
+    double width;
+    geom::linestring_t points;
+};
+
+/// Get all edges of the network keyed by the id of their first waterway.
+std::map<osmid_t, edge_result_t> get_edges(river_network_t const &network)
+{
+    std::map<osmid_t, edge_result_t> edges;
+    network.for_each_edge(
+        [&](osmid_t id, double width, geom::linestring_t &&points) {
+            auto const inserted =
+                edges.emplace(id, edge_result_t{width, std::move(points)});
+            REQUIRE(inserted.second);
+        });
+    return edges;
+}
+
+/// Get the component key for all waterways of the network.
+std::map<osmid_t, osmid_t> get_components(river_network_t const &network)
+{
+    std::map<osmid_t, osmid_t> components;
+    network.for_each_waterway_component(
+        [&](osmid_t id, osmid_t component) { components[id] = component; });
+    return components;
+}
+
+void build(river_network_t *network, unsigned int num_threads)
+{
+    network->build(num_threads);
+    network->propagate_widths(num_threads);
+}
+
+} // anonymous namespace
+
+TEST_CASE("empty river network", "[NoDB]")
+{
+    river_network_t network;
+    build(&network, 1);
+
+    REQUIRE(network.num_waterways() == 0);
+    REQUIRE(network.num_nodes() == 0);
+    REQUIRE(network.num_edges() == 0);
+    REQUIRE(network.num_components() == 0);
+}
+
+TEST_CASE("waterways sharing end points are joined into one edge", "[NoDB]")
+{
+    river_network_t network;
+    network.add_waterway(30, 1.0, geom::linestring_t{{0, 0}, {1, 0}});
+    network.add_waterway(31, 2.0, geom::linestring_t{{1, 0}, {2, 0}});
+    network.add_waterway(32, 3.0, geom::linestring_t{{2, 0}, {3, 0}});
+    build(&network, 1);
+
+    REQUIRE(network.num_waterways() == 3);
+    REQUIRE(network.num_nodes() == 4);
+    REQUIRE(network.num_segments() == 3);
+    REQUIRE(network.num_edges() == 1);
+
+    auto const edges = get_edges(network);
+    REQUIRE(edges.size() == 1);
+    auto const &edge = edges.at(30);
+    REQUIRE(edge.width == Approx(3.0));
+    REQUIRE(edge.points ==
+            geom::linestring_t{{0, 0}, {1, 0}, {2, 0}, {3, 0}});
+}
+
+TEST_CASE("edges end where the river network branches", "[NoDB]")
+{
+    river_network_t network;
+
+    // Two tributaries flow into the main river at (2, 0), which splits
+    // into two branches at (5, 0).
+    network.add_waterway(1, 5.0, geom::linestring_t{{0, 0}, {1, 0}, {2, 0}});
+    network.add_waterway(2, 10.0, geom::linestring_t{{2, 1}, {2, 0}});
+    network.add_waterway(3, 1.0, geom::linestring_t{{2, 0}, {3, 0}, {4, 0}});
+    network.add_waterway(4, 2.0, geom::linestring_t{{4, 0}, {5, 0}});
+    network.add_waterway(5, 1.0, geom::linestring_t{{5, 0}, {6, 1}});
+    network.add_waterway(6, 1.0, geom::linestring_t{{5, 0}, {6, -1}});
+    build(&network, 2);
+
+    REQUIRE(network.num_nodes() == 9);
+    REQUIRE(network.num_segments() == 8);
+    REQUIRE(network.num_edges() == 5);
+    REQUIRE(network.num_components() == 1);
+
+    auto const edges = get_edges(network);
+    REQUIRE(edges.size() == 5);
+
+    // Waterways 3 and 4 meet at a point which is not a branch, so they
+    // are in the same edge.
+    REQUIRE(edges.at(3).points ==
+            geom::linestring_t{{2, 0}, {3, 0}, {4, 0}, {5, 0}});
+    REQUIRE(edges.count(4) == 0);
+
+    SECTION("widths are propagated downstream")
+    {
+        REQUIRE(edges.at(1).width == Approx(5.0));
+        REQUIRE(edges.at(2).width == Approx(10.0));
+        REQUIRE(edges.at(3).width == Approx(10.0));
+        REQUIRE(edges.at(5).width == Approx(10.0));
+        REQUIRE(edges.at(6).width == Approx(10.0));
+    }
+}
+
+TEST_CASE("closed waterway forms a single edge", "[NoDB]")
+{
+    river_network_t network;
+    network.add_waterway(
+        20, 3.0, geom::linestring_t{{5, 5}, {6, 5}, {6, 6}, {5, 5}});
+    build(&network, 1);
+
+    REQUIRE(network.num_nodes() == 3);
+    REQUIRE(network.num_edges() == 1);
+    REQUIRE(network.num_components() == 1);
+
+    auto const edges = get_edges(network);
+    REQUIRE(edges.at(20).width == Approx(3.0));
+    REQUIRE(edges.at(20).points ==
+            geom::linestring_t{{5, 5}, {6, 5}, {6, 6}, {5, 5}});
+}
+
+TEST_CASE("widths are propagated around cycles", "[NoDB]")
+{
+    river_network_t network;
+
+    // Cycle (1, 0) -> (1, 1) -> (0, 1) -> (1, 0) with one waterway flowing
+    // in and one flowing out.
+    network.add_waterway(10, 4.0, geom::linestring_t{{0, 0}, {1, 0}});
+    network.add_waterway(11, 1.0, geom::linestring_t{{1, 0}, {1, 1}});
+    network.add_waterway(12, 7.0, geom::linestring_t{{1, 1}, {0, 1}});
+    network.add_waterway(13, 1.0, geom::linestring_t{{0, 1}, {1, 0}});
+    network.add_waterway(14, 2.0, geom::linestring_t{{1, 1}, {2, 2}});
+    build(&network, 2);
+
+    REQUIRE(network.num_nodes() == 5);
+    REQUIRE(network.num_segments() == 5);
+    REQUIRE(network.num_edges() == 4);
+    REQUIRE(network.num_components() == 1);
+
+    auto const edges = get_edges(network);
+
+    // Not influenced by the cycle, because it is upstream of it.
+    REQUIRE(edges.at(10).width == Approx(4.0));
+
+    // Everything in the cycle is upstream of everything else in it.
+    REQUIRE(edges.at(11).width == Approx(7.0));
+    REQUIRE(edges.at(12).width == Approx(7.0));
+    REQUIRE(edges.at(12).points ==
+            geom::linestring_t{{1, 1}, {0, 1}, {1, 0}});
+    REQUIRE(edges.at(14).width == Approx(7.0));
+}
+
+TEST_CASE("waterways get the id of their connected component", "[NoDB]")
+{
+    river_network_t network;
+    network.add_waterway(7, 1.0, geom::linestring_t{{0, 0}, {1, 0}});
+    network.add_waterway(3, 1.0, geom::linestring_t{{1, 0}, {2, 0}});
+    network.add_waterway(9, 1.0, geom::linestring_t{{3, 1}, {2, 0}});
+    network.add_waterway(5, 1.0, geom::linestring_t{{10, 10}, {11, 10}});
+    network.add_waterway(8, 1.0, geom::linestring_t{{11, 10}, {12, 10}});
+    network.add_waterway(4, 1.0, geom::linestring_t{{20, 20}, {21, 21}});
+    build(&network, 4);
+
+    REQUIRE(network.num_components() == 3);
+
+    auto const components = get_components(network);
+    REQUIRE(components.size() == 6);
+    REQUIRE(components.at(7) == 3);
+    REQUIRE(components.at(3) == 3);
+    REQUIRE(components.at(9) == 3);
+    REQUIRE(components.at(5) == 5);
+    REQUIRE(components.at(8) == 5);
+    REQUIRE(components.at(4) == 4);
+}
+
+TEST_CASE("number of threads doesn't change the result", "[NoDB]")
+{
+    auto const create = [](unsigned int num_threads) {
+        river_network_t network;
+        osmid_t id = 1;
+        for (int y = 0; y < 20; ++y) {
+            for (int x = 0; x < 20; ++x) {
+                // A grid of waterways flowing right and down, some of them
+                // wider than others.
+                double const width = (x * y) % 7;
+                geom::point_t const point{static_cast<double>(x),
+                                          static_cast<double>(y)};
+                network.add_waterway(
+                    id++, width,
+                    geom::linestring_t{point, {point.x() + 1, point.y()}});
+                network.add_waterway(
+                    id++, width,
+                    geom::linestring_t{point, {point.x(), point.y() + 1}});
+            }
+        }
+        build(&network, num_threads);
+        return network;
+    };
+
+    auto const single = create(1);
+    auto const multi = create(4);
+
+    REQUIRE(single.num_nodes() == multi.num_nodes());
+    REQUIRE(single.num_segments() == multi.num_segments());
+    REQUIRE(single.num_edges() == multi.num_edges());
+    REQUIRE(single.num_components() == 1);
+    REQUIRE(multi.num_components() == 1);
+
+    auto const single_edges = get_edges(single);
+    auto const multi_edges = get_edges(multi);
+    REQUIRE(single_edges.size() == multi_edges.size());
+    for (auto const &[id, edge] : single_edges) {
+        auto const &other = multi_edges.at(id);
+        REQUIRE(edge.width == Approx(other.width));
+        REQUIRE(edge.points == other.points);
+    }
+
+    // The last edge in the bottom right corner gets the maximum width
+    // from everything upstream.
+    REQUIRE(single_edges.at(800).width == Approx(6.0));
+}
@@ -14,6 +14,8 @@
 #include "geom-pole-of-inaccessibility.hpp"
 #include "geom.hpp"
 
+#include <cmath>
+
 TEST_CASE("null geometry returns null geom", "[NoDB]")
 {
     geom::geometry_t const geom{};
@@ -66,3 +68,39 @@ TEST_CASE("pole_of_inaccessibility with stretch factor", "[NoDB]")
     REQUIRE(pole_of_inaccessibility(geom, 0.01, 2) ==
             geom::geometry_t{geom::point_t{1.0, 0.5}});
 }
+
+TEST_CASE("pole_of_inaccessibility of polygon with many points", "[NoDB]")
+{
+    // Circle with a radius of 10 around (5, 5) and a circular hole with a
+    // radius of 4 around (1, 5). The pole is on the right side of the hole.
+    auto const circle = [](double cx, double cy, double r, bool reverse) {
+        constexpr double PI = 3.14159265358979323846;
+        std::size_t const num_points = 20000;
+        geom::ring_t ring;
+        for (std::size_t i = 0; i < num_points; ++i) {
+            double const angle =
+                (reverse ? -2.0 : 2.0) * PI * static_cast<double>(i) /
+                static_cast<double>(num_points);
+            ring.emplace_back(cx + r * std::cos(angle),
+                              cy + r * std::sin(angle));
+        }
+        ring.push_back(ring.front());
+        return ring;
+    };
+
+    geom::polygon_t polygon{circle(5.0, 5.0, 10.0, false)};
+
+    auto const pole = geom::pole_of_inaccessibility(polygon, 0.0001);
+    REQUIRE(pole.x() == Approx(5.0).margin(0.02));
+    REQUIRE(pole.y() == Approx(5.0).margin(0.02));
+
+    polygon.inners().push_back(circle(1.0, 5.0, 4.0, true));
+
+    // The largest inscribed circle touches the outer ring at (15, 5) and the
+    // inner ring at (5, 5), so it has its center at (10, 5). The distance
+    // changes only very slowly in y direction around that point, so the
+    // result is less precise in y direction.
+    auto const pole_with_hole = geom::pole_of_inaccessibility(polygon, 0.0001);
+    REQUIRE(pole_with_hole.x() == Approx(10.0).margin(0.05));
+    REQUIRE(pole_with_hole.y() == Approx(5.0).margin(0.5));
+}
@@ -9,6 +9,7 @@
 
 #include <catch.hpp>
 
+#include "format.hpp"
 #include "hex.hpp"
 
 #include <string>
@@ -36,6 +37,29 @@ TEST_CASE("hex encoding an empty string doesn't change output string", "[NoDB]")
     REQUIRE(result == "foo");
 }
 
+TEST_CASE("hex encode in place", "[NoDB]")
+{
+    std::string const prefix{"abc"};
+
+    // Test different lengths to make sure all code paths are used
+    for (std::size_t len = 0; len < 70; ++len) {
+        std::string input;
+        for (std::size_t i = 0; i < len; ++i) {
+            input += static_cast<char>((i * 37U + 11U) & 0xffU);
+        }
+
+        std::string expected{prefix};
+        for (auto const c : input) {
+            expected += fmt::format("{:02X}", static_cast<unsigned char>(c));
+        }
+
+        std::string result{prefix + input};
+        util::encode_hex_in_place(&result, prefix.size());
+        REQUIRE(result == expected);
+        REQUIRE(util::decode_hex(result.substr(prefix.size())) == input);
+    }
+}
+
 TEST_CASE("wkb hex decode of valid and invalid hex characters")
 {
     REQUIRE(util::decode_hex_char('0') == 0);
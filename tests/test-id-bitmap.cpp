@@ -0,0 +1,159 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include <catch.hpp>
+
+#include "id-bitmap.hpp"
+
+#include <random>
+#include <set>
+#include <vector>
+
+namespace {
+
+std::vector<osmid_t> get_ids(id_bitmap_t const &bitmap)
+{
+    std::vector<osmid_t> ids;
+    bitmap.for_each([&](osmid_t id) { ids.push_back(id); });
+    return ids;
+}
+
+} // anonymous namespace
+
+TEST_CASE("id_bitmap_t starts out empty", "[NoDB]")
+{
+    id_bitmap_t const bitmap;
+    REQUIRE(bitmap.empty());
+    REQUIRE(bitmap.size() == 0);
+    REQUIRE_FALSE(bitmap.contains(0));
+    REQUIRE_FALSE(bitmap.contains(17));
+}
+
+TEST_CASE("id_bitmap_t add and remove ids", "[NoDB]")
+{
+    id_bitmap_t bitmap;
+    bitmap.add_sorted(idlist_t{-5, 1, 3, 70000, 1000000000000});
+
+    REQUIRE(bitmap.size() == 5);
+    REQUIRE(bitmap.contains(-5));
+    REQUIRE(bitmap.contains(1));
+    REQUIRE(bitmap.contains(3));
+    REQUIRE(bitmap.contains(70000));
+    REQUIRE(bitmap.contains(1000000000000));
+    REQUIRE_FALSE(bitmap.contains(-4));
+    REQUIRE_FALSE(bitmap.contains(2));
+    REQUIRE_FALSE(bitmap.contains(70000 + 65536));
+
+    // adding existing ids doesn't change anything
+    bitmap.add_sorted(idlist_t{1, 2, 3});
+    REQUIRE(bitmap.size() == 6);
+    REQUIRE(bitmap.contains(2));
+
+    bitmap.remove_sorted(idlist_t{-5, 2, 4, 70000});
+    REQUIRE(bitmap.size() == 3);
+    REQUIRE_FALSE(bitmap.contains(-5));
+    REQUIRE_FALSE(bitmap.contains(2));
+    REQUIRE_FALSE(bitmap.contains(70000));
+
+    REQUIRE(get_ids(bitmap) == std::vector<osmid_t>{1, 3, 1000000000000});
+}
+
+TEST_CASE("id_bitmap_t with dense block", "[NoDB]")
+{
+    id_bitmap_t bitmap;
+
+    idlist_t even;
+    for (osmid_t id = 0; id < 65536; id += 2) {
+        even.push_back(id);
+    }
+    bitmap.add_sorted(even);
+    REQUIRE(bitmap.size() == 32768);
+    REQUIRE(bitmap.contains(0));
+    REQUIRE(bitmap.contains(65534));
+    REQUIRE_FALSE(bitmap.contains(65535));
+
+    // A dense block needs less memory than a list of ids
+    REQUIRE(bitmap.used_memory() < 32768 * sizeof(osmid_t) / 4);
+
+    idlist_t most;
+    for (osmid_t id = 0; id < 65536 - 200; id += 2) {
+        most.push_back(id);
+    }
+    bitmap.remove_sorted(most);
+    REQUIRE(bitmap.size() == 100);
+    REQUIRE_FALSE(bitmap.contains(0));
+    REQUIRE(bitmap.contains(65534));
+
+    auto const ids = get_ids(bitmap);
+    REQUIRE(ids.size() == 100);
+    REQUIRE(ids.front() == 65336);
+    REQUIRE(ids.back() == 65534);
+}
+
+TEST_CASE("id_bitmap_t merge", "[NoDB]")
+{
+    id_bitmap_t a;
+    a.add_sorted(idlist_t{1, 5, 100000});
+
+    id_bitmap_t b;
+    idlist_t ids;
+    for (osmid_t id = 0; id < 10000; ++id) {
+        ids.push_back(id);
+    }
+    ids.push_back(200000);
+    b.add_sorted(ids);
+
+    a.merge(std::move(b));
+    REQUIRE(a.size() == 10002);
+    REQUIRE(a.contains(9999));
+    REQUIRE(a.contains(100000));
+    REQUIRE(a.contains(200000));
+    REQUIRE(b.empty());
+}
+
+TEST_CASE("id_bitmap_t compared to std::set", "[NoDB]")
+{
+    std::mt19937 gen{42}; // NOLINT(cert-msc32-c,cert-msc51-cpp)
+    std::uniform_int_distribution<osmid_t> dist{-100000, 1000000};
+
+    id_bitmap_t bitmap;
+    std::set<osmid_t> reference;
+
+    for (int round = 0; round < 10; ++round) {
+        std::set<osmid_t> add;
+        std::set<osmid_t> remove;
+        for (int i = 0; i < 20000; ++i) {
+            add.insert(dist(gen));
+            remove.insert(dist(gen));
+        }
+
+        idlist_t add_list;
+        for (auto const id : add) {
+            add_list.push_back(id);
+            reference.insert(id);
+        }
+        bitmap.add_sorted(add_list);
+
+        idlist_t remove_list;
+        for (auto const id : remove) {
+            remove_list.push_back(id);
+            reference.erase(id);
+        }
+        bitmap.remove_sorted(remove_list);
+
+        REQUIRE(bitmap.size() == reference.size());
+    }
+
+    for (osmid_t id = -100000; id <= 1000000; id += 7) {
+        REQUIRE(bitmap.contains(id) == (reference.count(id) > 0));
+    }
+
+    REQUIRE(get_ids(bitmap) ==
+            std::vector<osmid_t>(reference.cbegin(), reference.cend()));
+}
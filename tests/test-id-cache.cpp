@@ -0,0 +1,99 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include <catch.hpp>
+
+#include "id-cache.hpp"
+
+TEST_CASE("id_cache_t starts out empty", "[NoDB]")
+{
+    id_cache_t cache;
+    REQUIRE(cache.size() == 0);
+    REQUIRE_FALSE(cache.contains(17));
+
+    cache.commit();
+    REQUIRE(cache.size() == 0);
+}
+
+TEST_CASE("id_cache_t ids are only visible after commit", "[NoDB]")
+{
+    id_cache_t cache;
+    cache.add(17);
+    cache.add(3);
+    cache.add(17);
+
+    REQUIRE_FALSE(cache.contains(3));
+    REQUIRE_FALSE(cache.contains(17));
+
+    cache.commit();
+    REQUIRE(cache.size() == 2);
+    REQUIRE(cache.contains(3));
+    REQUIRE(cache.contains(17));
+    REQUIRE_FALSE(cache.contains(4));
+}
+
+TEST_CASE("id_cache_t with ids from source", "[NoDB]")
+{
+    id_cache_t cache;
+    cache.add_from_source(idlist_t{5, 1, 3});
+    cache.add_from_source(idlist_t{2, 3});
+    cache.add(4);
+    cache.commit();
+
+    REQUIRE(cache.size() == 5);
+    for (osmid_t id = 1; id <= 5; ++id) {
+        REQUIRE(cache.contains(id));
+    }
+}
+
+TEST_CASE("id_cache_t remove ids", "[NoDB]")
+{
+    id_cache_t cache;
+    cache.add_from_source(idlist_t{1, 2, 3, 4});
+    cache.commit();
+
+    cache.remove(2);
+    cache.remove(4);
+    cache.remove(7);
+    REQUIRE(cache.contains(2));
+
+    cache.commit();
+    REQUIRE(cache.size() == 2);
+    REQUIRE(cache.contains(1));
+    REQUIRE_FALSE(cache.contains(2));
+    REQUIRE(cache.contains(3));
+    REQUIRE_FALSE(cache.contains(4));
+    REQUIRE_FALSE(cache.contains(7));
+}
+
+TEST_CASE("id_cache_t order of add and remove matters", "[NoDB]")
+{
+    id_cache_t cache;
+    cache.add_from_source(idlist_t{1, 2});
+    cache.commit();
+
+    // modified object: removed and added again
+    cache.remove(1);
+    cache.add(1);
+
+    // object added and then deleted
+    cache.add(3);
+    cache.remove(3);
+
+    // object removed, added, and removed again
+    cache.remove(2);
+    cache.add(2);
+    cache.remove(2);
+
+    cache.commit();
+    REQUIRE(cache.size() == 1);
+    REQUIRE(cache.contains(1));
+    REQUIRE_FALSE(cache.contains(2));
+    REQUIRE_FALSE(cache.contains(3));
+}
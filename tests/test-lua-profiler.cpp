@@ -0,0 +1,137 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include <catch.hpp>
+
+#include "common-cleanup.hpp"
+#include "lua-profiler.hpp"
+
+#include <lua.hpp>
+
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+
+namespace {
+
+char const *const LUA_CODE = R"(
+function inner(n)
+    local sum = 0
+    for i = 1, n do
+        sum = sum + i
+    end
+    return sum
+end
+
+function outer()
+    return inner(100000)
+end
+
+function short()
+    return inner(10)
+end
+)";
+
+std::shared_ptr<lua_State> init_lua()
+{
+    std::shared_ptr<lua_State> lua_state{
+        luaL_newstate(), [](lua_State *state) { lua_close(state); }};
+    luaL_openlibs(lua_state.get());
+    REQUIRE(luaL_dostring(lua_state.get(), LUA_CODE) == 0);
+    return lua_state;
+}
+
+void call_outer(lua_State *lua_state)
+{
+    lua_getglobal(lua_state, "outer");
+    REQUIRE(lua_pcall(lua_state, 0, 1, 0) == 0);
+    REQUIRE(lua_tointeger(lua_state, -1) == 5000050000);
+    lua_pop(lua_state, 1);
+}
+
+} // anonymous namespace
+
+TEST_CASE("Lua profiler without samples", "[NoDB]")
+{
+    auto const lua_state = init_lua();
+    lua_profiler_t const profiler{lua_state.get()};
+
+    call_outer(lua_state.get());
+
+    REQUIRE(profiler.num_samples() == 0);
+    REQUIRE(profiler.to_folded().empty());
+}
+
+TEST_CASE("Lua profiler samples call stacks", "[NoDB]")
+{
+    auto const lua_state = init_lua();
+    lua_profiler_t profiler{lua_state.get(), 100};
+
+    profiler.start("node;osm2pgsql.process_node");
+    call_outer(lua_state.get());
+    profiler.stop();
+
+    auto const samples = profiler.num_samples();
+    REQUIRE(samples > 0);
+
+    // No more samples after stop()
+    call_outer(lua_state.get());
+    REQUIRE(profiler.num_samples() == samples);
+
+    auto const folded = profiler.to_folded();
+    REQUIRE(folded.rfind("node;osm2pgsql.process_node;", 0) == 0);
+    // Functions called from C don't have a name, they are identified
+    // by the line they are defined on.
+    REQUIRE(folded.find(";function@10 ([string") != std::string::npos);
+    REQUIRE(folded.find(";inner ([string") != std::string::npos);
+    REQUIRE(folded.back() == '\n');
+}
+
+TEST_CASE("Lua profiler writes folded stacks to file", "[NoDB]")
+{
+    std::string const filename{"test_lua_profile.folded"};
+    testing::cleanup::file_t const file_cleaner{filename};
+
+    auto const lua_state = init_lua();
+    lua_profiler_t profiler{lua_state.get(), 100};
+
+    profiler.start("way;osm2pgsql.process_way");
+    call_outer(lua_state.get());
+    profiler.stop();
+    profiler.write(filename);
+
+    std::ifstream file{filename};
+    std::string const content{std::istreambuf_iterator<char>{file},
+                              std::istreambuf_iterator<char>{}};
+    REQUIRE(content == profiler.to_folded());
+}
+
+TEST_CASE("Lua profiler samples many short calls", "[NoDB]")
+{
+    auto const lua_state = init_lua();
+    lua_profiler_t profiler{lua_state.get(), 1000};
+
+    // Each call runs far fewer instructions than the sample interval, so
+    // they are only sampled if the instruction count carries over from one
+    // call to the next.
+    for (int i = 0; i < 10000; ++i) {
+        profiler.start("node;osm2pgsql.process_node");
+        lua_getglobal(lua_state.get(), "short");
+        REQUIRE(lua_pcall(lua_state.get(), 0, 1, 0) == 0);
+        REQUIRE(lua_tointeger(lua_state.get(), -1) == 55);
+        lua_pop(lua_state.get(), 1);
+        profiler.stop();
+    }
+
+    REQUIRE(profiler.num_samples() > 10);
+
+    auto const folded = profiler.to_folded();
+    REQUIRE(folded.find(";function@14 ([string") != std::string::npos);
+}
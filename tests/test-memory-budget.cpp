@@ -0,0 +1,98 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include <catch.hpp>
+
+#include "memory-budget.hpp"
+
+TEST_CASE("memory budget without limit", "[NoDB]")
+{
+    memory_budget_t budget;
+
+    auto &consumer = budget.consumer("test");
+    consumer.set(1000);
+
+    REQUIRE(budget.limit() == 0);
+    REQUIRE(budget.used() == 1000);
+    REQUIRE_FALSE(budget.under_pressure());
+    REQUIRE_FALSE(budget.exceeded());
+
+    REQUIRE_FALSE(budget.accounting_enabled());
+    budget.enable_accounting();
+    REQUIRE(budget.accounting_enabled());
+}
+
+TEST_CASE("memory budget sums up consumers", "[NoDB]")
+{
+    memory_budget_t budget;
+
+    auto &a = budget.consumer("a");
+    auto &b = budget.consumer("b");
+    REQUIRE(&budget.consumer("a") == &a);
+
+    a.set(100);
+    b.add(50);
+    b.add(30);
+    REQUIRE(a.used() == 100);
+    REQUIRE(b.used() == 80);
+    REQUIRE(budget.used() == 180);
+
+    a.set(20);
+    b.sub(50);
+    REQUIRE(a.used() == 20);
+    REQUIRE(b.used() == 30);
+    REQUIRE(budget.used() == 50);
+
+    a.set(0);
+    b.sub(30);
+    REQUIRE(budget.used() == 0);
+}
+
+TEST_CASE("memory budget pressure", "[NoDB]")
+{
+    memory_budget_t budget;
+    budget.set_limit(1000);
+    REQUIRE(budget.accounting_enabled());
+
+    auto &consumer = budget.consumer("test");
+
+    consumer.set(500);
+    REQUIRE_FALSE(budget.under_pressure());
+    REQUIRE_FALSE(budget.exceeded());
+
+    consumer.set(950);
+    REQUIRE(budget.under_pressure());
+    REQUIRE_FALSE(budget.exceeded());
+
+    consumer.set(1200);
+    REQUIRE(budget.under_pressure());
+    REQUIRE(budget.exceeded());
+
+    consumer.set(100);
+    REQUIRE_FALSE(budget.under_pressure());
+    REQUIRE_FALSE(budget.exceeded());
+}
+
+TEST_CASE("memory sampler is only due if accounting is enabled", "[NoDB]")
+{
+    memory_sampler_t sampler;
+    for (std::size_t i = 0; i < memory_sampler_t::INTERVAL * 3; ++i) {
+        REQUIRE_FALSE(sampler.due());
+    }
+
+    get_memory_budget().enable_accounting();
+
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < memory_sampler_t::INTERVAL * 3; ++i) {
+        if (sampler.due()) {
+            ++count;
+        }
+    }
+    REQUIRE(count == 3);
+}
@@ -0,0 +1,132 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include <catch.hpp>
+
+#include "common-cleanup.hpp"
+#include "metrics.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+
+TEST_CASE("metrics: counter", "[NoDB]")
+{
+    auto &counter = metrics::counter("test_counter_total", "Test counter.");
+    REQUIRE(counter.value() == 0);
+
+    counter.add();
+    counter.add(41);
+    REQUIRE(counter.value() == 42);
+
+    // Same name gives same counter
+    REQUIRE(&metrics::counter("test_counter_total", "Test counter.") ==
+            &counter);
+
+    // Different labels give different counters
+    REQUIRE(&metrics::counter("test_counter_total", "Test counter.",
+                              metrics::label("x", "y")) != &counter);
+}
+
+TEST_CASE("metrics: gauge", "[NoDB]")
+{
+    auto &gauge = metrics::gauge("test_gauge", "Test gauge.");
+    REQUIRE(gauge.value() == Approx(0.0));
+
+    gauge.set(3.5);
+    REQUIRE(gauge.value() == Approx(3.5));
+
+    gauge.add(-1.5);
+    REQUIRE(gauge.value() == Approx(2.0));
+}
+
+TEST_CASE("metrics: scoped timer only measures if enabled", "[NoDB]")
+{
+    auto &counter =
+        metrics::time_counter("test_timer_seconds_total", "Test timer.");
+
+    REQUIRE_FALSE(metrics::timing_enabled());
+    {
+        metrics::scoped_timer_t const timer{&counter};
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+    REQUIRE(counter.value() == 0);
+
+    metrics::set_timing_enabled(true);
+    {
+        metrics::scoped_timer_t const timer{&counter};
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+    metrics::set_timing_enabled(false);
+    REQUIRE(counter.value() >= 1000000);
+}
+
+TEST_CASE("metrics: label escaping", "[NoDB]")
+{
+    REQUIRE(metrics::label("a", "foo") == "a=\"foo\"");
+    REQUIRE(metrics::label("a", "x\"y\\z\nw") == "a=\"x\\\"y\\\\z\\nw\"");
+}
+
+TEST_CASE("metrics: prometheus text format", "[NoDB]")
+{
+    metrics::counter("test_text_total", "Some counter.",
+                     metrics::label("type", "a"))
+        .add(3);
+    metrics::counter("test_text_total", "Some counter.",
+                     metrics::label("type", "b"))
+        .add(4);
+    metrics::add_duration(
+        &metrics::time_counter("test_text_seconds_total", "Some time."),
+        std::chrono::milliseconds{1500});
+
+    auto const text = metrics::to_prometheus_text();
+
+    REQUIRE(text.find("# HELP test_text_total Some counter.\n"
+                      "# TYPE test_text_total counter\n"
+                      "test_text_total{type=\"a\"} 3\n"
+                      "test_text_total{type=\"b\"} 4\n") != std::string::npos);
+    REQUIRE(text.find("# TYPE test_text_seconds_total counter\n"
+                      "test_text_seconds_total 1.500000\n") !=
+            std::string::npos);
+    REQUIRE(text.find("# TYPE osm2pgsql_memory_peak_bytes gauge\n") !=
+            std::string::npos);
+}
+
+TEST_CASE("metrics: write to file", "[NoDB]")
+{
+    std::string const filename{"test_metrics.prom"};
+    testing::cleanup::file_t const file_cleaner{filename};
+
+    metrics::counter("test_file_total", "Written to file.").add(7);
+    metrics::write_to_file(filename);
+
+    std::ifstream file{filename};
+    std::string const content{std::istreambuf_iterator<char>{file},
+                              std::istreambuf_iterator<char>{}};
+    REQUIRE(content.find("test_file_total 7\n") != std::string::npos);
+}
+
+TEST_CASE("metrics: file writer writes file on destruction", "[NoDB]")
+{
+    std::string const filename{"test_metrics_writer.prom"};
+    testing::cleanup::file_t const file_cleaner{filename};
+
+    {
+        metrics::file_writer_t const writer{filename,
+                                            std::chrono::seconds{3600}};
+        metrics::counter("test_writer_total", "Written by writer.").add(2);
+    }
+
+    std::ifstream file{filename};
+    std::string const content{std::istreambuf_iterator<char>{file},
+                              std::istreambuf_iterator<char>{}};
+    REQUIRE(content.find("test_writer_total 2\n") != std::string::npos);
+}
@@ -11,6 +11,7 @@
 
 #include <algorithm>
 #include <array>
+#include <filesystem>
 
 #include <osmium/osm/crc.hpp>
 #include <osmium/osm/crc_zlib.hpp>
@@ -1282,3 +1283,65 @@ TEMPLATE_TEST_CASE("middle: change nodes in relation", "", options_slim_default,
         check_relation(mid, rel31);
     }
 }
+
+namespace {
+
+void import_into_ram_middle(options_t const &options,
+                            std::shared_ptr<thread_pool_t> const &thread_pool)
+{
+    auto mid = std::make_shared<middle_ram_t>(thread_pool, &options);
+    mid->start();
+    mid->set_requirements(output_requirements{});
+
+    test_buffer_t buffer;
+    mid->node(buffer.add_node("n1234 x98.7654321 y12.3456789"));
+    mid->after_nodes();
+    mid->after_ways();
+    mid->after_relations();
+
+    auto &nodes = buffer.add_way("w3 Nn1234").nodes();
+    REQUIRE(mid->get_query_instance()->nodes_get_list(&nodes) == 1);
+
+    mid->stop();
+}
+
+} // anonymous namespace
+
+TEST_CASE("middle ram snapshot with flat node file")
+{
+    options_t options = testing::opt_t().flatnodes();
+    options.ram_snapshot_file = "test_middle_ram.snapshot";
+    testing::cleanup::file_t const flatnode_cleaner{options.flat_node_file};
+    testing::cleanup::file_t const snapshot_cleaner{options.ram_snapshot_file};
+
+    auto thread_pool = std::make_shared<thread_pool_t>(1U);
+
+    import_into_ram_middle(options, thread_pool);
+    REQUIRE(std::filesystem::exists(options.ram_snapshot_file));
+
+    SECTION("Snapshot is used with the same flat node file")
+    {
+        import_into_ram_middle(options, thread_pool);
+        REQUIRE(std::filesystem::exists(options.ram_snapshot_file));
+    }
+
+    SECTION("Snapshot is rejected if the flat node file has changed")
+    {
+        auto const size = std::filesystem::file_size(options.flat_node_file);
+        std::filesystem::resize_file(options.flat_node_file, size * 2);
+
+        auto mid = std::make_shared<middle_ram_t>(thread_pool, &options);
+        mid->start();
+        REQUIRE_THROWS_WITH(
+            mid->set_requirements(output_requirements{}),
+            Catch::Matchers::Contains("different flat node file"));
+    }
+
+    SECTION("Snapshot is removed together with the flat node file on --drop")
+    {
+        options.droptemp = true;
+        import_into_ram_middle(options, thread_pool);
+        REQUIRE_FALSE(std::filesystem::exists(options.flat_node_file));
+        REQUIRE_FALSE(std::filesystem::exists(options.ram_snapshot_file));
+    }
+}
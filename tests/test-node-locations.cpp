@@ -10,6 +10,9 @@
 #include <catch.hpp>
 
 #include "node-locations.hpp"
+#include "ram-snapshot.hpp"
+
+#include "common-cleanup.hpp"
 
 TEST_CASE("node locations basics", "[NoDB]")
 {
@@ -104,9 +107,52 @@ TEST_CASE("full node locations store", "[NoDB]")
     node_locations_t nl{30};
     REQUIRE(nl.size() == 0);
 
-    REQUIRE(nl.set(3, {1.2, 3.4}));
-    REQUIRE_FALSE(nl.set(5, {5.6, 7.8}));
+    // Memory is allocated in segments, so the store will take nodes until
+    // the first segment is full.
+    osmid_t id = 1;
+    while (nl.set(id, {1.2, 3.4})) {
+        ++id;
+        REQUIRE(id < 10000);
+    }
+
+    REQUIRE(static_cast<osmid_t>(nl.size()) == id - 1);
+    REQUIRE_FALSE(nl.set(id + 1, {5.6, 7.8}));
 
-    REQUIRE(nl.size() == 1);
+    REQUIRE(nl.get(1) == osmium::Location{1.2, 3.4});
+    REQUIRE(nl.get(id - 1) == osmium::Location{1.2, 3.4});
+    REQUIRE(nl.get(id) == osmium::Location{});
 }
 
+
+TEST_CASE("node locations snapshot", "[NoDB]")
+{
+    std::string const snapshot_file = "test_node_locations.snapshot";
+    testing::cleanup::file_t const snapshot_cleaner{snapshot_file};
+
+    {
+        node_locations_t nl;
+        for (osmid_t id = 1; id < 100; ++id) {
+            REQUIRE(nl.set(id * 3, {1.0 + id, 2.0 + id}));
+        }
+
+        ram_snapshot_writer_t writer{snapshot_file};
+        nl.write_snapshot(&writer);
+        writer.commit();
+    }
+
+    ram_snapshot_reader_t reader{snapshot_file};
+    node_locations_t nl;
+    nl.read_snapshot(&reader);
+    REQUIRE(reader.at_end());
+
+    REQUIRE(nl.size() == 99);
+    for (osmid_t id = 1; id < 100; ++id) {
+        REQUIRE(nl.get(id * 3) == osmium::Location{1.0 + id, 2.0 + id});
+        REQUIRE(nl.get(id * 3 + 1) == osmium::Location{});
+    }
+
+    // adding more locations after reading a snapshot works
+    REQUIRE(nl.set(1000, {5.0, 6.0}));
+    REQUIRE(nl.get(1000) == osmium::Location{5.0, 6.0});
+    REQUIRE(nl.get(297) == osmium::Location{100.0, 101.0});
+}
@@ -54,6 +54,58 @@ TEST_CASE("Incompatible arguments", "[NoDB]")
     bad_opt({"-j", "-k"}, "--hstore excludes --hstore-all");
 
     bad_opt({"-a"}, "--append can only be used with slim mode");
+
+    bad_opt({"--slim", "--ram-snapshot", "snapshot.bin"},
+            "--ram-snapshot can not be used in --slim mode");
+
+    bad_opt({"--slim", "--ram-compress"},
+            "--ram-compress can not be used in --slim mode");
+}
+
+TEST_CASE("Persistent mode", "[NoDB]")
+{
+    bad_opt({"--slim", "--persistent"},
+            "--persistent can only be used with --append");
+
+    bad_opt({"-a", "--slim", "--persistent"},
+            "can not be given on the command line with --persistent");
+
+    std::vector<char const *> opts = {"osm2pgsql", "-a", "--slim",
+                                      "--persistent"};
+    auto const options =
+        parse_command_line((int)opts.size(), (char **)opts.data());
+    REQUIRE(options.persistent);
+    REQUIRE(options.input_files.empty());
+}
+
+TEST_CASE("Rebuild output", "[NoDB]")
+{
+    bad_opt({"--rebuild-output", "-a"},
+            "--rebuild-output can not be used with --append");
+
+    bad_opt({"--rebuild-output", "--drop"},
+            "--rebuild-output can not be used with --drop");
+
+    bad_opt({"--rebuild-output"},
+            "Input files can not be used with --rebuild-output");
+
+    std::vector<char const *> opts = {"osm2pgsql", "--rebuild-output"};
+    auto const options =
+        parse_command_line((int)opts.size(), (char **)opts.data());
+    REQUIRE(options.rebuild_output);
+    REQUIRE(options.slim);
+    REQUIRE_FALSE(options.append);
+}
+
+TEST_CASE("Metrics options", "[NoDB]")
+{
+    bad_opt({"--metrics-interval=5"},
+            "--metrics-interval can only be used with --metrics-file");
+
+    auto const options =
+        opt({"--metrics-file=metrics.prom", "--metrics-interval=5"});
+    REQUIRE(options.metrics_file == "metrics.prom");
+    REQUIRE(options.metrics_interval == 5);
 }
 
 TEST_CASE("Middle selection", "[NoDB]")
@@ -71,6 +123,14 @@ TEST_CASE("Lua styles", "[NoDB]")
                         Catch::Matchers::Contains("File does not exist"));
 }
 
+TEST_CASE("Lua profiling only works with flex output", "[NoDB]")
+{
+    bad_opt({"--lua-profile=profile.txt"},
+            "--lua-profile can only be used with the flex output");
+    bad_opt({"--output=null", "--lua-profile=profile.txt"},
+            "--lua-profile can only be used with the flex output");
+}
+
 TEST_CASE("Parsing bbox", "[NoDB]")
 {
     auto const opt1 = opt({"-b", "1.2,3.4,5.6,7.8"});
@@ -10,6 +10,9 @@
 #include <catch.hpp>
 
 #include "ordered-index.hpp"
+#include "ram-snapshot.hpp"
+
+#include "common-cleanup.hpp"
 
 TEST_CASE("ordered index basics", "[NoDB]")
 {
@@ -143,3 +146,51 @@ TEST_CASE("ordered index with huge gaps in ids", "[NoDB]")
     REQUIRE(index.get_block((2ULL << 32U) + 9U) == 3);
     REQUIRE(index.get_block((3ULL << 32U) + 2U) == 3);
 }
+
+TEST_CASE("ordered index snapshot", "[NoDB]")
+{
+    std::string const snapshot_file = "test_ordered_index.snapshot";
+    testing::cleanup::file_t const snapshot_cleaner{snapshot_file};
+
+    constexpr std::size_t BLOCK_SIZE = 4;
+
+    {
+        ordered_index_t index{BLOCK_SIZE};
+        for (osmid_t id = 10; id < 50; ++id) {
+            index.add(id * 2, static_cast<std::size_t>(id) * 10);
+        }
+
+        ram_snapshot_writer_t writer{snapshot_file};
+        index.write_snapshot(&writer);
+        writer.commit();
+    }
+
+    ram_snapshot_reader_t reader{snapshot_file};
+    ordered_index_t index{BLOCK_SIZE};
+    index.read_snapshot(&reader);
+    REQUIRE(reader.at_end());
+
+    REQUIRE(index.size() == 40);
+    for (osmid_t id = 10; id < 50; ++id) {
+        REQUIRE(index.get(id * 2) == static_cast<std::size_t>(id) * 10);
+        REQUIRE(index.get(id * 2 + 1) == index.not_found_value());
+    }
+    REQUIRE(index.get(1) == index.not_found_value());
+}
+
+TEST_CASE("reading truncated snapshot fails", "[NoDB]")
+{
+    std::string const snapshot_file = "test_ordered_index.snapshot";
+    testing::cleanup::file_t const snapshot_cleaner{snapshot_file};
+
+    {
+        ram_snapshot_writer_t writer{snapshot_file};
+        writer.write_value<uint64_t>(16);
+        writer.commit();
+    }
+
+    ram_snapshot_reader_t reader{snapshot_file};
+    ordered_index_t index;
+    REQUIRE_THROWS_WITH(index.read_snapshot(&reader),
+                        Catch::Matchers::Contains("truncated"));
+}
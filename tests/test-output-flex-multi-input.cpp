@@ -75,3 +75,15 @@ TEST_CASE("should use newest version of any object")
     CHECK(1 == conn.get_count(POINT_TABLE, "tags->'a' = '13.2'"));
 }
 
+TEST_CASE("should detect unordered data in any input file")
+{
+    options_t const options = testing::opt_t().slim().flex(CONF_FILE);
+
+    REQUIRE_THROWS_WITH(
+        db.run_import(options, {"n10 v1 dV x10.0 y10.0\n"
+                                "n11 v1 dV x10.1 y10.1\n",
+                                "n13 v1 dV x10.3 y10.3\n"
+                                "n12 v1 dV x10.2 y10.2\n",
+                                "n14 v1 dV x10.4 y10.4\n"}),
+        "Input data is not ordered: node id 12 after 13.");
+}
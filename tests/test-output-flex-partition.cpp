@@ -0,0 +1,73 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include <catch.hpp>
+
+#include "common-import.hpp"
+#include "common-options.hpp"
+
+#include <string>
+
+namespace {
+
+testing::db::import_t db;
+
+char const *const CONF_FILE = "test_output_flex_partition.lua";
+char const *const DATA_FILE = "liechtenstein-2013-08-03.osm.pbf";
+
+int num_partitions(testing::pg::conn_t const &conn, std::string const &table)
+{
+    return conn.get_count("pg_catalog.pg_inherits",
+                          "inhparent = 'public." + table + "'::regclass");
+}
+
+} // anonymous namespace
+
+TEST_CASE("partitioned tables contain the same data as unpartitioned ones")
+{
+    options_t const options = testing::opt_t().slim().flex(CONF_FILE);
+
+    REQUIRE_NOTHROW(db.run_file(options, DATA_FILE));
+
+    auto conn = db.db().connect();
+
+    auto const count = conn.get_count("osm2pgsql_test_plain");
+    REQUIRE(count > 0);
+
+    REQUIRE(num_partitions(conn, "osm2pgsql_test_plain") == 0);
+    REQUIRE(num_partitions(conn, "osm2pgsql_test_by_type") == 3);
+    REQUIRE(num_partitions(conn, "osm2pgsql_test_by_id") == 4);
+    REQUIRE(num_partitions(conn, "osm2pgsql_test_by_tile") == 16);
+
+    REQUIRE(count == conn.get_count("osm2pgsql_test_by_type"));
+    REQUIRE(count == conn.get_count("osm2pgsql_test_by_id"));
+    REQUIRE(count == conn.get_count("osm2pgsql_test_by_tile"));
+
+    REQUIRE(conn.get_count("osm2pgsql_test_plain", "osm_type = 'W'") ==
+            conn.get_count("osm2pgsql_test_by_type_p1"));
+
+    // Liechtenstein is completely in tile 2/2/1
+    REQUIRE(count == conn.get_count("osm2pgsql_test_by_tile", "tile = 6"));
+    REQUIRE(count == conn.get_count("osm2pgsql_test_by_tile_p6"));
+
+    // No temporary tables left over from clustering
+    REQUIRE(0 == conn.get_count("pg_catalog.pg_class",
+                                "relname LIKE 'osm2pgsql_test_%_tmp%'"));
+
+    // The indexes on the partitioned tables were created
+    REQUIRE(1 == conn.get_count("pg_catalog.pg_indexes",
+                                "tablename = 'osm2pgsql_test_by_id' AND "
+                                "indexname = 'osm2pgsql_test_by_id_pkey'"));
+    REQUIRE(4 == conn.get_count("pg_catalog.pg_indexes",
+                                "tablename LIKE 'osm2pgsql_test_by_id_p_' AND "
+                                "indexdef LIKE '%UNIQUE%'"));
+    REQUIRE(16 == conn.get_count("pg_catalog.pg_indexes",
+                                 "tablename LIKE 'osm2pgsql_test_by_tile_p%' "
+                                 "AND indexdef LIKE '%gist%'"));
+}
@@ -299,3 +299,109 @@ TEMPLATE_TEST_CASE("multipolygons", "", options_slim_default,
     REQUIRE(0 ==
             conn.get_count(with_schema("osm2pgsql_test_polygon", options)));
 }
+
+TEST_CASE("only newest version of object in change file is used")
+{
+    options_t options = options_slim_default::options();
+
+    REQUIRE_NOTHROW(db.run_import(options,
+                                  "n10 v1 dV x10.0 y10.0 Tamenity=bench\n"
+                                  "n11 v1 dV x10.1 y10.1\n"
+                                  "n12 v1 dV x10.2 y10.2\n"
+                                  "w20 v1 dV Thighway=primary Nn10,n11\n"));
+
+    auto conn = db.db().connect();
+
+    REQUIRE(1 == conn.get_count("osm2pgsql_test_point"));
+    REQUIRE(1 == conn.get_count("osm2pgsql_test_line"));
+
+    // A single change file with several versions of the same objects.
+    // Without merging, the input checks would reject the duplicates.
+    options.append = true;
+    REQUIRE_NOTHROW(db.run_import(options,
+                                  "n10 v2 dV x10.0 y10.0 Tamenity=restaurant\n"
+                                  "n10 v3 dV x10.0 y10.0 Tamenity=cafe\n"
+                                  "n10 v4 dV x10.0 y10.0 Tamenity=pub\n"
+                                  "w20 v2 dV Thighway=secondary Nn10,n11\n"
+                                  "w20 v3 dV Thighway=tertiary Nn10,n11,n12\n",
+                                  "opl,history=true"));
+
+    REQUIRE(1 == conn.get_count("osm2pgsql_test_point"));
+    REQUIRE(1 == conn.get_count("osm2pgsql_test_point",
+                                "node_id = 10 AND tags->'amenity' = 'pub'"));
+    REQUIRE(1 == conn.get_count("osm2pgsql_test_line"));
+    REQUIRE(1 == conn.get_count("osm2pgsql_test_line",
+                                "osm_id = 20 AND tags->'highway' = "
+                                "'tertiary' AND ST_NumPoints(geom) = 3"));
+}
+
+TEST_CASE("delete wins over modify with same version in change file")
+{
+    options_t options = options_slim_default::options();
+
+    REQUIRE_NOTHROW(
+        db.run_import(options, "n10 v1 dV x10.0 y10.0 Tamenity=bench\n"));
+
+    auto conn = db.db().connect();
+
+    REQUIRE(1 == conn.get_count("osm2pgsql_test_point"));
+
+    options.append = true;
+
+    SECTION("delete after modify")
+    {
+        REQUIRE_NOTHROW(
+            db.run_import(options,
+                          "n10 v2 dV x10.0 y10.0 Tamenity=restaurant\n"
+                          "n10 v2 dD\n",
+                          "opl,history=true"));
+    }
+
+    SECTION("delete before modify")
+    {
+        REQUIRE_NOTHROW(
+            db.run_import(options,
+                          "n10 v2 dD\n"
+                          "n10 v2 dV x10.0 y10.0 Tamenity=restaurant\n",
+                          "opl,history=true"));
+    }
+
+    REQUIRE(0 == conn.get_count("osm2pgsql_test_point"));
+}
+
+TEST_CASE("change files applied one after the other in the same process")
+{
+    options_t const options = options_slim_default::options();
+
+    REQUIRE_NOTHROW(db.run_import(options,
+                                  "n10 v1 dV x10.0 y10.0\n"
+                                  "n11 v1 dV x10.0 y10.1\n"
+                                  "w20 v1 dV Thighway=primary Nn10,n11\n"));
+
+    // The second change file modifies objects created in the first one and
+    // has lower ids than the first one.
+    REQUIRE_NOTHROW(db.run_rounds(
+        options, {"n12 v1 dV x10.1 y10.1\n"
+                  "w21 v1 dV Thighway=secondary Nn11,n12\n",
+                  "n11 v2 dV x10.0 y10.2\n"
+                  "n12 v2 dV x10.1 y10.3\n"
+                  "w21 v2 dV Thighway=tertiary Nn11,n12\n"}));
+
+    auto conn = db.db().connect();
+
+    REQUIRE(1 == conn.get_count("planet_osm_nodes", "id = 12"));
+    REQUIRE(1 == conn.get_count("planet_osm_ways", "id = 21"));
+
+    REQUIRE(2 == conn.get_count("osm2pgsql_test_line"));
+    REQUIRE(1 == conn.get_count("osm2pgsql_test_line",
+                                "osm_id = 21 AND tags->'highway' = "
+                                "'tertiary'"));
+
+    // Both ways must use the new locations of the nodes.
+    REQUIRE(1 == conn.get_count("osm2pgsql_test_line",
+                                "osm_id = 20 AND abs(ST_Y(ST_Transform("
+                                "ST_EndPoint(geom), 4326)) - 10.2) < 0.0001"));
+    REQUIRE(1 == conn.get_count("osm2pgsql_test_line",
+                                "osm_id = 21 AND abs(ST_Y(ST_Transform("
+                                "ST_EndPoint(geom), 4326)) - 10.3) < 0.0001"));
+}
@@ -12,6 +12,8 @@
 #include "common-import.hpp"
 #include "common-options.hpp"
 
+#include "format.hpp"
+
 namespace {
 
 testing::db::import_t db;
@@ -55,3 +57,131 @@ TEMPLATE_TEST_CASE("liechtenstein regression", "", options_slim_default,
     CHECK(4136 == conn.get_count("osm2pgsql_test_polygon"));
     CHECK(35 == conn.get_count("osm2pgsql_test_route"));
 }
+
+TEST_CASE("rebuild output from middle")
+{
+    options_t options = options_slim_default::options();
+    options.num_procs = 2;
+
+    char const *const data = "n10 v1 dV x10.0 y10.0\n"
+                             "n11 v1 dV Tamenity=cafe x10.1 y10.1\n"
+                             "n12 v1 dV x10.2 y10.2\n"
+                             "n13 v1 dV x10.2 y10.0\n"
+                             "w20 v1 dV Thighway=primary Nn10,n12\n"
+                             "w21 v1 dV Tbuilding=yes Nn10,n12,n13,n10\n"
+                             "r30 v1 dV Ttype=route,route=bus Mw20@\n";
+
+    REQUIRE_NOTHROW(db.run_import(options, data));
+
+    auto conn = db.db().connect();
+
+    CHECK(1 == conn.get_count("osm2pgsql_test_point"));
+    CHECK(1 == conn.get_count("osm2pgsql_test_line"));
+    CHECK(1 == conn.get_count("osm2pgsql_test_polygon"));
+    CHECK(1 == conn.get_count("osm2pgsql_test_route"));
+
+    conn.exec("DELETE FROM osm2pgsql_test_point");
+    conn.exec("DELETE FROM osm2pgsql_test_line");
+    conn.exec("DELETE FROM osm2pgsql_test_route");
+
+    REQUIRE_NOTHROW(db.run_rebuild_output(options));
+
+    CHECK(1 == conn.get_count("osm2pgsql_test_point", "node_id = 11"));
+    CHECK(1 == conn.get_count("osm2pgsql_test_line", "osm_id = 20"));
+    CHECK(1 == conn.get_count("osm2pgsql_test_polygon", "osm_id = 21"));
+    CHECK(1 == conn.get_count("osm2pgsql_test_route", "osm_id = 30"));
+
+    // middle tables are still there and unchanged
+    CHECK(4 == conn.get_count("planet_osm_nodes"));
+    CHECK(2 == conn.get_count("planet_osm_ways"));
+    CHECK(1 == conn.get_count("planet_osm_rels"));
+}
+
+TEST_CASE("relations are processed in parallel on import")
+{
+    // Relations are only processed in parallel if the middle has the
+    // attributes.
+    options_t options = options_slim_default::options();
+    options.num_procs = 3;
+    options.extra_attributes = true;
+
+    std::string data{"n10 v1 dV x10.0 y10.0\n"
+                     "n11 v1 dV x10.0 y10.1\n"
+                     "n12 v1 dV x10.1 y10.1\n"
+                     "n13 v1 dV x10.1 y10.0\n"
+                     "w20 v1 dV Nn10,n11,n12\n"
+                     "w21 v1 dV Nn12,n13,n10\n"};
+
+    // Relation ids spread over several id ranges
+    for (int i = 1; i <= 5; ++i) {
+        data += fmt::format("r{} v1 dV Ttype=multipolygon,landuse=forest "
+                            "Mw20@,w21@\n",
+                            i * 7000);
+    }
+    data += "r90000 v1 dV Ttype=route,route=bus Mw20@\n";
+
+    REQUIRE_NOTHROW(db.run_import(options, data.c_str()));
+
+    auto conn = db.db().connect();
+
+    CHECK(6 == conn.get_count("planet_osm_rels"));
+    CHECK(5 == conn.get_count("osm2pgsql_test_polygon",
+                              "osm_id < 0 AND ST_GeometryType(geom) = "
+                              "'ST_Polygon'"));
+    CHECK(1 == conn.get_count("osm2pgsql_test_route", "osm_id = 90000"));
+}
+
+TEST_CASE("relations processed in parallel have same attributes and tags")
+{
+    std::string const data{
+        "n10 v1 dV x10.0 y10.0\n"
+        "n11 v1 dV x10.0 y10.1\n"
+        "n12 v1 dV x10.1 y10.1\n"
+        "n13 v1 dV x10.1 y10.0\n"
+        "w20 v1 dV Nn10,n11,n12\n"
+        "w21 v1 dV Nn12,n13,n10\n"
+        "r1 v3 dV c101 t2020-01-02T03:04:05Z i11 uAlice "
+        "Ttype=multipolygon,name=Wood,landuse=forest Mw20@,w21@\n"
+        "r7000 v1 dV c102 t2021-02-03T04:05:06Z i12 uBob "
+        "Troute=bus,type=route,name=42 Mw20@\n"
+        "r25000 v7 dV c103 t2022-03-04T05:06:07Z i13 uCarol "
+        "Ttype=site,b=2,a=1 Mn10@,w21@\n"};
+
+    char const *const query =
+        "SELECT string_agg(concat_ws(' ', relation_id, version, timestamp,"
+        " changeset, uid, \"user\", tags::text, ST_AsText(geom)), '|'"
+        " ORDER BY relation_id) FROM osm2pgsql_test_attributes";
+
+    auto const import = [&](unsigned int num_procs, bool extra_attributes) {
+        options_t options =
+            testing::opt_t().slim().flex("test_output_flex_attributes.lua");
+        options.num_procs = num_procs;
+        options.extra_attributes = extra_attributes;
+        REQUIRE_NOTHROW(db.run_import(options, data.c_str()));
+        return db.db().connect().result_as_string(query);
+    };
+
+    auto const single = import(1, true);
+
+    auto conn = db.db().connect();
+    CHECK(3 == conn.get_count("osm2pgsql_test_attributes"));
+    CHECK(1 == conn.get_count("osm2pgsql_test_attributes",
+                              "relation_id = 1 AND version = 3 AND "
+                              "changeset = 101 AND uid = 11 AND "
+                              "\"user\" = 'Alice' AND "
+                              "tags->>'name' = 'Wood' AND "
+                              "geom IS NOT NULL"));
+
+    SECTION("deferred processing with attributes in middle")
+    {
+        CHECK(import(3, true) == single);
+    }
+
+    SECTION("processing while reading without attributes in middle")
+    {
+        CHECK(import(3, false) == import(1, false));
+        CHECK(1 == conn.get_count("osm2pgsql_test_attributes",
+                                  "relation_id = 25000 AND version = 7 AND "
+                                  "\"user\" = 'Carol'"));
+    }
+}
@@ -10,8 +10,13 @@
 #include <catch.hpp>
 
 #include "common-import.hpp"
+#include "pgsql-helper.hpp"
 #include "pgsql.hpp"
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
 namespace {
 
 testing::db::import_t db;
@@ -129,6 +134,89 @@ TEST_CASE("exec_prepared with mixed parameter types should work")
     REQUIRE(result.get(0, 0) == "33"); // 7 + 9 + 17
 }
 
+TEST_CASE("exec_params with binary array parameter should work")
+{
+    auto const conn = db.db().connect();
+
+    pg_binary_array_t ids{pg_binary_array_t::INT8_OID, 3};
+    ids.add(std::int64_t{3});
+    ids.add(std::int64_t{-5});
+    ids.add(std::int64_t{10000000000});
+
+    auto const result =
+        conn.exec_params("SELECT sum(x) FROM unnest($1::int8[]) AS t(x)",
+                         binary_param_t{ids.data()});
+    REQUIRE(result.num_tuples() == 1);
+    REQUIRE(result.get(0, 0) == "9999999998");
+}
+
+TEST_CASE("binary int8 and float8 results can be decoded")
+{
+    auto const conn = db.db().connect();
+    conn.exec("PREPARE test AS SELECT (-10000000000)::int8, (-2.5)::float8");
+
+    auto const result = conn.exec_prepared_as_binary("test");
+    REQUIRE(result.num_tuples() == 1);
+    REQUIRE(result.get_length(0, 0) == 8);
+    REQUIRE(result.get_length(0, 1) == 8);
+    REQUIRE(decode_binary_int8(result.get_value(0, 0)) == -10000000000);
+    REQUIRE(decode_binary_float8(result.get_value(0, 1)) == -2.5);
+}
+
+TEST_CASE("pipeline with callbacks returns results in order")
+{
+    auto const conn = db.db().connect();
+    conn.exec("PREPARE test(int) AS SELECT $1 * 2");
+
+    std::vector<std::string> results;
+    pg_pipeline_t pipeline{conn, 3};
+    for (int i = 0; i < 10; ++i) {
+        pipeline.exec_prepared_with_result(
+            [&](pg_result_t const &result) {
+                results.emplace_back(result.get(0, 0));
+            },
+            "test", i);
+    }
+    pipeline.finish();
+
+    REQUIRE(results.size() == 10);
+    REQUIRE(results[0] == "0");
+    REQUIRE(results[9] == "18");
+}
+
+TEST_CASE("pipeline runs inserts")
+{
+    auto const conn = db.db().connect();
+    conn.exec("CREATE TABLE pipeline_ins (x int)");
+    conn.exec("PREPARE ins(int) AS INSERT INTO pipeline_ins (x) VALUES ($1)");
+
+    {
+        pg_pipeline_t pipeline{conn};
+        for (int i = 0; i < 100; ++i) {
+            pipeline.exec_prepared("ins", i);
+        }
+        pipeline.finish();
+    }
+
+    auto const result = conn.exec("SELECT count(*) FROM pipeline_ins");
+    REQUIRE(result.get(0, 0) == "100");
+}
+
+TEST_CASE("pipeline with failing statement should fail")
+{
+    auto const conn = db.db().connect();
+    conn.exec("PREPARE test(int) AS SELECT 1 / $1");
+
+    pg_pipeline_t pipeline{conn};
+    pipeline.exec_prepared("test", 1);
+    pipeline.exec_prepared("test", 0);
+    pipeline.exec_prepared("test", 2);
+    REQUIRE_THROWS(pipeline.finish());
+
+    // connection is usable again after the pipeline is finished
+    REQUIRE(conn.exec("SELECT 42").get(0, 0) == "42");
+}
+
 TEST_CASE("create table and insert something")
 {
     auto const conn = db.db().connect();
@@ -12,6 +12,63 @@
 #include "projection.hpp"
 #include "reprojection.hpp"
 
+#include <thread>
+#include <vector>
+
+namespace {
+
+void check_reproject_points(reprojection_t const &reprojection)
+{
+    std::vector<geom::point_t> points{{0.0, 0.0},
+                                      {10.0, 53.0},
+                                      {-180.0, -85.0511288},
+                                      {180.0, 85.0511288},
+                                      {7.5, -33.3}};
+    auto const orig = points;
+
+    reprojection.reproject_points(points.data(), points.size());
+
+    REQUIRE(points.size() == orig.size());
+    for (std::size_t i = 0; i < points.size(); ++i) {
+        auto const c = reprojection.reproject(orig[i]);
+        REQUIRE(points[i].x() == Approx(c.x()));
+        REQUIRE(points[i].y() == Approx(c.y()));
+    }
+
+    // doesn't do anything and doesn't crash on empty input
+    reprojection.reproject_points(nullptr, 0);
+}
+
+void check_projection_in_threads(int srs)
+{
+    geom::point_t const point{10.0, 53.0};
+    auto const expected = get_projection(srs).reproject(point);
+
+    std::vector<geom::point_t> results(4);
+    std::vector<reprojection_t const *> objects(results.size());
+    std::vector<std::thread> threads;
+    for (std::size_t n = 0; n < results.size(); ++n) {
+        threads.emplace_back([&, n]() {
+            auto const &reprojection = get_projection(srs);
+            objects[n] = &reprojection;
+            for (int i = 0; i < 1000; ++i) {
+                results[n] = reprojection.reproject(point);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    for (std::size_t n = 0; n < results.size(); ++n) {
+        REQUIRE(results[n].x() == Approx(expected.x()));
+        REQUIRE(results[n].y() == Approx(expected.y()));
+        REQUIRE(objects[n] != &get_projection(srs));
+    }
+}
+
+} // anonymous namespace
+
 TEST_CASE("projection 4326", "[NoDB]")
 {
     osmium::Location const loc{10.0, 53.0};
@@ -85,6 +142,32 @@ TEST_CASE("projection 3857 bounds", "[NoDB]")
     }
 }
 
+TEST_CASE("reproject multiple points 4326", "[NoDB]")
+{
+    auto const reprojection =
+        reprojection_t::create_projection(PROJ_LATLONG);
+    check_reproject_points(*reprojection);
+}
+
+TEST_CASE("reproject multiple points 3857", "[NoDB]")
+{
+    auto const reprojection =
+        reprojection_t::create_projection(PROJ_SPHERE_MERC);
+    check_reproject_points(*reprojection);
+}
+
+TEST_CASE("get_projection returns same object in same thread", "[NoDB]")
+{
+    REQUIRE(&get_projection(PROJ_SPHERE_MERC) ==
+            &get_projection(PROJ_SPHERE_MERC));
+    REQUIRE(get_projection(PROJ_LATLONG).target_srs() == PROJ_LATLONG);
+}
+
+TEST_CASE("get_projection in several threads 3857", "[NoDB]")
+{
+    check_projection_in_threads(PROJ_SPHERE_MERC);
+}
+
 #ifdef HAVE_GENERIC_PROJ
 TEST_CASE("projection 5651", "[NoDB]")
 {
@@ -103,4 +186,40 @@ TEST_CASE("projection 5651", "[NoDB]")
     REQUIRE(ct.x() == Approx(1113194.91));
     REQUIRE(ct.y() == Approx(6982997.92));
 }
+
+TEST_CASE("reproject multiple points 3035", "[NoDB]")
+{
+    auto const reprojection = reprojection_t::create_projection(3035);
+    check_reproject_points(*reprojection);
+}
+
+TEST_CASE("get_projection in several threads 3035", "[NoDB]")
+{
+    check_projection_in_threads(3035);
+}
+
+TEST_CASE("generic projection object used in several threads", "[NoDB]")
+{
+    auto const reprojection = reprojection_t::create_projection(3035);
+    geom::point_t const point{10.0, 53.0};
+    auto const expected = reprojection->reproject(point);
+
+    std::vector<geom::point_t> results(4);
+    std::vector<std::thread> threads;
+    for (std::size_t n = 0; n < results.size(); ++n) {
+        threads.emplace_back([&, n]() {
+            for (int i = 0; i < 1000; ++i) {
+                results[n] = reprojection->reproject(point);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    for (auto const &result : results) {
+        REQUIRE(result.x() == Approx(expected.x()));
+        REQUIRE(result.y() == Approx(expected.y()));
+    }
+}
 #endif
@@ -0,0 +1,161 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This file is part of osm2pgsql (https://osm2pgsql.org/).
+ *
+ * Copyright (C) 2006-2026 by the osm2pgsql developer community.
+ * For a full list of authors see the git log.
+ */
+
+#include <catch.hpp>
+
+#include "ram-snapshot.hpp"
+#include "segmented-buffer.hpp"
+
+#include "common-cleanup.hpp"
+
+#include <protozero/varint.hpp>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+std::size_t add_string(segmented_buffer_t *buffer, std::string const &str)
+{
+    auto const offset = buffer->prepare(str.size());
+    buffer->append(str.data(), str.size());
+    return offset;
+}
+
+std::string get_string(segmented_buffer_t const &buffer, std::size_t offset,
+                       std::size_t size)
+{
+    return std::string(buffer.data(offset), size);
+}
+
+} // anonymous namespace
+
+TEST_CASE("segment size must be a power of two", "[NoDB]")
+{
+    REQUIRE_THROWS(segmented_buffer_t{5000});
+    REQUIRE_THROWS(segmented_buffer_t{1024});
+    REQUIRE_NOTHROW(segmented_buffer_t{4096});
+}
+
+TEST_CASE("empty segmented buffer", "[NoDB]")
+{
+    segmented_buffer_t const buffer{4096};
+    REQUIRE(buffer.empty());
+    REQUIRE(buffer.size() == 0);
+    REQUIRE(buffer.capacity() == 0);
+    REQUIRE(buffer.num_segments() == 0);
+}
+
+TEST_CASE("entries in segmented buffer never straddle segments", "[NoDB]")
+{
+    segmented_buffer_t buffer{4096};
+
+    std::string const str(1000, 'x');
+    std::vector<std::size_t> offsets;
+    for (int i = 0; i < 10; ++i) {
+        offsets.push_back(add_string(&buffer, str));
+    }
+
+    REQUIRE(buffer.size() == 10000);
+    REQUIRE(buffer.num_segments() == 3);
+    REQUIRE(buffer.capacity() == 3 * 4096);
+
+    for (std::size_t i = 1; i < offsets.size(); ++i) {
+        REQUIRE(offsets[i - 1] < offsets[i]);
+    }
+    REQUIRE(offsets[3] == 3000);
+    REQUIRE(offsets[4] == 4096);
+    REQUIRE(offsets[5] == 4096 + 1000);
+
+    for (auto const offset : offsets) {
+        REQUIRE(get_string(buffer, offset, 1000) == str);
+        REQUIRE(buffer.end_of(offset) - buffer.data(offset) >= 1000);
+    }
+
+    buffer.clear();
+    REQUIRE(buffer.empty());
+    REQUIRE(buffer.capacity() == 0);
+}
+
+TEST_CASE("oversized entries in segmented buffer", "[NoDB]")
+{
+    segmented_buffer_t buffer{4096};
+
+    auto const o1 = add_string(&buffer, "abc");
+    std::string const large(10000, 'y');
+    auto const o2 = add_string(&buffer, large);
+    auto const o3 = add_string(&buffer, "def");
+
+    REQUIRE(o1 == 0);
+    REQUIRE(o2 == 4096);
+    REQUIRE(o3 == 4 * 4096);
+    REQUIRE(buffer.num_segments() == 3);
+    REQUIRE(buffer.capacity() == 5 * 4096);
+
+    REQUIRE(get_string(buffer, o1, 3) == "abc");
+    REQUIRE(get_string(buffer, o2, large.size()) == large);
+    REQUIRE(get_string(buffer, o3, 3) == "def");
+}
+
+TEST_CASE("varints in segmented buffer", "[NoDB]")
+{
+    segmented_buffer_t buffer{4096};
+
+    std::vector<std::size_t> offsets;
+    for (std::uint64_t n = 0; n < 1000; ++n) {
+        offsets.push_back(buffer.prepare(protozero::max_varint_length));
+        buffer.append_varint(n * n * n);
+    }
+    REQUIRE(buffer.num_segments() > 1);
+
+    for (std::uint64_t n = 0; n < 1000; ++n) {
+        char const *begin = buffer.data(offsets[n]);
+        REQUIRE(protozero::decode_varint(&begin, buffer.end_of(offsets[n])) ==
+                n * n * n);
+    }
+}
+
+TEST_CASE("segmented buffer snapshot", "[NoDB]")
+{
+    std::string const snapshot_file = "test_segmented_buffer.snapshot";
+    testing::cleanup::file_t const snapshot_cleaner{snapshot_file};
+
+    std::string const large(10000, 'z');
+    std::size_t o1 = 0;
+    std::size_t o2 = 0;
+    {
+        segmented_buffer_t buffer{4096};
+        o1 = add_string(&buffer, "foo");
+        o2 = add_string(&buffer, large);
+
+        ram_snapshot_writer_t writer{snapshot_file};
+        buffer.write_snapshot(&writer);
+        writer.commit();
+    }
+
+    {
+        ram_snapshot_reader_t reader{snapshot_file};
+        segmented_buffer_t buffer{8192};
+        REQUIRE_THROWS(buffer.read_snapshot(&reader));
+    }
+
+    ram_snapshot_reader_t reader{snapshot_file};
+    segmented_buffer_t buffer{4096};
+    buffer.read_snapshot(&reader);
+    REQUIRE(reader.at_end());
+
+    REQUIRE(buffer.size() == 10003);
+    REQUIRE(get_string(buffer, o1, 3) == "foo");
+    REQUIRE(get_string(buffer, o2, large.size()) == large);
+
+    // adding more data after reading a snapshot works
+    auto const o3 = add_string(&buffer, "bar");
+    REQUIRE(o3 > o2);
+    REQUIRE(get_string(buffer, o3, 3) == "bar");
+}
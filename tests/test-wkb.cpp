@@ -187,4 +187,16 @@ TEST_CASE("wkb: geometrycollection", "[NoDB]")
     REQUIRE(result == geom);
 }
 
+TEST_CASE("wkb: append to existing string", "[NoDB]")
+{
+    geom::geometry_t const geom{
+        geom::linestring_t{{1.2, 2.3}, {3.4, 4.5}, {5.6, 6.7}}, 43};
+
+    std::string data{"foo"};
+    geom_to_ewkb(&data, geom, true);
+
+    REQUIRE(data.substr(0, 3) == "foo");
+    REQUIRE(data.substr(3) == geom_to_ewkb(geom, true));
+}
+
 TEST_CASE("wkb: invalid", "[NoDB]") { REQUIRE_THROWS(ewkb_to_geom("INVALID")); }